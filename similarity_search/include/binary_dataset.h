@@ -0,0 +1,86 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _BINARY_DATASET_H_
+#define _BINARY_DATASET_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "global.h"
+#include "object.h"
+#include "object_arena.h"
+
+namespace similarity {
+
+using std::string;
+
+/*
+ * Structure of the binary data set file:
+ *
+ * | header | padding | object 1 | padding | object 2 | padding | ...
+ *
+ * Each object is stored exactly as the Object buffer: | id | datasize | data |
+ * Objects start on 16-byte boundaries (the header size is also a multiple of 16).
+ * Hence, the file can be memory-mapped and objects can point directly to the mapping.
+ *
+ * Note that objects are stored after the space has transformed them
+ * (e.g., after logarithms are precomputed). Thus, the file can be used
+ * only with the same space (and the same distance value type).
+ */
+#define BINARY_DATASET_MAGIC      "NMSLBIN1"
+#define BINARY_DATASET_VERSION    1
+#define BINARY_DATASET_ALIGNMENT  16
+
+struct BinaryDatasetHeader {
+  char      magic[8];
+  uint64_t  version;
+  uint64_t  headerSize;   // The offset of the first object
+  uint64_t  objQty;
+  uint64_t  dimension;    // The dimensionality of dense vectors (0 for other spaces)
+  char      spaceDesc[256];
+  char      distType[16];
+};
+
+bool IsBinaryDataset(const char* FileName);
+
+void WriteBinaryDataset(const string& FileName,
+                        const string& SpaceDesc,
+                        const string& DistType,
+                        unsigned dimension,
+                        const ObjectVector& dataset);
+
+/*
+ * If the arena is not NULL, the file is mapped into memory and
+ * objects point to the mapping (the arena keeps the mapping alive).
+ * Otherwise, objects are copied to the heap and the caller is
+ * responsible for deleting them.
+ *
+ * RequestedDim should be either zero or match the dimensionality
+ * stored during conversion: the data can't be truncated at load time.
+ */
+void ReadBinaryDataset(ObjectVector& dataset,
+                       ObjectArena* arena,
+                       const string& SpaceDesc,
+                       const string& DistType,
+                       const char* FileName,
+                       unsigned RequestedDim,
+                       const int MaxNumObjects);
+
+}   // namespace similarity
+
+#endif    // _BINARY_DATASET_H_
@@ -57,6 +57,19 @@ template <class T> T L2NormSIMD(const T* pVect1, const T* pVect2, size_t qty);
 
 float L2SqrSIMD(const float* pVect1, const float* pVect2, size_t qty);
 
+/*
+ * The same norms for vectors stored in the transposed (structure-of-arrays) layout:
+ * the j-th element of the i-th vector is pBlock[j * stride + i]. Distances to the vectors
+ * start, ..., start + qty - 1 are stored in pOut[0], ..., pOut[qty - 1].
+ * The stride (i.e., the number of vectors) should be at least kTransposedLaneQty,
+ * because all the vectors in the block can be accessed.
+ */
+const size_t kTransposedLaneQty = 16;
+
+template <class T> void LInfNormTransposed(const T* pQuery, const T* pBlock, size_t dim, size_t stride, size_t start, size_t qty, T* pOut);
+template <class T> void L1NormTransposed(const T* pQuery, const T* pBlock, size_t dim, size_t stride, size_t start, size_t qty, T* pOut);
+template <class T> void L2NormTransposed(const T* pQuery, const T* pBlock, size_t dim, size_t stride, size_t start, size_t qty, T* pOut);
+
 /*
  * Scalar product related distances 
  */
@@ -27,73 +27,23 @@
 #include "object.h"
 #include "index.h"
 #include "knnqueue.h"
+#include "gold_standard.h"
 
 namespace similarity {
 
-template <class dist_t>
-class GoldStandard {
-public:
-  GoldStandard(const typename similarity::Space<dist_t>* space,
-              const ObjectVector& datapoints, 
-              const typename similarity::KNNQuery<dist_t>* query 
-              ) {
-    DoSeqSearch(space, datapoints, query->QueryObject());
-  }
-  GoldStandard(const typename similarity::Space<dist_t>* space,
-              const ObjectVector& datapoints, 
-              const typename similarity::RangeQuery<dist_t>* query 
-              ) {
-    DoSeqSearch(space, datapoints, query->QueryObject());
-  }
-  uint64_t GetSeqSearchTime()     const { return SeqSearchTime_; }
-  uint64_t GetSeqSearchCPUTime()  const { return SeqSearchCPUTime_; }
-
-  const DistObjectPairVector<dist_t>&   GetExactDists() const { return  ExactDists_;}
-private:
-  void DoSeqSearch(const similarity::Space<dist_t>* space,
-                   const ObjectVector&              datapoints,
-                   const Object*                    query) {
-    WallClockTimer  wtm;
-    CPUTimer        ctm;
-
-    wtm.reset();
-    ctm.reset();
-
-    ExactDists_.resize(datapoints.size());
-
-    for (size_t i = 0; i < datapoints.size(); ++i) {
-      // Distance can be asymmetric, but the query is always on the right side
-      ExactDists_[i] = std::make_pair(space->IndexTimeDistance(datapoints[i], query), datapoints[i]);
-    }
-
-    wtm.split();
-    ctm.split();
-
-    SeqSearchTime_ = wtm.elapsed();
-    SeqSearchCPUTime_ = ctm.elapsed();
-
-    std::sort(ExactDists_.begin(), ExactDists_.end());
-  }
-
-  uint64_t                            SeqSearchTime_;
-  uint64_t                            SeqSearchCPUTime_;
-
-  DistObjectPairVector<dist_t>        ExactDists_;
-};
-
 template <class dist_t>
 class EvalResults {
 public:
   EvalResults(const typename similarity::Space<dist_t>* space,
                    const typename similarity::KNNQuery<dist_t>* query,
-                   const GoldStandard<dist_t>& gs) : K_(0), ExactDists_(gs.GetExactDists()) {
+                   const GoldStandard<dist_t>& gs) : K_(0), ExactDists_(gs.GetExactDists()), SortedDists_(gs.GetSortedDists()) {
     GetKNNData(query);
     ComputeMetrics();
   }
 
   EvalResults(const typename similarity::Space<dist_t>* space,
                    const typename similarity::RangeQuery<dist_t>* query,
-                   const GoldStandard<dist_t>& gs) : K_(0), ExactDists_(gs.GetExactDists()) {
+                   const GoldStandard<dist_t>& gs) : K_(0), ExactDists_(gs.GetExactDists()), SortedDists_(gs.GetSortedDists()) {
     GetRangeData(query);
     ComputeMetrics();
   }
@@ -162,10 +112,11 @@ private:
       else break; // ExactDists are sorted by distance
     }
 
-    unique_ptr<KNNQueue<dist_t>> ResQ(query->Result()->Clone());
+    const KNNQueue<dist_t>* ResQ = query->Result();
 
-    while (!ResQ->Empty()) {
-      const Object* ResObject = reinterpret_cast<const Object*>(ResQ->TopObject());
+    // Distances are visited in the order of increasing values
+    for (auto it = ResQ->SortedBegin(); it != ResQ->SortedEnd(); ++it) {
+      const Object* ResObject = reinterpret_cast<const Object*>(it->second);
       CHECK(ResObject);
       /*
        * A search method can potentially return duplicate records.
@@ -173,9 +124,8 @@ private:
        */
       if (ApproxResultSet_.find(ResObject->id()) == ApproxResultSet_.end()) {
         ApproxResultSet_.insert(ResObject->id());
-        ApproxDists_.insert(ApproxDists_.begin(), ResQ->TopDistance());
+        ApproxDists_.push_back(it->first);
       }
-      ResQ->Pop();
     }
   }
 
@@ -228,17 +178,21 @@ private:
     if (ApproxDists_.size()) { 
       // 2. Compute the number of points closer to the 1-NN then the first result.
       CHECK(!ApproxDists_.empty());
-      for (size_t p = 0; p < ExactDists_.size(); ++p) {
-        if (ExactDists_[p].first >= ApproxDists_[0]) break;
+      for (size_t p = 0; p < SortedDists_.size(); ++p) {
+        if (SortedDists_[p] >= ApproxDists_[0]) break;
         ++NumberCloser_;
       }
       // 3. Compute the relative position error and the precision of approximation
-      CHECK(ApproxDists_.size() <= ExactDists_.size());
+      CHECK(ApproxDists_.size() <= SortedDists_.size());
 
       for (size_t k = 0, p = 0; k < ApproxDists_.size(); ++k) {
-        if (ApproxDists_[k] -  ExactDists_[p].first < 0) {
-          double mx = std::abs(std::max(ApproxDists_[k], ExactDists_[p].first));
-          double mn = std::abs(std::min(ApproxDists_[k], ExactDists_[p].first));
+        /*
+         * The gold standard may keep only distances to the closest points (see GoldStandardManager),
+         * then p can reach the end of SortedDists_
+         */
+        if (p < SortedDists_.size() && ApproxDists_[k] -  SortedDists_[p] < 0) {
+          double mx = std::abs(std::max(ApproxDists_[k], SortedDists_[p]));
+          double mn = std::abs(std::min(ApproxDists_[k], SortedDists_[p]));
   
           const double epsRel = 2e-5;
           const double epsAbs = 5e-4;
@@ -251,8 +205,8 @@ private:
            *
            */
           if (mx > 0 && (1- mn/mx) > epsRel && (mx - mn) > epsAbs) {
-            for (size_t i = 0; i < std::min(ExactDists_.size(), ApproxDists_.size()); ++i ) {
-              LOG(INFO) << "Ex: " << ExactDists_[i].first << 
+            for (size_t i = 0; i < std::min(SortedDists_.size(), ApproxDists_.size()); ++i ) {
+              LOG(INFO) << "Ex: " << SortedDists_[i] << 
                            " -> Apr: " << ApproxDists_[i] << 
                            " 1 - ratio: " << (1 - mn/mx) << " diff: " << (mx - mn);
             }
@@ -260,21 +214,21 @@ private:
                    << "that are closer to the query than object returned by "
                    << "(exact) sequential searching!"
                    << " Approx: " << ApproxDists_[k]
-                   << " Exact: "  << ExactDists_[p].first;
+                   << " Exact: "  << SortedDists_[p];
           }
         }
         size_t LastEqualP = p;
-        if (p < ExactDists_.size() && ApproxEqual(ExactDists_[p].first, ApproxDists_[k])) {
+        if (p < SortedDists_.size() && ApproxEqual(SortedDists_[p], ApproxDists_[k])) {
           ++p;
         } else {
-          while (p < ExactDists_.size() && ExactDists_[p].first < ApproxDists_[k]) {
+          while (p < SortedDists_.size() && SortedDists_[p] < ApproxDists_[k]) {
             ++p;
             ++LastEqualP;
           }
         }
         if (p < k) {
-          for (size_t i = 0; i < std::min(ExactDists_.size(), ApproxDists_.size()); ++i ) {
-            LOG(INFO) << "E: " << ExactDists_[i].first << " -> " << ApproxDists_[i];
+          for (size_t i = 0; i < std::min(SortedDists_.size(), ApproxDists_.size()); ++i ) {
+            LOG(INFO) << "E: " << SortedDists_[i] << " -> " << ApproxDists_[i];
           }
           LOG(FATAL) << "bug: p = " << p << " k = " << k;
         }
@@ -307,7 +261,9 @@ private:
   std::set<IdType>                    ApproxResultSet_;
   std::set<IdType>                    ExactResultSet_;
 
+  // The closest points and sorted distances to (possibly) all the data points
   const DistObjectPairVector<dist_t>& ExactDists_;
+  const std::vector<dist_t>&          SortedDists_;
 };
 
 }
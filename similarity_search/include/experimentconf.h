@@ -21,6 +21,7 @@
 #include <string>
 #include "global.h"
 #include "object.h"
+#include "object_arena.h"
 #include "utils.h"
 #include "space.h"
 
@@ -50,7 +51,8 @@ struct ExperimentConfig {
         dimension(dimension),
         knn(knn),
         eps(eps),
-        range(range)
+        range(range),
+        arena(new ObjectArena())
 {
     if (NoQueryFile) {
       if (!TestSetQty) {
@@ -62,12 +64,17 @@ struct ExperimentConfig {
 
   ~ExperimentConfig() {
     delete space;
+    /*
+     * Objects created in the arena are all released at once when it is deleted.
+     * Yet, a space can also create objects on the heap (see Space::ReadDataset).
+     */
     for (auto it = OrigData.begin(); it != OrigData.end(); ++it) {
-      delete *it;
+      if (!arena->Owns(*it)) delete *it;
     }
     for (auto it = OrigQuery.begin(); it != OrigQuery.end(); ++it) {
-      delete *it;
+      if (!arena->Owns(*it)) delete *it;
     }
+    delete arena;
   }
 
   void ReadDataset();
@@ -86,7 +93,14 @@ struct ExperimentConfig {
   float GetEPS() const { return eps; }
   const typename std::vector<dist_t>& GetRange() const { return range; }
   int   GetDimension() const { return dimension; }
+  const string& GetDataFile() const { return datafile; }
+  const string& GetQueryFile() const { return queryfile; }
   int   GetQueryQty() const { return NoQueryFile ? MaxNumQuery : OrigQuery.size(); }
+  /*
+   * Space::ReadDataset should create objects in this arena (see NewObject),
+   * objects created on the heap are deleted by the destructor.
+   */
+  ObjectArena* GetArena() const { return arena; }
 private:
   Space<dist_t>*    space;
   ObjectVector      dataobjects;
@@ -107,6 +121,8 @@ private:
   const typename std::vector<unsigned>& knn;       // knn search
   float eps;
   const typename std::vector<dist_t>& range;  // range search
+
+  ObjectArena* arena;
 };
 
 }
@@ -27,8 +27,9 @@
 #include <string>
 #include <utility>
 #include <thread>
-#include <mutex>
 #include <memory>
+#include <atomic>
+#include <algorithm>
 
 #include "global.h"
 #include "object.h"
@@ -43,17 +44,19 @@
 #include "logging.h"
 #include "methodfactory.h"
 #include "eval_results.h"
+#include "gold_standard.h"
 #include "meta_analysis.h"
+#include "histogram.h"
+#include "search_trace.h"
+#include "perf_counters.h"
 
 namespace similarity {
 
 using std::vector;
 using std::string;
 using std::stringstream;
-using std::mutex;
 using std::thread;
 using std::ref;
-using std::lock_guard;
 using std::unique_ptr;
 
 template <typename dist_t>
@@ -92,21 +95,28 @@ struct Experiments {
 
   static void RunAll(bool LogInfo, 
                      unsigned ThreadTestQty, 
+                     bool UsePerfCounters,
                      size_t TestSetId, 
                      vector<vector<MetaAnalysis*>>&   ExpResRange,
                      vector<vector<MetaAnalysis*>>&   ExpResKNN,
                      const ExperimentConfig<dist_t>&  config,
+                     const GoldStandardManager<dist_t>& managerGS,
                      const  std::vector<IndexType* >& IndexPtrs) {
 
     if (LogInfo) LOG(INFO) << ">>>> TestSetId: " << TestSetId;
     if (LogInfo) LOG(INFO) << ">>>> Will use: "  << ThreadTestQty << " threads in efficiency testing";
     if (LogInfo) config.PrintInfo();
 
+    // The sequential search is the baseline for ImprEfficiency, it is timed along with the gold standard
+    const uint64_t  SeqSearchTime     = managerGS.GetSeqSearchTime();
+    const uint64_t  SeqSearchCPUTime  = managerGS.GetSeqSearchCPUTime();
+
     if (!config.GetRange().empty()) {
       for (size_t i = 0; i < config.GetRange().size(); ++i) {
         const dist_t radius = config.GetRange()[i];
         RangeCreator  cr(radius);
-        Execute<RangeQuery<dist_t>, RangeCreator>(LogInfo, ThreadTestQty, TestSetId, ExpResRange[i], config, cr, IndexPtrs);
+        Execute<RangeQuery<dist_t>, RangeCreator>(LogInfo, ThreadTestQty, UsePerfCounters, TestSetId, ExpResRange[i], config, managerGS, cr, IndexPtrs,
+                                                  SeqSearchTime, SeqSearchCPUTime);
       }
     }
 
@@ -114,116 +124,135 @@ struct Experiments {
       for (size_t i = 0; i < config.GetKNN().size(); ++i) {
         const size_t K = config.GetKNN()[i];
         KNNCreator  cr(K, config.GetEPS());
-        Execute<KNNQuery<dist_t>, KNNCreator>(LogInfo, ThreadTestQty, TestSetId, ExpResKNN[i], config, cr, IndexPtrs);
+        Execute<KNNQuery<dist_t>, KNNCreator>(LogInfo, ThreadTestQty, UsePerfCounters, TestSetId, ExpResKNN[i], config, managerGS, cr, IndexPtrs,
+                                              SeqSearchTime, SeqSearchCPUTime);
       }
     }
     if (LogInfo) LOG(INFO) << "experiment done at " << CurrentTime();
 
   }
 
+  /*
+   * Queries are dispensed to threads in small chunks using a shared atomic counter:
+   * a thread that is done with its chunk grabs the next one. Thus, threads stay busy
+   * even if query costs are skewed. Each thread accumulates statistics
+   * privately (per-query values are stored in the cells reserved for these queries),
+   * and the statistics are merged after all the threads finish.
+   */
   template <typename QueryType, typename QueryCreatorType>
   struct  BenchmarkThreadParams {
     BenchmarkThreadParams(
-              mutex&                          UpdateStat,
-              unsigned                        ThreadQty,
-              unsigned                        QueryPart,
-              size_t                          TestSetId, 
-              std::vector<MetaAnalysis*>&     ExpRes,
+              std::atomic<size_t>&            NextQuery,
+              size_t                          QueryChunkSize,
               const ExperimentConfig<dist_t>& config,
               const QueryCreatorType&         QueryCreator,
               Index<dist_t>&                  Method,
-              unsigned                        MethNum,
-              vector<uint64_t>&               SearchTime,
-              vector<uint64_t>&               SearchCPUTime,
-
-              vector<double>&                 AvgNumDistComp,
-              vector<unsigned>&               max_result_size,
-              vector<double>&                 avg_result_size,
-              vector<uint64_t>&               DistCompQty) :
-    UpdateStat_(UpdateStat),
-    ThreadQty_(ThreadQty),
-    QueryPart_(QueryPart),
-    TestSetId_(TestSetId),
-    ExpRes_(ExpRes),
+              vector<double>&                 QueryDistComp,
+              vector<double>&                 QueryTime) :
+    NextQuery_(NextQuery),
+    QueryChunkSize_(QueryChunkSize),
     config_(config),
     QueryCreator_(QueryCreator),
     Method_(Method),
-    MethNum_(MethNum),
-    SearchTime_(SearchTime),
-    SearchCPUTime_(SearchCPUTime),
-
-    AvgNumDistComp_(AvgNumDistComp),
-    max_result_size_(max_result_size),
-    avg_result_size_(avg_result_size),
-    DistCompQty_(DistCompQty)
+    QueryDistComp_(QueryDistComp),
+    QueryTime_(QueryTime),
+    DistCompQty_(0),
+    SumResultSize_(0),
+    MaxResultSize_(0),
+    QueryTimeHist_(MetaAnalysis::NewQueryTimeHist()),
+    DistCompHist_(MetaAnalysis::NewDistCompHist())
     {}
 
-    mutex&                          UpdateStat_;
-    unsigned                        ThreadQty_;
-    unsigned                        QueryPart_;
-    size_t                          TestSetId_;
-    std::vector<MetaAnalysis*>&     ExpRes_;
+    std::atomic<size_t>&            NextQuery_;
+    size_t                          QueryChunkSize_;
     const ExperimentConfig<dist_t>& config_;
     const QueryCreatorType&         QueryCreator_;
     Index<dist_t>&                  Method_;
-    unsigned                        MethNum_;
-    vector<uint64_t>&               SearchTime_;
-    vector<uint64_t>&               SearchCPUTime_;
-
-    vector<double>&                 AvgNumDistComp_;
-    vector<unsigned>&               max_result_size_;
-    vector<double>&                 avg_result_size_;
-    vector<uint64_t>&               DistCompQty_;
+    vector<double>&                 QueryDistComp_;
+    vector<double>&                 QueryTime_;
+
+    // Per-thread accumulators
+    uint64_t                        DistCompQty_;
+    double                          SumResultSize_;
+    unsigned                        MaxResultSize_;
+    LogHistogram                    QueryTimeHist_;
+    LogHistogram                    DistCompHist_;
+#ifdef WITH_SEARCH_TRACE
+    SearchTrace                     Trace_;
+#endif
   };
 
   template <typename QueryType, typename QueryCreatorType> 
   struct BenchmarkThread {
     void operator ()(BenchmarkThreadParams<QueryType, QueryCreatorType>& prm) {
-      int numquery = prm.config_.GetQueryObjects().size();
+      size_t numquery = prm.config_.GetQueryObjects().size();
 
       WallClockTimer wtm;
-      CPUTimer       ctm;
 
       wtm.reset();
-      ctm.reset();
 
-      unsigned MethNum = prm.MethNum_;
-      unsigned QueryPart = prm.QueryPart_;
-      unsigned ThreadQty = prm.ThreadQty_;
+      for (;;) {
+        size_t start = prm.NextQuery_.fetch_add(prm.QueryChunkSize_);
+        if (start >= numquery) break;
+        size_t end = std::min(start + prm.QueryChunkSize_, numquery);
 
-      for (int q = 0; q < numquery; ++q) {
-        if ((q % ThreadQty) == QueryPart) {
+        for (size_t q = start; q < end; ++q) {
           unique_ptr<QueryType> query(prm.QueryCreator_(prm.config_.GetSpace(), 
                                       prm.config_.GetQueryObjects()[q]));
-          uint64_t  t1 = wtm.split();
+          uint64_t  t1 = wtm.splitnsec();
+#ifdef WITH_SEARCH_TRACE
+          query->Trace().Start();
+#endif
           prm.Method_.Search(query.get());
-          uint64_t  t2 = wtm.split();
-
-          {
-            lock_guard<mutex> g(prm.UpdateStat_);
+#ifdef WITH_SEARCH_TRACE
+          query->Trace().Stop();
+#endif
+          uint64_t  t2 = wtm.splitnsec();
 
-            prm.ExpRes_[MethNum]->AddDistComp(prm.TestSetId_, query->DistanceComputations());
-            prm.ExpRes_[MethNum]->AddQueryTime(prm.TestSetId_, (1.0*t2 - t1)/1e3);
+          prm.QueryDistComp_[q] = query->DistanceComputations();
+          prm.QueryTime_[q]     = (1.0*t2 - t1)/1e6;
+#ifdef WITH_SEARCH_TRACE
+          prm.Trace_.Merge(query->Trace());
+#endif
 
+          prm.QueryTimeHist_.Add(prm.QueryTime_[q]);
+          prm.DistCompHist_.Add(prm.QueryDistComp_[q]);
 
-            prm.DistCompQty_[MethNum] += query->DistanceComputations();
-            prm.avg_result_size_[MethNum] += query->ResultSize();
+          prm.DistCompQty_   += query->DistanceComputations();
+          prm.SumResultSize_ += query->ResultSize();
 
-            if (query->ResultSize() > prm.max_result_size_[MethNum]) {
-              prm.max_result_size_[MethNum] = query->ResultSize();
-            }
+          if (query->ResultSize() > prm.MaxResultSize_) {
+            prm.MaxResultSize_ = query->ResultSize();
           }
         }
       }
     }
   };
 
+#ifdef WITH_SEARCH_TRACE
+  static void LogSearchTrace(const SearchTrace& trace, size_t numquery) {
+    const double TicksPerMsec = SearchTraceTicksPerNanosec() * 1e6;
+    const double TotalTicks = std::max<uint64_t>(1, trace.GetTotalTicks());
+
+    LOG(INFO) << ">>>> Search trace (avg per query, the tracing overhead is included):";
+    for (unsigned phase = 0; phase < kTracePhaseQty; ++phase) {
+      LOG(INFO) << ">>>>   " << SearchTracePhaseName(phase) << ": "
+                << trace.GetTicks(phase) / TicksPerMsec / numquery << " msec ("
+                << round2(100.0 * trace.GetTicks(phase) / TotalTicks) << "%)"
+                << " # of calls: " << static_cast<double>(trace.GetCalls(phase)) / numquery;
+    }
+  }
+#endif
+
   template <typename QueryType, typename QueryCreatorType>
-  static void Execute(bool LogInfo, unsigned ThreadTestQty, size_t TestSetId, 
+  static void Execute(bool LogInfo, unsigned ThreadTestQty, bool UsePerfCounters, size_t TestSetId, 
                      std::vector<MetaAnalysis*>& ExpRes,
                      const ExperimentConfig<dist_t>& config,
+                     const GoldStandardManager<dist_t>& managerGS,
                      const  QueryCreatorType& QueryCreator,
-                     const  std::vector<IndexType* >& IndexPtrs) {
+                     const  std::vector<IndexType* >& IndexPtrs,
+                     uint64_t SeqSearchTime,
+                     uint64_t SeqSearchCPUTime) {
     int numquery = config.GetQueryObjects().size();
 
       /*
@@ -248,16 +277,15 @@ struct Experiments {
     vector<double>    PrecisionOfApprox(MethQty);
     vector<double>    SystemTimeElapsed(MethQty);
 
-    uint64_t  SeqSearchTime     = 0;
-    uint64_t  SeqSearchCPUTime  = 0;
-
     vector<double>    AvgNumDistComp(MethQty);
     vector<double>    ImprDistComp(MethQty);
     vector<unsigned>  max_result_size(MethQty);
     vector<double>    avg_result_size(MethQty);
     vector<uint64_t>  DistCompQty(MethQty);
-
-    mutex             UpdateStat;
+    vector<string>    PerfCountersReport(MethQty);
+#ifdef WITH_SEARCH_TRACE
+    vector<SearchTrace> Traces(MethQty);
+#endif
 
     config.GetSpace()->SetQueryPhase();
 
@@ -267,6 +295,13 @@ struct Experiments {
 
       if (LogInfo) LOG(INFO) << ">>>> Efficiency test for: "<< Method.ToString();
 
+      /*
+       * Counters should be opened before benchmarking threads are created,
+       * otherwise these threads are not monitored.
+       */
+      unique_ptr<PerfCounters> counters(UsePerfCounters ? new PerfCounters() : NULL);
+      if (counters) counters->Start();
+
       WallClockTimer wtm;
       CPUTimer       ctm;
 
@@ -275,36 +310,37 @@ struct Experiments {
 
       if (!ThreadTestQty) ThreadTestQty = 1;
 
-      vector<BenchmarkThreadParams<QueryType, QueryCreatorType>*> ThreadParams(ThreadTestQty);
-      vector<thread>                                              Threads(ThreadTestQty);
+      /*
+       * Chunks are small enough to balance the load,
+       * but large enough to make contention for the counter negligible.
+       */
+      size_t QueryChunkSize = std::max<size_t>(1, std::min<size_t>(16, numquery / (8 * ThreadTestQty)));
 
+      std::atomic<size_t>     NextQuery(0);
+      vector<double>          QueryDistComp(numquery);
+      vector<double>          QueryTime(numquery);
 
-      for (unsigned QueryPart = 0; QueryPart < ThreadTestQty; ++QueryPart) {
-        ThreadParams[QueryPart] =  new BenchmarkThreadParams<QueryType, QueryCreatorType>(
-                                              UpdateStat,
-                                              ThreadTestQty,
-                                              QueryPart,
-                                              TestSetId, 
-                                              ExpRes,
+      vector<unique_ptr<BenchmarkThreadParams<QueryType, QueryCreatorType>>> ThreadParams(ThreadTestQty);
+      vector<thread>                                                          Threads(ThreadTestQty);
+
+      for (unsigned ThreadId = 0; ThreadId < ThreadTestQty; ++ThreadId) {
+        ThreadParams[ThreadId].reset(new BenchmarkThreadParams<QueryType, QueryCreatorType>(
+                                              NextQuery,
+                                              QueryChunkSize,
                                               config,
                                               QueryCreator,
                                               Method,
-                                              MethNum,
-                                              SearchTime,
-                                              SearchCPUTime,
-                                              AvgNumDistComp,
-                                              max_result_size,
-                                              avg_result_size,
-                                              DistCompQty);
+                                              QueryDistComp,
+                                              QueryTime));
       }
 
       if (ThreadTestQty> 1) {
-        for (unsigned QueryPart = 0; QueryPart < ThreadTestQty; ++QueryPart) {
-          Threads[QueryPart] = std::thread(BenchmarkThread<QueryType, QueryCreatorType>(), 
-                                     ref(*ThreadParams[QueryPart]));
+        for (unsigned ThreadId = 0; ThreadId < ThreadTestQty; ++ThreadId) {
+          Threads[ThreadId] = std::thread(BenchmarkThread<QueryType, QueryCreatorType>(), 
+                                     ref(*ThreadParams[ThreadId]));
         }
-        for (unsigned QueryPart = 0; QueryPart < ThreadTestQty; ++QueryPart) {
-          Threads[QueryPart].join();
+        for (unsigned ThreadId = 0; ThreadId < ThreadTestQty; ++ThreadId) {
+          Threads[ThreadId].join();
         }
       } else {
         CHECK(ThreadTestQty == 1);
@@ -314,10 +350,43 @@ struct Experiments {
       wtm.split();
       ctm.split();
 
+      if (counters) {
+        counters->Stop();
+
+        stringstream report;
+        for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+          report << " " << PerfCounterName(i) << ": ";
+          if (counters->IsAvailable(i)) {
+            double PerQuery = static_cast<double>(counters->Get(i)) / numquery;
+            ExpRes[MethNum]->AddPerfCounter(i, PerQuery);
+            report << PerQuery;
+          } else {
+            report << "N/A";
+          }
+        }
+        PerfCountersReport[MethNum] = report.str();
+      }
+
       SearchTime[MethNum] = wtm.elapsed();
       SearchCPUTime[MethNum] = ctm.elapsed();
       SystemTimeElapsed[MethNum] = ctm.systemelapsed();
 
+      // Merging statistics (per-query values are added in the order of queries)
+      for (int q = 0; q < numquery; ++q) {
+        ExpRes[MethNum]->AddDistComp(TestSetId, QueryDistComp[q]);
+        ExpRes[MethNum]->AddQueryTime(TestSetId, QueryTime[q]);
+      }
+      for (const auto& prm: ThreadParams) {
+        DistCompQty[MethNum]     += prm->DistCompQty_;
+        avg_result_size[MethNum] += prm->SumResultSize_;
+        max_result_size[MethNum] = std::max(max_result_size[MethNum], prm->MaxResultSize_);
+        ExpRes[MethNum]->AddQueryTimeHist(prm->QueryTimeHist_);
+        ExpRes[MethNum]->AddDistCompHist(prm->DistCompHist_);
+#ifdef WITH_SEARCH_TRACE
+        Traces[MethNum].Merge(prm->Trace_);
+#endif
+      }
+
       AvgNumDistComp[MethNum] = static_cast<double>(DistCompQty[MethNum])/numquery;
       ImprDistComp[MethNum]   = config.GetDataObjects().size() / AvgNumDistComp[MethNum];
 
@@ -333,17 +402,11 @@ struct Experiments {
     if (LogInfo) LOG(INFO) << ">>>> Computing effectiveness metrics " ;
 
     for (int q = 0; q < numquery; ++q) {
-      unique_ptr<QueryType> queryGS(QueryCreator(config.GetSpace(), config.GetQueryObjects()[q]));
-
       /* 
-       * We compute gold stanard once for each query.
-       * Note that GS uses a lot of space, b/c we need to compute the distance
-       * from the query to every data point.
+       * The gold standard is computed once for each query 
+       * and it is shared by all k-NN and range searches.
        */
-      GoldStandard<dist_t>  QueryGS(config.GetSpace(), config.GetDataObjects(), queryGS.get());
-
-      SeqSearchTime     += QueryGS.GetSeqSearchTime();
-      SeqSearchCPUTime  += QueryGS.GetSeqSearchCPUTime();
+      const GoldStandard<dist_t>&  QueryGS = managerGS.Get(q);
 
       for (auto it = IndexPtrs.begin(); it != IndexPtrs.end(); ++it) {
         size_t MethNum = it - IndexPtrs.begin();
@@ -384,6 +447,14 @@ struct Experiments {
         LOG(INFO) << ">>>> Avg CPU time per query: " << (SearchCPUTime[MethNum]/double(1e3)/numquery) << " msec";
         LOG(INFO) << ">>>> System time elapsed:    " << (SystemTimeElapsed[MethNum]/double(1e6)) << " sec";
         LOG(INFO) << "=========================================";
+        if (UsePerfCounters) {
+          LOG(INFO) << ">>>> Hardware counters per query:" << PerfCountersReport[MethNum];
+          LOG(INFO) << "=========================================";
+        }
+#ifdef WITH_SEARCH_TRACE
+        LogSearchTrace(Traces[MethNum], numquery);
+        LOG(INFO) << "=========================================";
+#endif
       }
 
       double  ImprEfficiency = static_cast<double>(SeqSearchTime)/SearchTime[MethNum];
@@ -34,6 +34,13 @@ static const int kMaxFilenameLength = 255;
 #define DEPRECATED(func)  func
 #endif
 
+// Hints the processor to load the cache line containing the address
+#ifdef __GNUC__
+#define PREFETCH(addr)    __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
+
 namespace similarity {
 // disable copy and assign
 #undef DISABLE_COPY_AND_ASSIGN
@@ -0,0 +1,142 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _GOLD_STANDARD_H_
+#define _GOLD_STANDARD_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "object.h"
+#include "space.h"
+#include "experimentconf.h"
+
+#define GOLD_STANDARD_CACHE_MAGIC   "NMSLGS02"
+
+namespace similarity {
+
+using std::string;
+using std::vector;
+
+/*
+ * Exact neighbors of one query: the closest data points sorted by the distance
+ * and sorted distances from the query to data points (see GoldStandardManager).
+ */
+template <class dist_t>
+class GoldStandard {
+public:
+  GoldStandard() {}
+  /*
+   * Computes distances from all data points to the query (sequential searching)
+   * and keeps only:
+   * (1) at least KeepQty closest points (plus points tied with the last one);
+   * (2) all the points within MaxRadius (if HasRange is true).
+   * If KeepAllDists is true, distances to all the data points are kept as well,
+   * otherwise, only distances to the kept points are.
+   */
+  GoldStandard(const Space<dist_t>*   space,
+               const ObjectVector&    datapoints,
+               const Object*          query,
+               size_t                 KeepQty,
+               bool                   HasRange,
+               dist_t                 MaxRadius,
+               bool                   KeepAllDists);
+
+  const DistObjectPairVector<dist_t>&   GetExactDists() const { return  ExactDists_;}
+  DistObjectPairVector<dist_t>&         GetExactDists() { return  ExactDists_;}
+  const vector<dist_t>&                 GetSortedDists() const { return SortedDists_; }
+  vector<dist_t>&                       GetSortedDists() { return SortedDists_; }
+private:
+  DistObjectPairVector<dist_t>        ExactDists_;
+  vector<dist_t>                      SortedDists_;
+};
+
+/*
+ * Computes gold standard data for all the queries of the current test set,
+ * which is shared by all k-NN and range searches. Queries are processed
+ * in parallel (if ThreadQty is zero, all hardware threads are used).
+ * For each query, only about MaxCacheGSRelativeQty * (the largest K) closest points
+ * (plus all the points within the largest radius) are kept. If MaxCacheGSRelativeQty
+ * is zero, all the points are kept. Recall needs only the largest K closest points, but the relative
+ * position error and the number of closer points depend on positions of found points
+ * among all the data points. Hence, if KeepAllDists is true, sorted distances to all
+ * the data points are kept as well, which takes (# of queries) * (# of data points)
+ * distance values of memory (and of the cache file). Otherwise, found points
+ * further than the last kept neighbor are assigned this neighbor's position,
+ * so RelPosError and NumCloser can be underestimated (see IsExact).
+ *
+ * The sequential search, which is the baseline for ImprEfficiency, is timed
+ * (in one thread) along with computing the gold standard, using the largest K
+ * (or the largest radius if there are only range searches).
+ *
+ * The gold standard and the sequential search time can be cached in a file. The cache is keyed
+ * by the data file, the query file, the space, the search parameters,
+ * as well as by hashes of the data and query sets. If any of these
+ * doesn't match, the gold standard is recomputed and the cache is overwritten.
+ */
+template <class dist_t>
+class GoldStandardManager {
+public:
+  GoldStandardManager(const ExperimentConfig<dist_t>& config,
+                      unsigned MaxCacheGSRelativeQty,
+                      bool KeepAllDists);
+
+  // True if RelPosError and NumCloser computed using the gold standard are exact
+  static bool IsExact(unsigned MaxCacheGSRelativeQty, bool KeepAllDists) {
+    return KeepAllDists || !MaxCacheGSRelativeQty;
+  }
+
+  void Compute(unsigned ThreadQty);
+  // Returns false if the file doesn't exist or the cache key doesn't match
+  bool Load(const string& FileName);
+  void Save(const string& FileName) const;
+
+  // Loads the gold standard from the cache file or computes (and caches) it
+  void Obtain(const string& CacheFileName, unsigned ThreadQty) {
+    if (CacheFileName.empty() || !Load(CacheFileName)) {
+      Compute(ThreadQty);
+      if (!CacheFileName.empty()) Save(CacheFileName);
+    }
+  }
+
+  const GoldStandard<dist_t>& Get(size_t QueryId) const { return GoldStandards_[QueryId]; }
+  uint64_t GetSeqSearchTime() const { return SeqSearchTime_; }
+  uint64_t GetSeqSearchCPUTime() const { return SeqSearchCPUTime_; }
+private:
+  string CacheKey() const;
+  // Times the sequential search in the same way as the methods (i.e., SeqSearch computes distances in batches)
+  template <typename QueryType, typename QueryCreatorType>
+  void TimeSeqSearch(const QueryCreatorType& QueryCreator);
+
+  const ExperimentConfig<dist_t>&   config_;
+  size_t                            KeepQty_;
+  bool                              KeepAllDists_;
+  bool                              HasRange_;
+  dist_t                            MaxRadius_;
+  vector<GoldStandard<dist_t>>      GoldStandards_;
+  uint64_t                          SeqSearchTime_;
+  uint64_t                          SeqSearchCPUTime_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(GoldStandardManager);
+};
+
+}   // namespace similarity
+
+#endif    // _GOLD_STANDARD_H_
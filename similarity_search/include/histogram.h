@@ -0,0 +1,123 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "logging.h"
+
+namespace similarity {
+
+/*
+ * A histogram with logarithmic buckets: each power of two is split
+ * into BucketsPerOctave buckets, so that a quantile is estimated
+ * with a relative error of at most 2^(1/BucketsPerOctave) - 1
+ * (about 4.4% for the default 16 buckets).
+ *
+ * Values smaller than MinValue are counted in the first bucket,
+ * values larger than MaxValue are counted in the last one.
+ * Exact minimum and maximum values are tracked separately,
+ * quantile estimates are clamped to [minimum, maximum].
+ *
+ * Adding a value involves neither locking nor memory allocation:
+ * each thread should use its own histogram and histograms are merged
+ * afterwards.
+ */
+class LogHistogram {
+ public:
+  LogHistogram(double MinValue, double MaxValue, unsigned BucketsPerOctave = 16) :
+          MinValue_(MinValue), BucketsPerOctave_(BucketsPerOctave),
+          Count_(0),
+          Min_(std::numeric_limits<double>::max()),
+          Max_(-std::numeric_limits<double>::max()) {
+    CHECK(MinValue > 0 && MaxValue > MinValue && BucketsPerOctave > 0);
+    Buckets_.resize(BucketId(MaxValue) + 1);
+  }
+
+  void Add(double val) {
+    ++Buckets_[std::min<size_t>(BucketId(val), Buckets_.size() - 1)];
+    ++Count_;
+    Min_ = std::min(Min_, val);
+    Max_ = std::max(Max_, val);
+  }
+
+  // Histograms should have the same bucket structure
+  void Merge(const LogHistogram& other) {
+    CHECK(MinValue_ == other.MinValue_ &&
+          BucketsPerOctave_ == other.BucketsPerOctave_ &&
+          Buckets_.size() == other.Buckets_.size());
+    for (size_t i = 0; i < Buckets_.size(); ++i) Buckets_[i] += other.Buckets_[i];
+    Count_ += other.Count_;
+    Min_ = std::min(Min_, other.Min_);
+    Max_ = std::max(Max_, other.Max_);
+  }
+
+  uint64_t Count() const { return Count_; }
+  double   Min() const { return Count_ ? Min_ : 0; }
+  double   Max() const { return Count_ ? Max_ : 0; }
+
+  /*
+   * Returns an estimate of the q-quantile (0 <= q <= 1): the geometric
+   * middle of the bucket that contains the ceil(q * Count())-th smallest value.
+   */
+  double Quantile(double q) const {
+    if (!Count_) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * Count_));
+    rank = std::max<uint64_t>(1, std::min(rank, Count_));
+
+    uint64_t sum = 0;
+    size_t   i = 0;
+    for (; i < Buckets_.size(); ++i) {
+      sum += Buckets_[i];
+      if (sum >= rank) break;
+    }
+    // The last bucket has no upper bound
+    if (i + 1 >= Buckets_.size()) return Max_;
+    double res = i ? MinValue_ * std::pow(2.0, (i + 0.5) / BucketsPerOctave_) : MinValue_;
+    return std::max(Min_, std::min(Max_, res));
+  }
+
+  // Bucket boundaries: [LowerBound(i), LowerBound(i + 1))
+  size_t   BucketQty() const { return Buckets_.size(); }
+  uint64_t BucketCount(size_t i) const { return Buckets_[i]; }
+  double   LowerBound(size_t i) const {
+    return i ? MinValue_ * std::pow(2.0, static_cast<double>(i) / BucketsPerOctave_) : 0;
+  }
+
+ private:
+  size_t BucketId(double val) const {
+    if (!(val > MinValue_)) return 0;
+    return static_cast<size_t>(std::log2(val / MinValue_) * BucketsPerOctave_);
+  }
+
+  double                  MinValue_;
+  unsigned                BucketsPerOctave_;
+  std::vector<uint64_t>   Buckets_;
+  uint64_t                Count_;
+  double                  Min_;
+  double                  Max_;
+};
+
+}   // namespace similarity
+
+#endif    // _HISTOGRAM_H_
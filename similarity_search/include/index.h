@@ -18,6 +18,9 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+#include "logging.h"
 
 namespace similarity {
 
@@ -37,8 +40,65 @@ class Index {
   virtual void Search(RangeQuery<dist_t>* query) = 0;
   virtual void Search(KNNQuery<dist_t>* query) = 0;
   virtual const std::string ToString() const = 0;
+
+  /*
+   * Save the index structure to a file and load it back (see index_io.h).
+   * Data objects are not saved: a saved index can be loaded only
+   * for the same data set. Load() is called for an index that was
+   * created by the method factory without building (BuildIndex == false).
+   * Methods that don't support saving/loading terminate the program.
+   */
+  virtual void Save(const std::string& location) const {
+    LOG(FATAL) << "Saving of the index is not supported by the method: " << ToString();
+  }
+  virtual void Load(const std::string& location) {
+    LOG(FATAL) << "Loading of the index is not supported by the method: " << ToString();
+  }
+  /*
+   * Parameters affecting the index structure, e.g., "bucketSize=50,arity=2,maxPathLen=0".
+   * They are a part of the index file name and they are stored in the index file:
+   * the index is loaded only if they are the same.
+   */
+  virtual const std::string BuildParams() const { return ""; }
+
+  /*
+   * The number of bytes used by the index structure: nodes, buckets
+   * (including copies of data objects), pivots, posting lists, graphs, etc.
+   * The data set itself is not included. Methods that don't account
+   * for their memory return zero: then the memory usage is estimated
+   * from the change in the virtual memory size of the process.
+   */
+  virtual size_t MemoryUsage() const { return 0; }
 };
 
+/*
+ * Memory used by elements of standard containers. Node-based containers
+ * are assumed to keep three pointers and a color per node (red-black trees)
+ * or a pointer per node plus a pointer per bucket (hash tables).
+ */
+template <typename T>
+inline size_t VectorMemoryUsage(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+template <typename T>
+inline size_t VectorMemoryUsage(const std::vector<std::vector<T>>& v) {
+  size_t res = v.capacity() * sizeof(std::vector<T>);
+  for (const auto& e : v) res += VectorMemoryUsage(e);
+  return res;
+}
+
+template <typename Set>
+inline size_t TreeMemoryUsage(const Set& s) {
+  return s.size() * (sizeof(typename Set::value_type) + 4 * sizeof(void*));
+}
+
+template <typename HashSet>
+inline size_t HashMemoryUsage(const HashSet& s) {
+  return s.size() * (sizeof(typename HashSet::value_type) + sizeof(void*)) +
+         s.bucket_count() * sizeof(void*);
+}
+
 }  // namespace similarity
 
 #endif     // _METRIC_INDEX_STRUCTURE_H_
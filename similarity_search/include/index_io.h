@@ -0,0 +1,157 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _INDEX_IO_H_
+#define _INDEX_IO_H_
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+#include "global.h"
+#include "object.h"
+#include "logging.h"
+
+namespace similarity {
+
+using std::string;
+using std::vector;
+
+/*
+ * Index files keep only the structure of an index:
+ * data objects are not saved, they are referenced by their
+ * positions in the data set. Thus, an index can be loaded
+ * only if the data set is exactly the same as at the time of saving.
+ * Because buckets may store copies of data objects (see CreateCacheOptimizedBucket),
+ * positions are found using object ids, which should be unique.
+ *
+ * The file header includes the method description (Index::ToString()),
+ * the parameters affecting the index structure (e.g., "bucketSize=50,arity=2,maxPathLen=0"),
+ * the number of data objects, and a hash of object ids and contents,
+ * so that the use of a different data set is detected.
+ */
+#define INDEX_FILE_MAGIC    "NMSLIDX3"
+
+/*
+ * A null object pointer is written as this position.
+ */
+const uint64_t kNullObjectPos = static_cast<uint64_t>(-1);
+
+/*
+ * FNV-1a hash of object ids, data lengths, and data: it detects the use
+ * of a different data set (or of a different subset), even if
+ * the objects have the same ids and sizes.
+ */
+uint64_t DataSetHash(const ObjectVector& data);
+
+class IndexFileWriter {
+ public:
+  IndexFileWriter(const string& FileName,
+                  const string& MethodDesc,
+                  const string& BuildParams,
+                  const ObjectVector& data);
+
+  template <typename T>
+  void Write(const T& val) {
+    static_assert(std::is_pod<T>::value, "Only plain types can be written directly");
+    out_.write(reinterpret_cast<const char*>(&val), sizeof(val));
+  }
+
+  template <typename T>
+  void WriteVector(const vector<T>& v) {
+    static_assert(std::is_pod<T>::value, "Only vectors of plain types can be written directly");
+    Write<uint64_t>(v.size());
+    if (!v.empty()) out_.write(reinterpret_cast<const char*>(&v[0]), sizeof(T) * v.size());
+  }
+
+  void WriteObject(const Object* obj);
+  void WriteObjectVector(const ObjectVector& v);
+  /*
+   * Writes the id and the contents of an object that is not in the data set,
+   * e.g., of a permutation computed for a data object.
+   */
+  void WriteObjectCopy(const Object* obj);
+
+  // Should be called after the index is written
+  void Close();
+
+ private:
+  string                                   FileName_;
+  std::ofstream                            out_;
+  std::unordered_map<IdType, uint64_t> pos_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(IndexFileWriter);
+};
+
+class IndexFileReader {
+ public:
+  // Terminates the program if the header doesn't match the method, its parameters, or the data set
+  IndexFileReader(const string& FileName,
+                  const string& MethodDesc,
+                  const string& BuildParams,
+                  const ObjectVector& data);
+
+  template <typename T>
+  void Read(T& val) {
+    static_assert(std::is_pod<T>::value, "Only plain types can be read directly");
+    in_.read(reinterpret_cast<char*>(&val), sizeof(val));
+    CheckRead();
+  }
+
+  template <typename T>
+  void ReadVector(vector<T>& v) {
+    static_assert(std::is_pod<T>::value, "Only vectors of plain types can be read directly");
+    uint64_t qty;
+    Read(qty);
+    CheckQty(qty, sizeof(T));
+    v.resize(qty);
+    if (qty) {
+      in_.read(reinterpret_cast<char*>(&v[0]), sizeof(T) * qty);
+      CheckRead();
+    }
+  }
+
+  const Object* ReadObject();
+  void ReadObjectVector(ObjectVector& v);
+  // Reads an object written by WriteObjectCopy(), the caller should delete it
+  Object* ReadObjectCopy();
+
+  // Checks that the whole file has been read
+  void Close();
+
+ private:
+  void CheckRead();
+  // Terminates the program if qty elements of the given size don't fit into the rest of the file
+  void CheckQty(uint64_t qty, size_t elemSize);
+  string ReadString();
+
+  string              FileName_;
+  std::ifstream       in_;
+  uint64_t            fileSize_;
+  const ObjectVector& data_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(IndexFileReader);
+};
+
+}   // namespace similarity
+
+#endif    // _INDEX_IO_H_
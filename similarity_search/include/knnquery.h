@@ -47,15 +47,23 @@ class KNNQuery : public Query<dist_t> {
   bool CheckAndAddToResult(const dist_t distance, const Object* object);
   bool CheckAndAddToResult(const Object* object);
   size_t CheckAndAddToResult(const ObjectVector& bucket);
+  // Distances are computed in batches (see Query::DistanceBatch)
+  size_t CheckAndAddToResult(const Object* const* objs, size_t qty);
+  // The same, but distances are computed using the transposed copy of objs
+  size_t CheckAndAddToResult(const Object* const* objs, const TransposedBucket<dist_t>& bucket);
 
   bool Equals(const KNNQuery<dist_t>* query) const;
   void Print() const;
   static std::string Type() { return "K-NN"; }
 
  protected:
+  // Radius() is called very often, so it is recomputed only when the result changes
+  void UpdateRadius();
+
   unsigned K_;
   float eps_;
   KNNQueue<dist_t>* result_;
+  dist_t radius_;
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(KNNQuery);
@@ -17,7 +17,9 @@
 #ifndef _KNN_QUEUE_H_
 #define _KNN_QUEUE_H_
 
-#include <queue>
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <vector>
 #include <utility>
 
@@ -25,56 +27,157 @@
 
 namespace similarity {
 
+/*
+ * A fixed-capacity queue that keeps K elements with the smallest distances.
+ * The storage is allocated once (in the constructor), so that neither Push
+ * nor Reset allocate memory.
+ *
+ * For large K, the elements are kept in a binary max-heap.
+ * For small K (K <= kSmallK), the elements are kept in an array sorted
+ * in the descending order: an insertion is a short shift, which is cheaper
+ * than heap operations for a handful of elements.
+ * In both cases, the farthest element is stored in the first cell.
+ *
+ * Elements are compared as pairs (distance, object pointer), exactly
+ * as they were compared by the std::priority_queue used previously.
+ */
 template <typename dist_t>
 class KNNQueue {
  public:
-  KNNQueue(unsigned K) : K_(K) {}
+  typedef std::pair<dist_t, const void*> QueueElement;
+  /*
+   * Iterates over the elements in the order of increasing distances.
+   */
+  typedef typename std::vector<QueueElement>::const_reverse_iterator SortedIterator;
+
+  static const unsigned kSmallK = 16;
+
+  KNNQueue(unsigned K) : K_(K), size_(0), elems_(K),
+                         sorted_(true), small_(K <= kSmallK) {}
 
   ~KNNQueue() {}
 
-  void Reset() { QueueType empty; std::swap(empty, queue_); }
+  void Reset() { size_ = 0; sorted_ = true; }
 
-  bool Empty() const { return queue_.empty(); }
+  bool Empty() const { return size_ == 0; }
 
-  size_t Size() const { return queue_.size(); }
+  size_t Size() const { return size_; }
 
   dist_t TopDistance() const {
-    return queue_.empty()
+    return size_ == 0
         ? std::numeric_limits<dist_t>::max()
-        : queue_.top().first;
+        : elems_[0].first;
   }
 
-  const void* TopObject() const { return queue_.top().second; }
+  const void* TopObject() const { return elems_[0].second; }
 
   const void* Pop() {
     const void* top_object = TopObject();
-    queue_.pop();
+    if (small_ || sorted_) {
+      // Removing the first element of a descending array keeps it sorted
+      std::copy(elems_.begin() + 1, elems_.begin() + size_, elems_.begin());
+      --size_;
+    } else {
+      std::pop_heap(elems_.begin(), elems_.begin() + size_);
+      --size_;
+    }
     return top_object;
   }
 
   void Push(const dist_t distance, const void* object) {
-    if (Size() < K_) {
-      queue_.push(QueueElement(distance, object));
+    if (K_ == 0) return;
+    QueueElement e(distance, object);
+    if (size_ < K_) {
+      if (small_) {
+        InsertSorted(e);
+      } else {
+        elems_[size_++] = e;
+        std::push_heap(elems_.begin(), elems_.begin() + size_);
+        sorted_ = false;
+      }
     } else {
       if (TopDistance() > distance) {
-        Pop();
-        queue_.push(QueueElement(distance, object));
+        if (small_) {
+          ReplaceTopSorted(e);
+        } else {
+          ReplaceTopHeap(e);
+          sorted_ = false;
+        }
       }
     }
   }
 
+  /*
+   * Sorted iteration doesn't modify the contents of the queue.
+   * If necessary, the heap is sorted in place: an array sorted
+   * in the descending order is a valid max-heap.
+   * Pushing elements invalidates the iterators.
+   */
+  SortedIterator SortedBegin() const {
+    Sort();
+    return SortedIterator(elems_.begin() + size_);
+  }
+
+  SortedIterator SortedEnd() const {
+    return SortedIterator(elems_.begin());
+  }
+
   KNNQueue* Clone() const {
     KNNQueue* clone = new KNNQueue(K_);
-    clone->queue_ = queue_;
+    std::copy(elems_.begin(), elems_.begin() + size_, clone->elems_.begin());
+    clone->size_ = size_;
+    clone->sorted_ = sorted_;
     return clone;
   }
 
  private:
-  typedef std::pair<dist_t, const void*> QueueElement;
-  typedef std::priority_queue<QueueElement> QueueType;
+  void Sort() const {
+    if (!sorted_) {
+      std::sort(elems_.begin(), elems_.begin() + size_, std::greater<QueueElement>());
+      sorted_ = true;
+    }
+  }
+
+  void InsertSorted(const QueueElement& e) {
+    size_t i = size_;
+    // New elements are likely to be close, so the scan starts from the end
+    while (i > 0 && elems_[i - 1] < e) {
+      elems_[i] = elems_[i - 1];
+      --i;
+    }
+    elems_[i] = e;
+    ++size_;
+  }
+
+  void ReplaceTopSorted(const QueueElement& e) {
+    size_t i = 0;
+    while (i + 1 < size_ && e < elems_[i + 1]) {
+      elems_[i] = elems_[i + 1];
+      ++i;
+    }
+    elems_[i] = e;
+  }
+
+  // Replaces the root of the heap and sifts the new element down
+  void ReplaceTopHeap(const QueueElement& e) {
+    size_t i = 0;
+    for (;;) {
+      size_t child = 2 * i + 1;
+      if (child >= size_) break;
+      if (child + 1 < size_ && elems_[child] < elems_[child + 1]) ++child;
+      if (!(e < elems_[child])) break;
+      elems_[i] = elems_[child];
+      i = child;
+    }
+    elems_[i] = e;
+  }
 
-  QueueType queue_;
-  unsigned K_;
+  unsigned                              K_;
+  size_t                                size_;
+  // Sorted iteration may reorder the heap, but it doesn't change the contents
+  mutable std::vector<QueueElement>     elems_;
+  mutable bool                          sorted_;
+  bool                                  small_;
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(KNNQueue);
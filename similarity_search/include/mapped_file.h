@@ -0,0 +1,81 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "global.h"
+#include "logging.h"
+
+namespace similarity {
+
+/*
+ * A read-only memory mapping of a complete file.
+ * The file is unmapped when the object is destroyed.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& FileName) : addr_(NULL), size_(0) {
+    int fd = open(FileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+      LOG(FATAL) << "Cannot open file: '" << FileName << "' error: " << strerror(errno);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      close(fd);
+      LOG(FATAL) << "Cannot stat file: '" << FileName << "' error: " << strerror(errno);
+    }
+    size_ = st.st_size;
+    if (size_) {
+      void* addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        LOG(FATAL) << "Cannot mmap file: '" << FileName << "' error: " << strerror(errno);
+      }
+      addr_ = reinterpret_cast<char*>(addr);
+      // Let the kernel start reading the data in the background
+      madvise(addr_, size_, MADV_WILLNEED);
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (addr_ != NULL) munmap(addr_, size_);
+  }
+
+  char*   data() const { return addr_; }
+  size_t  size() const { return size_; }
+
+ private:
+  char*   addr_;
+  size_t  size_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(MappedFile);
+};
+
+}   // namespace similarity
+
+#endif    // _MAPPED_FILE_H_
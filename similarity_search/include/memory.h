@@ -27,6 +27,8 @@ class MemUsage {
   MemUsage(int pid = getpid()) {
     snprintf(status_file_, sizeof(status_file_),
              "/proc/%d/status", pid);
+    snprintf(clear_refs_file_, sizeof(clear_refs_file_),
+             "/proc/%d/clear_refs", pid);
   }
 
   ~MemUsage() {}
@@ -34,24 +36,53 @@ class MemUsage {
   /** returns the current virtual memory size of
       the process with pid in MB **/
   double get_vmsize() {
+    return get_status_field("VmSize:");
+  }
+
+  /** returns the current resident set size
+      of the process with pid in MB **/
+  double get_rss() {
+    return get_status_field("VmRSS:");
+  }
+
+  /** returns the peak resident set size (high water mark)
+      of the process with pid in MB **/
+  double get_peak_rss() {
+    return get_status_field("VmHWM:");
+  }
+
+  /** resets the peak resident set size to the current one,
+      returns false if the kernel doesn't support it (Linux < 4.0) **/
+  bool reset_peak_rss() {
+    FILE* f = fopen(clear_refs_file_, "wt");
+    if (!f) {
+      return false;
+    }
+    const bool res = fputs("5", f) >= 0;
+    return (fclose(f) == 0) && res;
+  }
+
+ private:
+  double get_status_field(const char* name) {
     FILE* f = fopen(status_file_, "rt");
     if (!f) {
       return -1.0;
     }
+    const size_t len = strlen(name);
     char buf[100];
-    int vmsize = -1024;
+    int val = -1024;
     while (fgets(buf, sizeof(buf), f)) {
-      if (strncmp(buf, "VmSize:", 7) == 0) {
-        sscanf(buf + 7, "%d", &vmsize);
+      if (strncmp(buf, name, len) == 0) {
+        sscanf(buf + len, "%d", &val);
         break;
       }
     }
     fclose(f);
-    return vmsize / 1024.0;
+    return val / 1024.0;
   }
 
- private:
   char status_file_[50];
+  char clear_refs_file_[50];
 };
 
 #else
@@ -61,6 +92,15 @@ class MemUsage {
   double get_vmsize() {
     return -1.0;
   }
+  double get_rss() {
+    return -1.0;
+  }
+  double get_peak_rss() {
+    return -1.0;
+  }
+  bool reset_peak_rss() {
+    return false;
+  }
 };
 
 #endif
@@ -21,6 +21,8 @@
 #include <string>
 
 #include "utils.h"
+#include "histogram.h"
+#include "perf_counters.h"
 
 namespace similarity {
 
@@ -29,7 +31,9 @@ using std::string;
 
 class MetaAnalysis {
 public:
-  MetaAnalysis(size_t TestSetQty, double zVal = 1.96) : zVal_(zVal) {
+  MetaAnalysis(size_t TestSetQty, double zVal = 1.96) : zVal_(zVal),
+                                                        QueryTimeHist_(NewQueryTimeHist()),
+                                                        DistCompHist_(NewDistCompHist()) {
     Recall_         .resize(TestSetQty);
     LogRelPosError_ .resize(TestSetQty);
     NumCloser_      .resize(TestSetQty);
@@ -38,6 +42,8 @@ public:
     ImprEfficiency_ .resize(TestSetQty);
     ImprDistComp_   .resize(TestSetQty);
     Mem_            .resize(TestSetQty);
+    PeakRSS_        .resize(TestSetQty);
+    PerfCounters_   .resize(kPerfCounterQty);
   }
 
   // Let's protect Add* functions, b/c them can be called from different threads  
@@ -56,15 +62,35 @@ public:
   void AddDistComp(size_t SetId, double DistComp) {
     DistComp_[SetId].push_back(DistComp);
   }
+  /*
+   * Histograms are merged over all test sets, i.e., percentiles
+   * are computed for the union of all queries.
+   */
+  void AddQueryTimeHist(const LogHistogram& hist) {
+    QueryTimeHist_.Merge(hist);
+  }
+  void AddDistCompHist(const LogHistogram& hist) {
+    DistCompHist_.Merge(hist);
+  }
+  // Histograms to be merged should be created by these functions
+  static LogHistogram NewQueryTimeHist() { return LogHistogram(1e-3, 1e7); } // in ms
+  static LogHistogram NewDistCompHist()  { return LogHistogram(1, 1e12); }
   void SetMem(size_t SetId, double Mem) {
     Mem_[SetId] = Mem;
   }
+  void SetPeakRSS(size_t SetId, double PeakRSS) {
+    PeakRSS_[SetId] = PeakRSS;
+  }
   void SetImprEfficiency(size_t SetId, double ImprEfficiency) {
     ImprEfficiency_[SetId] = ImprEfficiency;
   }
   void SetImprDistComp(size_t SetId, double ImprDistComp) {
     ImprDistComp_[SetId] = ImprDistComp;
   }
+  // Hardware counters are added only if they are available (one value per test set)
+  void AddPerfCounter(unsigned counter, double PerQueryValue) {
+    PerfCounters_[counter].push_back(PerQueryValue);
+  }
 
   void ComputeAll() {
     ComputeOneSimple("Recall", Recall_, RecallAvg, RecallConfMin, RecallConfMax);
@@ -76,6 +102,7 @@ public:
     ComputeOneSimple("ImprEfficiency", ImprEfficiency_, ImprEfficiencyAvg, ImprEfficiencyConfMin, ImprEfficiencyConfMax);
     ComputeOneSimple("ImprDistComp", ImprDistComp_, ImprDistCompAvg, ImprDistCompConfMin, ImprDistCompConfMax);
     ComputeOneSimple("MemUsage", Mem_, MemAvg, MemConfMin, MemConfMax);
+    ComputeOneSimple("PeakRSS", PeakRSS_, PeakRSSAvg, PeakRSSConfMin, PeakRSSConfMax);
   }
 
   double GetRecallAvg() const { return RecallAvg;} 
@@ -102,6 +129,10 @@ public:
   double GetMemConfMin() const{return MemConfMin;}; 
   double GetMemConfMax() const { return MemConfMax;}
 
+  double GetPeakRSSAvg() const { return PeakRSSAvg;} 
+  double GetPeakRSSConfMin() const{return PeakRSSConfMin;}; 
+  double GetPeakRSSConfMax() const { return PeakRSSConfMax;}
+
   double GetQueryTimeAvg() const { return QueryTimeAvg;} 
   double GetQueryTimeConfMin() const{return QueryTimeConfMin;}; 
   double GetQueryTimeConfMax() const { return QueryTimeConfMax;}
@@ -109,6 +140,24 @@ public:
   double GetDistCompAvg() const { return DistCompAvg;} 
   double GetDistCompConfMin() const{return DistCompConfMin;}; 
   double GetDistCompConfMax() const { return DistCompConfMax;}
+
+  // q-quantiles, e.g., GetQueryTimeQuantile(0.99) is the 99-th percentile
+  double GetQueryTimeQuantile(double q) const { return QueryTimeHist_.Quantile(q); }
+  double GetQueryTimeMax() const { return QueryTimeHist_.Max(); }
+  double GetDistCompQuantile(double q) const { return DistCompHist_.Quantile(q); }
+  double GetDistCompMax() const { return DistCompHist_.Max(); }
+
+  // Average (over test sets) value of the hardware counter per query
+  bool HasPerfCounter(unsigned counter) const { return !PerfCounters_[counter].empty(); }
+  bool HasAnyPerfCounter() const {
+    for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+      if (HasPerfCounter(i)) return true;
+    }
+    return false;
+  }
+  double GetPerfCounterAvg(unsigned counter) const {
+    return HasPerfCounter(counter) ? Mean(&PerfCounters_[counter][0], PerfCounters_[counter].size()) : 0;
+  }
 private:
 double RecallAvg, RecallConfMin, RecallConfMax;
 double LogRelPosErrorAvg, LogRelPosErrorConfMin, LogRelPosErrorConfMax;
@@ -118,6 +167,7 @@ double DistCompAvg, DistCompConfMin, DistCompConfMax;
 double ImprEfficiencyAvg, ImprEfficiencyConfMin, ImprEfficiencyConfMax;
 double ImprDistCompAvg, ImprDistCompConfMin, ImprDistCompConfMax;
 double MemAvg, MemConfMin, MemConfMax;
+double PeakRSSAvg, PeakRSSConfMin, PeakRSSConfMax;
 double zVal_;
 
 vector<vector<double>>   Recall_; 
@@ -128,8 +178,13 @@ vector<vector<double>>   DistComp_;
 vector<double>           ImprEfficiency_; 
 vector<double>           ImprDistComp_; 
 vector<double>           Mem_; 
+vector<double>           PeakRSS_; 
+vector<vector<double>>   PerfCounters_;
+
+LogHistogram             QueryTimeHist_;
+LogHistogram             DistCompHist_;
 
-MetaAnalysis(){} // be private!
+MetaAnalysis() : QueryTimeHist_(NewQueryTimeHist()), DistCompHist_(NewDistCompHist()) {} // be private!
 
 void ComputeOneSimple(const string &Name, 
                     const vector<vector<double>>& vals, double& avg, double& ConfMin, double& ConfMax) {
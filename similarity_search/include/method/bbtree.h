@@ -30,6 +30,7 @@
 
 #include "index.h"
 #include "params.h"
+#include "task_pool.h"
 
 #define METH_BBTREE                 "bbtree"
 
@@ -53,15 +54,28 @@ class BBTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const;
+
  private:
 
   class BBNode {
    public:
+    // The left subtree is built by a pool thread only if it has at least this many objects
+    static const size_t ParallelSubtreeMinQty = 1024;
+    // Divergences are computed in parallel in chunks of this size
+    static const size_t ParallelDistChunkQty = 2048;
+
+    /*
+     * The random generator created from the seed picks the initial centers
+     * and seeds both children, so the tree is the same regardless of indexThreadQty.
+     */
     BBNode(const BregmanDiv<dist_t>* div,
-           const ObjectVector& data, size_t bucket_size, bool use_optim);
+           const ObjectVector& data, size_t bucket_size, bool use_optim,
+           TaskPool& pool, unsigned seed);
     ~BBNode();
 
     inline bool IsLeaf();
+    size_t MemoryUsage() const;
 
     template <typename QueryType>
     bool RecBinSearch(const BregmanDiv<dist_t>* div,
@@ -80,12 +94,13 @@ class BBTree : public Index<dist_t> {
                     Object* query_gradient, QueryType* query,
                     int& MaxLeavesToVisit_);
 
-    void SelectCenters(const ObjectVector& data, ObjectVector& centers);
+    void SelectCenters(const ObjectVector& data, ObjectVector& centers, mt19937& gen);
 
     void FindSplitKMeans(const BregmanDiv<dist_t>* div, 
                          const ObjectVector& data,
                          ObjectVector& bucket_left, 
-                         ObjectVector& bucket_right);
+                         ObjectVector& bucket_right,
+                         TaskPool& pool, mt19937& gen);
 
    private:
     enum { kMaxRetry = 10 };
@@ -68,6 +68,11 @@ class DummyMethod : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  /*
+   * The number of bytes used by the index, the data set is not included.
+   */
+  size_t MemoryUsage() const { return sizeof(*this); }
+
  private:
   const ObjectVector&     data_;
   bool                    bDoSeqSearch_;
@@ -18,7 +18,10 @@
 #define _METRIC_GHTREE_H_
 
 #include "index.h"
+#include "index_io.h"
 #include "params.h"
+#include "task_pool.h"
+#include "transposed_bucket.h"
 
 #define METH_GHTREE                 "ghtree"
 
@@ -37,22 +40,46 @@ class GHTree : public Index<dist_t> {
   GHTree(const Space<dist_t>* space,
          const ObjectVector& data,
          const AnyParams& MethParams,
-         bool use_random_center = true);
+         bool use_random_center = true,
+         bool BuildIndex = true);
   ~GHTree();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
 
   class GHNode {
    public:
+    // The left subtree is spawned as a pool task only if it has at least this many objects
+    static const size_t ParallelSubtreeMinQty = 1024;
+    // Objects are assigned to subtrees in parallel in chunks of this size
+    static const size_t ParallelDistChunkQty = 2048;
+
+    /*
+     * Pivots are selected using a generator initialized with the seed,
+     * seeds of the children are drawn from the same generator.
+     * Hence, the same seed produces the same tree for any number of threads.
+     */
     GHNode(const Space<dist_t>* space, ObjectVector& data,
-           size_t bucket_size, bool chunk_bucket,
-           const bool use_random_center, bool is_root);
+           size_t bucket_size, bool chunk_bucket, bool transpose_bucket,
+           const bool use_random_center, bool is_root,
+           TaskPool& pool, unsigned seed);
+    // Loads a (sub)tree saved by Save()
+    GHNode(IndexFileReader& reader, const Space<dist_t>* space,
+           bool chunk_bucket, bool transpose_bucket);
     ~GHNode();
 
+    void Save(IndexFileWriter& writer) const;
+    size_t MemoryUsage() const;
+
     template <typename QueryType>
     void GenericSearch(QueryType* query, int& MaxLeavesToVisit);
 
@@ -63,14 +90,19 @@ class GHTree : public Index<dist_t> {
     GHNode* right_child_;
     ObjectVector* bucket_;
     char* CacheOptimizedBucket_;
+    // NULL unless transposeBucket is set and the space supports the transposed layout
+    TransposedBucket<dist_t>* transposed_;
     friend class GHTree;
   };
 
+  const Space<dist_t>* space_;
+  const ObjectVector& data_;
   GHNode* root_;
 
   size_t                    BucketSize_;
   int                       MaxLeavesToVisit_;
   bool                      ChunkBucket_;
+  bool                      TransposeBucket_;
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(GHTree);
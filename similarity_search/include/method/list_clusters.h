@@ -18,8 +18,10 @@
 #define _LIST_OF_CLUSTERS_H_
 
 #include "index.h"
+#include "index_io.h"
 #include "lcstrategy.h"
 #include "params.h"
+#include "transposed_bucket.h"
 
 #define METH_LIST_CLUSTERS          "list_clusters"
 
@@ -39,13 +41,20 @@ class ListClusters : public Index<dist_t> {
  public:
   ListClusters(const Space<dist_t>* space,
                const ObjectVector& data,
-               const AnyParams& MethParams);
+               const AnyParams& MethParams,
+               bool BuildIndex = true);
   ~ListClusters();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
   static const Object* SelectNextCenter(
       DistObjectPairVector<dist_t>& remaining,
       ListClustersStrategy strategy);
@@ -58,9 +67,15 @@ class ListClusters : public Index<dist_t> {
   class Cluster {
    public:
     Cluster(const Object* center);
+    // Loads a cluster saved by Save()
+    Cluster(IndexFileReader& reader);
     ~Cluster();
 
+    void Save(IndexFileWriter& writer) const;
+    size_t MemoryUsage() const;
+
     void OptimizeBucket();
+    void TransposeBucket(const Space<dist_t>* space);
     void AddObject(const Object* object,
                    const dist_t dist);
 
@@ -76,9 +91,13 @@ class ListClusters : public Index<dist_t> {
     dist_t covering_radius_;
     char* CacheOptimizedBucket_;
     ObjectVector* bucket_;
+    // NULL unless transposeBucket is set and the space supports the transposed layout
+    TransposedBucket<dist_t>* transposed_;
     int MaxLeavesToVisit_;
   };
 
+  const Space<dist_t>*  space_;
+  const ObjectVector&   data_;
   std::vector<Cluster*> cluster_list_;
 
   ListClustersStrategy Strategy_; 
@@ -87,6 +106,7 @@ class ListClusters : public Index<dist_t> {
   dist_t               Radius_;
   int                  MaxLeavesToVisit_;
   bool                 ChunkBucket_;
+  bool                 TransposeBucket_;
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(ListClusters);
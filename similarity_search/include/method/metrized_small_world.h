@@ -18,13 +18,15 @@
 #define _METRIZED_SMALL_WORLD_H_
 
 #include "index.h"
+#include "index_io.h"
 #include "params.h"
-//#include <vector>
-#include <set>
+#include <vector>
 #include <limits>
 #include <iostream>
-#include <map>
-#include <unordered_set>
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <stdint.h>
 
 
 #define METH_METRIZED_SMALL_WORLD                 "metrized_small_world"
@@ -32,33 +34,95 @@
 namespace similarity {
 
 using std::string;
+using std::vector;
 
 template <typename dist_t>
 class Space;
 
+// Node ids of the frozen graph
+typedef uint32_t MSWNodeId;
+
 //----------------------------------
+/*
+ * During a multi-threaded build, friends are added to a node
+ * by different threads: the list of friends is protected by a per-node lock.
+ * Once the index is built, the unprotected getAllFriends() can be used.
+ */
 class MSWNode{
 public:
-	MSWNode(const Object *Obj){
+	MSWNode(const Object *Obj, size_t id){
 		data_ = Obj;
+		id_ = id;
 	}
 	~MSWNode(){};
 	void removeAllFriends(){
+		std::unique_lock<std::mutex> lock(accessGuard_);
 		friends.clear();
 	}
-	void addFriend(MSWNode* element){
-		friends.insert(element);
+	// Returns the number of friends after the addition
+	size_t addFriend(MSWNode* element){
+		std::unique_lock<std::mutex> lock(accessGuard_);
+		if (std::find(friends.begin(), friends.end(), element) == friends.end()) {
+			friends.push_back(element);
+		}
+		return friends.size();
+	}
+	/*
+	 * Leaves at most maxQty friends. Friends are considered from the closest
+	 * to the farthest one: a friend is kept only if it is closer to the node
+	 * than to any friend kept before. Thus, the remaining friends point
+	 * in different directions rather than to the same cluster.
+	 */
+	template <typename dist_t>
+	void pruneFriends(const Space<dist_t>* space, size_t maxQty){
+		std::unique_lock<std::mutex> lock(accessGuard_);
+		if (friends.size() <= maxQty) return;
+
+		vector<std::pair<dist_t, MSWNode*>> cand;
+		cand.reserve(friends.size());
+		for (MSWNode* f : friends) cand.emplace_back(space->IndexTimeDistance(data_, f->getData()), f);
+		std::sort(cand.begin(), cand.end(),
+		          [](const std::pair<dist_t, MSWNode*>& a, const std::pair<dist_t, MSWNode*>& b) {
+		            return a.first < b.first || (a.first == b.first && a.second->getId() < b.second->getId());
+		          });
+
+		friends.clear();
+		for (const auto& c : cand) {
+			if (friends.size() >= maxQty) break;
+			bool keep = true;
+			for (MSWNode* kept : friends) {
+				if (space->IndexTimeDistance(c.second->getData(), kept->getData()) < c.first) {
+					keep = false;
+					break;
+				}
+			}
+			if (keep) friends.push_back(c.second);
+		}
 	}
 	const Object* getData(){
 		return data_;
 	}
-	const set<MSWNode*>& getAllFriends(){
+	// Ids are consecutive numbers starting from zero
+	size_t getId() const {
+		return id_;
+	}
+	const vector<MSWNode*>& getAllFriends(){
 		return friends;
 	}
+	// A thread-safe version of getAllFriends() to be used during a build
+	void copyAllFriends(vector<MSWNode*>& res){
+		std::unique_lock<std::mutex> lock(accessGuard_);
+		res.assign(friends.begin(), friends.end());
+	}
+	size_t MemoryUsage() const {
+		return sizeof(*this) + VectorMemoryUsage(friends);
+	}
 
 private:
-	const Object* data_;
-	set<MSWNode*> friends;
+	const Object*    data_;
+	size_t           id_;
+	vector<MSWNode*> friends;
+	std::mutex       accessGuard_;
 };
 //----------------------------------
 template <typename dist_t>
@@ -82,29 +146,124 @@ public:
     	else
     	return false;
 	}
+    bool operator> (const EvaluatedMSWNode &obj1) const
+	{
+    	return obj1 < *this;
+	}
 
 private:
 	dist_t distance;
 	MSWNode* element;
 };
 //----------------------------------
-template <typename dist_t>
-class SearchResult{
+/*
+ * The frozen graph (in the compressed sparse row format) and upper layers of
+ * the hierarchy of entry points are searched by the same code via these adapters.
+ * A node is identified by its position in the graph (or layer).
+ */
+class MSWFrozenGraph {
 public:
-	SearchResult(set<EvaluatedMSWNode<dist_t>> viewedList, int steps){
-		viewedList_ = viewedList;
-		steps_ = steps;
-	}
-	~SearchResult(){}
-	const set<EvaluatedMSWNode<dist_t>>& getViewedList(){
-		return viewedList_;
-	}
-	int getSteps(){
-		return steps_;
-	}
+  MSWFrozenGraph(const vector<size_t>& offsets, const vector<MSWNodeId>& friends,
+                 const vector<const Object*>& data, const vector<const char*>& payload)
+                 : offsets_(offsets), friends_(friends), data_(data), payload_(payload) {}
+  size_t size() const { return data_.size(); }
+  const MSWNodeId* friendsBegin(MSWNodeId pos) const { return friends_.data() + offsets_[pos]; }
+  const MSWNodeId* friendsEnd(MSWNodeId pos) const { return friends_.data() + offsets_[pos + 1]; }
+  const Object* object(MSWNodeId pos) const { return data_[pos]; }
+  const char* payload(MSWNodeId pos) const { return payload_[pos]; }
+private:
+  const vector<size_t>&         offsets_;
+  const vector<MSWNodeId>&      friends_;
+  const vector<const Object*>&  data_;
+  const vector<const char*>&    payload_;
+};
+
+/*
+ * An upper layer of the hierarchy of entry points. Layers are
+ * much smaller than the graph, so they aren't frozen.
+ */
+struct MSWLayer {
+  // Ids of nodes in the increasing order
+  vector<MSWNodeId>           ids;
+  // Positions of nodes in the layer below (for the lowest layer, these are ids)
+  vector<MSWNodeId>           down;
+  vector<vector<MSWNodeId>>   friends;
+
+  size_t MemoryUsage() const {
+    return VectorMemoryUsage(ids) + VectorMemoryUsage(down) + VectorMemoryUsage(friends);
+  }
+};
+
+class MSWLayerGraph {
+public:
+  MSWLayerGraph(const MSWLayer& layer, const vector<const Object*>& data, const vector<const char*>& payload)
+                : layer_(layer), data_(data), payload_(payload) {}
+  size_t size() const { return layer_.ids.size(); }
+  const MSWNodeId* friendsBegin(MSWNodeId pos) const { return layer_.friends[pos].data(); }
+  const MSWNodeId* friendsEnd(MSWNodeId pos) const { return friendsBegin(pos) + layer_.friends[pos].size(); }
+  const Object* object(MSWNodeId pos) const { return data_[layer_.ids[pos]]; }
+  const char* payload(MSWNodeId pos) const { return payload_[layer_.ids[pos]]; }
 private:
-	set<EvaluatedMSWNode<dist_t>> viewedList_;
-	int steps_;
+  const MSWLayer&               layer_;
+  const vector<const Object*>&  data_;
+  const vector<const char*>&    payload_;
+};
+//----------------------------------
+/*
+ * A set of visited nodes, which is cleared in O(1) time by incrementing the epoch
+ * (the array of marks is zeroed only when the epoch wraps around).
+ */
+class MSWVisitedList {
+public:
+  MSWVisitedList() : epoch_(0) {}
+  void Reset(size_t qty) {
+    if (marks_.size() < qty) marks_.resize(qty, 0);
+    if (++epoch_ == 0) {
+      std::fill(marks_.begin(), marks_.end(), 0);
+      epoch_ = 1;
+    }
+  }
+  // Returns false if the node was already visited
+  bool Visit(size_t id) {
+    if (marks_[id] == epoch_) return false;
+    marks_[id] = epoch_;
+    return true;
+  }
+private:
+  vector<uint16_t> marks_;
+  uint16_t         epoch_;
+};
+//----------------------------------
+/*
+ * The search state, which is reused by all searches carried out by the same thread,
+ * so that searching doesn't allocate memory (except when buffers grow).
+ */
+template <typename dist_t>
+struct MSWSearchBuffers {
+  MSWVisitedList                    visited;
+  // A min-heap of candidates to expand
+  vector<EvaluatedMSWNode<dist_t>>  candidates;
+  // A max-heap of at most k+1 closest evaluated nodes
+  vector<EvaluatedMSWNode<dist_t>>  results;
+  // Closest nodes found by all search attempts
+  vector<EvaluatedMSWNode<dist_t>>  found;
+  // A copy of friends of the expanded node (during a build)
+  vector<MSWNode*>                  friends;
+  // The same as above, but for the search in the frozen graph
+  vector<std::pair<dist_t, MSWNodeId>>  idCandidates;
+  vector<std::pair<dist_t, MSWNodeId>>  idResults;
+  vector<std::pair<dist_t, MSWNodeId>>  idFound;
+  // Nodes to expand during a range search and the numbers of hops outside the ball
+  vector<std::pair<MSWNodeId, int>>     rangeQueue;
+  // Nodes added to rangeQueue (a node can be evaluated, but not expanded)
+  MSWVisitedList                        rangeExpanded;
+  // Distances to nodes evaluated by a range search (valid only for visited nodes)
+  vector<dist_t>                        rangeDists;
+
+  static MSWSearchBuffers& ThreadLocal() {
+    static thread_local MSWSearchBuffers buffers;
+    return buffers;
+  }
 };
 //----------------------------------
 template <typename dist_t>
@@ -112,7 +271,8 @@ class Metrized_small_world : public Index<dist_t> {
 public:
  Metrized_small_world(const Space<dist_t>* space,
                       const ObjectVector& data,
-                      const AnyParams& MethParams);
+                      const AnyParams& MethParams,
+                      bool BuildIndex = true);
  ~Metrized_small_world();
 
  typedef std::vector<MSWNode*> ElementList;
@@ -121,22 +281,113 @@ public:
  const std::string ToString() const;
  void Search(RangeQuery<dist_t>* query);
  void Search(KNNQuery<dist_t>* query);
- MSWNode* getRandomEnterPoint();
- dist_t getKDistance(const set<EvaluatedMSWNode<dist_t>>& ElementSet, size_t k);
- SearchResult<dist_t> kSearchElementsWithAttempts(const Space<dist_t>* space, MSWNode* query, int NN, int initAttempts);
+
+ void Save(const string& location) const;
+ void Load(const string& location);
+ const string BuildParams() const;
+
+ size_t MemoryUsage() const;
+
+ // The locked version is used during a (multi-threaded) build
+ MSWNode* getRandomEnterPoint(bool locked = false);
+ // Finds (at most) NN unique closest elements, sorted by the distance
+ void kSearchElementsWithAttempts(const Space<dist_t>* space, MSWNode* query, size_t NN, int initAttempts,
+                                  vector<EvaluatedMSWNode<dist_t>>& res);
  void add(const Space<dist_t>* space, MSWNode *newElement);
- void link(MSWNode* first, MSWNode* second){
-	 first->addFriend(second);
-     second->addFriend(first);
+ void link(const Space<dist_t>* space, MSWNode* first, MSWNode* second){
+	 const size_t FirstQty = first->addFriend(second);
+	 const size_t SecondQty = second->addFriend(first);
+	 if (maxDegree_ && FirstQty > maxDegree_) first->pruneFriends(space, maxDegree_);
+	 if (maxDegree_ && SecondQty > maxDegree_) second->pruneFriends(space, maxDegree_);
  }
  template <typename QueryType> void GenSearch(QueryType* query);
 
+ // Returns a node id found via upper layers (or a random one if there are no layers)
+ template <typename QueryType>
+ MSWNodeId getEnterPoint(QueryType* query) const;
+ // The number of upper layers of the hierarchy of entry points (see buildHierarchy)
+ size_t getUpperLayerQty() const { return layers_.size(); }
+ // Ids of nodes of the upper layer l (1 <= l <= getUpperLayerQty()) in the increasing order
+ const vector<MSWNodeId>& getUpperLayerIds(size_t l) const { return layers_[l - 1].ids; }
+ // The maximum number of friends of a node of the frozen graph (l = 0) or the upper layer l
+ size_t getMaxDegree(size_t l) const;
+
 private:
+ /*
+  * A greedy search from a random enter point, which stops when the closest
+  * unexpanded candidate is farther than the (k+1)-th closest evaluated node.
+  * The closest nodes are left in the max-heap buf.results.
+  */
+ template <typename QueryType>
+ void searchOneAttempt(QueryType* query, size_t k, MSWSearchBuffers<dist_t>& buf);
+ // Moves the k closest unique nodes from buf.found to res
+ void selectClosest(size_t k, MSWSearchBuffers<dist_t>& buf, vector<EvaluatedMSWNode<dist_t>>& res);
+
+ /*
+  * Once the graph is built (or loaded), it is converted to the compressed sparse row
+  * format and the nodes are deleted: friends of the node i are frozenFriends_[j],
+  * where frozenOffsets_[i] <= j < frozenOffsets_[i+1]. Node ids are positions of
+  * objects in the data set, frozenData_[i] points to the data set object of the node i.
+  * frozenPayload_[i] is frozenData_[i]->data(): objects can be stored anywhere
+  * (e.g., in a memory-mapped file), so their data is prefetched using these pointers.
+  */
+ void freeze();
+ // The same as searchOneAttempt, but for the frozen graph or a layer (results are left in buf.idResults)
+ template <typename GraphType, typename QueryType>
+ void searchOneAttemptFrozen(const GraphType& graph, QueryType* query, MSWNodeId provider,
+                             size_t k, MSWSearchBuffers<dist_t>& buf);
+
+ /*
+  * Upper layers of the hierarchy of entry points are sampled geometrically:
+  * a node of a layer gets to the next one with the probability 1/max(NN, 2)
+  * (there are at most MaxHierarchyLevel upper layers).
+  * Each layer is a small world graph, where a node is linked to NN closest
+  * nodes found in the same layer. As in the bottom layer, friend lists longer
+  * than maxDegree_ are pruned. A search descends through the layers greedily,
+  * the closest node of the lowest upper layer is the first enter point of the search.
+  * Levels of nodes are sampled using a generator initialized with the seed.
+  */
+ void buildHierarchy(const Space<dist_t>* space, unsigned seed);
+ static const int MaxHierarchyLevel = 16;
+ // The same as MSWNode::pruneFriends for the node of the layer at the position pos
+ void pruneLayerFriends(const Space<dist_t>* space, MSWLayer& layer, MSWNodeId pos, size_t maxQty) const;
+ // Moves to the closest friend in the layer while it is closer than the current node
+ template <typename QueryType>
+ MSWNodeId descendLayer(const MSWLayer& layer, QueryType* query, MSWNodeId pos, dist_t& dist) const;
+
+ const ObjectVector& data_;
  int NN_;
  int initIndexAttempts_;
  int initSearchAttempts_;
+ /*
+  * A range search expands nodes outside the query ball
+  * if they are at most rangeExpandHops_ hops away from the ball.
+  * Larger values increase recall at the expense of more distance computations.
+  */
+ int rangeExpandHops_;
+ // If true, initSearchAttempts_ is one by default (see buildHierarchy)
+ bool useHierarchy_;
+ /*
+  * A KNN search keeps max(k, efSearch_) closest nodes (and stops when the closest
+  * unexpanded candidate is farther than all of them). Larger values increase
+  * recall, which is useful when there are few search attempts.
+  */
+ int efSearch_;
+ // If non-zero, friend lists that become longer are pruned (see MSWNode::pruneFriends)
+ size_t maxDegree_;
+ // One by default: only a graph built in one thread is determined by the seed
+ size_t indexThreadQty_;
  int size_;
  ElementList ElList;
+ // Protects ElList and size_ during a multi-threaded build
+ std::mutex ElListGuard_;
+
+ vector<size_t>                frozenOffsets_;
+ vector<MSWNodeId>             frozenFriends_;
+ vector<const Object*>         frozenData_;
+ vector<const char*>           frozenPayload_;
+ // layers_[i] is the layer i+1, the graph itself is the layer zero
+ vector<MSWLayer>              layers_;
 
 protected:
  void incSize(){
@@ -53,6 +53,8 @@ class MultiIndex : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const;
+
  private:
 
   std::vector<Index<dist_t>*> indices_;
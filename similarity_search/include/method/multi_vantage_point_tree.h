@@ -45,6 +45,8 @@ class MultiVantagePointTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const;
+
  private:
 
   struct Entry;
@@ -80,6 +82,7 @@ class MultiVantagePointTree : public Index<dist_t> {
         isleaf_(isleaf) {}
     virtual ~Node() {}
     inline bool isleaf() const { return isleaf_; }
+    virtual size_t MemoryUsage() const = 0;
 
    protected:
     const Object* pivot1_;
@@ -110,6 +113,13 @@ class MultiVantagePointTree : public Index<dist_t> {
       delete child3_;
       delete child4_;
     }
+    size_t MemoryUsage() const {
+      size_t res = sizeof(*this);
+      for (const Node* child : {child1_, child2_, child3_, child4_}) {
+        if (child != NULL) res += child->MemoryUsage();
+      }
+      return res;
+    }
    private:
     dist_t m1_;
     dist_t m21_, m22_;
@@ -143,6 +153,12 @@ class MultiVantagePointTree : public Index<dist_t> {
     ~LeafNode() {
       ClearBucket(CacheOptimizedBucket_, bucket_);
     }
+    size_t MemoryUsage() const {
+      size_t res = sizeof(*this) + VectorMemoryUsage(entries_) +
+                   BucketMemoryUsage(CacheOptimizedBucket_, bucket_);
+      for (const Entry& e : entries_) res += VectorMemoryUsage(e.path);
+      return res;
+    }
 
    private:
     Entries       entries_;
@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "index.h"
+#include "index_io.h"
 #include "permutation_utils.h"
 
 
@@ -42,15 +43,23 @@ class PermutationIndexIncrementalBin : public Index<dist_t> {
                               const ObjectVector& data,
                               const size_t num_pivot,
                               const size_t bin_threshold,
-                              const double db_scan_percentage);
+                              const double db_scan_percentage,
+                              bool BuildIndex = true);
   ~PermutationIndexIncrementalBin();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   const ObjectVector& data_;
+  const size_t        num_pivot_;
   ObjectVector        pivot_;
   const size_t        bin_threshold_;
   const size_t        db_scan_;
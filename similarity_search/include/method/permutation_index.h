@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "index.h"
+#include "index_io.h"
 #include "space_rank_correl.h"
 #include "permutation_utils.h"
 
@@ -38,17 +39,25 @@ class PermutationIndex : public Index<dist_t> {
                    const ObjectVector& data,
                    const size_t num_pivot,
                    const double db_scan_percentage,
-                   const IntDistFuncPtr perm_func);
+                   const IntDistFuncPtr perm_func,
+                   bool BuildIndex = true);
   ~PermutationIndex();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   const ObjectVector& data_;
   const size_t db_scan_;
   const IntDistFuncPtr permfunc_;
+  const size_t num_pivot_;
   ObjectVector pivot_;
   std::vector<Permutation> permtable_;
 
@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "index.h"
+#include "index_io.h"
 #include "permutation_utils.h"
 
 // If set, permutation vectors are stored contiguously in memory
@@ -39,16 +40,24 @@ class PermutationIndexIncremental : public Index<dist_t> {
   PermutationIndexIncremental(const Space<dist_t>* space,
                               const ObjectVector& data,
                               const size_t num_pivot,
-                              const double db_scan_percentage);
+                              const double db_scan_percentage,
+                              bool BuildIndex = true);
   ~PermutationIndexIncremental();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   const ObjectVector& data_;
   const size_t db_scan_;
+  const size_t num_pivot_;
   ObjectVector pivot_;
 #ifdef CONTIGUOUS_STORAGE
   std::vector<PivotIdType> permtable_;
@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "index.h"
+#include "index_io.h"
 #include "permutation_utils.h"
 
 #define METH_PERM_INVERTED_INDEX   "perm_inv_indx"
@@ -54,16 +55,24 @@ class PermutationInvertedIndex : public Index<dist_t> {
                 const size_t num_pivot_index,
                 const size_t num_pivot_search,
                 const size_t max_pos_diff,
-                const double db_scan_fraction);
+                const double db_scan_fraction,
+                bool BuildIndex = true);
   ~PermutationInvertedIndex();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   const ObjectVector& data_;
   const size_t db_scan_;
+  const size_t num_pivot_;
   const int num_pivot_index_;      // ki in the original paper
   const int num_pivot_search_;     // ks in the original paper
   const int max_pos_diff_;
@@ -19,6 +19,7 @@
 
 #include <string>
 #include "index.h"
+#include "index_io.h"
 #include "permutation_utils.h"
 
 #define METH_PERMUTATION_PREFIX_IND "perm_prefix"
@@ -44,17 +45,27 @@ class PermutationPrefixIndex : public Index<dist_t> {
                          const size_t num_pivot,
                          const size_t prefix_length,
                          const size_t min_candidate,
-                         bool chunk_bucket);
+                         bool chunk_bucket,
+                         bool BuildIndex = true);
   ~PermutationPrefixIndex();
 
   const std::string ToString() const;
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   template <typename QueryType>
   void GenSearch(QueryType* query);
 
+  const ObjectVector& data_;
+  const size_t num_pivot_;
+  const bool chunk_bucket_;
   // permutation prefix length (l in the original paper) in (0, num_pivot]
   const size_t prefix_length_;
   const size_t min_candidate_;
@@ -53,7 +53,8 @@ class PermutationVPTree : public Index<dist_t> {
  public:
   PermutationVPTree(const Space<dist_t>* space,
                    const ObjectVector& data,
-                   const AnyParams& MethPars);
+                   const AnyParams& MethPars,
+                   bool BuildIndex = true);
 
   ~PermutationVPTree();
 
@@ -61,9 +62,20 @@ class PermutationVPTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  /*
+   * Permutations are indexed by the VP-tree rather than data objects,
+   * so the VP-tree is saved to a separate file: <location>.vptree
+   */
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
   const Space<dist_t>*      space_;
   const ObjectVector&       data_;
+  size_t                    num_pivot_;
   size_t                    db_scan_qty_;
   ObjectVector              pivots_;
   ObjectVector              PermData_;
@@ -47,6 +47,8 @@ class ProjectionVPTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const;
+
  private:
   const SpaceSparseVector<dist_t>*  space_;
   const ObjectVector&               data_;
@@ -39,6 +39,8 @@ class SeqSearch : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const { return sizeof(*this); }
+
  private:
   const ObjectVector&     data_;
   // disable copy and assign
@@ -47,6 +47,8 @@ class SpatialApproxTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  size_t MemoryUsage() const;
+
  private:
   struct SATKnn;
   class SATNode;
@@ -17,9 +17,18 @@
 #define _VPTREE_H_
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
 
 #include "index.h"
+#include "index_io.h"
 #include "params.h"
+#include "task_pool.h"
+#include "object_arena.h"
+#include "transposed_bucket.h"
 
 #define METH_VPTREE          "vptree"
 #define METH_VPTREE_SAMPLE   "vptree_sample"
@@ -27,6 +36,7 @@
 namespace similarity {
 
 using std::string;
+using std::vector;
 
 // Vantage point tree
 
@@ -40,7 +50,8 @@ class VPTree : public Index<dist_t> {
          const Space<dist_t>* space,
          const ObjectVector& data,
          const AnyParams& MethParams,
-         bool use_random_center = true);
+         bool use_random_center = true,
+         bool BuildIndex = true);
   ~VPTree();
 
   const std::string ToString() const;
@@ -48,52 +59,185 @@ class VPTree : public Index<dist_t> {
   void Search(RangeQuery<dist_t>* query);
   void Search(KNNQuery<dist_t>* query);
 
+  void Save(const string& location) const;
+  void Load(const string& location);
+  const string BuildParams() const;
+
+  size_t MemoryUsage() const;
+
  private:
 
   class VPNode {
    public:
     // We want trees to be balanced
-    const size_t BalanceConst = 4; 
-
+    static const size_t BalanceConst = 4; 
+    // Smaller subtrees are built by the thread that creates their parent
+    static const size_t ParallelSubtreeMinQty = 1024;
+    // Distances to the pivot are computed in parallel in chunks of this size
+    static const size_t ParallelDistChunkQty = 4096;
+
+    /*
+     * The node uses its own random generator initialized with the seed
+     * (this generator is also passed to the search oracle creator),
+     * and it seeds its children using this generator. Thus, the tree
+     * doesn't depend on the order in which subtrees are built.
+     *
+     * paths contains distances from data objects to (at most MaxPathLen)
+     * closest ancestor pivots: PathLen(level, MaxPathLen) distances per object.
+     *
+     * If arity is two, data is split at the median distance to the pivot.
+     * Otherwise, data is split into (at most) arity shells at quantiles of distances.
+     */
     VPNode(bool     PrintProgress,
            unsigned level,
            size_t   TotalQty,
-           size_t&  IndexedQty,
+           std::atomic<size_t>&  IndexedQty,
+           TaskPool& pool,
+           unsigned seed,
            const SearchOracleCreator& OracleCreator,
            const Space<dist_t>* space, const ObjectVector& data,
-           size_t BucketSize, bool ChunkBucket,
+           size_t arity,
+           size_t MaxPathLen, const vector<dist_t>& paths,
+           size_t BucketSize, bool ChunkBucket, bool TransposeBucket,
            const string& SaveHistFileName,
            bool use_random_center, bool is_root);
+    // Loads a (sub)tree saved by Save()
+    VPNode(IndexFileReader& reader,
+           const SearchOracleCreator& OracleCreator,
+           const Space<dist_t>* space,
+           bool ChunkBucket, bool TransposeBucket,
+           unsigned level, size_t MaxPathLen);
     ~VPNode();
 
+    void Save(IndexFileWriter& writer) const;
+    size_t MemoryUsage() const;
+
+    // QueryPath contains distances from the query to pivots of all ancestors
     template <typename QueryType>
-    void GenericSearch(QueryType* query, int& MaxLeavesToVisit);
+    void GenericSearch(QueryType* query, int& MaxLeavesToVisit, vector<dist_t>& QueryPath);
 
    private:
-    void CreateBucket(bool ChunkBucket, const ObjectVector& data, 
+    void CreateBucket(const Space<dist_t>* space,
+                      bool ChunkBucket, bool TransposeBucket, const ObjectVector& data, 
+                      const vector<dist_t>& paths,
                       bool PrintProgress,
-                      size_t&  IndexedQty, size_t   TotalQty);
+                      std::atomic<size_t>&  IndexedQty, size_t   TotalQty);
+    struct Shell {
+      VPNode*     child_;
+      /* 
+       * Even if dist_t is double, or long double
+       * storing the bound as the single-precision number (i.e., float)
+       * should be good enough.
+       */
+      float       bound_;
+    };
     const Object* pivot_;
-    /* 
-     * Even if dist_t is double, or long double
-     * storing the median as the single-precision number (i.e., float)
-     * should be good enough.
+    /*
+     * Distances from objects of the i-th child to the pivot are in
+     * [shells_[i - 1].bound_, shells_[i].bound_), the bound of the last shell isn't used.
+     * In the binary tree, the bound is the median and objects whose distance
+     * is equal to the median may be in both children.
      */
-    float         mediandist_;
-    VPNode*       left_child_;
-    VPNode*       right_child_;
+    vector<Shell> shells_;
     SearchOracle* oracle_;
     ObjectVector* bucket_;
     char*         CacheOptimizedBucket_;
+    // NULL unless transposeBucket is set and the space supports the transposed layout
+    TransposedBucket<dist_t>* transposed_;
+    // Distances from bucket objects to ancestor pivots (in the same format as paths)
+    vector<dist_t> PivotDists_;
 
     friend class VPTree;
   };
 
+  /*
+   * If flatLayout is dfs or veb, once the tree is built (or loaded),
+   * it is laid out in one array in the depth-first or van Emde Boas order
+   * and the nodes are deleted. Children are referenced by positions,
+   * oracles are stored by value (in the same order), and, if chunkBucket is set,
+   * copies of pivots and bucket objects are stored in the layout order.
+   */
+  struct FlatNode {
+    const Object* pivot_;         // NULL for a bucket
+    uint32_t      oracle_;        // A position in flatOracles_
+    // Shells are flatShells_[ShellStart_], ..., flatShells_[ShellStart_ + ShellQty_ - 1]
+    uint32_t      ShellStart_;
+    uint32_t      ShellQty_;
+    // Bucket objects are flatObjects_[BucketStart_], ..., flatObjects_[BucketEnd_ - 1]
+    uint32_t      BucketStart_;
+    uint32_t      BucketEnd_;
+  };
+  // The same as VPNode::Shell
+  struct FlatShell {
+    uint32_t      child_;         // kFlatNull if there is no child
+    float         bound_;
+  };
+  static const uint32_t kFlatNull = static_cast<uint32_t>(-1);
+
+  void Flatten();
+  static size_t Height(const VPNode* node);
+  static void LayoutDFS(VPNode* node, vector<VPNode*>& order);
+  // Lays out nodes above the given height, their children at this height are added to below
+  static void LayoutVEB(VPNode* node, size_t height, vector<VPNode*>& order, vector<VPNode*>& below);
+  void SaveFlat(IndexFileWriter& writer, uint32_t node, unsigned level) const;
+  template <typename QueryType>
+  void FlatSearch(QueryType* query, uint32_t node, int& MaxLeavesToVisit, vector<dist_t>& QueryPath);
+
+  /*
+   * If maxPathLen is positive, buckets keep distances from their objects to
+   * (at most maxPathLen) closest ancestor pivots, like the multi-vantage point tree does.
+   * The search skips an object if, for some ancestor pivot p, |d(p, q) - d(p, o)| > r.
+   * Thus, this is exact only in metric spaces.
+   */
+  static size_t PathLen(unsigned level, size_t MaxPathLen) {
+    return std::min<size_t>(level, MaxPathLen);
+  }
+
+  /*
+   * If bestFirst is set, a KNN search visits subtrees in the order of lower bounds
+   * on distances from the query to their objects (see BestFirstSearch). The same code
+   * works for both layouts of the tree: nodes are accessed via these views.
+   */
+  class PointerTreeView;
+  class FlatTreeView;
+  template <typename TreeView>
+  void BestFirstSearch(const TreeView& view, KNNQuery<dist_t>* query);
+
+  const Space<dist_t>*      space_;
+  const ObjectVector&       data_;
+  const SearchOracleCreator OracleCreator_;
+
   VPNode* root_;
   size_t  BucketSize_;
   int     MaxLeavesToVisit_;
   bool    ChunkBucket_;
+  /*
+   * If transposeBucket is set and the space is dense (e.g., l1, l2, linf),
+   * buckets also keep a copy of their vectors in the transposed layout
+   * (see TransposedBucket). Distances to objects of such a bucket are computed
+   * several at a time, unless the bucket is filtered using maxPathLen.
+   */
+  bool    TransposeBucket_;
   string  SaveHistFileName_;
+  string  FlatLayout_;
+  bool    BestFirst_;
+  size_t  MaxPathLen_;
+  /*
+   * The number of children of a node. The oracle of the node is applied to
+   * every bound between shells, but the sampling oracle is learned for the median.
+   * Thus, it is less accurate if the arity is larger than two.
+   */
+  size_t  Arity_;
+
+  vector<FlatNode>              flatNodes_;
+  vector<FlatShell>             flatShells_;
+  vector<SearchOracle>          flatOracles_;
+  vector<const Object*>         flatObjects_;
+  // Distances of flatObjects_[i] to ancestor pivots start at flatPivotDists_[i * MaxPathLen_]
+  vector<dist_t>                flatPivotDists_;
+  std::unique_ptr<ObjectArena>  flatArena_;
+  // Transposed buckets of flatNodes_[i] (NULL for nodes without them)
+  vector<std::unique_ptr<TransposedBucket<dist_t>>> flatTransposed_;
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(VPTree);
 };
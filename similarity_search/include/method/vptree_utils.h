@@ -25,9 +25,9 @@
 
 namespace similarity {
 
-inline size_t SelectVantagePoint(const ObjectVector& data, bool use_random_center) {
+inline size_t SelectVantagePoint(const ObjectVector& data, bool use_random_center, mt19937& gen) {
   CHECK(!data.empty());
-  return use_random_center ? RandomInt() % data.size() : data.size() - 1;
+  return use_random_center ? gen() % data.size() : data.size() - 1;
 }
 
 /* 
@@ -44,7 +44,8 @@ public:
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& MethPars);
+                           const AnyParams& MethPars,
+                           bool BuildIndex);
 
   static MethodFactoryRegistry& Instance() {
     static MethodFactoryRegistry elem;
@@ -57,14 +58,20 @@ public:
     Creators_[MethodName] = func;
   }
 
+  /*
+   * If BuildIndex is false, methods that support loading (see Index::Load)
+   * only memorize parameters and the index structure is not created.
+   * Other methods ignore this flag.
+   */
   Index<dist_t>* CreateMethod(bool PrintProgress,
                             const string& MethName,
                             const string& SpaceType,
                             const Space<dist_t>* space,
                             const ObjectVector& DataObjects,
-                            const AnyParams& MethPars) {
+                            const AnyParams& MethPars,
+                            bool BuildIndex = true) {
     if (Creators_.count(MethName)) {
-      return Creators_[MethName](PrintProgress, SpaceType, space, DataObjects, MethPars);
+      return Creators_[MethName](PrintProgress, SpaceType, space, DataObjects, MethPars, BuildIndex);
     } else {
       LOG(FATAL) << "It looks like the method " << MethName << 
                     " is not defined for the distance type : " << DistTypeName<dist_t>();
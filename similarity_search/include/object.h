@@ -48,16 +48,17 @@ class Object {
     buffer_ = new char[ID_SIZE + DATALENGTH_SIZE + datalength];
     CHECK(buffer_ != NULL);
     memory_allocated_ = true;
-    char* ptr = buffer_;
-    memcpy(ptr, &id, ID_SIZE);
-    ptr += ID_SIZE;
-    memcpy(ptr, &datalength, DATALENGTH_SIZE);
-    ptr += DATALENGTH_SIZE;
-    if (data != NULL) {
-      memcpy(ptr, data, datalength);
-    } else {
-      memset(ptr, 0, datalength);
-    }
+    InitBuffer(buffer_, id, datalength, data);
+  }
+
+  /* 
+   * Fills in an externally allocated buffer (e.g., provided by ObjectArena).
+   * The buffer should be at least ID_SIZE + DATALENGTH_SIZE + datalength
+   * bytes long. The object doesn't own the buffer.
+   */
+  Object(char* buffer, IdType id, size_t datalength, const void* data)
+    : buffer_(buffer), memory_allocated_(false) {
+    InitBuffer(buffer_, id, datalength, data);
   }
 
   ~Object() {
@@ -95,6 +96,18 @@ class Object {
   }
 
  private:
+  static void InitBuffer(char* ptr, IdType id, size_t datalength, const void* data) {
+    memcpy(ptr, &id, ID_SIZE);
+    ptr += ID_SIZE;
+    memcpy(ptr, &datalength, DATALENGTH_SIZE);
+    ptr += DATALENGTH_SIZE;
+    if (data != NULL) {
+      memcpy(ptr, data, datalength);
+    } else {
+      memset(ptr, 0, datalength);
+    }
+  }
+
   char* buffer_;
   bool memory_allocated_;
 
@@ -154,6 +167,28 @@ inline void ClearBucket(char* CacheOptimizedBucket,
   delete bucket;
 }
 
+/*
+ * Memory used by a bucket (see CreateCacheOptimizedBucket),
+ * including copies of objects if the bucket is cache-optimized.
+ */
+inline size_t BucketMemoryUsage(const char* CacheOptimizedBucket,
+                                const ObjectVector* bucket) {
+  if (!bucket) return 0;
+  size_t res = sizeof(ObjectVector) + bucket->capacity() * sizeof(const Object*);
+  if (CacheOptimizedBucket) res += bucket->size() * sizeof(Object) + TotalSpaceUsed(*bucket);
+  return res;
+}
+
+// Memory used by objects created by the index (e.g., pivots or projections)
+inline size_t ObjectMemoryUsage(const Object* object) {
+  return object ? sizeof(Object) + object->bufferlength() : 0;
+}
+
+inline size_t ObjectsMemoryUsage(const ObjectVector& objects) {
+  return objects.capacity() * sizeof(const Object*) +
+         objects.size() * sizeof(Object) + TotalSpaceUsed(objects);
+}
+
 typedef std::list<const Object*> ObjectList;
 
 template<typename dist_t>
@@ -0,0 +1,174 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _OBJECT_ARENA_H_
+#define _OBJECT_ARENA_H_
+
+#include <stdint.h>
+
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "global.h"
+#include "object.h"
+#include "mapped_file.h"
+#include "logging.h"
+
+namespace similarity {
+
+/*
+ * A dataset-wide store for objects. Instead of allocating each
+ * object (and its buffer) on the heap, objects are packed one after
+ * another into large chunks: | Object | id | datasize | data ... | Object | ...
+ * Each entry starts on a kArenaAlignment boundary, so object data is
+ * 16-byte aligned (ID_SIZE + DATALENGTH_SIZE == 16).
+ *
+ * Objects created by the arena must NOT be deleted individually:
+ * the memory is released in one go when the arena is destroyed.
+ * Whether an object belongs to the arena can be checked using Owns().
+ * The arena is not thread-safe.
+ */
+class ObjectArena {
+ public:
+  enum { kArenaAlignment = 16 };
+  static const size_t kDefaultChunkSize = 16 * 1024 * 1024;
+
+  explicit ObjectArena(size_t ChunkSize = kDefaultChunkSize)
+    : chunk_size_(ChunkSize), curr_(NULL), left_(0),
+      object_qty_(0), mem_used_(0), mem_allocated_(0) {}
+
+  ~ObjectArena() {
+    for (const auto& chunk: chunks_) delete [] chunk.first;
+    for (MappedFile* f: mapped_files_) delete f;
+  }
+
+  Object* CreateObject(IdType id, size_t datalength, const void* data) {
+    const size_t ObjSize = AlignSize(sizeof(Object));
+    const size_t BuffSize = AlignSize(ID_SIZE + DATALENGTH_SIZE + datalength);
+    char* p = Allocate(ObjSize + BuffSize);
+    ++object_qty_;
+    return new (p) Object(p + ObjSize, id, datalength, data);
+  }
+
+  const Object* CloneObject(const Object* obj) {
+    return CreateObject(obj->id(), obj->datalength(), obj->data());
+  }
+
+  /*
+   * Creates an object that doesn't copy data, but points to an existing buffer,
+   * e.g., to a memory-mapped file adopted by the arena (see AdoptMappedFile).
+   */
+  const Object* CreateObjectRef(char* buffer) {
+    char* p = Allocate(AlignSize(sizeof(Object)));
+    ++object_qty_;
+    return new (p) Object(buffer);
+  }
+
+  // The arena takes ownership and unmaps the file when it is destroyed
+  void AdoptMappedFile(MappedFile* file) { mapped_files_.push_back(file); }
+
+  /*
+   * Takes over all the objects of the other arena, which becomes empty.
+   * Objects aren't copied, e.g., objects created by several threads
+   * in their own arenas can be merged into a single arena.
+   */
+  void Merge(ObjectArena& other) {
+    for (const Chunk& chunk: other.chunks_) AddChunk(chunk.first, chunk.second);
+    mapped_files_.insert(mapped_files_.end(), other.mapped_files_.begin(), other.mapped_files_.end());
+    object_qty_    += other.object_qty_;
+    mem_used_      += other.mem_used_;
+    mem_allocated_ += other.mem_allocated_;
+
+    other.chunks_.clear();
+    other.mapped_files_.clear();
+    other.curr_ = NULL;
+    other.left_ = 0;
+    other.object_qty_ = other.mem_used_ = other.mem_allocated_ = 0;
+  }
+
+  // Checks if the object was created by the arena (it takes O(log(# of chunks)))
+  bool Owns(const Object* obj) const {
+    const char* p = reinterpret_cast<const char*>(obj);
+    auto it = std::upper_bound(chunks_.begin(), chunks_.end(), p,
+                               [](const char* p, const Chunk& chunk) { return p < chunk.first; });
+    if (it == chunks_.begin()) return false;
+    --it;
+    return p < it->first + it->second;
+  }
+
+  size_t ObjectQty() const { return object_qty_; }
+  // The number of bytes occupied by objects (including alignment padding)
+  size_t MemoryUsed() const { return mem_used_; }
+  // The number of bytes requested from the heap
+  size_t MemoryAllocated() const { return mem_allocated_; }
+
+ private:
+  static size_t AlignSize(size_t size) {
+    return (size + kArenaAlignment - 1) & ~static_cast<size_t>(kArenaAlignment - 1);
+  }
+
+  char* Allocate(size_t size) {
+    if (size > left_) {
+      // Very large objects get a dedicated chunk
+      size_t ChunkSize = std::max(size, chunk_size_);
+      char* chunk = new char[ChunkSize + kArenaAlignment];
+      CHECK(chunk != NULL);
+      AddChunk(chunk, ChunkSize + kArenaAlignment);
+      mem_allocated_ += ChunkSize + kArenaAlignment;
+      curr_ = reinterpret_cast<char*>(AlignSize(reinterpret_cast<uintptr_t>(chunk)));
+      left_ = ChunkSize;
+    }
+    char* res = curr_;
+    curr_ += size;
+    left_ -= size;
+    mem_used_ += size;
+    return res;
+  }
+
+  // Chunks are sorted by their addresses (see Owns)
+  void AddChunk(char* chunk, size_t size) {
+    Chunk c(chunk, size);
+    chunks_.insert(std::upper_bound(chunks_.begin(), chunks_.end(), c), c);
+  }
+
+  typedef std::pair<char*, size_t> Chunk;
+
+  size_t              chunk_size_;
+  char*               curr_;
+  size_t              left_;
+  size_t              object_qty_;
+  size_t              mem_used_;
+  size_t              mem_allocated_;
+  std::vector<Chunk>  chunks_;
+  std::vector<MappedFile*>  mapped_files_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(ObjectArena);
+};
+
+/*
+ * If the arena is not NULL, the object is created in the arena.
+ * Otherwise, it is allocated on the heap and the caller should delete it.
+ */
+inline Object* NewObject(ObjectArena* arena, IdType id, size_t datalength, const void* data) {
+  return arena ? arena->CreateObject(id, datalength, data) : new Object(id, datalength, data);
+}
+
+}   // namespace similarity
+
+#endif    // _OBJECT_ARENA_H_
@@ -16,6 +16,7 @@
 #ifndef PARAMS_H
 #define PARAMS_H
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <limits>
@@ -112,6 +113,11 @@ public:
     GetParam<ParamType>(Name, Value, false);
   }
 
+  // Checks if the parameter is specified (without marking it as seen)
+  bool HasParam(const string& Name) const {
+    return std::find(params.ParamNames.begin(), params.ParamNames.end(), Name) != params.ParamNames.end();
+  }
+
   /*
    * Takes a list of exceptions and extracts all parameter values, 
    * except parameters from the excpetions' list. The extracted parameters
@@ -195,6 +201,7 @@ void ParseCommandLine(int argc, char*av[],
                       shared_ptr<AnyParams>&  SpaceParams,
                       unsigned&               dimension,
                       unsigned&               ThreadTestQty,
+                      bool&                   PerfCounters,
                       bool&                   DoAppend, 
                       string&                 ResFilePrefix,
                       unsigned&               TestSetQty,
@@ -205,6 +212,12 @@ void ParseCommandLine(int argc, char*av[],
                       vector<unsigned>&       knn,
                       float&                  eps,
                       string&                 RangeArg,
+                      string&                 SaveIndexPrefix,
+                      string&                 LoadIndexPrefix,
+                      string&                 CachePrefixGS,
+                      unsigned&               MaxCacheGSRelativeQty,
+                      bool&                   KeepAllDistsGS,
+                      unsigned&               ThreadGSQty,
                       multimap<string, shared_ptr<AnyParams>>& Methods);
 
 };
@@ -0,0 +1,67 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+#include "global.h"
+
+namespace similarity {
+
+enum PerfCounterType {
+  kPerfCycles       = 0,
+  kPerfInstructions = 1,
+  kPerfLLCMisses    = 2,
+  kPerfBranchMisses = 3,
+  kPerfCounterQty   = 4
+};
+
+const char* PerfCounterName(unsigned counter);
+
+/*
+ * Hardware performance counters (Linux perf_event_open), which count
+ * user-space events of the calling thread and of all the threads
+ * it creates after the counters are opened (a thread's counts are added
+ * when the thread finishes). Counters can be unavailable, e.g., in a virtual
+ * machine, on non-Linux systems, or if /proc/sys/kernel/perf_event_paranoid
+ * doesn't permit monitoring: such counters are simply ignored.
+ * If the number of counters exceeds the number of hardware registers,
+ * the kernel multiplexes them and the counts are extrapolated.
+ */
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+
+  bool IsAvailable(unsigned counter) const { return fd_[counter] >= 0; }
+  bool IsAnyAvailable() const;
+
+  // Resets and enables counting
+  void Start();
+  void Stop();
+  // Returns zero for an unavailable counter
+  uint64_t Get(unsigned counter) const;
+ private:
+  int fd_[kPerfCounterQty];
+
+  DISABLE_COPY_AND_ASSIGN(PerfCounters);
+};
+
+}   // namespace similarity
+
+#endif    // _PERF_COUNTERS_H_
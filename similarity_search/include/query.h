@@ -18,12 +18,16 @@
 #define _QUERY_H_
 
 #include "object.h"
+#include "search_trace.h"
 
 namespace similarity {
 
 template <typename dist_t>
 class Space;
 
+template <typename dist_t>
+class TransposedBucket;
+
 template <typename dist_t>
 class Query {
  public:
@@ -39,16 +43,33 @@ class Query {
   // Distance can be assymetric!
   virtual dist_t DistanceObjLeft(const Object* object);
   virtual dist_t DistanceObjRight(const Object* object);
+  /*
+   * Computes out[i] = DistanceObjLeft(objs[i]) for qty objects using a single call
+   * to the space (see Space::BatchDistance). Each object counts as a distance computation.
+   */
+  void DistanceBatch(const Object* const* objs, size_t qty, dist_t* out);
+  // The same for objects start, ..., start + qty - 1 of the transposed bucket
+  void DistanceTransposed(const TransposedBucket<dist_t>& bucket, size_t start, size_t qty, dist_t* out);
+  // Buckets are processed in batches of this size (see CheckAndAddToResult)
+  static const size_t kDistanceBatchQty = 64;
 
   virtual void Reset() = 0;
   virtual dist_t Radius() const = 0;
   virtual unsigned ResultSize() const = 0;
   virtual void Print() const = 0;
 
+#ifdef WITH_SEARCH_TRACE
+  SearchTrace& Trace() { return trace_; }
+  const SearchTrace& Trace() const { return trace_; }
+#endif
+
  protected:
   const Space<dist_t>* space_;
   const Object* query_object_;
   uint64_t distance_computations_;
+#ifdef WITH_SEARCH_TRACE
+  SearchTrace trace_;
+#endif
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(Query);
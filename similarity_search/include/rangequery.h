@@ -38,6 +38,10 @@ class RangeQuery : public Query<dist_t> {
   bool CheckAndAddToResult(const dist_t distance, const Object* object);
   bool CheckAndAddToResult(const Object* object);
   size_t CheckAndAddToResult(const ObjectVector& bucket);
+  // Distances are computed in batches (see Query::DistanceBatch)
+  size_t CheckAndAddToResult(const Object* const* objs, size_t qty);
+  // The same, but distances are computed using the transposed copy of objs
+  size_t CheckAndAddToResult(const Object* const* objs, const TransposedBucket<dist_t>& bucket);
   bool Equals(const RangeQuery<dist_t>* query) const;
   void Print() const;
   static std::string Type() { return "RANGE"; }
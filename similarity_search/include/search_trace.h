@@ -0,0 +1,154 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _SEARCH_TRACE_H_
+#define _SEARCH_TRACE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "global.h"
+
+/*
+ * Optional per-phase tracing of the search: the time of each query
+ * is split among distance evaluation, pruning (the decisions made
+ * by tree/graph traversal code) and maintenance of the result queue
+ * (and other queues of candidates). The remaining time is attributed
+ * to the traversal itself.
+ *
+ * Tracing is enabled at compile time with -DWITH_SEARCH_TRACE
+ * (cmake -DWITH_SEARCH_TRACE=ON). Otherwise, all the macros below
+ * expand to nothing and there is no overhead.
+ *
+ * The attribution is exclusive: when phases are nested (e.g., a distance
+ * is computed while updating the queue of candidates), the time of the
+ * inner phase is subtracted from the time of the outer one.
+ */
+
+#ifdef WITH_SEARCH_TRACE
+
+#define SEARCH_TRACE_CONCAT_IMPL(a, b) a##b
+#define SEARCH_TRACE_CONCAT(a, b)      SEARCH_TRACE_CONCAT_IMPL(a, b)
+
+// Attributes the time until the end of the current scope to the phase
+#define SEARCH_TRACE_SCOPE(query, phase) \
+  similarity::SearchTraceScope SEARCH_TRACE_CONCAT(SearchTraceScope_, __LINE__)((query)->Trace(), similarity::phase)
+// Attributes the time of evaluating the expression to the phase
+#define SEARCH_TRACE_EXPR(query, phase, expr) \
+  (similarity::SearchTraceScope((query)->Trace(), similarity::phase), (expr))
+
+#else
+
+#define SEARCH_TRACE_SCOPE(query, phase)
+#define SEARCH_TRACE_EXPR(query, phase, expr) (expr)
+
+#endif
+
+namespace similarity {
+
+enum SearchTracePhase {
+  kTraceTraversal = 0,
+  kTraceDistance  = 1,
+  kTracePruning   = 2,
+  kTraceQueue     = 3,
+  kTracePhaseQty  = 4
+};
+
+inline const char* SearchTracePhaseName(unsigned phase) {
+  static const char* names[kTracePhaseQty] = {"traversal", "distance", "pruning", "queue"};
+  return phase < kTracePhaseQty ? names[phase] : "unknown";
+}
+
+/*
+ * Ticks are TSC cycles on x86 (reading the TSC is several times cheaper
+ * than a call to clock_gettime) and nanoseconds elsewhere.
+ */
+inline uint64_t SearchTraceTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+// The number of ticks per nanosecond, estimated once
+double SearchTraceTicksPerNanosec();
+
+class SearchTrace {
+ public:
+  SearchTrace() { Start(); }
+
+  void Start() {
+    for (unsigned i = 0; i < kTracePhaseQty; ++i) {
+      ticks_[i] = 0;
+      calls_[i] = 0;
+    }
+    phase_ = kTraceTraversal;
+    last_ = SearchTraceTicks();
+  }
+  void Stop() { Switch(kTraceTraversal); }
+
+  // Returns the previous phase
+  SearchTracePhase Switch(SearchTracePhase phase) {
+    uint64_t now = SearchTraceTicks();
+    ticks_[phase_] += now - last_;
+    last_ = now;
+    SearchTracePhase prev = phase_;
+    phase_ = phase;
+    return prev;
+  }
+  void Enter(SearchTracePhase phase) { ++calls_[phase]; }
+
+  void Merge(const SearchTrace& other) {
+    for (unsigned i = 0; i < kTracePhaseQty; ++i) {
+      ticks_[i] += other.ticks_[i];
+      calls_[i] += other.calls_[i];
+    }
+  }
+
+  uint64_t GetTicks(unsigned phase) const { return ticks_[phase]; }
+  uint64_t GetCalls(unsigned phase) const { return calls_[phase]; }
+  uint64_t GetTotalTicks() const {
+    uint64_t res = 0;
+    for (unsigned i = 0; i < kTracePhaseQty; ++i) res += ticks_[i];
+    return res;
+  }
+ private:
+  uint64_t          ticks_[kTracePhaseQty];
+  uint64_t          calls_[kTracePhaseQty];
+  SearchTracePhase  phase_;
+  uint64_t          last_;
+};
+
+class SearchTraceScope {
+ public:
+  SearchTraceScope(SearchTrace& trace, SearchTracePhase phase) : trace_(trace) {
+    trace_.Enter(phase);
+    prev_ = trace_.Switch(phase);
+  }
+  ~SearchTraceScope() { trace_.Switch(prev_); }
+ private:
+  SearchTrace&      trace_;
+  SearchTracePhase  prev_;
+
+  DISABLE_COPY_AND_ASSIGN(SearchTraceScope);
+};
+
+}   // namespace similarity
+
+#endif    // _SEARCH_TRACE_H_
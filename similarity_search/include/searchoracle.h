@@ -18,16 +18,20 @@
 
 #include <string>
 #include <sstream>
+#include <random>
 
 #include "object.h"
 #include "space.h"
 #include "experimentconf.h"
+#include "index.h"
+#include "index_io.h"
 #include "logging.h"
 
 namespace similarity {
 
 using std::string; 
 using std::stringstream;
+using std::mt19937;
 
 enum VPTreeVisitDecision { kVisitLeft = 1, kVisitRight = 2, kVisitBoth = 3 };
 
@@ -65,6 +69,9 @@ public:
     str << "AlphaLeft: " << alpha_left_ << " AlphaRight: " << alpha_right_;
     return str.str();
   }
+  // Stretching coefficients are not saved: they are specified when the index is loaded
+  void Save(IndexFileWriter& writer) const {}
+  size_t MemoryUsage() const { return sizeof(*this); }
 private:
   double alpha_left_;
   double alpha_right_;
@@ -78,9 +85,19 @@ public:
     LOG(INFO) << "alphaRight (right stretch coeff)= " << alpha_right;
 
   }
-  TriangIneq<dist_t>* Create(unsigned level, const Object* /*pivot_*/, const DistObjectPairVector<dist_t>& /*dists*/) const {
+  TriangIneq<dist_t>* Create(unsigned level, const Object* /*pivot_*/, const DistObjectPairVector<dist_t>& /*dists*/,
+                             mt19937& /*gen*/) const {
     return new TriangIneq<dist_t>(alpha_left_, alpha_right_);
   }
+  TriangIneq<dist_t>* Load(IndexFileReader& reader) const {
+    return new TriangIneq<dist_t>(alpha_left_, alpha_right_);
+  }
+  /*
+   * True if oracles prune every shell that is farther from the query than
+   * the radius according to the triangle inequality (i.e., unless the inequality
+   * is relaxed by a stretching coefficient smaller than one).
+   */
+  bool PrunesBeyondRadius() const { return alpha_left_ >= 1 && alpha_right_ >= 1; }
 private:
   double alpha_left_;
   double alpha_right_;
@@ -98,8 +115,16 @@ public:
                    float  QuantileStepPivot,
                    float  QuantileStepPseudoQuery,
                    size_t NumOfPseudoQueriesInQuantile,
-                   float  DistLearnThreshold
+                   float  DistLearnThreshold,
+                   mt19937& gen // random numbers for sampling
                    );
+    // Re-creates a previously saved oracle
+    SamplingOracle(bool NotEnoughData,
+                   const std::vector<dist_t>& PivotDists,
+                   const std::vector<dist_t>& MaxPseudoQueryDists) :
+                   NotEnoughData_(NotEnoughData),
+                   QuantilePivotDists(PivotDists),
+                   QuantileMaxPseudoQueryDists(MaxPseudoQueryDists) {}
     static std::string GetName() { return "sampling"; }
 
     inline VPTreeVisitDecision Classify(dist_t dist, dist_t MaxDist, dist_t MedianDist) {
@@ -136,6 +161,14 @@ public:
 
       return str1.str() + "\n" + str2.str() + "\n";
     }
+    void Save(IndexFileWriter& writer) const {
+      writer.Write<uint8_t>(NotEnoughData_);
+      writer.WriteVector(QuantilePivotDists);
+      writer.WriteVector(QuantileMaxPseudoQueryDists);
+    }
+    size_t MemoryUsage() const {
+      return sizeof(*this) + VectorMemoryUsage(QuantilePivotDists) + VectorMemoryUsage(QuantileMaxPseudoQueryDists);
+    }
 
 private:
   const  unsigned MinQuantIndQty = 4;  
@@ -150,7 +183,8 @@ private:
 template <typename dist_t>
 class SamplingOracleCreator {
 public:
-    SamplingOracle<dist_t>* Create(unsigned level, const Object* pivot, const DistObjectPairVector<dist_t>& dists) const {
+    SamplingOracle<dist_t>* Create(unsigned level, const Object* pivot, const DistObjectPairVector<dist_t>& dists,
+                                   mt19937& gen) const {
       try {
         return new SamplingOracle<dist_t>(space_,
                                           AllVectors_,
@@ -161,7 +195,8 @@ public:
                                           QuantileStepPivot_,
                                           QuantileStepPseudoQuery_,
                                           NumOfPseudoQueriesInQuantile_,
-                                          DistLearnThreshold_);
+                                          DistLearnThreshold_,
+                                          gen);
       } catch (const std::exception& e) {
         LOG(FATAL) << "Exception while creating sampling oracle: " << e.what();
       } catch (...) {
@@ -169,6 +204,18 @@ public:
       } 
       return NULL;
     }
+    SamplingOracle<dist_t>* Load(IndexFileReader& reader) const {
+      uint8_t               NotEnoughData;
+      std::vector<dist_t>   PivotDists, MaxPseudoQueryDists;
+
+      reader.Read(NotEnoughData);
+      reader.ReadVector(PivotDists);
+      reader.ReadVector(MaxPseudoQueryDists);
+
+      return new SamplingOracle<dist_t>(NotEnoughData != 0, PivotDists, MaxPseudoQueryDists);
+    }
+    // Learned oracles can visit shells that are farther than the radius
+    bool PrunesBeyondRadius() const { return false; }
     SamplingOracleCreator(const typename similarity::Space<dist_t>* space,
                    const ObjectVector& AllVectors,
                    bool   DoRandSample,
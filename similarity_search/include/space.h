@@ -57,6 +57,9 @@ class RangeQuery;
 template <typename dist_t>
 struct Experiments;
 
+template <typename dist_t>
+class GoldStandardManager;
+
 template <typename dist_t>
 class Space {
  public:
@@ -69,12 +72,24 @@ class Space {
     }
     return HiddenDistance(obj1, obj2);
   }
+  /*
+   * If config isn't NULL, objects should be created in the config's arena
+   * (config->GetArena(), see NewObject), heap-allocated objects are deleted by the config.
+   * Otherwise, the caller is responsible for deleting them.
+   */
   virtual void ReadDataset(ObjectVector& dataset,
                       const ExperimentConfig<dist_t>* config,
                       const char* inputfile,
                       const int MaxNumObjects) const = 0;
   virtual std::string ToString() const = 0;
   virtual void PrintInfo() const { LOG(INFO) << ToString(); }
+  /*
+   * Dense vector spaces can compute distances to objects stored in the transposed
+   * (structure-of-arrays) layout, see TransposedBucket. In such a space, the object
+   * data is an array of dist_t and this function returns the number of its elements.
+   * Otherwise, it returns zero.
+   */
+  virtual size_t TransposedDim(const Object* obj) const { return 0; }
 
  protected:
   void SetIndexPhase() const { bIndexPhase = true; }
@@ -84,11 +99,30 @@ class Space {
   friend class RangeQuery<dist_t>;
   friend class KNNQuery<dist_t>;
   friend class Experiments<dist_t>;
+  friend class GoldStandardManager<dist_t>;
   /* 
    * This function is private, but it will be accessible by the friend class Query
    * IndexTimeDistance access can be disable/enabled only by function friends 
    */
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
+  /*
+   * Computes out[i] = HiddenDistance(objs[i], query) for qty objects (i.e., objects
+   * are on the left side, see Query::DistanceObjLeft). The virtual call is made
+   * once for all the objects: spaces can override this function to call
+   * the (inlined) distance function in a loop.
+   */
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+    for (size_t i = 0; i < qty; ++i) out[i] = HiddenDistance(objs[i], query);
+  }
+  /*
+   * Computes out[i] = HiddenDistance(obj, query) for objects start, ..., start + qty - 1
+   * stored in the transposed layout: the j-th element of the i-th object
+   * is block[j * stride + i] (see TransposedBucket).
+   */
+  virtual void TransposedDistance(const Object* query, const dist_t* block, size_t dim, size_t stride,
+                                  size_t start, size_t qty, dist_t* out) const {
+    LOG(FATAL) << "The transposed layout is not supported by the space: " << ToString();
+  }
  private:
   bool mutable bIndexPhase = true;
 };
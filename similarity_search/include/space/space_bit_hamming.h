@@ -24,9 +24,11 @@
 #include <string.h>
 #include "global.h"
 #include "object.h"
+#include "object_arena.h"
 #include "utils.h"
 #include "space.h"
 #include "distcomp.h"
+#include "permutation_type.h"
 
 #define SPACE_BIT_HAMMING "bit_hamming"
 
@@ -40,11 +42,18 @@ class SpaceBitHamming : public Space<int> {
                       const ExperimentConfig<int>* config,
                       const char* inputfile,
                       const int MaxNumObjects) const;
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<uint32_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<uint32_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual std::string ToString() const { return "Hamming (bit-storage) space"; }
  protected:
   virtual int HiddenDistance(const Object* obj1, const Object* obj2) const;
-  void ReadVec(std::string line, std::vector<uint32_t>& v) const;
+  /*
+   * Reads len characters of the line, which doesn't need to be zero-terminated.
+   * Numbers can be separated by spaces, commas, and colons (see ReadNextNum).
+   * The vector v is a buffer for non-binarized values.
+   */
+  void ReadVec(const char* line, size_t len, std::vector<PivotIdType>& v, std::vector<uint32_t>& binVect) const;
+
+  class LineParser;
 };
 
 }  // namespace similarity
@@ -27,6 +27,7 @@
 #include "utils.h"
 #include "space.h"
 #include "space_lp.h"
+#include "task_pool.h"
 
 #define SPACE_KLDIV_FAST                        "kldivfast"
 #define SPACE_KLDIV_FAST_RIGHT_QUERY            "kldivfastrq" 
@@ -63,7 +64,13 @@ class BregmanDiv : public VectorSpace<dist_t> {
    */
   virtual size_t GetElemQty(const Object* object) const = 0;
 
-  virtual Object* Mean(const ObjectVector& data) const;
+  // The caller is responsible for deleting the mean
+  Object* Mean(const ObjectVector& data) const;
+  /*
+   * Sums up vectors in parallel. The data is split into chunks of a fixed size,
+   * hence, the result doesn't depend on the number of threads.
+   */
+  Object* Mean(const ObjectVector& data, TaskPool& pool) const;
 
   static inline
   const BregmanDiv<dist_t>* ConvertFrom(const Space<dist_t>* space) {
@@ -80,6 +87,8 @@ class BregmanDiv : public VectorSpace<dist_t> {
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
+  // Is called after the mean is computed, e.g., to precompute logarithms
+  virtual void FinalizeMean(Object* mean) const {}
 };
 
 template <typename dist_t>
@@ -92,7 +101,7 @@ class KLDivAbstract : public BregmanDiv<dist_t> {
   virtual Object* InverseGradientFunction(const Object* object) const;
 
   virtual std::string ToString() const = 0;
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const = 0;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const = 0;
   virtual size_t GetElemQty(const Object* object) const = 0;
  protected:
   // Should not be directly accessible
@@ -105,12 +114,13 @@ class KLDivGenSlow : public KLDivAbstract<dist_t> {
   virtual ~KLDivGenSlow() {}
 
   virtual std::string ToString() const { return "Generalized Kullback-Leibler divergence"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
 
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t); }
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 template <typename dist_t>
@@ -120,12 +130,13 @@ class KLDivGenFast : public KLDivAbstract<dist_t> {
 
   virtual Object* InverseGradientFunction(const Object* object) const;
   virtual std::string ToString() const { return "Generalized Kullback-Leibler divergence (precomputed logs)"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t)/ 2; }
-  virtual Object* Mean(const ObjectVector& data) const;
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
+  virtual void FinalizeMean(Object* mean) const;
 };
 
 template <typename dist_t>
@@ -138,12 +149,13 @@ class ItakuraSaitoFast : public BregmanDiv<dist_t> {
   virtual Object* GradientFunction(const Object* object) const;
 
   virtual std::string ToString() const { return "Itakura-Saito (precomputed logs)"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t)/ 2; }
-  virtual Object* Mean(const ObjectVector& data) const;
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
+  virtual void FinalizeMean(Object* mean) const;
 };
 
 template <typename dist_t>
@@ -152,11 +164,12 @@ class KLDivGenFastRightQuery : public VectorSpace<dist_t> {
   virtual ~KLDivGenFastRightQuery() {}
 
   virtual std::string ToString() const { return "Generalized Kullback-Leibler divergence, right queries (precomputed logs)"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t)/ 2; }
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 template <typename dist_t>
@@ -165,11 +178,12 @@ class KLDivFast: public VectorSpace<dist_t> {
   virtual ~KLDivFast() {}
 
   virtual std::string ToString() const { return "Kullback-Leibler divergence (precomputed logs)"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t)/ 2; }
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 template <typename dist_t>
@@ -178,11 +192,12 @@ class KLDivFastRightQuery: public VectorSpace<dist_t> {
   virtual ~KLDivFastRightQuery() {}
 
   virtual std::string ToString() const { return "Kullback-Leibler divergence, right queries (precomputed logs)"; }
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
   virtual size_t GetElemQty(const Object* object) const { return object->datalength()/ sizeof(dist_t)/ 2; }
  protected:
   // Should not be directly accessible
   virtual dist_t HiddenDistance(const Object* object1, const Object* object2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 }  // namespace similarity
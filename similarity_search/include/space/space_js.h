@@ -47,10 +47,13 @@ class SpaceJSBase : public VectorSpace<dist_t> {
   virtual ~SpaceJSBase() {}
 
   virtual std::string ToString() const = 0;
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
 
  protected:
   dist_t JensenShannonFunc(const Object* obj1, const Object* obj2) const;
+  // If TakeSqrt is true, computes square roots of divergences (i.e., the metric)
+  void JensenShannonBatch(const Object* query, const Object* const* objs, size_t qty,
+                          dist_t* out, bool TakeSqrt) const;
   JSType  GetType() const { return type_; }
  private:
   JSType   type_;
@@ -72,6 +75,9 @@ class SpaceJSDiv : public SpaceJSBase<dist_t> {
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const {
     return SpaceJSBase<dist_t>::JensenShannonFunc(obj1, obj2);
   }
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+    SpaceJSBase<dist_t>::JensenShannonBatch(query, objs, qty, out, false);
+  }
  private:
 };
 
@@ -90,6 +96,9 @@ class SpaceJSMetric : public SpaceJSBase<dist_t> {
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const {
     return sqrt(SpaceJSBase<dist_t>::JensenShannonFunc(obj1, obj2));
   }
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+    SpaceJSBase<dist_t>::JensenShannonBatch(query, objs, qty, out, true);
+  }
  private:
 };
 
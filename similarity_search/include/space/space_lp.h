@@ -82,9 +82,14 @@ class SpaceLp : public VectorSpace<dist_t> {
   virtual ~SpaceLp() {}
 
   virtual std::string ToString() const;
+  // Only the custom implementations (l1, l2, and linf) support the transposed layout
+  virtual size_t TransposedDim(const Object* obj) const;
 
  protected:
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
+  virtual void TransposedDistance(const Object* query, const dist_t* block, size_t dim, size_t stride,
+                                  size_t start, size_t qty, dist_t* out) const;
  private:
   SpaceLpDist<dist_t> distObj_;
 };
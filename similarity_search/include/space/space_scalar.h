@@ -44,6 +44,7 @@ public:
   }
 protected:
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 template <typename dist_t>
@@ -54,6 +55,7 @@ public:
   }
 protected:
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual void BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const;
 };
 
 
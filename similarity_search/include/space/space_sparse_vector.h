@@ -25,6 +25,7 @@
 #include <string.h>
 #include "global.h"
 #include "object.h"
+#include "object_arena.h"
 #include "utils.h"
 #include "space.h"
 #include "distcomp.h"
@@ -63,8 +64,14 @@ class SpaceSparseVector : public Space<dist_t> {
   };
 
   typedef pair<uint32_t, dist_t>  ElemType;  
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<ElemType>& InpVect) const;
-  void ReadSparseVec(std::string line, std::vector<ElemType>& v) const;
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<ElemType>& InpVect, ObjectArena* arena = NULL) const;
+  /*
+   * Reads len characters of the line, which doesn't need to be zero-terminated.
+   * Numbers can be separated by spaces, commas, and colons (see ReadNextNum).
+   */
+  void ReadSparseVec(const char* line, size_t len, std::vector<ElemType>& v) const;
+
+  class LineParser;
   
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
 
@@ -24,6 +24,7 @@
 #include <string.h>
 #include "global.h"
 #include "object.h"
+#include "object_arena.h"
 #include "utils.h"
 #include "space.h"
 
@@ -38,10 +39,39 @@ class VectorSpace : public Space<dist_t> {
                       const ExperimentConfig<dist_t>* config,
                       const char* inputfile,
                       const int MaxNumObjects) const;
-  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const;
+  // If the arena isn't NULL, the object is created in the arena (see NewObject)
+  virtual Object* CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena = NULL) const;
+  /*
+   * Returns the # of vector elements in the first line of the text file (zero if the file is empty).
+   * ReadDataset checks that all the lines have the same # of elements.
+   */
+  int ReadDimensionality(const char* FileName) const;
  protected:
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
-  void ReadVec(std::string line, std::vector<dist_t>& v) const;
+  /*
+   * Reads len characters of the line, which doesn't need to be zero-terminated.
+   * Numbers can be separated by spaces, commas, and colons (see ReadNextNum).
+   */
+  void ReadVec(const char* line, size_t len, std::vector<dist_t>& v) const;
+  /*
+   * A helper for BatchDistance: computes out[i] = func(x, y, length),
+   * where x is the data of objs[i] and y is the data of the query.
+   * Unlike HiddenDistance, func is called directly, not via a virtual function.
+   * The query is checked by the caller once per batch, objects are checked only
+   * in the debug mode, because this check is in the innermost loop.
+   */
+  template <typename DistFunc>
+  static void BatchVectorDistance(const Object* query, const Object* const* objs, size_t qty,
+                                  dist_t* out, size_t length, DistFunc func) {
+    const dist_t* y = reinterpret_cast<const dist_t*>(query->data());
+    for (size_t i = 0; i < qty; ++i) {
+      if (i + 1 < qty) PREFETCH(objs[i + 1]->data());
+      DCHECK(objs[i]->datalength() == query->datalength());
+      out[i] = func(reinterpret_cast<const dist_t*>(objs[i]->data()), y, length);
+    }
+  }
+
+  class LineParser;
 };
 
 }  // namespace similarity
@@ -0,0 +1,123 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _TASK_POOL_H_
+#define _TASK_POOL_H_
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "global.h"
+
+namespace similarity {
+
+/*
+ * A set of tasks spawned by the same parent, e.g., subtrees of a node.
+ * The parent waits for them using TaskPool::Wait.
+ */
+class TaskGroup {
+ public:
+  TaskGroup() : pending_(0) {}
+ private:
+  // Both are guarded by the mutex of the pool
+  size_t              pending_;
+  std::exception_ptr  error_;
+
+  friend class TaskPool;
+  DISABLE_COPY_AND_ASSIGN(TaskGroup);
+};
+
+/*
+ * A pool of threads to construct indices in parallel.
+ *
+ * Tasks can spawn other tasks and wait for them. A waiting thread
+ * doesn't sleep while there are queued tasks: it executes them.
+ * Thus, recursive (divide-and-conquer) construction never deadlocks.
+ * Idle workers take the oldest (typically the largest) tasks,
+ * while waiting threads take the most recent ones.
+ *
+ * If the pool has only one thread, tasks are executed immediately
+ * in the calling thread, i.e., the order of execution is the same
+ * as in the sequential code.
+ */
+class TaskPool {
+ public:
+  // ThreadQty includes the thread that creates the pool
+  explicit TaskPool(size_t ThreadQty);
+  ~TaskPool();
+
+  size_t GetThreadQty() const { return workers_.size() + 1; }
+  // The default number of threads used to construct an index
+  static size_t DefaultThreadQty() {
+    return std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  void Spawn(TaskGroup& group, std::function<void()> task);
+  // Waits for all tasks in the group and rethrows the first exception thrown by them
+  void Wait(TaskGroup& group);
+
+  /*
+   * Calls f(i) for i in [start, end). The range is split into chunks
+   * of at least MinChunkSize elements.
+   */
+  template <typename F>
+  void ParallelFor(size_t start, size_t end, size_t MinChunkSize, const F& f) {
+    if (start >= end) return;
+    // A few chunks per thread to balance the load
+    const size_t ChunkSize = std::max(std::max<size_t>(MinChunkSize, 1),
+                                      (end - start + 4 * GetThreadQty() - 1) / (4 * GetThreadQty()));
+    if (workers_.empty() || end - start <= ChunkSize) {
+      for (size_t i = start; i < end; ++i) f(i);
+      return;
+    }
+    TaskGroup group;
+    for (size_t ChunkStart = start; ChunkStart < end; ChunkStart += ChunkSize) {
+      const size_t ChunkEnd = std::min(end, ChunkStart + ChunkSize);
+      Spawn(group, [ChunkStart, ChunkEnd, &f]() {
+        for (size_t i = ChunkStart; i < ChunkEnd; ++i) f(i);
+      });
+    }
+    Wait(group);
+  }
+
+ private:
+  struct Task {
+    TaskGroup*            group_;
+    std::function<void()> func_;
+  };
+
+  void Worker();
+  void Execute(Task& task);
+
+  std::vector<std::thread>  workers_;
+  std::deque<Task>          queue_;
+  std::mutex                mutex_;
+  // Signals that a task is queued or finished, or the pool is stopped
+  std::condition_variable   cond_;
+  bool                      stop_;
+
+  DISABLE_COPY_AND_ASSIGN(TaskPool);
+};
+
+}   // namespace similarity
+
+#endif    // _TASK_POOL_H_
@@ -0,0 +1,310 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _TEXT_READER_H_
+#define _TEXT_READER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <exception>
+
+#include "global.h"
+#include "object.h"
+#include "object_arena.h"
+#include "mapped_file.h"
+#include "logging.h"
+#include "utils.h"
+
+namespace similarity {
+
+// Numbers are separated by white-spaces, commas, and colons
+inline bool IsNumSeparator(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f' || c == ',' || c == ':';
+}
+
+/*
+ * Reads the next number from [p, end) and advances the pointer. The text isn't
+ * zero-terminated (e.g., it is a line of a memory-mapped file), so the number
+ * is copied to a buffer on the stack and converted there. Leading separators
+ * are skipped. Returns false if there are no more numbers, or if the next token
+ * is not a number (this mimics the behavior of stream >> val). In particular,
+ * floating-point numbers must be decimal: unlike strtod, nan, inf, and hexadecimal
+ * numbers are not accepted.
+ */
+template <typename T, typename ConvType>
+inline bool ReadNextNum(const char*& p, const char* end, T& val, ConvType conv) {
+  while (p < end && IsNumSeparator(*p)) ++p;
+
+  const char* tokenEnd = p;
+  while (tokenEnd < end && !IsNumSeparator(*tokenEnd)) ++tokenEnd;
+  if (tokenEnd == p) return false;
+
+  const size_t  len = tokenEnd - p;
+  char          buf[64];
+  std::string   longToken;  // Numbers don't need to be this long, but they can
+  const char*   token = buf;
+  if (len < sizeof(buf)) {
+    memcpy(buf, p, len);
+    buf[len] = 0;
+  } else {
+    longToken.assign(p, len);
+    token = longToken.c_str();
+  }
+
+  char* convEnd;
+  val = conv(token, &convEnd);
+  if (convEnd == token) return false;
+  p += convEnd - token;
+  return true;
+}
+
+// A decimal number starts with an optional sign followed by a digit or a point and a digit
+inline bool IsDecimalNumStart(const char* s) {
+  if (*s == '+' || *s == '-') ++s;
+  if (*s == '.') ++s;
+  return *s >= '0' && *s <= '9' && !(s[0] == '0' && (s[1] == 'x' || s[1] == 'X'));
+}
+
+// Converts a decimal floating-point number, see ReadNextNum
+template <typename T, typename ConvType>
+inline T ConvDecimal(const char* s, char** e, ConvType conv) {
+  if (!IsDecimalNumStart(s)) {
+    *e = const_cast<char*>(s);
+    return 0;
+  }
+  return conv(s, e);
+}
+
+template <typename T>
+inline bool ReadNextNum(const char*& p, const char* end, T& val);
+
+template <>
+inline bool ReadNextNum<float>(const char*& p, const char* end, float& val) {
+  return ReadNextNum(p, end, val, [](const char* s, char** e) { return ConvDecimal<float>(s, e, strtof); });
+}
+
+template <>
+inline bool ReadNextNum<double>(const char*& p, const char* end, double& val) {
+  return ReadNextNum(p, end, val, [](const char* s, char** e) { return ConvDecimal<double>(s, e, strtod); });
+}
+
+template <>
+inline bool ReadNextNum<int32_t>(const char*& p, const char* end, int32_t& val) {
+  return ReadNextNum(p, end, val, [](const char* s, char** e) { return static_cast<int32_t>(strtol(s, e, 10)); });
+}
+
+template <>
+inline bool ReadNextNum<uint32_t>(const char*& p, const char* end, uint32_t& val) {
+  return ReadNextNum(p, end, val, [](const char* s, char** e) { return static_cast<uint32_t>(strtoul(s, e, 10)); });
+}
+
+/*
+ * Counts lines in [beg, end). The last line may not be terminated by '\n'.
+ * Empty lines are not counted if SkipEmpty is true.
+ */
+inline size_t CountLines(const char* beg, const char* end, bool SkipEmpty) {
+  size_t qty = 0;
+  while (beg < end) {
+    const char* eol = reinterpret_cast<const char*>(memchr(beg, '\n', end - beg));
+    if (eol == NULL) eol = end;
+    if (!SkipEmpty || eol > beg) ++qty;
+    beg = eol + 1;
+  }
+  return qty;
+}
+
+/*
+ * Returns the end of the first MaxQty lines in [beg, end), or end if there are fewer lines.
+ * Empty lines are not counted if SkipEmpty is true.
+ */
+inline const char* FindLinesEnd(const char* beg, const char* end, bool SkipEmpty, size_t MaxQty) {
+  size_t qty = 0;
+  while (beg < end && qty < MaxQty) {
+    const char* eol = reinterpret_cast<const char*>(memchr(beg, '\n', end - beg));
+    if (eol == NULL) return end;
+    if (!SkipEmpty || eol > beg) ++qty;
+    beg = eol + 1;
+  }
+  return beg;
+}
+
+template <typename LineParserType>
+struct TextChunkParser {
+  typedef typename LineParserType::ResultType ResultType;
+
+  /*
+   * Parses at most MaxQty lines from [beg, end). Lines aren't copied:
+   * the line parser gets the line id, the position and the length of the line
+   * in the file (without '\n'), and the arena of the thread.
+   */
+  void operator()(const char* beg, const char* end,
+                  size_t FirstId, size_t MaxQty, bool SkipEmpty,
+                  LineParserType& parser, ObjectArena* arena,
+                  std::vector<ResultType>& res) {
+    res.clear();
+    res.reserve(MaxQty);
+
+    size_t id = FirstId;
+
+    while (beg < end && res.size() < MaxQty) {
+      const char* eol = reinterpret_cast<const char*>(memchr(beg, '\n', end - beg));
+      if (eol == NULL) eol = end;
+      if (!SkipEmpty || eol > beg) {
+        res.push_back(parser(id++, beg, eol - beg, arena));
+      }
+      beg = eol + 1;
+    }
+  }
+};
+
+/*
+ * Splits the text file into chunks on line boundaries and parses
+ * the chunks in parallel using copies of the line parser (one per thread).
+ * The results are stored in the original line order, so that
+ * line ids (0, 1, ..., empty lines are not counted if SkipEmpty is true)
+ * are the same as in the case of a sequential reading.
+ *
+ * The line parser should define ResultType and
+ * ResultType operator()(size_t id, const char* line, size_t len, ObjectArena* arena),
+ * where the line isn't zero-terminated (see ReadNextNum).
+ * If MaxNumObjects is non-zero, at most MaxNumObjects lines are parsed.
+ * If ThreadQty is zero, all the cores are used.
+ * As before, a missing file produces an empty result (rather than an error).
+ *
+ * The line parser shouldn't terminate the program (e.g., using LOG(FATAL)), because
+ * other threads are still parsing. Instead, it should throw an exception:
+ * after all the threads finish, the exception thrown by the thread parsing
+ * the earliest part of the file is rethrown in the calling thread.
+ *
+ * If the arena isn't NULL, the parser should create objects in the arena passed to it:
+ * each thread gets its own arena, which is merged into the given one afterwards.
+ * Thus, objects are created in place (and in the line order) rather than
+ * on the heap. Otherwise, the parser gets a NULL arena.
+ */
+template <typename LineParserType>
+void ParallelParseTextFile(const char* FileName,
+                           const int MaxNumObjects,
+                           bool SkipEmpty,
+                           const LineParserType& parser,
+                           std::vector<typename LineParserType::ResultType>& res,
+                           unsigned ThreadQty = 0,
+                           ObjectArena* arena = NULL) {
+  // Don't create tiny chunks
+  const size_t MinChunkSize = 1024 * 1024;
+
+  res.clear();
+
+  if (!IsFileExists(FileName)) {
+    LOG(ERROR) << "Cannot open file: '" << FileName << "'";
+    return;
+  }
+
+  MappedFile file(FileName);
+
+  const char* beg = file.data();
+  const char* end = beg + file.size();
+
+  // Lines past the first MaxNumObjects ones are neither counted nor parsed
+  if (MaxNumObjects) end = FindLinesEnd(beg, end, SkipEmpty, MaxNumObjects);
+  const size_t size = end - beg;
+
+  if (!ThreadQty) ThreadQty = std::thread::hardware_concurrency();
+  ThreadQty = std::max<size_t>(1, std::min<size_t>(ThreadQty, size / MinChunkSize));
+
+  std::vector<const char*> bounds(ThreadQty + 1);
+
+  bounds[0] = beg;
+  bounds[ThreadQty] = end;
+  for (unsigned i = 1; i < ThreadQty; ++i) {
+    const char* p = std::max(beg + size / ThreadQty * i, bounds[i - 1]);
+    const char* eol = p < end ? reinterpret_cast<const char*>(memchr(p, '\n', end - p)) : NULL;
+    bounds[i] = eol ? eol + 1 : end;
+  }
+
+  std::vector<size_t> LineQty(ThreadQty);
+
+  if (ThreadQty > 1) {
+    std::vector<std::thread> threads(ThreadQty);
+    for (unsigned i = 0; i < ThreadQty; ++i) {
+      threads[i] = std::thread([&, i]() { LineQty[i] = CountLines(bounds[i], bounds[i + 1], SkipEmpty); });
+    }
+    for (auto& t: threads) t.join();
+  } else {
+    LineQty[0] = CountLines(beg, end, SkipEmpty);
+  }
+
+  // The id of the first line in each chunk
+  std::vector<size_t> FirstId(ThreadQty);
+  size_t total = 0;
+  for (unsigned i = 0; i < ThreadQty; ++i) {
+    FirstId[i] = total;
+    total += LineQty[i];
+  }
+
+  std::vector<LineParserType>                                     parsers(ThreadQty, parser);
+  std::vector<std::vector<typename LineParserType::ResultType>>   parts(ThreadQty);
+
+  if (ThreadQty > 1) {
+    // Chunks of thread arenas are roughly as large as the text parts (the text is usually larger)
+    std::vector<std::unique_ptr<ObjectArena>> arenas(ThreadQty);
+    if (arena != NULL) {
+      for (unsigned i = 0; i < ThreadQty; ++i) {
+        arenas[i].reset(new ObjectArena(std::min<size_t>(ObjectArena::kDefaultChunkSize,
+                                                         bounds[i + 1] - bounds[i])));
+      }
+    }
+
+    std::vector<std::thread>          threads(ThreadQty);
+    std::vector<std::exception_ptr>   errors(ThreadQty);
+    for (unsigned i = 0; i < ThreadQty; ++i) {
+      threads[i] = std::thread([&, i]() {
+        try {
+          TextChunkParser<LineParserType>()(bounds[i], bounds[i + 1], FirstId[i], LineQty[i], SkipEmpty,
+                                            parsers[i], arenas[i].get(), parts[i]);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+    for (auto& t: threads) t.join();
+    for (const auto& e: errors) {
+      if (e) std::rethrow_exception(e);
+    }
+
+    if (arena != NULL) {
+      for (auto& a: arenas) arena->Merge(*a);
+    }
+  } else {
+    TextChunkParser<LineParserType>()(beg, end, 0, LineQty[0], SkipEmpty, parsers[0], arena, parts[0]);
+  }
+
+  size_t qty = 0;
+  for (const auto& part: parts) qty += part.size();
+  res.reserve(qty);
+  for (const auto& part: parts) res.insert(res.end(), part.begin(), part.end());
+}
+
+}   // namespace similarity
+
+#endif    // _TEXT_READER_H_
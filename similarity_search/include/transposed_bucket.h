@@ -0,0 +1,85 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifndef _TRANSPOSED_BUCKET_H_
+#define _TRANSPOSED_BUCKET_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "global.h"
+#include "object.h"
+#include "logging.h"
+#include "space.h"
+#include "distcomp.h"
+
+namespace similarity {
+
+/*
+ * A copy of bucket vectors in the transposed (structure-of-arrays) layout:
+ * the j-th element of the i-th object is data()[j * stride() + i].
+ * Thus, the space can compute distances to several objects at once
+ * (see Space::TransposedDistance). The stride is the number of objects,
+ * but buckets smaller than kTransposedLaneQty are padded with zeros.
+ * The objects themselves are kept by the bucket as usual:
+ * the i-th column corresponds to the i-th object of the bucket.
+ */
+template <typename dist_t>
+class TransposedBucket {
+ public:
+  /*
+   * Returns NULL if the bucket is empty or the space doesn't support
+   * the transposed layout (see Space::TransposedDim).
+   */
+  static TransposedBucket* Create(const Space<dist_t>* space, const ObjectVector& bucket) {
+    if (bucket.empty()) return NULL;
+    const size_t dim = space->TransposedDim(bucket[0]);
+    if (!dim) return NULL;
+
+    TransposedBucket* res = new TransposedBucket(dim, bucket.size());
+    for (size_t i = 0; i < bucket.size(); ++i) {
+      CHECK(space->TransposedDim(bucket[i]) == dim);
+      const dist_t* x = reinterpret_cast<const dist_t*>(bucket[i]->data());
+      for (size_t j = 0; j < dim; ++j) res->block_[j * res->stride_ + i] = x[j];
+    }
+    return res;
+  }
+
+  size_t        size() const { return qty_; }
+  size_t        dim() const { return dim_; }
+  size_t        stride() const { return stride_; }
+  const dist_t* data() const { return block_.data(); }
+
+  size_t MemoryUsage() const { return sizeof(*this) + block_.capacity() * sizeof(dist_t); }
+
+ private:
+  TransposedBucket(size_t dim, size_t qty)
+    : dim_(dim), qty_(qty),
+      stride_(std::max(qty, kTransposedLaneQty)),
+      block_(dim * stride_) {}
+
+  size_t          dim_;
+  size_t          qty_;
+  size_t          stride_;
+  vector<dist_t>  block_;
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(TransposedBucket);
+};
+
+}  // namespace similarity
+
+#endif  // _TRANSPOSED_BUCKET_H_
@@ -50,23 +50,27 @@ bool IsFileExists(const char* filename);
 
 inline bool IsFileExists(const string& filename) { return IsFileExists(filename.c_str()); }
 
+/*
+ * Each thread has its own generator, so that RandomInt() and RandomReal()
+ * can be called from different threads. To make, e.g., index construction
+ * reproducible, a thread can re-seed its generator: RandomGen().seed(...)
+ */
+inline mt19937& RandomGen() {
+    static thread_local mt19937 gen(random_device{}());
+    return gen;
+}
+
 inline int RandomInt() {
-    // Static is thread-safe in C++ 11
-    static random_device rdev;
-    static mt19937 gen(rdev());
-    static std::uniform_int_distribution<int> distr(0, std::numeric_limits<int>::max());
+    std::uniform_int_distribution<int> distr(0, std::numeric_limits<int>::max());
   
-    return distr(gen); 
+    return distr(RandomGen()); 
 }
 
 template <class T>
 inline T RandomReal() {
-    // Static is thread-safe in C++ 11
-    static random_device rdev;
-    static mt19937 gen(rdev());
-    static std::uniform_real_distribution<T> distr(0, 1);
+    std::uniform_real_distribution<T> distr(0, 1);
 
-    return distr(gen); 
+    return distr(RandomGen()); 
 }
 
 void RStrip(char* str);
@@ -100,6 +104,7 @@ inline bool ApproxLess(const T& x, const T& y) {
 
 inline double round1(double x) { return round(x*10.0)/10.0; }
 inline double round2(double x) { return round(x*100.0)/100.0; }
+inline double round3(double x) { return round(x*1000.0)/1000.0; }
 
 /*
  * This function will only work for strings without spaces
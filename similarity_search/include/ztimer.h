@@ -15,24 +15,36 @@
 
 /**
  *  author: Preston Bannister
+ *
+ *  Uses the monotonic clock with the nanosecond resolution:
+ *  on Linux, clock_gettime is served by vDSO, i.e., without a system call.
  */
 class WallClockTimer {
 public:
-    struct timeval t1, t2;
+    struct timespec t1, t2;
     WallClockTimer() :
         t1(), t2() {
-        gettimeofday(&t1, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
         t2 = t1;
     }
     void reset() {
-        gettimeofday(&t1, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
         t2 = t1;
     }
+    // returns the elapsed time in nano seconds (ns)
+    uint64_t elapsednsec() {
+        return static_cast<uint64_t>(t2.tv_sec - t1.tv_sec) * 1000ULL * 1000ULL * 1000ULL + (t2.tv_nsec - t1.tv_nsec);
+    }
+    // returns the elapsed time in micro seconds (mu s)
     uint64_t elapsed() {
-        return ((t2.tv_sec - t1.tv_sec) * 1000ULL * 1000ULL) + ((t2.tv_usec - t1. tv_usec));
+        return elapsednsec() / 1000ULL;
+    }
+    uint64_t splitnsec() {
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        return elapsednsec();
     }
     uint64_t split() {
-        gettimeofday(&t2, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
         return elapsed();
     }
 };
@@ -0,0 +1,149 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <memory>
+
+#include "binary_dataset.h"
+#include "mapped_file.h"
+#include "logging.h"
+
+namespace similarity {
+
+using std::unique_ptr;
+
+static size_t AlignBinSize(size_t size) {
+  return (size + BINARY_DATASET_ALIGNMENT - 1) & ~static_cast<size_t>(BINARY_DATASET_ALIGNMENT - 1);
+}
+
+static void CopyDesc(char* dst, size_t dstSize, const string& src, const char* what) {
+  if (src.size() >= dstSize) {
+    LOG(FATAL) << "The " << what << " description is too long: '" << src << "'";
+  }
+  memset(dst, 0, dstSize);
+  memcpy(dst, src.c_str(), src.size());
+}
+
+bool IsBinaryDataset(const char* FileName) {
+  std::ifstream InFile(FileName, std::ios::binary);
+  char magic[sizeof(BinaryDatasetHeader::magic)];
+  if (!InFile.read(magic, sizeof(magic))) return false;
+  return memcmp(magic, BINARY_DATASET_MAGIC, sizeof(magic)) == 0;
+}
+
+void WriteBinaryDataset(const string& FileName,
+                        const string& SpaceDesc,
+                        const string& DistType,
+                        unsigned dimension,
+                        const ObjectVector& dataset) {
+  BinaryDatasetHeader hdr;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, BINARY_DATASET_MAGIC, sizeof(hdr.magic));
+  hdr.version     = BINARY_DATASET_VERSION;
+  hdr.headerSize  = AlignBinSize(sizeof(hdr));
+  hdr.objQty      = dataset.size();
+  hdr.dimension   = dimension;
+  CopyDesc(hdr.spaceDesc, sizeof(hdr.spaceDesc), SpaceDesc, "space");
+  CopyDesc(hdr.distType, sizeof(hdr.distType), DistType, "distance type");
+
+  std::ofstream OutFile(FileName.c_str(), std::ios::binary | std::ios::trunc | std::ios::out);
+  if (!OutFile) {
+    LOG(FATAL) << "Cannot create output file: '" << FileName << "'";
+  }
+  OutFile.exceptions(std::ios::badbit | std::ios::failbit);
+
+  const char padding[BINARY_DATASET_ALIGNMENT] = {0};
+
+  OutFile.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+  OutFile.write(padding, hdr.headerSize - sizeof(hdr));
+
+  for (const Object* obj: dataset) {
+    size_t len = obj->bufferlength();
+    OutFile.write(obj->buffer(), len);
+    OutFile.write(padding, AlignBinSize(len) - len);
+  }
+  OutFile.close();
+}
+
+void ReadBinaryDataset(ObjectVector& dataset,
+                       ObjectArena* arena,
+                       const string& SpaceDesc,
+                       const string& DistType,
+                       const char* FileName,
+                       unsigned RequestedDim,
+                       const int MaxNumObjects) {
+  dataset.clear();
+
+  unique_ptr<MappedFile> file(new MappedFile(FileName));
+
+  if (file->size() < sizeof(BinaryDatasetHeader)) {
+    LOG(FATAL) << "The binary data file is truncated: '" << FileName << "'";
+  }
+  const BinaryDatasetHeader* hdr = reinterpret_cast<const BinaryDatasetHeader*>(file->data());
+
+  if (memcmp(hdr->magic, BINARY_DATASET_MAGIC, sizeof(hdr->magic)) != 0) {
+    LOG(FATAL) << "Not a binary data file: '" << FileName << "'";
+  }
+  if (hdr->version != BINARY_DATASET_VERSION) {
+    LOG(FATAL) << "Unsupported version (" << hdr->version << ") of the binary data file: '" << FileName << "'";
+  }
+  if (SpaceDesc != hdr->spaceDesc || DistType != hdr->distType) {
+    LOG(FATAL) << "The binary data file '" << FileName << "' was created for the space: '"
+               << hdr->spaceDesc << "' (distance type " << hdr->distType << "), "
+               << "but the current space is: '" << SpaceDesc << "' (distance type " << DistType << ")";
+  }
+  if (RequestedDim && RequestedDim != hdr->dimension) {
+    LOG(FATAL) << "The binary data file '" << FileName << "' was created using dimensionality: "
+               << hdr->dimension << ", but the requested dimensionality is: " << RequestedDim
+               << ". Please, convert the data file again.";
+  }
+
+  size_t qty = hdr->objQty;
+  if (MaxNumObjects && static_cast<size_t>(MaxNumObjects) < qty) qty = MaxNumObjects;
+
+  dataset.reserve(qty);
+
+  const size_t fileSize = file->size();
+  size_t pos = hdr->headerSize;
+
+  for (size_t i = 0; i < qty; ++i) {
+    if (pos + ID_SIZE + DATALENGTH_SIZE > fileSize) {
+      LOG(FATAL) << "The binary data file is truncated: '" << FileName << "'";
+    }
+    char* buffer = file->data() + pos;
+    Object tmp(buffer);
+    size_t len = tmp.bufferlength();
+    if (pos + len > fileSize) {
+      LOG(FATAL) << "The binary data file is truncated: '" << FileName << "'";
+    }
+    if (arena != NULL) {
+      dataset.push_back(arena->CreateObjectRef(buffer));
+    } else {
+      dataset.push_back(tmp.Clone());
+    }
+    pos += AlignBinSize(len);
+  }
+
+  if (arena != NULL) arena->AdoptMappedFile(file.release());
+
+  LOG(INFO) << "Read " << dataset.size() << " objects from the binary file: '" << FileName << "'";
+}
+
+}   // namespace similarity
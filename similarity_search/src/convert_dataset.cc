@@ -0,0 +1,161 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+/*
+ * Converts a text data (or query) file to the binary format,
+ * which can be memory-mapped by Space::ReadDataset (see binary_dataset.h).
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "global.h"
+#include "utils.h"
+#include "ztimer.h"
+#include "experimentconf.h"
+#include "space.h"
+#include "space_vector.h"
+#include "spacefactory.h"
+#include "binary_dataset.h"
+#include "logging.h"
+#include "params.h"
+
+using namespace similarity;
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+namespace po = boost::program_options;
+
+template <typename dist_t>
+void Convert(const string&                SpaceType,
+             const shared_ptr<AnyParams>& SpaceParams,
+             const string&                InputFile,
+             const string&                OutputFile,
+             unsigned                     MaxNumData,
+             unsigned                     dimension) {
+  vector<unsigned>  knn;
+  vector<dist_t>    range;
+
+  /*
+   * The config is needed only to pass the dimensionality to the space.
+   * Note that the space will be deleted by the destructor of ExperimentConfig.
+   */
+  ExperimentConfig<dist_t> config(SpaceFactoryRegistry<dist_t>::
+                                  Instance().CreateSpace(SpaceType, *SpaceParams),
+                                  InputFile, "", 1 /* TestSetQty */,
+                                  MaxNumData, 0 /* MaxNumQuery */,
+                                  dimension, knn, 0 /* eps */, range);
+
+  ObjectVector data;
+
+  const Space<dist_t>* space = config.GetSpace();
+  space->ReadDataset(data, &config, InputFile.c_str(), MaxNumData);
+
+  /*
+   * The actual dimensionality of dense vectors is stored, so that the binary file
+   * can be loaded specifying either zero or this dimensionality.
+   */
+  const VectorSpace<dist_t>* VectSpace = dynamic_cast<const VectorSpace<dist_t>*>(space);
+  if (!dimension && VectSpace != NULL) dimension = VectSpace->ReadDimensionality(InputFile.c_str());
+
+  WriteBinaryDataset(OutputFile, space->ToString(), DistTypeName<dist_t>(), dimension, data);
+
+  LOG(INFO) << "Wrote " << data.size() << " objects to the binary file: '" << OutputFile << "'";
+}
+
+int main(int ac, char* av[]) {
+  WallClockTimer timer;
+  timer.reset();
+
+  string    DistType;
+  string    SpaceType;
+  string    InputFile;
+  string    OutputFile;
+  unsigned  MaxNumData;
+  unsigned  dimension;
+
+  po::options_description ProgOptDesc("Allowed options");
+  ProgOptDesc.add_options()
+    ("help,h", "produce help message")
+    ("spaceType,s",     po::value<string>(&SpaceType)->required(),
+                        "space type, e.g., l1, l2, lp:p=0.5")
+    ("distType",        po::value<string>(&DistType)->default_value("float"),
+                        "distance value type: int, float, double")
+    ("inputFile,i",     po::value<string>(&InputFile)->required(),
+                        "input (text) data file")
+    ("outputFile,o",    po::value<string>(&OutputFile)->required(),
+                        "output (binary) data file")
+    ("maxNumData",      po::value<unsigned>(&MaxNumData)->default_value(0),
+                        "if non-zero, only the first maxNumData elements are converted")
+    ("dimension,d",     po::value<unsigned>(&dimension)->default_value(0),
+                        "optional dimensionality")
+    ;
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(ac, av, ProgOptDesc), vm);
+    if (vm.count("help")) {
+      std::cout << av[0] << std::endl << ProgOptDesc << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+  } catch (const std::exception& e) {
+    std::cout << av[0] << std::endl << ProgOptDesc << std::endl;
+    LOG(FATAL) << e.what();
+  }
+
+  ToLower(DistType);
+  ToLower(SpaceType);
+
+  vector<string> tmp;
+  if (!SplitStr(SpaceType, tmp, ':') || tmp.size() > 2  || !tmp.size()) {
+    LOG(FATAL) << "Wrong format of the space argument: '" << SpaceType;
+  }
+  SpaceType = tmp[0];
+
+  vector<string> SpaceDesc;
+  if (tmp.size() == 2) {
+    if (!SplitStr(tmp[1], SpaceDesc, ',')) {
+      LOG(FATAL) << "Cannot split space arguments in: " << tmp[1];
+    }
+  }
+  shared_ptr<AnyParams> SpaceParams(new AnyParams(SpaceDesc));
+
+  if (!IsFileExists(InputFile)) {
+    LOG(FATAL) << "input file " << InputFile << " doesn't exist";
+  }
+
+  if ("int" == DistType) {
+    Convert<int>(SpaceType, SpaceParams, InputFile, OutputFile, MaxNumData, dimension);
+  } else if ("float" == DistType) {
+    Convert<float>(SpaceType, SpaceParams, InputFile, OutputFile, MaxNumData, dimension);
+  } else if ("double" == DistType) {
+    Convert<double>(SpaceType, SpaceParams, InputFile, OutputFile, MaxNumData, dimension);
+  } else {
+    LOG(FATAL) << "Unknown distance value type: " << DistType;
+  }
+
+  timer.split();
+  LOG(INFO) << "Time elapsed = " << timer.elapsed() / 1e6;
+
+  return 0;
+}
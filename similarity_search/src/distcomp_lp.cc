@@ -510,6 +510,177 @@ double L2NormSIMD(const double* pVect1, const double* pVect2, size_t qty) {
 template float  L2NormSIMD<float>(const float* pVect1, const float* pVect2, size_t qty);
 template double L2NormSIMD<double>(const double* pVect1, const double* pVect2, size_t qty);
 
+/*
+ * Transposed (structure-of-arrays) layout.
+ *
+ * Vectors are processed in groups of kTransposedLaneQty floats (or doubles
+ * that take the same space). The lanes of a group are kept in one GCC vector
+ * (i.e., in two AVX registers), and the loop goes over elements, so no horizontal
+ * sums are needed. We don't rely on the auto-vectorizer: with -O3 it unrolls the
+ * loop over lanes completely and produces a much slower scalar code.
+ * If the number of vectors isn't a multiple of the group size, the last group
+ * overlaps the previous one: a few distances are computed twice, but no padding is needed.
+ *
+ * The order of operations is the same as in the SIMD functions above: the first SimdQty
+ * elements are split among PartQty partial results (the element j goes to the partial
+ * result j % PartQty), the partial results are merged from left to right, and the
+ * remaining elements are accumulated one by one using TailT values. Partial results
+ * are independent chains of operations, so they also keep the SIMD units busy.
+ * The compiler must not reassociate additions or fuse multiplications with additions here,
+ * so the distances don't depend on the compiler options. Yet, the compiler can do this
+ * in the SIMD functions (e.g., with -Ofast), so the distances may differ in the last bits.
+ *
+ * GCC vectors and these pragmas are supported only by GCC (the vector operations
+ * used here require GCC 4.8). Otherwise, vectors are processed in groups by the plain
+ * loop over lanes, which is vectorized by the compiler (if at all).
+ */
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER) && !defined(__clang__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define TRANSPOSED_GCC_VECTORS
+#endif
+
+#ifdef TRANSPOSED_GCC_VECTORS
+#pragma GCC push_options
+#pragma GCC optimize ("no-fast-math", "fp-contract=off")
+
+typedef float  TransposedFloats  __attribute__((vector_size(kTransposedLaneQty * sizeof(float))));
+typedef double TransposedDoubles __attribute__((vector_size(kTransposedLaneQty * sizeof(float))));
+
+template <class T, class V, size_t PartQty, size_t BlockQty, class TailT,
+          class Accum, class Merge, class TailAccum, class Finish>
+inline void TransposedDist(const T* pQuery, const T* pBlock, size_t dim, size_t stride,
+                           size_t start, size_t qty, T* pOut,
+                           Accum accum, Merge merge, TailAccum tailAccum, Finish finish) {
+    const size_t LaneQty = sizeof(V) / sizeof(T);
+    CHECK(stride >= kTransposedLaneQty && start + qty <= stride);
+    const size_t end = start + qty;
+    const size_t SimdQty = dim / BlockQty * BlockQty;
+    for (size_t group = start; group < end; group += LaneQty) {
+        const size_t first = group + LaneQty <= stride ? group : stride - LaneQty;
+        V res[PartQty] = {};
+        const T* pRow = pBlock + first;
+        size_t j = 0;
+        for (; j < SimdQty; j += PartQty, pRow += PartQty * stride) {
+#if __GNUC__ >= 8
+            #pragma GCC unroll 4
+#endif
+            for (size_t k = 0; k < PartQty; ++k) {
+                V row;
+                memcpy(&row, pRow + k * stride, sizeof(row));
+                accum(res[k], row - pQuery[j + k]);
+            }
+        }
+        V merged = res[0];
+        for (size_t k = 1; k < PartQty; ++k) merge(merged, res[k]);
+        TailT tail[LaneQty];
+        for (size_t l = 0; l < LaneQty; ++l) tail[l] = merged[l];
+        for (; j < dim; ++j, pRow += stride) {
+            const T q = pQuery[j];
+            for (size_t l = 0; l < LaneQty; ++l) tail[l] = tailAccum(tail[l], pRow[l] - q);
+        }
+        const size_t last = group + LaneQty < end ? group + LaneQty : end;
+        for (size_t i = group; i < last; ++i) pOut[i - start] = finish(tail[i - first]);
+    }
+}
+
+/*
+ * Vector lambdas update partial results in place: if vectors were passed by value,
+ * GCC would warn that the ABI depends on the instruction set. Also, the lambdas
+ * don't call std::max or fabs, because functions compiled with different math
+ * options are not inlined.
+ */
+#define TRANSPOSED_DIST(T, V, PartQty, BlockQty, TailT, accum, merge) \
+    TransposedDist<T, V, PartQty, BlockQty, TailT>(pQuery, pBlock, dim, stride, start, qty, pOut, \
+                                                   accum, merge, tailAccum, finish)
+#else
+// All the elements are accumulated using TailT values
+template <class T, class TailT, class TailAccum, class Finish>
+inline void TransposedDist(const T* pQuery, const T* pBlock, size_t dim, size_t stride,
+                           size_t start, size_t qty, T* pOut,
+                           TailAccum tailAccum, Finish finish) {
+    CHECK(stride >= kTransposedLaneQty && start + qty <= stride);
+    const size_t end = start + qty;
+    for (size_t group = start; group < end; group += kTransposedLaneQty) {
+        const size_t LaneQty = std::min(kTransposedLaneQty, end - group);
+        TailT res[kTransposedLaneQty] = {};
+        const T* pRow = pBlock + group;
+        for (size_t j = 0; j < dim; ++j, pRow += stride) {
+            const T q = pQuery[j];
+            for (size_t l = 0; l < LaneQty; ++l) res[l] = tailAccum(res[l], pRow[l] - q);
+        }
+        for (size_t l = 0; l < LaneQty; ++l) pOut[group - start + l] = finish(res[l]);
+    }
+}
+
+#define TRANSPOSED_DIST(T, V, PartQty, BlockQty, TailT, accum, merge) \
+    TransposedDist<T, TailT>(pQuery, pBlock, dim, stride, start, qty, pOut, tailAccum, finish)
+#endif
+
+// The same operations as in LInfNormSIMD (though, max doesn't depend on the order)
+template <>
+void LInfNormTransposed(const float* pQuery, const float* pBlock, size_t dim, size_t stride, size_t start, size_t qty, float* pOut) {
+    auto tailAccum = [](float res, float diff) { float a = diff < 0 ? -diff : diff; return res < a ? a : res; };
+    auto finish = [](float res) { return res; };
+    TRANSPOSED_DIST(float, TransposedFloats, 4, 4, float,
+                    [](TransposedFloats& res, const TransposedFloats& diff) {
+                      TransposedFloats a = diff < 0 ? -diff : diff; res = res < a ? a : res; },
+                    [](TransposedFloats& res0, const TransposedFloats& res1) { res0 = res0 < res1 ? res1 : res0; });
+}
+
+template <>
+void LInfNormTransposed(const double* pQuery, const double* pBlock, size_t dim, size_t stride, size_t start, size_t qty, double* pOut) {
+    auto tailAccum = [](double res, double diff) { double a = diff < 0 ? -diff : diff; return res < a ? a : res; };
+    auto finish = [](double res) { return res; };
+    TRANSPOSED_DIST(double, TransposedDoubles, 2, 8, double,
+                    [](TransposedDoubles& res, const TransposedDoubles& diff) {
+                      TransposedDoubles a = diff < 0 ? -diff : diff; res = res < a ? a : res; },
+                    [](TransposedDoubles& res0, const TransposedDoubles& res1) { res0 = res0 < res1 ? res1 : res0; });
+}
+
+// The same operations as in L1NormSIMD (including the types of the remaining elements)
+template <>
+void L1NormTransposed(const float* pQuery, const float* pBlock, size_t dim, size_t stride, size_t start, size_t qty, float* pOut) {
+    auto tailAccum = [](double res, float diff) { return res + (diff < 0 ? -diff : diff); };
+    auto finish = [](double res) { return float(res); };
+    TRANSPOSED_DIST(float, TransposedFloats, 4, 4, double,
+                    [](TransposedFloats& res, const TransposedFloats& diff) { res += diff < 0 ? -diff : diff; },
+                    [](TransposedFloats& res0, const TransposedFloats& res1) { res0 += res1; });
+}
+
+template <>
+void L1NormTransposed(const double* pQuery, const double* pBlock, size_t dim, size_t stride, size_t start, size_t qty, double* pOut) {
+    auto tailAccum = [](double res, double diff) { float d = diff; return res + (d < 0 ? -d : d); };
+    auto finish = [](double res) { return res; };
+    TRANSPOSED_DIST(double, TransposedDoubles, 2, 8, double,
+                    [](TransposedDoubles& res, const TransposedDoubles& diff) { res += diff < 0 ? -diff : diff; },
+                    [](TransposedDoubles& res0, const TransposedDoubles& res1) { res0 += res1; });
+}
+
+// The same operations as in L2NormSIMD
+template <>
+void L2NormTransposed(const float* pQuery, const float* pBlock, size_t dim, size_t stride, size_t start, size_t qty, float* pOut) {
+    auto tailAccum = [](float res, float diff) { return res + diff * diff; };
+    auto finish = [](float res) { return sqrt(res); };
+    TRANSPOSED_DIST(float, TransposedFloats, 4, 4, float,
+                    [](TransposedFloats& res, const TransposedFloats& diff) { res += diff * diff; },
+                    [](TransposedFloats& res0, const TransposedFloats& res1) { res0 += res1; });
+}
+
+template <>
+void L2NormTransposed(const double* pQuery, const double* pBlock, size_t dim, size_t stride, size_t start, size_t qty, double* pOut) {
+    auto tailAccum = [](double res, double diff) { return res + diff * diff; };
+    auto finish = [](double res) { return sqrt(res); };
+    TRANSPOSED_DIST(double, TransposedDoubles, 2, 8, double,
+                    [](TransposedDoubles& res, const TransposedDoubles& diff) { res += diff * diff; },
+                    [](TransposedDoubles& res0, const TransposedDoubles& res1) { res0 += res1; });
+}
+
+#undef TRANSPOSED_DIST
+
+#ifdef TRANSPOSED_GCC_VECTORS
+#pragma GCC pop_options
+#endif
+
 /*
  * Slower versions of LP-distance
  */
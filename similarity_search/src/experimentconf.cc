@@ -100,6 +100,8 @@ void ExperimentConfig<dist_t>::ReadDataset() {
     }
   }
 
+  LOG(INFO) << "Object arena: " << arena->ObjectQty() << " objects, "
+            << arena->MemoryAllocated() / 1024.0 / 1024.0 << " MBs";
   LOG(INFO) << "data & query .... ok!\n";
 }
 
@@ -29,7 +29,8 @@ Index<dist_t>* CreateDummy(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
     AnyParamManager pmgr(AllParams);
     bool bDoSeqSearch = false;
     pmgr.GetParamOptional("doSeqSearch",  bDoSeqSearch);
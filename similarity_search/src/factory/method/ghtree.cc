@@ -29,9 +29,10 @@ Index<dist_t>* CreateGHTree(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
-    return new GHTree<dist_t>(space, DataObjects, AllParams);
+    return new GHTree<dist_t>(space, DataObjects, AllParams, true /* use random center */, BuildIndex);
 }
 
 /*
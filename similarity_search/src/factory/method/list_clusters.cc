@@ -29,9 +29,10 @@ Index<dist_t>* CreateListClusters(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
-    return new ListClusters<dist_t>(space, DataObjects, AllParams);
+    return new ListClusters<dist_t>(space, DataObjects, AllParams, BuildIndex);
 }
 
 /*
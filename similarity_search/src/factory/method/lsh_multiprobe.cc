@@ -30,7 +30,8 @@ Index<dist_t>* CreateLSHMultiprobe(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
     unsigned  LSH_M = 20;
     unsigned  LSH_L = 50;
     unsigned  LSH_H = 1017881;
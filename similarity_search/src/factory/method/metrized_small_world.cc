@@ -29,9 +29,10 @@ Index<dist_t>* CreateMetrizedSmallWorld(bool PrintProgress,
                                         const string& SpaceType,
                                         const Space<dist_t>* space,
                                         const ObjectVector& DataObjects,
-                                        const AnyParams& AllParams) {
+                                        const AnyParams& AllParams,
+                                        bool BuildIndex) {
 
-    return new Metrized_small_world<dist_t>(space, DataObjects, AllParams);
+    return new Metrized_small_world<dist_t>(space, DataObjects, AllParams, BuildIndex);
 }
 
 /*
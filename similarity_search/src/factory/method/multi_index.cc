@@ -29,7 +29,8 @@ Index<dist_t>* CreateMultiIndex(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
     return new MultiIndex<dist_t>(SpaceType, space, DataObjects, AllParams);
 }
@@ -29,7 +29,8 @@ Index<dist_t>* CreateMultiVantagePointTree(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
     return new MultiVantagePointTree<dist_t>(space, DataObjects, AllParams);
 }
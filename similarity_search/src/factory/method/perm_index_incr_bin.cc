@@ -29,7 +29,8 @@ Index<dist_t>* CreatePermutationIndexIncrementalBin(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
   AnyParamManager pmgr(AllParams);
 
   double    DbScanFrac = 0.05;
@@ -49,7 +50,8 @@ Index<dist_t>* CreatePermutationIndexIncrementalBin(bool PrintProgress,
                                                        DataObjects,
                                                        NumPivot,
                                                        BinThres,
-                                                       DbScanFrac);
+                                                       DbScanFrac,
+                                                       BuildIndex);
 
 }
 
@@ -29,7 +29,8 @@ Index<dist_t>* CreatePermutationIndex(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
   AnyParamManager pmgr(AllParams);
 
   double    DbScanFrac = 0.05;
@@ -46,7 +47,8 @@ Index<dist_t>* CreatePermutationIndex(bool PrintProgress,
                                       DataObjects,
                                       NumPivot,
                                       DbScanFrac,
-                                      SpearmanRhoSIMD
+                                      SpearmanRhoSIMD,
+                                      BuildIndex
                                      );
 
 }
@@ -30,7 +30,8 @@ Index<dist_t>* CreatePermInvertedIndex(
     const string& SpaceType,
     const Space<dist_t>* space,
     const ObjectVector& DataObjects,
-    const AnyParams& AllParams) {
+    const AnyParams& AllParams,
+    bool BuildIndex) {
   AnyParamManager pmgr(AllParams);
 
   size_t num_pivot = 50;
@@ -66,7 +67,8 @@ Index<dist_t>* CreatePermInvertedIndex(
       num_pivot_index,
       num_pivot_search,
       max_pos_diff,
-      db_scan_frac
+      db_scan_frac,
+      BuildIndex
   );
 }
 
@@ -29,7 +29,8 @@ Index<dist_t>* CreatePermutationPrefixIndex(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
   AnyParamManager pmgr(AllParams);
 
   size_t    NumPivot        = 16;
@@ -58,7 +59,8 @@ Index<dist_t>* CreatePermutationPrefixIndex(bool PrintProgress,
                 NumPivot, 
                 PrefixLength, 
                 MinCandidate,
-                ChunkBucket);
+                ChunkBucket,
+                BuildIndex);
 
 }
 
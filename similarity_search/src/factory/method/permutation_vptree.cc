@@ -29,9 +29,10 @@ Index<dist_t>* CreatePermutationVPTree(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
-    return new PermutationVPTree<dist_t, SpearmanRhoSIMD>(space, DataObjects, AllParams);
+    return new PermutationVPTree<dist_t, SpearmanRhoSIMD>(space, DataObjects, AllParams, BuildIndex);
 }
 
 /*
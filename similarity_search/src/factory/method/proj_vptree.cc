@@ -31,7 +31,8 @@ Index<dist_t>* CreateProjVPTree(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
 
     if (SpaceType != SPACE_SPARSE_ANGULAR_DISTANCE &&
         SpaceType != SPACE_SPARSE_COSINE_SIMILARITY) LOG(FATAL) << METH_PROJ_VPTREE << 
@@ -29,7 +29,8 @@ Index<dist_t>* CreateVPTreeTriang(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
     AnyParamManager pmgr(AllParams);
 
     double AlphaLeft = 1.0, AlphaRight = 1.0;
@@ -46,7 +47,9 @@ Index<dist_t>* CreateVPTreeTriang(bool PrintProgress,
                                                 OracleCreator,
                                                 space,
                                                 DataObjects,
-                                                RemainParams
+                                                RemainParams,
+                                                true /* use random center */,
+                                                BuildIndex
                                                 );
 }
 
@@ -55,7 +58,8 @@ Index<dist_t>* CreateVPTreeSample(bool PrintProgress,
                            const string& SpaceType,
                            const Space<dist_t>* space,
                            const ObjectVector& DataObjects,
-                           const AnyParams& AllParams) {
+                           const AnyParams& AllParams,
+                           bool BuildIndex) {
     AnyParamManager pmgr(AllParams);
 
     bool      DoRandSample                  = true;
@@ -95,7 +99,9 @@ Index<dist_t>* CreateVPTreeSample(bool PrintProgress,
                                                  OracleCreator,
                                                  space,
                                                  DataObjects,
-                                                 RemainParams
+                                                 RemainParams,
+                                                 true /* use random center */,
+                                                 BuildIndex
                                                  );
 }
 
@@ -0,0 +1,387 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "gold_standard.h"
+#include "index_io.h"
+#include "knnquery.h"
+#include "logging.h"
+#include "rangequery.h"
+#include "seqsearch.h"
+#include "ztimer.h"
+#include "utils.h"
+
+namespace similarity {
+
+template <class dist_t>
+GoldStandard<dist_t>::GoldStandard(const Space<dist_t>*   space,
+                                   const ObjectVector&    datapoints,
+                                   const Object*          query,
+                                   size_t                 KeepQty,
+                                   bool                   HasRange,
+                                   dist_t                 MaxRadius,
+                                   bool                   KeepAllDists) {
+  ExactDists_.resize(datapoints.size());
+
+  for (size_t i = 0; i < datapoints.size(); ++i) {
+    // Distance can be asymmetric, but the query is always on the right side
+    ExactDists_[i] = std::make_pair(space->IndexTimeDistance(datapoints[i], query), datapoints[i]);
+  }
+
+  if (ExactDists_.empty()) return;
+
+  auto beg = ExactDists_.begin();
+  auto end = ExactDists_.end();
+
+  size_t keep = KeepQty && KeepQty < ExactDists_.size() ? KeepQty : ExactDists_.size();
+
+  // All points within the largest radius are needed to evaluate range searches
+  size_t InRangeQty = 0;
+  if (HasRange) {
+    InRangeQty = std::partition(beg, end,
+                                [MaxRadius](const DistObjectPair<dist_t>& e) { return e.first <= MaxRadius; })
+                 - beg;
+  }
+
+  if (keep <= InRangeQty) {
+    keep = InRangeQty;
+  } else {
+    // Instead of sorting all the points, select the closest ones first
+    std::nth_element(beg + InRangeQty, beg + keep - 1, end);
+    // Points tied with the last kept one are needed to evaluate k-NN searches
+    const dist_t last = ExactDists_[keep - 1].first;
+    keep = std::partition(beg + keep, end,
+                          [last](const DistObjectPair<dist_t>& e) { return e.first == last; })
+           - beg;
+  }
+
+  std::sort(beg, beg + keep);
+
+  // Points that are not kept are farther than the kept ones
+  SortedDists_.resize(KeepAllDists ? ExactDists_.size() : keep);
+  for (size_t i = 0; i < SortedDists_.size(); ++i) {
+    SortedDists_[i] = ExactDists_[i].first;
+  }
+  std::sort(SortedDists_.begin() + keep, SortedDists_.end());
+
+  ExactDists_.resize(keep);
+  ExactDists_.shrink_to_fit();
+}
+
+template <class dist_t>
+GoldStandardManager<dist_t>::GoldStandardManager(const ExperimentConfig<dist_t>& config,
+                                                 unsigned MaxCacheGSRelativeQty,
+                                                 bool KeepAllDists)
+                                                : config_(config),
+                                                  KeepQty_(MaxCacheGSRelativeQty ? 1 : 0),
+                                                  KeepAllDists_(KeepAllDists),
+                                                  HasRange_(!config.GetRange().empty()),
+                                                  MaxRadius_(0),
+                                                  SeqSearchTime_(0),
+                                                  SeqSearchCPUTime_(0) {
+  /*
+   * The largest K closest points are needed to compute recall.
+   * If there are only range searches, only points within the largest radius are needed.
+   * A zero KeepQty_ means keeping all the points.
+   */
+  if (MaxCacheGSRelativeQty && !config.GetKNN().empty()) {
+    KeepQty_ = MaxCacheGSRelativeQty * *std::max_element(config.GetKNN().begin(), config.GetKNN().end());
+  }
+  if (HasRange_) {
+    MaxRadius_ = *std::max_element(config.GetRange().begin(), config.GetRange().end());
+  }
+}
+
+template <class dist_t>
+void GoldStandardManager<dist_t>::Compute(unsigned ThreadQty) {
+  const Space<dist_t>*  space = config_.GetSpace();
+  const ObjectVector&   data = config_.GetDataObjects();
+  const ObjectVector&   queries = config_.GetQueryObjects();
+  const size_t          qty = queries.size();
+
+  WallClockTimer wtm;
+  wtm.reset();
+
+  GoldStandards_.clear();
+  GoldStandards_.resize(qty);
+
+  if (!ThreadQty) ThreadQty = std::max(1U, std::thread::hardware_concurrency());
+  ThreadQty = std::min<size_t>(ThreadQty, std::max<size_t>(qty, 1));
+
+  // Each thread grabs the next unprocessed query (queries are expensive)
+  std::atomic<size_t> NextQuery(0);
+
+  auto worker = [&]() {
+    for (size_t q = NextQuery++; q < qty; q = NextQuery++) {
+      GoldStandards_[q] = GoldStandard<dist_t>(space, data, queries[q],
+                                               KeepQty_, HasRange_, MaxRadius_, KeepAllDists_);
+    }
+  };
+
+  if (ThreadQty > 1) {
+    vector<std::thread> threads(ThreadQty);
+    for (auto& t: threads) t = std::thread(worker);
+    for (auto& t: threads) t.join();
+  } else {
+    worker();
+  }
+
+  wtm.split();
+  LOG(INFO) << "Computed gold standard data for " << qty << " queries using "
+            << ThreadQty << " threads in " << wtm.elapsed() / 1e6 << " sec";
+  if (KeepQty_ && !KeepAllDists_) {
+    LOG(INFO) << "Only " << KeepQty_ << " closest points per query are kept in the gold standard:"
+              << " RelPosError and NumCloser are approximate (underestimated)";
+  }
+
+  /*
+   * The cost of the sequential search is dominated by computing distances
+   * to all the data points, which doesn't depend on K or the radius.
+   */
+  if (!config_.GetKNN().empty()) {
+    const size_t K = *std::max_element(config_.GetKNN().begin(), config_.GetKNN().end());
+    const float  eps = config_.GetEPS();
+    TimeSeqSearch<KNNQuery<dist_t>>([K, eps](const Space<dist_t>* space, const Object* query) {
+                                      return new KNNQuery<dist_t>(space, query, K, eps);
+                                    });
+  } else if (HasRange_) {
+    const dist_t radius = MaxRadius_;
+    TimeSeqSearch<RangeQuery<dist_t>>([radius](const Space<dist_t>* space, const Object* query) {
+                                        return new RangeQuery<dist_t>(space, query, radius);
+                                      });
+  }
+}
+
+template <class dist_t>
+template <typename QueryType, typename QueryCreatorType>
+void GoldStandardManager<dist_t>::TimeSeqSearch(const QueryCreatorType& QueryCreator) {
+  SeqSearch<dist_t> seq(config_.GetDataObjects());
+
+  config_.GetSpace()->SetQueryPhase();
+
+  WallClockTimer wtm;
+  CPUTimer       ctm;
+
+  wtm.reset();
+  ctm.reset();
+
+  for (size_t q = 0; q < config_.GetQueryObjects().size(); ++q) {
+    std::unique_ptr<QueryType> query(QueryCreator(config_.GetSpace(), config_.GetQueryObjects()[q]));
+    seq.Search(query.get());
+  }
+
+  wtm.split();
+  ctm.split();
+
+  config_.GetSpace()->SetIndexPhase();
+
+  SeqSearchTime_    = wtm.elapsed();
+  SeqSearchCPUTime_ = ctm.elapsed();
+}
+
+static void AddFileInfo(std::stringstream& str, const string& FileName) {
+  struct stat st;
+  str << " '" << FileName << "'";
+  if (!FileName.empty() && stat(FileName.c_str(), &st) == 0) {
+    str << " (size=" << st.st_size << " mtime=" << st.st_mtime << ")";
+  }
+}
+
+template <class dist_t>
+string GoldStandardManager<dist_t>::CacheKey() const {
+  std::stringstream str;
+
+  str.precision(std::numeric_limits<dist_t>::digits10 + 2);
+
+  str << "dataFile:";   AddFileInfo(str, config_.GetDataFile());
+  str << " queryFile:"; AddFileInfo(str, config_.GetQueryFile());
+  str << " space: " << config_.GetSpace()->ToString()
+      << " distType: " << DistTypeName<dist_t>()
+      << " dimension: " << config_.GetDimension()
+      << " keepQty: " << KeepQty_
+      << " keepAllDists: " << KeepAllDists_;
+  if (HasRange_) str << " maxRadius: " << MaxRadius_;
+  str << " dataQty: " << config_.GetDataObjects().size()
+      << " dataHash: " << DataSetHash(config_.GetDataObjects())
+      << " queryQty: " << config_.GetQueryObjects().size()
+      << " queryHash: " << DataSetHash(config_.GetQueryObjects());
+
+  return str.str();
+}
+
+template <typename T>
+static void WriteVal(std::ofstream& out, const T& val) {
+  out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+template <typename T>
+static void ReadVal(std::ifstream& in, T& val, const string& FileName) {
+  in.read(reinterpret_cast<char*>(&val), sizeof(val));
+  if (!in) {
+    LOG(FATAL) << "The gold standard cache file is truncated: '" << FileName << "'";
+  }
+}
+
+template <class dist_t>
+void GoldStandardManager<dist_t>::Save(const string& FileName) const {
+  const ObjectVector& data = config_.GetDataObjects();
+
+  std::ofstream out(FileName.c_str(), std::ios::binary | std::ios::trunc | std::ios::out);
+  if (!out) {
+    LOG(FATAL) << "Cannot create the gold standard cache file: '" << FileName << "'";
+  }
+  out.exceptions(std::ios::badbit | std::ios::failbit);
+
+  // Data points are saved as their positions in the data set
+  std::unordered_map<const Object*, uint32_t> pos;
+  CHECK(data.size() < std::numeric_limits<uint32_t>::max());
+  for (size_t i = 0; i < data.size(); ++i) pos[data[i]] = i;
+
+  const string key = CacheKey();
+
+  out.write(GOLD_STANDARD_CACHE_MAGIC, strlen(GOLD_STANDARD_CACHE_MAGIC));
+  WriteVal<uint64_t>(out, key.size());
+  out.write(key.c_str(), key.size());
+  WriteVal<uint64_t>(out, SeqSearchTime_);
+  WriteVal<uint64_t>(out, SeqSearchCPUTime_);
+  WriteVal<uint64_t>(out, GoldStandards_.size());
+
+  for (const GoldStandard<dist_t>& gs: GoldStandards_) {
+    const DistObjectPairVector<dist_t>& dists = gs.GetExactDists();
+    const vector<dist_t>&               sorted = gs.GetSortedDists();
+
+    WriteVal<uint64_t>(out, dists.size());
+    for (const DistObjectPair<dist_t>& e: dists) {
+      WriteVal<dist_t>(out, e.first);
+      WriteVal<uint32_t>(out, pos[e.second]);
+    }
+    // Distances to the kept points are already saved
+    CHECK(sorted.size() >= dists.size());
+    WriteVal<uint64_t>(out, sorted.size() - dists.size());
+    for (size_t i = dists.size(); i < sorted.size(); ++i) {
+      WriteVal<dist_t>(out, sorted[i]);
+    }
+  }
+  out.close();
+
+  LOG(INFO) << "The gold standard is saved to: '" << FileName << "'";
+}
+
+template <class dist_t>
+bool GoldStandardManager<dist_t>::Load(const string& FileName) {
+  const ObjectVector& data = config_.GetDataObjects();
+
+  if (!IsFileExists(FileName)) {
+    LOG(INFO) << "The gold standard cache file '" << FileName << "' doesn't exist";
+    return false;
+  }
+
+  std::ifstream in(FileName.c_str(), std::ios::binary);
+  if (!in) {
+    LOG(FATAL) << "Cannot open the gold standard cache file: '" << FileName << "'";
+  }
+
+  char magic[sizeof(GOLD_STANDARD_CACHE_MAGIC) - 1];
+  in.read(magic, sizeof(magic));
+  if (!in || memcmp(magic, GOLD_STANDARD_CACHE_MAGIC, sizeof(magic)) != 0) {
+    LOG(FATAL) << "Not a gold standard cache file: '" << FileName << "'";
+  }
+
+  uint64_t len;
+  ReadVal(in, len, FileName);
+  if (len > 65536) {
+    LOG(FATAL) << "The gold standard cache file is corrupt: '" << FileName << "'";
+  }
+  string key(len, ' ');
+  if (len) {
+    in.read(&key[0], len);
+    if (!in) {
+      LOG(FATAL) << "The gold standard cache file is truncated: '" << FileName << "'";
+    }
+  }
+  const string ExpectedKey = CacheKey();
+  if (key != ExpectedKey) {
+    LOG(INFO) << "The gold standard cache file '" << FileName << "' is stale, the gold standard will be recomputed";
+    LOG(INFO) << "Cached:   " << key;
+    LOG(INFO) << "Expected: " << ExpectedKey;
+    return false;
+  }
+
+  ReadVal(in, SeqSearchTime_, FileName);
+  ReadVal(in, SeqSearchCPUTime_, FileName);
+
+  uint64_t qty;
+  ReadVal(in, qty, FileName);
+  if (qty != config_.GetQueryObjects().size()) {
+    LOG(FATAL) << "The gold standard cache file is corrupt: '" << FileName << "'";
+  }
+
+  GoldStandards_.clear();
+  GoldStandards_.reserve(qty);
+
+  for (uint64_t q = 0; q < qty; ++q) {
+    uint64_t dqty, rqty;
+    ReadVal(in, dqty, FileName);
+    if (dqty > data.size()) {
+      LOG(FATAL) << "The gold standard cache file is corrupt: '" << FileName << "'";
+    }
+    GoldStandards_.push_back(GoldStandard<dist_t>());
+    DistObjectPairVector<dist_t>& dists = GoldStandards_.back().GetExactDists();
+    vector<dist_t>&               sorted = GoldStandards_.back().GetSortedDists();
+    dists.resize(dqty);
+    for (uint64_t i = 0; i < dqty; ++i) {
+      uint32_t pos;
+      ReadVal(in, dists[i].first, FileName);
+      ReadVal(in, pos, FileName);
+      if (pos >= data.size()) {
+        LOG(FATAL) << "The gold standard cache file is corrupt: '" << FileName << "'";
+      }
+      dists[i].second = data[pos];
+    }
+    ReadVal(in, rqty, FileName);
+    if (rqty > data.size() - dqty) {
+      LOG(FATAL) << "The gold standard cache file is corrupt: '" << FileName << "'";
+    }
+    sorted.resize(dqty + rqty);
+    for (uint64_t i = 0; i < dqty; ++i) sorted[i] = dists[i].first;
+    for (uint64_t i = dqty; i < dqty + rqty; ++i) {
+      ReadVal(in, sorted[i], FileName);
+    }
+  }
+
+  LOG(INFO) << "The gold standard is loaded from: '" << FileName << "'";
+  return true;
+}
+
+template class GoldStandard<float>;
+template class GoldStandard<double>;
+template class GoldStandard<int>;
+template class GoldStandardManager<float>;
+template class GoldStandardManager<double>;
+template class GoldStandardManager<int>;
+
+}   // namespace similarity
@@ -0,0 +1,210 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <string.h>
+
+#include "index_io.h"
+
+namespace similarity {
+
+static inline void FNVHashBytes(uint64_t& h, const void* buf, size_t len) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(buf);
+  for (size_t i = 0; i < len; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+}
+
+uint64_t DataSetHash(const ObjectVector& data) {
+  uint64_t h = 14695981039346656037ULL;
+  for (const Object* obj: data) {
+    uint64_t vals[2] = { static_cast<uint64_t>(obj->id()), static_cast<uint64_t>(obj->datalength()) };
+    FNVHashBytes(h, vals, sizeof(vals));
+    FNVHashBytes(h, obj->data(), obj->datalength());
+  }
+  return h;
+}
+
+IndexFileWriter::IndexFileWriter(const string& FileName,
+                                 const string& MethodDesc,
+                                 const string& BuildParams,
+                                 const ObjectVector& data)
+                                 : FileName_(FileName),
+                                   out_(FileName.c_str(), std::ios::binary | std::ios::trunc | std::ios::out) {
+  if (!out_) {
+    LOG(FATAL) << "Cannot create the index file: '" << FileName << "'";
+  }
+  out_.exceptions(std::ios::badbit | std::ios::failbit);
+
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (!pos_.insert(std::make_pair(data[i]->id(), i)).second) {
+      LOG(FATAL) << "Cannot save the index: data object ids are not unique (id=" << data[i]->id() << ")";
+    }
+  }
+
+  out_.write(INDEX_FILE_MAGIC, strlen(INDEX_FILE_MAGIC));
+  Write<uint64_t>(MethodDesc.size());
+  out_.write(MethodDesc.c_str(), MethodDesc.size());
+  Write<uint64_t>(BuildParams.size());
+  out_.write(BuildParams.c_str(), BuildParams.size());
+  Write<uint64_t>(data.size());
+  Write<uint64_t>(DataSetHash(data));
+}
+
+void IndexFileWriter::WriteObject(const Object* obj) {
+  if (obj == NULL) {
+    Write(kNullObjectPos);
+    return;
+  }
+  auto it = pos_.find(obj->id());
+  if (it == pos_.end()) {
+    LOG(FATAL) << "Bug: the index refers to an object (id=" << obj->id() << ") that is not in the data set";
+  }
+  Write(it->second);
+}
+
+void IndexFileWriter::WriteObjectVector(const ObjectVector& v) {
+  Write<uint64_t>(v.size());
+  for (const Object* obj: v) WriteObject(obj);
+}
+
+void IndexFileWriter::WriteObjectCopy(const Object* obj) {
+  Write<uint64_t>(obj->id());
+  Write<uint64_t>(obj->datalength());
+  out_.write(obj->data(), obj->datalength());
+}
+
+void IndexFileWriter::Close() {
+  out_.close();
+  LOG(INFO) << "The index is saved to: '" << FileName_ << "'";
+}
+
+IndexFileReader::IndexFileReader(const string& FileName,
+                                 const string& MethodDesc,
+                                 const string& BuildParams,
+                                 const ObjectVector& data)
+                                 : FileName_(FileName),
+                                   in_(FileName.c_str(), std::ios::binary),
+                                   fileSize_(0),
+                                   data_(data) {
+  if (!in_) {
+    LOG(FATAL) << "Cannot open the index file: '" << FileName << "'";
+  }
+  in_.seekg(0, std::ios::end);
+  fileSize_ = in_.tellg();
+  in_.seekg(0, std::ios::beg);
+
+  char magic[sizeof(INDEX_FILE_MAGIC) - 1];
+  in_.read(magic, sizeof(magic));
+  CheckRead();
+  if (memcmp(magic, INDEX_FILE_MAGIC, sizeof(magic)) != 0) {
+    LOG(FATAL) << "Not an index file: '" << FileName << "'";
+  }
+
+  string desc = ReadString();
+  if (desc != MethodDesc) {
+    LOG(FATAL) << "The index file '" << FileName << "' was created by the method: '" << desc << "'"
+               << ", but the current method is: '" << MethodDesc << "'";
+  }
+  string params = ReadString();
+  if (params != BuildParams) {
+    LOG(FATAL) << "The index file '" << FileName << "' was created with the parameters: '" << params << "'"
+               << ", but the current parameters are: '" << BuildParams << "'";
+  }
+
+  uint64_t qty, hash;
+  Read(qty);
+  Read(hash);
+  if (qty != data.size() || hash != DataSetHash(data)) {
+    LOG(FATAL) << "The index file '" << FileName << "' was created for a different data set"
+               << " (# of objects: " << qty << " vs. " << data.size() << " in the current data set)";
+  }
+}
+
+string IndexFileReader::ReadString() {
+  uint64_t len;
+  Read(len);
+  if (len > 4096) {
+    LOG(FATAL) << "The index file is corrupt: '" << FileName_ << "'";
+  }
+  string res(len, ' ');
+  if (len) {
+    in_.read(&res[0], len);
+    CheckRead();
+  }
+  return res;
+}
+
+const Object* IndexFileReader::ReadObject() {
+  uint64_t pos;
+  Read(pos);
+  if (pos == kNullObjectPos) return NULL;
+  if (pos >= data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << FileName_ << "' (invalid object position: " << pos << ")";
+  }
+  return data_[pos];
+}
+
+void IndexFileReader::ReadObjectVector(ObjectVector& v) {
+  uint64_t qty;
+  Read(qty);
+  if (qty > data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << FileName_ << "'";
+  }
+  v.resize(qty);
+  for (size_t i = 0; i < qty; ++i) v[i] = ReadObject();
+}
+
+Object* IndexFileReader::ReadObjectCopy() {
+  uint64_t id, len;
+  Read(id);
+  Read(len);
+  if (len > (1ULL << 32)) {
+    LOG(FATAL) << "The index file is corrupt: '" << FileName_ << "'";
+  }
+  CheckQty(len, 1);
+  Object* obj = new Object(id, len, NULL);
+  in_.read(obj->data(), len);
+  if (!in_) {
+    delete obj;
+    CheckRead();
+  }
+  return obj;
+}
+
+void IndexFileReader::Close() {
+  if (in_.peek() != std::ifstream::traits_type::eof()) {
+    LOG(FATAL) << "The index file has trailing data (is it corrupt?): '" << FileName_ << "'";
+  }
+  in_.close();
+  LOG(INFO) << "The index is loaded from: '" << FileName_ << "'";
+}
+
+void IndexFileReader::CheckRead() {
+  if (!in_) {
+    LOG(FATAL) << "The index file is truncated: '" << FileName_ << "'";
+  }
+}
+
+void IndexFileReader::CheckQty(uint64_t qty, size_t elemSize) {
+  uint64_t pos = in_.tellg();
+  if (pos > fileSize_ || qty > (fileSize_ - pos) / elemSize) {
+    LOG(FATAL) << "The index file is corrupt: '" << FileName_ << "'"
+               << " (" << qty << " elements don't fit into the rest of the file)";
+  }
+}
+
+}   // namespace similarity
@@ -24,16 +24,16 @@
 #include "index.h"
 #include "rangequery.h"
 #include "knnquery.h"
+#include "transposed_bucket.h"
 
 namespace similarity {
 
-using std::unique_ptr;
-
 template <typename dist_t>
 KNNQuery<dist_t>::KNNQuery(const Space<dist_t>* space, const Object* query_object, const unsigned K, float eps)
     : Query<dist_t>(space, query_object),
       K_(K), eps_(eps),
       result_(new KNNQueue<dist_t>(K)) {
+  UpdateRadius();
 }
 
 template <typename dist_t>
@@ -45,6 +45,7 @@ template <typename dist_t>
 void KNNQuery<dist_t>::Reset() {
   this->ResetStats();
   result_->Reset();
+  UpdateRadius();
 }
 
 template <typename dist_t>
@@ -53,12 +54,17 @@ const KNNQueue<dist_t>* KNNQuery<dist_t>::Result() const {
 }
 
 template <typename dist_t>
-dist_t KNNQuery<dist_t>::Radius() const {
-  return result_->Size() < static_cast<size_t>(K_)
+void KNNQuery<dist_t>::UpdateRadius() {
+  radius_ = result_->Size() < static_cast<size_t>(K_)
       ? DistMax<dist_t>()
       : static_cast<dist_t>(result_->TopDistance() / (static_cast<dist_t>(1) + eps_));
 }
 
+template <typename dist_t>
+dist_t KNNQuery<dist_t>::Radius() const {
+  return radius_;
+}
+
 template <typename dist_t>
 unsigned KNNQuery<dist_t>::ResultSize() const {
   return result_->Size();
@@ -67,9 +73,11 @@ unsigned KNNQuery<dist_t>::ResultSize() const {
 template <typename dist_t>
 bool KNNQuery<dist_t>::CheckAndAddToResult(const dist_t distance,
                                            const Object* object) {
+  SEARCH_TRACE_SCOPE(this, kTraceQueue);
   if (result_->Size() < static_cast<size_t>(K_) ||
       distance < result_->TopDistance()) {
     result_->Push(distance, object);
+    UpdateRadius();
     return true;
   }
   return false;
@@ -82,10 +90,37 @@ bool KNNQuery<dist_t>::CheckAndAddToResult(const Object* object) {
 
 template <typename dist_t>
 size_t KNNQuery<dist_t>::CheckAndAddToResult(const ObjectVector& bucket) {
+  return CheckAndAddToResult(bucket.data(), bucket.size());
+}
+
+template <typename dist_t>
+size_t KNNQuery<dist_t>::CheckAndAddToResult(const Object* const* objs, size_t qty) {
+  size_t res = 0;
+  dist_t dists[Query<dist_t>::kDistanceBatchQty];
+  for (size_t start = 0; start < qty; start += Query<dist_t>::kDistanceBatchQty) {
+    const size_t BatchQty = std::min(Query<dist_t>::kDistanceBatchQty, qty - start);
+    this->DistanceBatch(objs + start, BatchQty, dists);
+    for (size_t i = 0; i < BatchQty; ++i) {
+      if (CheckAndAddToResult(dists[i], objs[start + i])) {
+        ++res;
+      }
+    }
+  }
+  return res;
+}
+
+template <typename dist_t>
+size_t KNNQuery<dist_t>::CheckAndAddToResult(const Object* const* objs, const TransposedBucket<dist_t>& bucket) {
+  const size_t qty = bucket.size();
   size_t res = 0;
-  for (size_t i = 0; i < bucket.size(); ++i) {
-    if (CheckAndAddToResult(bucket[i])) {
-      ++res;
+  dist_t dists[Query<dist_t>::kDistanceBatchQty];
+  for (size_t start = 0; start < qty; start += Query<dist_t>::kDistanceBatchQty) {
+    const size_t BatchQty = std::min(Query<dist_t>::kDistanceBatchQty, qty - start);
+    this->DistanceTransposed(bucket, start, BatchQty, dists);
+    for (size_t i = 0; i < BatchQty; ++i) {
+      if (CheckAndAddToResult(dists[i], objs[start + i])) {
+        ++res;
+      }
     }
   }
   return res;
@@ -94,40 +129,39 @@ size_t KNNQuery<dist_t>::CheckAndAddToResult(const ObjectVector& bucket) {
 template <typename dist_t>
 bool KNNQuery<dist_t>::Equals(const KNNQuery<dist_t>* other) const {
   bool equal = true;
-  unique_ptr<KNNQueue<dist_t>> first(result_->Clone());
-  unique_ptr<KNNQueue<dist_t>> second(other->result_->Clone());
-  while (equal && !first->Empty() && !second->Empty()) {
-    equal = equal && ApproxEqual(first->TopDistance(), second->TopDistance());
+  auto first = result_->SortedBegin();
+  auto second = other->result_->SortedBegin();
+  while (equal && first != result_->SortedEnd() && second != other->result_->SortedEnd()) {
+    equal = equal && ApproxEqual(first->first, second->first);
     if (!equal) {
       std::cerr << "Equality check failed: "
-                << first->TopDistance() <<  " != "
-                << second->TopDistance() << std::endl;
+                << first->first <<  " != "
+                << second->first << std::endl;
     }
-    first->Pop();
-    second->Pop();
+    ++first;
+    ++second;
   }
-  equal = equal && first->Empty() && second->Empty();   // both should be empty
+  // both should be at the end
+  equal = equal && first == result_->SortedEnd() && second == other->result_->SortedEnd();
   return equal;
 }
 
 template <typename dist_t>
 void KNNQuery<dist_t>::Print() const {
-  unique_ptr<KNNQueue<dist_t>> clone(Result()->Clone());
   std::cerr << "queryID = " << this->query_object_->id()
             << " size = " << ResultSize()
             << " (k=" << GetK()
             << " dc=" << this->DistanceComputations()
             << ") ";
-  while (!clone->Empty()) {
-    if (clone->TopObject() == NULL) {
-      std::cerr << "null (" << clone->TopDistance() << ")";
+  for (auto it = result_->SortedBegin(); it != result_->SortedEnd(); ++it) {
+    if (it->second == NULL) {
+      std::cerr << "null (" << it->first << ")";
     } else {
-      const Object* object = reinterpret_cast<const Object*>(clone->TopObject());
+      const Object* object = reinterpret_cast<const Object*>(it->second);
       std::cerr << object->id() << "("
-                << clone->TopDistance() << " "
+                << it->first << " "
                 << this->space_->IndexTimeDistance(object, this->QueryObject()) << ") ";
     }
-    clone->Pop();
   }
   std::cerr << std::endl;
 }
@@ -25,6 +25,7 @@
 #include <sstream>
 #include <vector>
 #include <fstream>
+#include <iomanip>
 #include <map>
 
 #include "global.h"
@@ -32,6 +33,7 @@
 #include "memory.h"
 #include "ztimer.h"
 #include "experiments.h"
+#include "gold_standard.h"
 #include "experimentconf.h"
 #include "space.h"
 #include "spacefactory.h"
@@ -39,6 +41,7 @@
 #include "methodfactory.h"
 
 #include "meta_analysis.h"
+#include "perf_counters.h"
 #include "params.h"
 
 using namespace similarity;
@@ -81,10 +84,21 @@ void OutData(bool DoAppend, const string& FilePrefix,
   OutFileData.close();
 }
 
+// Percentiles of query times and of # of distance computations
+const double kReportedQuantiles[] = {0.5, 0.95, 0.99, 0.999};
+
+// 0.5 -> P50, 0.999 -> P99.9
+string QuantileName(double q) {
+  stringstream str;
+  str << "P" << q * 100;
+  return str.str();
+}
+
 template <typename dist_t>
 void ProcessResults(const ExperimentConfig<dist_t>& config,
                     MetaAnalysis& ExpRes,
                     const string& MethDesc,
+                    bool ExactGS, // See GoldStandardManager::IsExact
                     string& PrintStr, // For display
                     string& HeaderStr,
                     string& DataStr   /* to be processed by a script */) {
@@ -92,7 +106,13 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
 
   ExpRes.ComputeAll();
 
-  Header << "MethodName\tRecall\tRelPosError\tNumCloser\tQueryTime\tDistComp\tImprEfficiency\tImprDistComp\tMem" << std::endl;
+  // Metrics computed using a truncated gold standard are marked as approximate
+  const char* GSSuffix = ExactGS ? "" : "Approx";
+
+  Header << "MethodName\tRecall\tRelPosError" << GSSuffix << "\tNumCloser" << GSSuffix << "\tQueryTime\tDistComp\tImprEfficiency\tImprDistComp\tMem\tPeakRSS";
+  for (double q: kReportedQuantiles) Header << "\tQueryTime" << QuantileName(q);
+  for (double q: kReportedQuantiles) Header << "\tDistComp" << QuantileName(q);
+  Header << std::endl;
 
   Data << "\"" << MethDesc << "\"\t";
   Data << ExpRes.GetRecallAvg() << "\t";
@@ -102,7 +122,10 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
   Data << ExpRes.GetDistCompAvg() << "\t";
   Data << ExpRes.GetImprEfficiencyAvg() << "\t";
   Data << ExpRes.GetImprDistCompAvg() << "\t";
-  Data << size_t(ExpRes.GetMemAvg());
+  Data << size_t(ExpRes.GetMemAvg()) << "\t";
+  Data << size_t(ExpRes.GetPeakRSSAvg());
+  for (double q: kReportedQuantiles) Data << "\t" << ExpRes.GetQueryTimeQuantile(q);
+  for (double q: kReportedQuantiles) Data << "\t" << ExpRes.GetDistCompQuantile(q);
   Data << std::endl;
 
   Print << std::endl << 
@@ -115,6 +138,10 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
   Print << "Recall:         " << ExpRes.GetRecallAvg()              << " -> " << "[" << ExpRes.GetRecallConfMin() << " " << ExpRes.GetRecallConfMax() << "]" << std::endl;
   Print << "RelPosError:    " << round2(ExpRes.GetRelPosErrorAvg())  << " -> " << "[" << round2(ExpRes.GetRelPosErrorConfMin()) << " \t" << round2(ExpRes.GetRelPosErrorConfMax()) << "]" << std::endl;
   Print << "NumCloser:      " << round2(ExpRes.GetNumCloserAvg())    << " -> " << "[" << round2(ExpRes.GetNumCloserConfMin()) << " \t" << round2(ExpRes.GetNumCloserConfMax()) << "]" << std::endl;
+  if (!ExactGS) {
+    Print << "RelPosError and NumCloser are approximate (underestimated):" << std::endl
+          << "the gold standard doesn't keep distances to all the data points" << std::endl;
+  }
   Print << "------------------------------------" << std::endl;
   Print << "QueryTime:      " << round2(ExpRes.GetQueryTimeAvg())    << " -> " << "[" << round2(ExpRes.GetQueryTimeConfMin()) << " \t" << round2(ExpRes.GetQueryTimeConfMax()) << "]" << std::endl;
   Print << "DistComp:       " << round2(ExpRes.GetDistCompAvg())     << " -> " << "[" << round2(ExpRes.GetDistCompConfMin()) << " \t" << round2(ExpRes.GetDistCompConfMax()) << "]" << std::endl;
@@ -123,7 +150,31 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
   Print << "ImprDistComp:   " << round2(ExpRes.GetImprDistCompAvg()) << " -> " << "[" << round2(ExpRes.GetImprDistCompAvg()) << " \t"<< round2(ExpRes.GetImprDistCompConfMax()) << "]" << std::endl;
   Print << "------------------------------------" << std::endl;
   Print << "Memory Usage:   " << round2(ExpRes.GetMemAvg()) << " MB" << std::endl;
+  Print << "Peak RSS:       " << round2(ExpRes.GetPeakRSSAvg()) << " MB" << std::endl;
+  Print << "------------------------------------" << std::endl;
+  Print << "Percentiles:    ";
+  for (double q: kReportedQuantiles) Print << QuantileName(q) << " \t";
+  Print << "Max" << std::endl;
+  Print << "QueryTime:      ";
+  for (double q: kReportedQuantiles) Print << round3(ExpRes.GetQueryTimeQuantile(q)) << " \t";
+  Print << round3(ExpRes.GetQueryTimeMax()) << std::endl;
+  Print << "DistComp:       ";
+  for (double q: kReportedQuantiles) Print << round2(ExpRes.GetDistCompQuantile(q)) << " \t";
+  Print << round2(ExpRes.GetDistCompMax()) << std::endl;
   Print << "------------------------------------" << std::endl;
+  if (ExpRes.HasAnyPerfCounter()) {
+    Print << "Hardware counters per query:" << std::endl;
+    for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+      Print << std::left << std::setw(16) << (string(PerfCounterName(i)) + ":") << std::right;
+      if (ExpRes.HasPerfCounter(i)) Print << round2(ExpRes.GetPerfCounterAvg(i)) << std::endl;
+      else Print << "N/A" << std::endl;
+    }
+    if (ExpRes.HasPerfCounter(kPerfCycles) && ExpRes.HasPerfCounter(kPerfInstructions)) {
+      Print << "IPC:            "
+            << round2(ExpRes.GetPerfCounterAvg(kPerfInstructions) / ExpRes.GetPerfCounterAvg(kPerfCycles)) << std::endl;
+    }
+    Print << "------------------------------------" << std::endl;
+  }
 
   PrintStr  = Print.str();
   DataStr   = Data.str();
@@ -136,6 +187,7 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
              const shared_ptr<AnyParams>& SpaceParams,
              unsigned                     dimension,
              unsigned                     ThreadTestQty,
+             bool                         PerfCounters,
              bool                         DoAppend, 
              const string&                ResFilePrefix,
              unsigned                     TestSetQty,
@@ -145,7 +197,13 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
              unsigned                     MaxNumQuery,
              const                        vector<unsigned>& knn,
              const                        float eps,
-             const string&                RangeArg
+             const string&                RangeArg,
+             const string&                SaveIndexPrefix,
+             const string&                LoadIndexPrefix,
+             const string&                CachePrefixGS,
+             unsigned                     MaxCacheGSRelativeQty,
+             bool                         KeepAllDistsGS,
+             unsigned                     ThreadGSQty
 )
 {
   LOG(INFO) << "### Append? : "       << DoAppend;
@@ -171,6 +229,10 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
   config.ReadDataset();
   MemUsage  mem_usage_measure;
 
+  if ((!SaveIndexPrefix.empty() || !LoadIndexPrefix.empty()) && config.GetTestSetQty() > 1) {
+    LOG(FATAL) << "Indices can be saved or loaded only if there is a single test set";
+  }
+
 
   std::vector<std::string>          MethDesc;
   vector<double>                    MemUsage;
@@ -200,6 +262,13 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
 
     ReportIntrinsicDimensionality("Main data set" , *config.GetSpace(), config.GetDataObjects());
 
+    GoldStandardManager<dist_t> managerGS(config, MaxCacheGSRelativeQty, KeepAllDistsGS);
+    {
+      std::stringstream CacheFileGS;
+      if (!CachePrefixGS.empty()) CacheFileGS << CachePrefixGS << "_tset=" << TestSetId;
+      managerGS.Obtain(CacheFileGS.str(), ThreadGSQty);
+    }
+
     vector<Index<dist_t>*>  IndexPtrs;
     try {
       MethNum = 0;
@@ -209,6 +278,16 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
 
         LOG(INFO) << ">>>> Index type parameter: " << MethodName;
         const double vmsize_before = mem_usage_measure.get_vmsize();
+        /*
+         * The peak RSS is a high water mark for the whole process lifetime, which includes
+         * the data set, the gold standard, and indices of previously tested methods.
+         * Hence, it is reset before creating the index, and the RSS preceding
+         * the creation is subtracted: what remains is the peak memory used to create the index.
+         */
+        if (!mem_usage_measure.reset_peak_rss()) {
+          LOG(INFO) << "Cannot reset the peak RSS, it includes memory used before creating the index";
+        }
+        const double rss_before = mem_usage_measure.get_rss();
 
 
         WallClockTimer wtm;
@@ -221,20 +300,43 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
                            CreateMethod(true /* print progress */,
                                         MethodName, 
                                         SpaceType, config.GetSpace(), 
-                                        config.GetDataObjects(), MethPars));
+                                        config.GetDataObjects(), MethPars,
+                                        LoadIndexPrefix.empty() /* build index? */));
+
+        // Indices built with different parameters are saved to different files
+        const string IndexFileSuffix = "." + MethodName +
+                                       (IndexPtrs.back()->BuildParams().empty() ? "" : "." + IndexPtrs.back()->BuildParams());
+
+        if (!LoadIndexPrefix.empty()) {
+          IndexPtrs.back()->Load(LoadIndexPrefix + IndexFileSuffix);
+        }
 
         LOG(INFO) << "==============================================";
         wtm.split();
         ctm.split();
 
         const double vmsize_after = mem_usage_measure.get_vmsize();
+        const double peak_rss = mem_usage_measure.get_peak_rss() - rss_before;
 
         const double data_size = DataSpaceUsed(config.GetDataObjects()) / 1024.0 / 1024.0;
+        const double index_size = IndexPtrs.back()->MemoryUsage() / 1024.0 / 1024.0;
 
-        const double TotalMemByMethod = vmsize_after - vmsize_before + data_size;
+        /*
+         * If the method doesn't account for its memory, the memory usage
+         * is estimated from the change in the virtual memory size,
+         * which includes allocator overhead and unrelated memory mappings.
+         */
+        const double TotalMemByMethod = (index_size > 0 ? index_size : vmsize_after - vmsize_before) + data_size;
 
         LOG(INFO) << ">>>> Process memory usage: " << vmsize_after << " MBs";
-        LOG(INFO) << ">>>> Virtual memory usage: " << TotalMemByMethod << " MBs";
+        LOG(INFO) << ">>>> Peak RSS increase:    " << peak_rss << " MBs";
+        if (index_size > 0) {
+          LOG(INFO) << ">>>> Index size:           " << index_size << " MBs";
+        } else {
+          LOG(INFO) << ">>>> Virtual memory usage: " << vmsize_after - vmsize_before << " MBs"
+                    << " (the method doesn't report the index size)";
+        }
+        LOG(INFO) << ">>>> Total memory usage:   " << TotalMemByMethod << " MBs";
         LOG(INFO) << ">>>> Data size:            " << data_size << " MBs";
         LOG(INFO) << ">>>> Time elapsed:         " << (wtm.elapsed()/double(1e6)) << " sec";
         LOG(INFO) << ">>>> CPU time elapsed:     " << (ctm.userelapsed()/double(1e6)) << " sec";
@@ -244,20 +346,27 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
         for (size_t i = 0; i < config.GetRange().size(); ++i) {
           MetaAnalysis* res = ExpResRange[i][MethNum];
           res->SetMem(TestSetId, TotalMemByMethod);
+          res->SetPeakRSS(TestSetId, peak_rss);
         }
         for (size_t i = 0; i < config.GetKNN().size(); ++i) {
           MetaAnalysis* res = ExpResKNN[i][MethNum];
           res->SetMem(TestSetId, TotalMemByMethod);
+          res->SetPeakRSS(TestSetId, peak_rss);
         }
 
         if (!TestSetId) MethDesc.push_back(IndexPtrs.back()->ToString());
+
+        if (!SaveIndexPrefix.empty()) {
+          IndexPtrs.back()->Save(SaveIndexPrefix + IndexFileSuffix);
+        }
       }
 
       Experiments<dist_t>::RunAll(true /* print info */, 
                                       ThreadTestQty, 
+                                      PerfCounters,
                                       TestSetId,
                                       ExpResRange, ExpResKNN,
-                                      config, IndexPtrs);
+                                      config, managerGS, IndexPtrs);
 
 
     } catch (const std::exception& e) {
@@ -277,6 +386,8 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
     }
   }
 
+  const bool ExactGS = GoldStandardManager<dist_t>::IsExact(MaxCacheGSRelativeQty, KeepAllDistsGS);
+
   for (auto it = MethDesc.begin(); it != MethDesc.end(); ++it) {
     size_t MethNum = it - MethDesc.begin();
 
@@ -288,7 +399,7 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
     for (size_t i = 0; i < config.GetRange().size(); ++i) {
       MetaAnalysis* res = ExpResRange[i][MethNum];
 
-      ProcessResults(config, *res, MethDesc[MethNum], Print, Header, Data);
+      ProcessResults(config, *res, MethDesc[MethNum], ExactGS, Print, Header, Data);
       LOG(INFO) << "Range: " << config.GetRange()[i];
       LOG(INFO) << Print;
       LOG(INFO) << "Data: " << Header << Data;
@@ -305,7 +416,7 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
     for (size_t i = 0; i < config.GetKNN().size(); ++i) {
       MetaAnalysis* res = ExpResKNN[i][MethNum];
 
-      ProcessResults(config, *res, MethDesc[MethNum], Print, Header, Data);
+      ProcessResults(config, *res, MethDesc[MethNum], ExactGS, Print, Header, Data);
       LOG(INFO) << "KNN: " << config.GetKNN()[i];
       LOG(INFO) << Print;
       LOG(INFO) << "Data: " << Header << Data;
@@ -340,6 +451,13 @@ int main(int ac, char* av[]) {
   unsigned              dimension;
   float                 eps = 0.0;
   unsigned              ThreadTestQty;
+  bool                  PerfCounters;
+  string                SaveIndexPrefix;
+  string                LoadIndexPrefix;
+  string                CachePrefixGS;
+  unsigned              MaxCacheGSRelativeQty;
+  bool                  KeepAllDistsGS;
+  unsigned              ThreadGSQty;
 
   multimap<string, shared_ptr<AnyParams>>        Methods;
 
@@ -349,6 +467,7 @@ int main(int ac, char* av[]) {
                        SpaceParams,
                        dimension,
                        ThreadTestQty,
+                       PerfCounters,
                        DoAppend, 
                        ResFilePrefix,
                        TestSetQty,
@@ -359,6 +478,12 @@ int main(int ac, char* av[]) {
                        knn,
                        eps,
                        RangeArg,
+                       SaveIndexPrefix,
+                       LoadIndexPrefix,
+                       CachePrefixGS,
+                       MaxCacheGSRelativeQty,
+                       KeepAllDistsGS,
+                       ThreadGSQty,
                        Methods);
 
   ToLower(DistType);
@@ -369,6 +494,7 @@ int main(int ac, char* av[]) {
                   SpaceParams,
                   dimension,
                   ThreadTestQty,
+                  PerfCounters,
                   DoAppend, 
                   ResFilePrefix,
                   TestSetQty,
@@ -378,7 +504,13 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  SaveIndexPrefix,
+                  LoadIndexPrefix,
+                  CachePrefixGS,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else if ("float" == DistType) {
     RunExper<float>(Methods,
@@ -386,6 +518,7 @@ int main(int ac, char* av[]) {
                   SpaceParams,
                   dimension,
                   ThreadTestQty,
+                  PerfCounters,
                   DoAppend, 
                   ResFilePrefix,
                   TestSetQty,
@@ -395,7 +528,13 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  SaveIndexPrefix,
+                  LoadIndexPrefix,
+                  CachePrefixGS,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else if ("double" == DistType) {
     RunExper<double>(Methods,
@@ -403,6 +542,7 @@ int main(int ac, char* av[]) {
                   SpaceParams,
                   dimension,
                   ThreadTestQty,
+                  PerfCounters,
                   DoAppend, 
                   ResFilePrefix,
                   TestSetQty,
@@ -412,7 +552,13 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  SaveIndexPrefix,
+                  LoadIndexPrefix,
+                  CachePrefixGS,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else {
     LOG(FATAL) << "Unknown distance value type: " << DistType;
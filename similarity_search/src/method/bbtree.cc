@@ -54,8 +54,18 @@ BBTree<dist_t>::BBTree(
   pmgr.GetParamOptional("chunkBucket", ChunkBucket_);
   pmgr.GetParamOptional("maxLeavesToVisit", MaxLeavesToVisit_);
 
+  size_t   IndexThreadQty = TaskPool::DefaultThreadQty();
+  unsigned Seed = RandomInt();
+
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
+  pmgr.GetParamOptional("seed", Seed);
+
+  LOG(INFO) << "Building the bbtree using " << IndexThreadQty << " threads, seed: " << Seed;
+
+  TaskPool pool(IndexThreadQty);
+
   BregmanDivSpace_ = BregmanDiv<dist_t>::ConvertFrom(space); // Should be the special space!
-  root_node_ = new BBNode(BregmanDivSpace_, data, BucketSize_, ChunkBucket_);
+  root_node_ = new BBNode(BregmanDivSpace_, data, BucketSize_, ChunkBucket_, pool, Seed);
 }
 
 template <typename dist_t>
@@ -68,6 +78,11 @@ const std::string BBTree<dist_t>::ToString() const {
   return "bbtree";
 }
 
+template <typename dist_t>
+size_t BBTree<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + (root_node_ != NULL ? root_node_->MemoryUsage() : 0);
+}
+
 
 template <typename dist_t>
 void BBTree<dist_t>::Search(RangeQuery<dist_t>* query) {
@@ -94,8 +109,9 @@ void BBTree<dist_t>::Search(KNNQuery<dist_t>* query) {
 
 template <typename dist_t>
 BBTree<dist_t>::BBNode::BBNode(
-    const BregmanDiv<dist_t>* div, const ObjectVector& data, size_t bucket_size, bool use_optim)
-    : center_(div->Mean(data)),
+    const BregmanDiv<dist_t>* div, const ObjectVector& data, size_t bucket_size, bool use_optim,
+    TaskPool& pool, unsigned seed)
+    : center_(div->Mean(data, pool)),
       center_gradf_(div->GradientFunction(center_)),
       covering_radius_(0.0),
       is_leaf_(false),
@@ -103,11 +119,13 @@ BBTree<dist_t>::BBNode::BBNode(
       CacheOptimizedBucket_(NULL),
       left_child_(NULL),
       right_child_(NULL) {
-  dist_t dist;
+  std::vector<dist_t> dists(data.size());
+  pool.ParallelFor(0, data.size(), ParallelDistChunkQty, [&](size_t i) {
+    dists[i] = div->IndexTimeDistance(data[i], center_);
+  });
   for (size_t i = 0; i < data.size(); ++i) {
-    dist = div->IndexTimeDistance(data[i], center_);
-    if (dist > covering_radius_) {
-      covering_radius_ = dist;
+    if (dists[i] > covering_radius_) {
+      covering_radius_ = dists[i];
     }
   }
 
@@ -119,20 +137,33 @@ BBTree<dist_t>::BBNode::BBNode(
       bucket_ = new ObjectVector(data);
     }
   } else {
+    mt19937      gen(seed);
     ObjectVector bucket_left;
     ObjectVector bucket_right;
     int retry = 0;
     while (retry < kMaxRetry && (bucket_left.empty() || bucket_right.empty())) {
-      FindSplitKMeans(div, data, bucket_left, bucket_right);
+      FindSplitKMeans(div, data, bucket_left, bucket_right, pool, gen);
       retry++;
     }
     if (retry < kMaxRetry) {
+      const unsigned left_seed = gen();
+      const unsigned right_seed = gen();
+      TaskGroup      children;
+
       if (!bucket_left.empty()) {
-        left_child_ = new BBNode(div, bucket_left, bucket_size, use_optim);
+        auto build_left = [&]() {
+          left_child_ = new BBNode(div, bucket_left, bucket_size, use_optim, pool, left_seed);
+        };
+        if (bucket_left.size() >= ParallelSubtreeMinQty) {
+          pool.Spawn(children, build_left);
+        } else {
+          build_left();
+        }
       }
       if (!bucket_right.empty()) {
-        right_child_ = new BBNode(div, bucket_right, bucket_size, use_optim);
+        right_child_ = new BBNode(div, bucket_right, bucket_size, use_optim, pool, right_seed);
       }
+      pool.Wait(children);
     } else {
       is_leaf_ = true;
       if (use_optim) {
@@ -158,13 +189,22 @@ bool BBTree<dist_t>::BBNode::IsLeaf() {
   return is_leaf_;
 }
 
+template <typename dist_t>
+size_t BBTree<dist_t>::BBNode::MemoryUsage() const {
+  size_t res = sizeof(*this) + ObjectMemoryUsage(center_) + ObjectMemoryUsage(center_gradf_) +
+               BucketMemoryUsage(CacheOptimizedBucket_, bucket_);
+  if (left_child_ != NULL)  res += left_child_->MemoryUsage();
+  if (right_child_ != NULL) res += right_child_->MemoryUsage();
+  return res;
+}
+
 template <typename dist_t>
 void BBTree<dist_t>::BBNode::SelectCenters(
-    const ObjectVector& data, ObjectVector& centers) {
+    const ObjectVector& data, ObjectVector& centers, mt19937& gen) {
   std::vector<int> center_idx(centers.size());
   for (size_t j, i = 0; i < centers.size(); ) {
     while (true) {
-      int r = RandomInt() % data.size();
+      int r = gen() % data.size();
       for (j = 0; j < i; ++j) {
         if (center_idx[j] == r) break;
       }
@@ -183,18 +223,25 @@ void BBTree<dist_t>::BBNode::SelectCenters(
 template <typename dist_t>
 void BBTree<dist_t>::BBNode::FindSplitKMeans(
     const BregmanDiv<dist_t>* div, const ObjectVector& data,
-    ObjectVector& bucket_left, ObjectVector& bucket_right) {
+    ObjectVector& bucket_left, ObjectVector& bucket_right,
+    TaskPool& pool, mt19937& gen) {
   ObjectVector centers(2);
-  SelectCenters(data, centers);
+  SelectCenters(data, centers, gen);
+
+  // Buckets are filled sequentially to preserve the order of objects
+  std::vector<char> is_left(data.size());
 
   for (int retry = 0; retry < kMaxRetry; ++retry) {
     bucket_left.clear();
     bucket_right.clear();
 
-    for (size_t i = 0; i < data.size(); ++i) {
+    pool.ParallelFor(0, data.size(), ParallelDistChunkQty, [&](size_t i) {
       const dist_t div_left = div->IndexTimeDistance(data[i], centers[0]);
       const dist_t div_right = div->IndexTimeDistance(data[i], centers[1]);
-      if (div_left < div_right) {
+      is_left[i] = div_left < div_right;
+    });
+    for (size_t i = 0; i < data.size(); ++i) {
+      if (is_left[i]) {
         bucket_left.push_back(data[i]);
       } else {
         bucket_right.push_back(data[i]);
@@ -206,10 +253,10 @@ void BBTree<dist_t>::BBNode::FindSplitKMeans(
     }
 
     if (bucket_left.empty() || bucket_right.empty()) {
-      SelectCenters(data, centers);
+      SelectCenters(data, centers, gen);
     } else {
-      centers[0] = div->Mean(bucket_left);
-      centers[1] = div->Mean(bucket_right);
+      centers[0] = div->Mean(bucket_left, pool);
+      centers[1] = div->Mean(bucket_right, pool);
     }
   }
 
@@ -227,11 +274,7 @@ void BBTree<dist_t>::BBNode::LeftSearch(const BregmanDiv<dist_t>* div,
   if (MaxLeavesToVisit <= 0) return; // early termination
   if (IsLeaf()) {
     --MaxLeavesToVisit;
-    dist_t dist;
-    for (size_t j = 0; j < bucket_->size(); ++j) {
-      dist = query->DistanceObjLeft((*bucket_)[j]);
-      query->CheckAndAddToResult(dist, (*bucket_)[j]);
-    }
+    query->CheckAndAddToResult(*bucket_);
   } else {
     const dist_t div_left = query->DistanceObjRight(left_child_->center_);
     const dist_t div_right = query->DistanceObjRight(right_child_->center_);
@@ -15,12 +15,14 @@
  */
 
 #include <limits>
+#include <sstream>
 
 #include "space.h"
 #include "knnquery.h"
 #include "rangequery.h"
 #include "ghtree.h"
 #include "utils.h"
+#include "search_trace.h"
 
 namespace similarity {
 
@@ -28,19 +30,38 @@ template <typename dist_t>
 GHTree<dist_t>::GHTree(const Space<dist_t>* space,
                        const ObjectVector& data,
                        const AnyParams& MethParams,
-                       bool use_random_center)
-    : BucketSize_(50),
+                       bool use_random_center,
+                       bool BuildIndex)
+    : space_(space),
+      data_(data),
+      root_(NULL),
+      BucketSize_(50),
       MaxLeavesToVisit_(FAKE_MAX_LEAVES_TO_VISIT),
-      ChunkBucket_(true) {
+      ChunkBucket_(true),
+      TransposeBucket_(false) {
   AnyParamManager pmgr(MethParams);
 
   pmgr.GetParamOptional("bucketSize", BucketSize_);
   pmgr.GetParamOptional("chunkBucket", ChunkBucket_);
+  pmgr.GetParamOptional("transposeBucket", TransposeBucket_);
   pmgr.GetParamOptional("maxLeavesToVisit", MaxLeavesToVisit_);
 
+  size_t   IndexThreadQty = TaskPool::DefaultThreadQty();
+  unsigned Seed = RandomInt();
+
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
+  pmgr.GetParamOptional("seed", Seed);
+
+  if (!BuildIndex) return;
+
+  LOG(INFO) << "Building the GH-tree using " << IndexThreadQty << " threads, seed: " << Seed;
+
+  TaskPool pool(IndexThreadQty);
+
   root_ = new GHNode(space, const_cast<ObjectVector&>(data),
-                     BucketSize_, ChunkBucket_,
-                     use_random_center, true);
+                     BucketSize_, ChunkBucket_, TransposeBucket_,
+                     use_random_center, true,
+                     pool, Seed);
 }
 
 template <typename dist_t>
@@ -63,13 +84,42 @@ void GHTree<dist_t>::Search(KNNQuery<dist_t>* query) {
   root_->GenericSearch(query, mx);
 }
 
+template <typename dist_t>
+const string GHTree<dist_t>::BuildParams() const {
+  std::stringstream str;
+  str << "bucketSize=" << BucketSize_;
+  return str.str();
+}
+
+template <typename dist_t>
+void GHTree<dist_t>::Save(const string& location) const {
+  CHECK(root_ != NULL);
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  root_->Save(writer);
+  writer.Close();
+}
+
+template <typename dist_t>
+void GHTree<dist_t>::Load(const string& location) {
+  delete root_;
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  root_ = new GHNode(reader, space_, ChunkBucket_, TransposeBucket_);
+  reader.Close();
+}
+
+template <typename dist_t>
+size_t GHTree<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + (root_ != NULL ? root_->MemoryUsage() : 0);
+}
+
 template <typename dist_t>
 GHTree<dist_t>::GHNode::GHNode(
     const Space<dist_t>* space, ObjectVector& data,
-    size_t bucket_size, bool chunk_bucket,
-    const bool use_random_center, bool is_root)
+    size_t bucket_size, bool chunk_bucket, bool transpose_bucket,
+    const bool use_random_center, bool is_root,
+    TaskPool& pool, unsigned seed)
   : pivot1_(NULL), pivot2_(NULL), left_child_(NULL), right_child_(NULL),
-    bucket_(NULL), CacheOptimizedBucket_(NULL) {
+    bucket_(NULL), CacheOptimizedBucket_(NULL), transposed_(NULL) {
   CHECK(!data.empty());
 
   if (data.size() <= bucket_size) {
@@ -78,24 +128,36 @@ GHTree<dist_t>::GHNode::GHNode(
     } else {
       bucket_ = new ObjectVector(data);
     }
+    if (transpose_bucket) transposed_ = TransposedBucket<dist_t>::Create(space, *bucket_);
     return;
   }
 
+  mt19937 gen(seed);
+
   int data_size = static_cast<int>(data.size());
-  int pivot1_id = use_random_center ? RandomInt() % data_size : data_size - 1;
+  int pivot1_id = use_random_center ? gen() % data_size : data_size - 1;
   int pivot2_id = -1;
   pivot1_ = data[pivot1_id];
 
   if (data.size() >= 2) {    // check if there exists at least 1 except pivot1
+    const int   CandQty = 100;
+    int         cand_ids[CandQty];
+    dist_t      cand_dists[CandQty];
+
+    // There are too few candidates to compute their distances in parallel
+    for (int t = 0; t < CandQty; ++t) {
+      cand_ids[t] = gen() % data_size;
+      if (cand_ids[t] != pivot1_id) {
+        cand_dists[t] = space->IndexTimeDistance(pivot1_, data[cand_ids[t]]);
+      }
+    }
+
     dist_t maxd = 0;
-    int id;
-    for (int t = 0; t < 100; ++t) {
-        id = RandomInt() % data_size;
-        if (id != pivot1_id) {
-            dist_t curd = space->IndexTimeDistance(pivot1_, data[id]);
-            if (curd >= maxd) {
-              maxd = curd;
-              pivot2_id = id;
+    for (int t = 0; t < CandQty; ++t) {
+        if (cand_ids[t] != pivot1_id) {
+            if (cand_dists[t] >= maxd) {
+              maxd = cand_dists[t];
+              pivot2_id = cand_ids[t];
             }
         }
     }
@@ -106,13 +168,20 @@ GHTree<dist_t>::GHNode::GHNode(
 
   if (data.size() >= 3) {   // at least 1 object except pivot1 & 2
     ObjectVector left_subset, right_subset;
-    dist_t dist_to_pivot1, dist_to_pivot2;
+    // Subsets are filled sequentially to preserve the order of objects
+    std::vector<char> is_left(data_size);
+
+    pool.ParallelFor(0, data_size, ParallelDistChunkQty, [&](size_t i) {
+      if (int(i) == pivot1_id || int(i) == pivot2_id)
+        return;
+      dist_t dist_to_pivot1 = space->IndexTimeDistance(pivot1_, data[i]);
+      dist_t dist_to_pivot2 = space->IndexTimeDistance(pivot2_, data[i]);
+      is_left[i] = dist_to_pivot1 < dist_to_pivot2;    // close to pivot1
+    });
     for (int i = 0; i < data_size; ++i) {
       if (i == pivot1_id || i == pivot2_id)
         continue;
-      dist_to_pivot1 = space->IndexTimeDistance(pivot1_, data[i]);
-      dist_to_pivot2 = space->IndexTimeDistance(pivot2_, data[i]);
-      if (dist_to_pivot1 < dist_to_pivot2) {    // close to pivot1
+      if (is_left[i]) {
         left_subset.push_back(data[i]);
       } else {
         right_subset.push_back(data[i]);
@@ -123,20 +192,89 @@ GHTree<dist_t>::GHNode::GHNode(
       ObjectVector().swap(data);
     }
 
+    const unsigned left_seed = gen();
+    const unsigned right_seed = gen();
+    TaskGroup      children;
+
     if (!left_subset.empty()) {
-      left_child_ = new GHNode(space, left_subset, bucket_size, chunk_bucket, use_random_center, false);
+      auto build_left = [&]() {
+        left_child_ = new GHNode(space, left_subset, bucket_size, chunk_bucket, transpose_bucket, use_random_center, false, pool, left_seed);
+      };
+      if (left_subset.size() >= ParallelSubtreeMinQty) {
+        pool.Spawn(children, build_left);
+      } else {
+        build_left();
+      }
     }
 
     if (!right_subset.empty()) {
-      right_child_ = new GHNode(space, right_subset, bucket_size, chunk_bucket, use_random_center, false);
+      right_child_ = new GHNode(space, right_subset, bucket_size, chunk_bucket, transpose_bucket, use_random_center, false, pool, right_seed);
+    }
+
+    pool.Wait(children);
+  }
+}
+
+/*
+ * A node is saved as: a bucket flag followed either by the bucket objects,
+ * or by both pivots and both children (each child is preceded by a flag).
+ */
+template <typename dist_t>
+void GHTree<dist_t>::GHNode::Save(IndexFileWriter& writer) const {
+  writer.Write<uint8_t>(bucket_ != NULL);
+  if (bucket_ != NULL) {
+    writer.WriteObjectVector(*bucket_);
+    return;
+  }
+  writer.WriteObject(pivot1_);
+  writer.WriteObject(pivot2_);
+  writer.Write<uint8_t>(left_child_ != NULL);
+  if (left_child_ != NULL) left_child_->Save(writer);
+  writer.Write<uint8_t>(right_child_ != NULL);
+  if (right_child_ != NULL) right_child_->Save(writer);
+}
+
+template <typename dist_t>
+size_t GHTree<dist_t>::GHNode::MemoryUsage() const {
+  size_t res = sizeof(*this) + BucketMemoryUsage(CacheOptimizedBucket_, bucket_);
+  if (transposed_ != NULL)  res += transposed_->MemoryUsage();
+  if (left_child_ != NULL)  res += left_child_->MemoryUsage();
+  if (right_child_ != NULL) res += right_child_->MemoryUsage();
+  return res;
+}
+
+template <typename dist_t>
+GHTree<dist_t>::GHNode::GHNode(IndexFileReader& reader, const Space<dist_t>* space,
+                               bool chunk_bucket, bool transpose_bucket)
+  : pivot1_(NULL), pivot2_(NULL), left_child_(NULL), right_child_(NULL),
+    bucket_(NULL), CacheOptimizedBucket_(NULL), transposed_(NULL) {
+  uint8_t flag;
+
+  reader.Read(flag);
+  if (flag) {
+    ObjectVector data;
+    reader.ReadObjectVector(data);
+    if (chunk_bucket) {
+      CreateCacheOptimizedBucket(data, CacheOptimizedBucket_, bucket_);
+    } else {
+      bucket_ = new ObjectVector(data);
     }
+    if (transpose_bucket) transposed_ = TransposedBucket<dist_t>::Create(space, *bucket_);
+    return;
   }
+  pivot1_ = reader.ReadObject();
+  pivot2_ = reader.ReadObject();
+  reader.Read(flag);
+  if (flag) left_child_ = new GHNode(reader, space, chunk_bucket, transpose_bucket);
+  reader.Read(flag);
+  if (flag) right_child_ = new GHNode(reader, space, chunk_bucket, transpose_bucket);
 }
 
 template <typename dist_t>
 GHTree<dist_t>::GHNode::~GHNode() {
   delete left_child_;
   delete right_child_;
+  delete transposed_;
   ClearBucket(CacheOptimizedBucket_, bucket_);
 }
 
@@ -147,10 +285,10 @@ void GHTree<dist_t>::GHNode::GenericSearch(QueryType* query, int& MaxLeavesToVis
   if (bucket_) {
     --MaxLeavesToVisit;
 
-    for (unsigned i = 0; i < bucket_->size(); ++i) {
-      const Object* Obj = (*bucket_)[i];
-      dist_t distQC = query->DistanceObjLeft(Obj);
-      query->CheckAndAddToResult(distQC, Obj);
+    if (transposed_ != NULL) {
+      query->CheckAndAddToResult(bucket_->data(), *transposed_);
+    } else {
+      query->CheckAndAddToResult(*bucket_);
     }
     return;
   }
@@ -175,23 +313,23 @@ void GHTree<dist_t>::GHNode::GenericSearch(QueryType* query, int& MaxLeavesToVis
     if (dist_to_pivot1 < dist_to_pivot2) {
       // check left first
       if (left_child_ != NULL &&
-          (dist_to_pivot1 - dist_to_pivot2) / 2 <= query->Radius()) {
+          SEARCH_TRACE_EXPR(query, kTracePruning, (dist_to_pivot1 - dist_to_pivot2) / 2 <= query->Radius())) {
         left_child_->GenericSearch(query, MaxLeavesToVisit);
       }
       // then right
       if (right_child_ != NULL &&
-          (dist_to_pivot2 - dist_to_pivot1) / 2 <= query->Radius()) {
+          SEARCH_TRACE_EXPR(query, kTracePruning, (dist_to_pivot2 - dist_to_pivot1) / 2 <= query->Radius())) {
         right_child_->GenericSearch(query, MaxLeavesToVisit);
       }
     } else {
       // check right first
       if (right_child_ != NULL &&
-          (dist_to_pivot2 - dist_to_pivot1) / 2 <= query->Radius()) {
+          SEARCH_TRACE_EXPR(query, kTracePruning, (dist_to_pivot2 - dist_to_pivot1) / 2 <= query->Radius())) {
         right_child_->GenericSearch(query, MaxLeavesToVisit);
       }
       // then left
       if (left_child_ != NULL &&
-          (dist_to_pivot1 - dist_to_pivot2) / 2 <= query->Radius()) {
+          SEARCH_TRACE_EXPR(query, kTracePruning, (dist_to_pivot1 - dist_to_pivot2) / 2 <= query->Radius())) {
         left_child_->GenericSearch(query, MaxLeavesToVisit);
       }
     }
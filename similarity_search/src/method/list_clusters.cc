@@ -19,9 +19,11 @@
 #include "rangequery.h"
 #include "list_clusters.h"
 #include "utils.h"
+#include "search_trace.h"
 
 #include <queue>
 #include <utility>
+#include <sstream>
 
 namespace similarity {
 
@@ -44,13 +46,17 @@ template <typename dist_t>
 ListClusters<dist_t>::ListClusters(
     const Space<dist_t>* space,
     const ObjectVector& data, 
-    const AnyParams& MethParams) : 
+    const AnyParams& MethParams,
+    bool BuildIndex) : 
+                              space_(space),
+                              data_(data),
                               Strategy_(ListClustersStrategy::kRandom),
                               UseBucketSize_(true),
                               BucketSize_(50),
                               Radius_(0.1),
                               MaxLeavesToVisit_(FAKE_MAX_LEAVES_TO_VISIT),
-                              ChunkBucket_(true) {
+                              ChunkBucket_(true),
+                              TransposeBucket_(false) {
   AnyParamManager pmgr(MethParams);
 
   string sVal = "random";
@@ -77,6 +83,9 @@ ListClusters<dist_t>::ListClusters(
   pmgr.GetParamOptional("radius", Radius_);
   pmgr.GetParamOptional("maxLeavesToVisit", MaxLeavesToVisit_);
   pmgr.GetParamOptional("chunkBucket", ChunkBucket_);
+  pmgr.GetParamOptional("transposeBucket", TransposeBucket_);
+
+  if (!BuildIndex) return;
     
   // <distance to previous centers, object>
   DistObjectPairVector<dist_t> remaining;
@@ -148,6 +157,11 @@ ListClusters<dist_t>::ListClusters(
       i->OptimizeBucket();
     }
   }
+  if (TransposeBucket_) {
+    for (auto i: cluster_list_) {
+      i->TransposeBucket(space_);
+    }
+  }
 }
 
 template <typename dist_t>
@@ -157,6 +171,69 @@ ListClusters<dist_t>::~ListClusters() {
   }
 }
 
+template <typename dist_t>
+const string ListClusters<dist_t>::BuildParams() const {
+  std::stringstream str;
+  str << "strategy=";
+  switch (Strategy_) {
+    case ListClustersStrategy::kRandom:                 str << "random"; break;
+    case ListClustersStrategy::kClosestPrevCenter:      str << "closestPrevCenter"; break;
+    case ListClustersStrategy::kFarthestPrevCenter:     str << "farthestPrevCenter"; break;
+    case ListClustersStrategy::kMinSumDistPrevCenters:  str << "minSumDistPrevCenters"; break;
+    case ListClustersStrategy::kMaxSumDistPrevCenters:  str << "maxSumDistPrevCenters"; break;
+  }
+  str << ",useBucketSize=" << UseBucketSize_;
+  if (UseBucketSize_) str << ",bucketSize=" << BucketSize_;
+  else str << ",radius=" << Radius_;
+  return str.str();
+}
+
+template <typename dist_t>
+void ListClusters<dist_t>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.Write<uint64_t>(cluster_list_.size());
+  for (const auto& cluster : cluster_list_) {
+    cluster->Save(writer);
+  }
+  writer.Close();
+}
+
+template <typename dist_t>
+void ListClusters<dist_t>::Load(const string& location) {
+  for (auto& cluster : cluster_list_) {
+    delete cluster;
+  }
+  cluster_list_.clear();
+
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  uint64_t qty;
+  reader.Read(qty);
+  for (uint64_t i = 0; i < qty; ++i) {
+    cluster_list_.push_back(new Cluster(reader));
+  }
+  reader.Close();
+
+  if (ChunkBucket_) {
+    for (auto i: cluster_list_) {
+      i->OptimizeBucket();
+    }
+  }
+  if (TransposeBucket_) {
+    for (auto i: cluster_list_) {
+      i->TransposeBucket(space_);
+    }
+  }
+}
+
+template <typename dist_t>
+size_t ListClusters<dist_t>::MemoryUsage() const {
+  size_t res = sizeof(*this) + VectorMemoryUsage(cluster_list_);
+  for (const auto& cluster : cluster_list_) {
+    res += cluster->MemoryUsage();
+  }
+  return res;
+}
+
 template <typename dist_t>
 const std::string ListClusters<dist_t>::ToString() const {
   return "list of clusters";
@@ -180,9 +257,9 @@ void ListClusters<dist_t>::GenSearch(QueryType* query) {
       const dist_t dist_qc = query->DistanceObjLeft(cluster->GetCenter());
       query->CheckAndAddToResult(dist_qc, cluster->GetCenter());
 
-      if (dist_qc - query->Radius() < cluster->GetCoveringRadius()) {
+      if (SEARCH_TRACE_EXPR(query, kTracePruning, dist_qc - query->Radius() < cluster->GetCoveringRadius())) {
         cluster->Search(query);
-        if (dist_qc + query->Radius() < cluster->GetCoveringRadius()) {
+        if (SEARCH_TRACE_EXPR(query, kTracePruning, dist_qc + query->Radius() < cluster->GetCoveringRadius())) {
         /* 
         * All the query points are inside the current cluster,
         * they have all been compared to the query already.
@@ -214,7 +291,8 @@ void ListClusters<dist_t>::GenSearch(QueryType* query) {
       const dist_t dist_qc = query->DistanceObjLeft(cluster->GetCenter());
       query->CheckAndAddToResult(dist_qc, cluster->GetCenter());
 
-      if (dist_qc - query->Radius() < cluster->GetCoveringRadius()) {
+      if (SEARCH_TRACE_EXPR(query, kTracePruning, dist_qc - query->Radius() < cluster->GetCoveringRadius())) {
+        SEARCH_TRACE_SCOPE(query, kTraceQueue);
         queue.push(Elem(cluster, dist_qc));
       }
     }
@@ -233,9 +311,10 @@ void ListClusters<dist_t>::GenSearch(QueryType* query) {
       cluster->Search(query);
       ++lproc;
 
-      if (dist_qc + query->Radius() < cluster->GetCoveringRadius()) {
+      if (SEARCH_TRACE_EXPR(query, kTracePruning, dist_qc + query->Radius() < cluster->GetCoveringRadius())) {
        return;
       }
+      SEARCH_TRACE_SCOPE(query, kTraceQueue);
       queue.pop();
     }
   }
@@ -283,11 +362,34 @@ const Object* ListClusters<dist_t>::SelectNextCenter(
 template <typename dist_t>
 ListClusters<dist_t>::Cluster::Cluster(const Object* center)
   : center_(center), covering_radius_(0), 
-    CacheOptimizedBucket_(NULL), bucket_(new(ObjectVector)) {
+    CacheOptimizedBucket_(NULL), bucket_(new(ObjectVector)), transposed_(NULL) {
+}
+
+template <typename dist_t>
+ListClusters<dist_t>::Cluster::Cluster(IndexFileReader& reader)
+  : center_(NULL), covering_radius_(0),
+    CacheOptimizedBucket_(NULL), bucket_(new(ObjectVector)), transposed_(NULL) {
+  center_ = reader.ReadObject();
+  reader.Read(covering_radius_);
+  reader.ReadObjectVector(*bucket_);
+}
+
+template <typename dist_t>
+void ListClusters<dist_t>::Cluster::Save(IndexFileWriter& writer) const {
+  writer.WriteObject(center_);
+  writer.Write(covering_radius_);
+  writer.WriteObjectVector(*bucket_);
+}
+
+template <typename dist_t>
+size_t ListClusters<dist_t>::Cluster::MemoryUsage() const {
+  return sizeof(*this) + BucketMemoryUsage(CacheOptimizedBucket_, bucket_) +
+         (transposed_ != NULL ? transposed_->MemoryUsage() : 0);
 }
 
 template <typename dist_t>
 ListClusters<dist_t>::Cluster::~Cluster() {
+  delete transposed_;
   ClearBucket(CacheOptimizedBucket_, bucket_);
 }
 
@@ -300,6 +402,12 @@ void ListClusters<dist_t>::Cluster::OptimizeBucket() {
   delete OldBucket;
 }
 
+template <typename dist_t>
+void ListClusters<dist_t>::Cluster::TransposeBucket(const Space<dist_t>* space) {
+  delete transposed_;
+  transposed_ = TransposedBucket<dist_t>::Create(space, *bucket_);
+}
+
 template <typename dist_t>
 void ListClusters<dist_t>::Cluster::AddObject(
     const Object* object,
@@ -328,8 +436,10 @@ const ObjectVector& ListClusters<dist_t>::Cluster::GetBucket() {
 template <typename dist_t>
 template <typename QueryType>
 void ListClusters<dist_t>::Cluster::Search(QueryType* query) const {
-  for (const auto& object : (*bucket_)) {
-    query->CheckAndAddToResult(object);
+  if (transposed_ != NULL) {
+    query->CheckAndAddToResult(bucket_->data(), *transposed_);
+  } else {
+    query->CheckAndAddToResult(*bucket_);
   }
 }
 
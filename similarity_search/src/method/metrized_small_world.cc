@@ -16,38 +16,103 @@
 #include <cmath>
 #include <memory>
 #include <iostream>
+#include <sstream>
 
 #include "space.h"
 #include "knnquery.h"
 #include "rangequery.h"
 #include "metrized_small_world.h"
+#include "search_trace.h"
+#include "task_pool.h"
 #include <vector>
-#include <set>
-#include <map>
 #include <typeinfo>
-#include <unordered_set>
+#include <atomic>
 
 namespace similarity {
 
 template <typename dist_t>
 Metrized_small_world<dist_t>::Metrized_small_world(const Space<dist_t>* space,
                                                    const ObjectVector& data,
-                                                   const AnyParams& MethParams) :
+                                                   const AnyParams& MethParams,
+                                                   bool BuildIndex) :
+                                                   data_(data),
                                                    NN_(5),
                                                    initIndexAttempts_(2),
                                                    initSearchAttempts_(10),
+                                                   rangeExpandHops_(1),
+                                                   useHierarchy_(false),
+                                                   efSearch_(0),
+                                                   maxDegree_(0),
+                                                   indexThreadQty_(1),
                                                    size_(0)
 {
   AnyParamManager pmgr(MethParams);
 
+  // The global generator is used only if the seed isn't specified
+  unsigned Seed = pmgr.HasParam("seed") ? 0 : RandomInt();
+
   pmgr.GetParamOptional("NN", NN_);
   pmgr.GetParamOptional("initIndexAttempts", initIndexAttempts_);
+  pmgr.GetParamOptional("useHierarchy", useHierarchy_);
+  // Only the first search attempt starts from the hierarchy, other attempts are rarely useful
+  if (useHierarchy_) initSearchAttempts_ = 1;
   pmgr.GetParamOptional("initSearchAttempts", initSearchAttempts_);
-
-  for (size_t i = 0; i != data.size(); ++i) {
-	  MSWNode* node = new MSWNode(data[i]);
-	  add(space, node);
+  pmgr.GetParamOptional("rangeExpandHops", rangeExpandHops_);
+  pmgr.GetParamOptional("efSearch", efSearch_);
+  pmgr.GetParamOptional("maxDegree", maxDegree_);
+  pmgr.GetParamOptional("indexThreadQty", indexThreadQty_);
+  pmgr.GetParamOptional("seed", Seed);
+
+  // As in other methods, zero threads means building in the calling thread
+  if (!indexThreadQty_) indexThreadQty_ = 1;
+
+  if (!BuildIndex) return;
+
+  /*
+   * With one thread (the default), the same seed produces the same graph.
+   * With several threads, the graph depends on the order of insertions.
+   */
+  LOG(INFO) << "Building the small world graph using " << indexThreadQty_ << " threads, seed: " << Seed;
+
+  mt19937 gen(Seed);
+  vector<unsigned> WorkerSeeds(indexThreadQty_);
+  for (unsigned& WorkerSeed : WorkerSeeds) WorkerSeed = gen();
+
+  ElList.reserve(data.size());
+  if (data.empty()) return;
+  // The first element is added sequentially, it doesn't have friends
+  add(space, new MSWNode(data[0], 0));
+
+  /*
+   * Objects are dispensed to threads one by one using a shared counter,
+   * so that they are inserted in (almost) the same order as in the sequential build.
+   * Because threads don't see elements being inserted by other threads,
+   * the graph is slightly different from the graph created by one thread.
+   */
+  std::atomic<size_t> next(1);
+  TaskPool            pool(indexThreadQty_);
+  TaskGroup           workers;
+
+  for (size_t t = 0; t < indexThreadQty_; ++t) {
+    const unsigned WorkerSeed = WorkerSeeds[t];
+    pool.Spawn(workers, [&, WorkerSeed]() {
+      /*
+       * Enter points of the insertion searches are selected using RandomGen().
+       * With one thread, the task runs in the calling thread, so the state of
+       * its generator is restored: otherwise, the seeds of methods created later would change.
+       */
+      const mt19937 SavedGen = RandomGen();
+      RandomGen().seed(WorkerSeed);
+      for (size_t i = next++; i < data.size(); i = next++) {
+        add(space, new MSWNode(data[i], i));
+      }
+      RandomGen() = SavedGen;
+    });
   }
+  pool.Wait(workers);
+
+  freeze();
+  if (useHierarchy_) buildHierarchy(space, gen());
 }
 
 template <typename dist_t>
@@ -55,12 +120,320 @@ const std::string Metrized_small_world<dist_t>::ToString() const {
   return "metrized_small_world";
 }
 
+/*
+ * Makes an element being inserted look like a query,
+ * so that the same search code is used during indexing and querying.
+ * Note that the element is the left argument of the distance.
+ */
+template <typename dist_t>
+class MSWIndexTimeQuery {
+public:
+  MSWIndexTimeQuery(const Space<dist_t>* space, const Object* obj) : space_(space), obj_(obj) {}
+  dist_t DistanceObjLeft(const Object* obj) const {
+    return space_->IndexTimeDistance(obj_, obj);
+  }
+#ifdef WITH_SEARCH_TRACE
+  // Indexing isn't traced
+  SearchTrace& Trace() { return trace_; }
+private:
+  SearchTrace trace_;
+#endif
+private:
+  const Space<dist_t>* space_;
+  const Object*        obj_;
+};
+
+template <typename dist_t>
+Metrized_small_world<dist_t>::~Metrized_small_world() {
+  for (MSWNode* node : ElList) delete node;
+}
+
+template <typename dist_t>
+void Metrized_small_world<dist_t>::freeze() {
+  const size_t qty = ElList.size();
+  if (qty > std::numeric_limits<MSWNodeId>::max()) {
+    LOG(FATAL) << "The small world graph is too large: " << qty << " nodes";
+  }
+  // Ids are consecutive numbers starting from zero
+  vector<MSWNode*> nodes(qty);
+  for (MSWNode* node : ElList) nodes[node->getId()] = node;
+
+  size_t FriendQty = 0;
+  for (MSWNode* node : nodes) FriendQty += node->getAllFriends().size();
+
+  frozenOffsets_.resize(qty + 1);
+  frozenFriends_.clear();
+  frozenFriends_.reserve(FriendQty);
+  frozenData_.resize(qty);
+  frozenPayload_.resize(qty);
+
+  for (size_t i = 0; i < qty; ++i) {
+    frozenOffsets_[i] = frozenFriends_.size();
+    for (MSWNode* f : nodes[i]->getAllFriends()) frozenFriends_.push_back(f->getId());
+    // The data set objects aren't copied, node ids are their positions
+    frozenData_[i] = nodes[i]->getData();
+    frozenPayload_[i] = frozenData_[i]->data();
+  }
+  frozenOffsets_[qty] = frozenFriends_.size();
+
+  LOG(INFO) << "The small world graph has " << qty << " nodes, the average degree is "
+            << (qty ? double(FriendQty) / qty : 0) << ", the maximum degree is " << getMaxDegree(0);
+
+  for (MSWNode* node : ElList) delete node;
+  ElementList().swap(ElList);
+}
+
+template <typename dist_t>
+size_t Metrized_small_world<dist_t>::getMaxDegree(size_t l) const {
+  size_t res = 0;
+  if (l) {
+    for (const auto& friends : layers_[l - 1].friends) res = std::max(res, friends.size());
+  } else {
+    for (size_t i = 0; i + 1 < frozenOffsets_.size(); ++i) res = std::max(res, frozenOffsets_[i + 1] - frozenOffsets_[i]);
+  }
+  return res;
+}
+
+template <typename dist_t>
+void Metrized_small_world<dist_t>::buildHierarchy(const Space<dist_t>* space, unsigned seed) {
+  const size_t qty = frozenData_.size();
+  mt19937                                 gen(seed);
+  std::uniform_real_distribution<double>  distr(0, 1);
+
+  // With NN = 1 (or less), each node would get to the next layer
+  const double  LevelProb = 1.0 / std::max(NN_, 2);
+  vector<int>   levels(qty);
+  int           maxLevel = 0;
+  for (size_t i = 0; i < qty; ++i) {
+    while (levels[i] < MaxHierarchyLevel && distr(gen) < LevelProb) ++levels[i];
+    maxLevel = std::max(maxLevel, levels[i]);
+  }
+
+  layers_.assign(maxLevel, MSWLayer());
+  for (int l = 1; l <= maxLevel; ++l) {
+    MSWLayer&     layer = layers_[l - 1];
+    const size_t  LowerQty = l == 1 ? qty : layers_[l - 2].ids.size();
+    for (size_t j = 0; j < LowerQty; ++j) {
+      const MSWNodeId id = l == 1 ? j : layers_[l - 2].ids[j];
+      if (levels[id] >= l) {
+        layer.ids.push_back(id);
+        layer.down.push_back(j);
+      }
+    }
+    layer.friends.resize(layer.ids.size());
+  }
+  LOG(INFO) << "The hierarchy of entry points has " << maxLevel << " layers, "
+            << "the lowest one has " << (maxLevel ? layers_[0].ids.size() : 0) << " nodes";
+
+  /*
+   * Nodes of higher layers are inserted first: thus, the first node
+   * of the top layer (the enter point of all searches) is inserted first.
+   */
+  vector<MSWNodeId> order;
+  for (size_t i = 0; i < qty; ++i) {
+    if (levels[i]) order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&levels](MSWNodeId a, MSWNodeId b) { return levels[a] > levels[b]; });
+
+  MSWSearchBuffers<dist_t>&             buf = MSWSearchBuffers<dist_t>::ThreadLocal();
+  vector<std::pair<dist_t, MSWNodeId>>& closest = buf.idFound;
+
+  for (size_t n = 1; n < order.size(); ++n) {
+    const MSWNodeId           id = order[n];
+    MSWIndexTimeQuery<dist_t> query(space, frozenData_[id]);
+    MSWNodeId                 pos = 0;
+    dist_t                    dist = query.DistanceObjLeft(frozenData_[layers_.back().ids[0]]);
+
+    for (int l = maxLevel; l >= 1; --l) {
+      MSWLayer& layer = layers_[l - 1];
+      if (l > levels[id]) {
+        pos = descendLayer(layer, &query, pos, dist);
+      } else {
+        searchOneAttemptFrozen(MSWLayerGraph(layer, frozenData_, frozenPayload_), &query, pos, NN_, buf);
+        closest.assign(buf.idResults.begin(), buf.idResults.end());
+        std::sort(closest.begin(), closest.end());
+        if (closest.size() > size_t(NN_)) closest.resize(NN_);
+
+        const MSWNodeId self = std::lower_bound(layer.ids.begin(), layer.ids.end(), id) - layer.ids.begin();
+        for (const auto& ev : closest) {
+          layer.friends[self].push_back(ev.second);
+          layer.friends[ev.second].push_back(self);
+          if (maxDegree_) pruneLayerFriends(space, layer, ev.second, maxDegree_);
+        }
+        if (maxDegree_) pruneLayerFriends(space, layer, self, maxDegree_);
+        pos = closest[0].second;
+        dist = closest[0].first;
+      }
+      if (l > 1) pos = layer.down[pos];
+    }
+  }
+}
+
 template <typename dist_t>
-Metrized_small_world<dist_t>::~Metrized_small_world() {}
+void Metrized_small_world<dist_t>::pruneLayerFriends(const Space<dist_t>* space, MSWLayer& layer,
+                                                     MSWNodeId pos, size_t maxQty) const {
+  vector<MSWNodeId>& friends = layer.friends[pos];
+  if (friends.size() <= maxQty) return;
+
+  const Object* obj = frozenData_[layer.ids[pos]];
+  vector<std::pair<dist_t, MSWNodeId>> cand;
+  cand.reserve(friends.size());
+  for (MSWNodeId f : friends) cand.emplace_back(space->IndexTimeDistance(obj, frozenData_[layer.ids[f]]), f);
+  // Positions are ordered by node ids, so ties are broken as in MSWNode::pruneFriends
+  std::sort(cand.begin(), cand.end());
+
+  friends.clear();
+  for (const auto& c : cand) {
+    if (friends.size() >= maxQty) break;
+    bool keep = true;
+    for (MSWNodeId kept : friends) {
+      if (space->IndexTimeDistance(frozenData_[layer.ids[c.second]], frozenData_[layer.ids[kept]]) < c.first) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) friends.push_back(c.second);
+  }
+}
 
 template <typename dist_t>
-MSWNode* Metrized_small_world<dist_t>::getRandomEnterPoint()
+template <typename QueryType>
+MSWNodeId Metrized_small_world<dist_t>::descendLayer(const MSWLayer& layer, QueryType* query,
+                                                    MSWNodeId pos, dist_t& dist) const {
+  while (true) {
+    MSWNodeId best = pos;
+    for (MSWNodeId f : layer.friends[pos]) {
+      dist_t d = query->DistanceObjLeft(frozenData_[layer.ids[f]]);
+      if (d < dist) {
+        best = f;
+        dist = d;
+      }
+    }
+    if (best == pos) return pos;
+    pos = best;
+  }
+}
+
+template <typename dist_t>
+template <typename QueryType>
+MSWNodeId Metrized_small_world<dist_t>::getEnterPoint(QueryType* query) const {
+  if (layers_.empty()) return RandomInt() % frozenData_.size();
+
+  MSWNodeId pos = 0;
+  dist_t    dist = query->DistanceObjLeft(frozenData_[layers_.back().ids[0]]);
+  for (size_t l = layers_.size(); l >= 1; --l) {
+    pos = layers_[l - 1].down[descendLayer(layers_[l - 1], query, pos, dist)];
+  }
+  return pos;
+}
+
+/*
+ * The graph is saved as a list of nodes (in the order of ids).
+ * For each node, we save the data object and the ids of its friends.
+ * Then, upper layers of the hierarchy of entry points are saved (if any).
+ */
+template <typename dist_t>
+const string Metrized_small_world<dist_t>::BuildParams() const {
+  std::stringstream str;
+  str << "NN=" << NN_ << ",initIndexAttempts=" << initIndexAttempts_
+      << ",maxDegree=" << maxDegree_ << ",useHierarchy=" << useHierarchy_;
+  return str.str();
+}
+
+template <typename dist_t>
+void Metrized_small_world<dist_t>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+
+  const size_t qty = frozenData_.size();
+  writer.Write<uint64_t>(qty);
+  for (size_t i = 0; i < qty; ++i) {
+    writer.WriteObject(frozenData_[i]);
+    vector<uint64_t> friends(frozenFriends_.begin() + frozenOffsets_[i],
+                             frozenFriends_.begin() + frozenOffsets_[i + 1]);
+    writer.WriteVector(friends);
+  }
+  writer.Write<uint64_t>(layers_.size());
+  for (const MSWLayer& layer : layers_) {
+    writer.WriteVector(layer.ids);
+    writer.WriteVector(layer.down);
+    for (const auto& friends : layer.friends) writer.WriteVector(friends);
+  }
+  writer.Close();
+}
+
+template <typename dist_t>
+void Metrized_small_world<dist_t>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+
+  uint64_t qty;
+  reader.Read(qty);
+  if (qty > data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+
+  ElList.clear();
+  vector<vector<uint64_t>> friends(qty);
+  for (uint64_t i = 0; i < qty; ++i) {
+    ElList.push_back(new MSWNode(reader.ReadObject(), i));
+    reader.ReadVector(friends[i]);
+  }
+  for (uint64_t i = 0; i < qty; ++i) {
+    for (uint64_t f : friends[i]) {
+      if (f >= qty) {
+        LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+      }
+      ElList[i]->addFriend(ElList[f]);
+    }
+  }
+  size_ = qty;
+
+  uint64_t LayerQty;
+  reader.Read(LayerQty);
+  layers_.resize(LayerQty);
+  for (size_t l = 0; l < LayerQty; ++l) {
+    MSWLayer&     layer = layers_[l];
+    const size_t  LowerQty = l ? layers_[l - 1].ids.size() : qty;
+    reader.ReadVector(layer.ids);
+    reader.ReadVector(layer.down);
+    if (layer.ids.empty() || layer.down.size() != layer.ids.size()) {
+      LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+    }
+    layer.friends.resize(layer.ids.size());
+    for (size_t j = 0; j < layer.ids.size(); ++j) {
+      reader.ReadVector(layer.friends[j]);
+      if (layer.ids[j] >= qty || layer.down[j] >= LowerQty ||
+          (l ? layers_[l - 1].ids[layer.down[j]] : layer.down[j]) != layer.ids[j]) {
+        LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+      }
+      for (MSWNodeId f : layer.friends[j]) {
+        if (f >= layer.ids.size()) {
+          LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+        }
+      }
+    }
+  }
+
+  reader.Close();
+
+  freeze();
+}
+
+template <typename dist_t>
+size_t Metrized_small_world<dist_t>::MemoryUsage() const {
+  size_t res = sizeof(*this) + VectorMemoryUsage(ElList);
+  for (const MSWNode* node : ElList) res += node->MemoryUsage();
+  res += VectorMemoryUsage(frozenOffsets_) + VectorMemoryUsage(frozenFriends_) +
+         VectorMemoryUsage(frozenData_) + VectorMemoryUsage(frozenPayload_);
+  for (const MSWLayer& layer : layers_) res += layer.MemoryUsage();
+  return res;
+}
+
+template <typename dist_t>
+MSWNode* Metrized_small_world<dist_t>::getRandomEnterPoint(bool locked)
 {
+	std::unique_lock<std::mutex> lock(ElListGuard_, std::defer_lock);
+	if (locked) lock.lock();
 	int size = ElList.size();
 	if(!ElList.size())
 	{
@@ -68,123 +441,290 @@ MSWNode* Metrized_small_world<dist_t>::getRandomEnterPoint()
 	}
 	else
 	{
-		int num = rand()%size;
+		int num = RandomInt()%size;
 		return ElList[num];
 	}
 }
 
-template <typename dist_t> dist_t Metrized_small_world<dist_t>::getKDistance(const set<EvaluatedMSWNode<dist_t>>& ElementSet, size_t k)
+template <typename dist_t>
+template <typename QueryType>
+void Metrized_small_world<dist_t>::searchOneAttempt(QueryType* query, size_t k, MSWSearchBuffers<dist_t>& buf)
 {
-	if (k >= ElementSet.size()) {
-	  return (*ElementSet.rbegin()).getDistance();
-	}
-	size_t i=0;
-  for (auto el = ElementSet.begin(); el != ElementSet.end(); ++el) {
-	  if (i>=k) return (*el).getDistance();
-		i++;
-	}
-  return 0; // to shut up the compiler
+  vector<EvaluatedMSWNode<dist_t>>& candidates = buf.candidates;
+  vector<EvaluatedMSWNode<dist_t>>& results = buf.results;
+  const std::greater<EvaluatedMSWNode<dist_t>> minHeapCmp;
+
+  candidates.clear();
+  results.clear();
+  buf.visited.Reset(data_.size());
+
+  MSWNode* provider = getRandomEnterPoint(true);
+  buf.visited.Visit(provider->getId());
+
+  EvaluatedMSWNode<dist_t> ev(query->DistanceObjLeft(provider->getData()), provider);
+  candidates.push_back(ev);
+  results.push_back(ev);
+
+  while (!candidates.empty()) {
+    EvaluatedMSWNode<dist_t> currEv = candidates.front();
+    {
+      SEARCH_TRACE_SCOPE(query, kTraceQueue);
+      std::pop_heap(candidates.begin(), candidates.end(), minHeapCmp);
+      candidates.pop_back();
+    }
+    /* 
+     * Check condition for lower bound: the top of the result heap 
+     * is the (k+1)-th closest distance (or the largest one if fewer
+     * than k+1 nodes were evaluated)
+     */
+    if (SEARCH_TRACE_EXPR(query, kTracePruning, currEv.getDistance() > results.front().getDistance())) {
+      break;
+    }
+
+    // Other threads can add friends concurrently
+    currEv.getMSWNode()->copyAllFriends(buf.friends);
+
+    //calculate distance for each element from neighbor
+    for (MSWNode* node : buf.friends) {
+      if (!buf.visited.Visit(node->getId())) continue;
+
+      dist_t d = query->DistanceObjLeft(node->getData());
+      /*
+       * A candidate farther than the current lower bound would stop the search,
+       * because the lower bound never increases: such candidates aren't queued.
+       */
+      if (results.size() <= k || d <= results.front().getDistance()) {
+        SEARCH_TRACE_SCOPE(query, kTraceQueue);
+        candidates.emplace_back(d, node);
+        std::push_heap(candidates.begin(), candidates.end(), minHeapCmp);
+
+        results.emplace_back(d, node);
+        std::push_heap(results.begin(), results.end());
+        if (results.size() > k + 1) {
+          std::pop_heap(results.begin(), results.end());
+          results.pop_back();
+        }
+      }
+    }
+  }
+}
+
+// The distance function reads both the object and its data
+static inline void PrefetchObject(const Object* obj, const char* payload) {
+  PREFETCH(obj);
+  PREFETCH(payload);
 }
 
 template <typename dist_t>
-SearchResult<dist_t>
-Metrized_small_world<dist_t>::kSearchElementsWithAttempts(const Space<dist_t>* space, MSWNode* query, int NN, int initIndexAttempts)
+template <typename GraphType, typename QueryType>
+void Metrized_small_world<dist_t>::searchOneAttemptFrozen(const GraphType& graph, QueryType* query, MSWNodeId provider,
+                                                          size_t k, MSWSearchBuffers<dist_t>& buf)
 {
-	int steps = 0;
-	set <EvaluatedMSWNode<dist_t>> globalViewedSet;
-
-	for (int i=0; i < initIndexAttempts; i++){
-
-		/**
-		 * Search of most k-closest elements to the query.
-		 */
-		MSWNode* provider = getRandomEnterPoint();
-
-		unordered_set<MSWNode*> visitedSet; //The set of elements which has used to extend our view represented by viewedSet
-		set<EvaluatedMSWNode<dist_t>> viewedSet; //The set of all elements which distance was calculated
-		map <MSWNode*, dist_t> viewedMap;
-		set<EvaluatedMSWNode<dist_t>> candidateSet; //the set of elements which we can use to evaluate
-		EvaluatedMSWNode<dist_t> evE1;
-
-		dist_t d = space->IndexTimeDistance(query->getData(), provider->getData());
-		EvaluatedMSWNode<dist_t> ev(d, provider);
-
-		candidateSet.insert(ev);
-		viewedSet.insert(ev);
-		viewedMap.insert(std::pair<MSWNode*, dist_t>(ev.getMSWNode(), ev.getDistance()));
-
-		while(!candidateSet.empty()){
-			auto iter = candidateSet.begin();
-			EvaluatedMSWNode<dist_t> currEv = *iter;
-			candidateSet.erase(iter);
-			dist_t lowerBound = getKDistance(viewedSet, NN);
-			//Check condition for lower bound
-			if (currEv.getDistance() > lowerBound) {
-				break;
-			}
-
-			visitedSet.insert(currEv.getMSWNode());
-			const set<MSWNode*>& neighbor = (currEv.getMSWNode())->getAllFriends();
-
-			//synchronized
-			//calculate distance for each element from neighbor
-			for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter){
-				if (viewedMap.find(*iter) == viewedMap.end()){
-					d = space->IndexTimeDistance(query->getData(), (*iter)->getData());
-					EvaluatedMSWNode<dist_t> evE1(d, *iter);
-					viewedMap.insert(std::pair<MSWNode*, dist_t>((*iter), evE1.getDistance()));
-					viewedSet.insert(evE1);
-					candidateSet.insert(evE1);
-				}
-			}
-
-		}
-
-		globalViewedSet.insert(viewedSet.begin(), viewedSet.end());
-		steps = steps + visitedSet.size();
-	}
+  typedef std::pair<dist_t, MSWNodeId> EvaluatedId;
+  vector<EvaluatedId>& candidates = buf.idCandidates;
+  vector<EvaluatedId>& results = buf.idResults;
+  const std::greater<EvaluatedId> minHeapCmp;
+
+  candidates.clear();
+  results.clear();
+  buf.visited.Reset(graph.size());
+  buf.visited.Visit(provider);
+
+  EvaluatedId ev(query->DistanceObjLeft(graph.object(provider)), provider);
+  candidates.push_back(ev);
+  results.push_back(ev);
+
+  while (!candidates.empty()) {
+    const EvaluatedId currEv = candidates.front();
+    {
+      SEARCH_TRACE_SCOPE(query, kTraceQueue);
+      std::pop_heap(candidates.begin(), candidates.end(), minHeapCmp);
+      candidates.pop_back();
+    }
+
+    if (SEARCH_TRACE_EXPR(query, kTracePruning, currEv.first > results.front().first)) {
+      break;
+    }
+
+    const MSWNodeId* friends = graph.friendsBegin(currEv.second);
+    const MSWNodeId* friendsEnd = graph.friendsEnd(currEv.second);
+    if (friends < friendsEnd) PrefetchObject(graph.object(*friends), graph.payload(*friends));
+
+    for (; friends < friendsEnd; ++friends) {
+      // Let's load the next friend while computing the distance to the current one
+      if (friends + 1 < friendsEnd) PrefetchObject(graph.object(friends[1]), graph.payload(friends[1]));
+      const MSWNodeId id = *friends;
+      if (!buf.visited.Visit(id)) continue;
+
+      dist_t d = query->DistanceObjLeft(graph.object(id));
+      if (results.size() <= k || d <= results.front().first) {
+        SEARCH_TRACE_SCOPE(query, kTraceQueue);
+        candidates.emplace_back(d, id);
+        std::push_heap(candidates.begin(), candidates.end(), minHeapCmp);
+
+        results.emplace_back(d, id);
+        std::push_heap(results.begin(), results.end());
+        if (results.size() > k + 1) {
+          std::pop_heap(results.begin(), results.end());
+          results.pop_back();
+        }
+      }
+    }
+  }
+}
+
+template <typename dist_t>
+void Metrized_small_world<dist_t>::selectClosest(size_t k, MSWSearchBuffers<dist_t>& buf, 
+                                                 vector<EvaluatedMSWNode<dist_t>>& res)
+{
+  vector<EvaluatedMSWNode<dist_t>>& found = buf.found;
+  // The same node can be found by several attempts
+  std::sort(found.begin(), found.end(), 
+            [](const EvaluatedMSWNode<dist_t>& a, const EvaluatedMSWNode<dist_t>& b) {
+              return a.getDistance() < b.getDistance() ||
+                     (a.getDistance() == b.getDistance() && a.getMSWNode()->getId() < b.getMSWNode()->getId());
+            });
+  res.clear();
+  for (size_t i = 0; i < found.size() && res.size() < k; ++i) {
+    if (i && found[i].getMSWNode() == found[i-1].getMSWNode()) continue;
+    res.push_back(found[i]);
+  }
+}
+
+template <typename dist_t>
+void
+Metrized_small_world<dist_t>::kSearchElementsWithAttempts(const Space<dist_t>* space, MSWNode* query, size_t NN, int initIndexAttempts,
+                                                          vector<EvaluatedMSWNode<dist_t>>& res)
+{
+  MSWSearchBuffers<dist_t>&     buf = MSWSearchBuffers<dist_t>::ThreadLocal();
+  MSWIndexTimeQuery<dist_t>     IndexQuery(space, query->getData());
 
-  SearchResult<dist_t> Result(globalViewedSet, steps);
-  return Result;
+  buf.found.clear();
+  for (int i=0; i < initIndexAttempts; i++){
+    searchOneAttempt(&IndexQuery, NN, buf);
+    buf.found.insert(buf.found.end(), buf.results.begin(), buf.results.end());
+  }
+  selectClosest(NN, buf, res);
 }
 
 template <typename dist_t>
 void Metrized_small_world<dist_t>::add(const Space<dist_t>* space, MSWNode *newElement){
 
-	int linkCount = 0;
-	MSWNode* enterPoint = getRandomEnterPoint();
+	MSWNode* enterPoint = getRandomEnterPoint(true);
 	newElement->removeAllFriends(); 		//отсебятина, в исходном коде не было.
 
 	if(enterPoint == NULL){
+		std::unique_lock<std::mutex> lock(ElListGuard_);
 		ElList.push_back(newElement);
 		incSize();
 		return;
 	}
 
-	SearchResult<dist_t> sr = kSearchElementsWithAttempts(space, newElement, NN_, initIndexAttempts_);
-
-	int i = 0;
-	const set <EvaluatedMSWNode<dist_t>>& viewed = sr.getViewedList();
-	for (auto ee = viewed.begin(); ee != viewed.end(); ++ee) {
-		if (i >= NN_) break;
-		i ++;
-		MSWNode* el = (*ee).getMSWNode();
-		const set<MSWNode*>& vec = newElement->getAllFriends();
-		if (vec.find(el) == vec.end())
-		{
-			link(((*ee).getMSWNode()), newElement);
-			linkCount++;
-		}
+	vector<EvaluatedMSWNode<dist_t>> viewed;
+	kSearchElementsWithAttempts(space, newElement, NN_, initIndexAttempts_, viewed);
+
+	for (const auto& ee : viewed) {
+		link(space, ee.getMSWNode(), newElement);
 	}
 
+	std::unique_lock<std::mutex> lock(ElListGuard_);
 	ElList.push_back(newElement);
 	incSize();
 }
 
+/*
+ * Each of initSearchAttempts_ attempts greedily descends from a random enter point
+ * until it gets into the query ball (or reaches a local minimum). Then, the ball is
+ * explored in the breadth-first order. Nodes found by previous attempts aren't
+ * evaluated again, in particular, an attempt ends immediately if it descends into
+ * an already explored part of the ball.
+ */
 template <typename dist_t>
 void Metrized_small_world<dist_t>::Search(RangeQuery<dist_t>* query) {
-  //GenSearch(query);
-
+  if (frozenData_.empty()) return;
+
+  MSWSearchBuffers<dist_t>&           buf = MSWSearchBuffers<dist_t>::ThreadLocal();
+  vector<std::pair<MSWNodeId, int>>&  queue = buf.rangeQueue;
+  vector<dist_t>&                     dists = buf.rangeDists;
+  const dist_t                        radius = query->Radius();
+
+  buf.visited.Reset(frozenData_.size());
+  buf.rangeExpanded.Reset(frozenData_.size());
+  if (dists.size() < frozenData_.size()) dists.resize(frozenData_.size());
+
+  /*
+   * Each node is evaluated at most once: if the node was visited before, its distance
+   * is taken from dists. A newly evaluated node in the query ball is added to the result.
+   */
+  auto evaluate = [&](MSWNodeId id) -> dist_t {
+    if (!buf.visited.Visit(id)) return dists[id];
+    const dist_t d = query->DistanceObjLeft(frozenData_[id]);
+    dists[id] = d;
+    if (d <= radius) query->CheckAndAddToResult(d, frozenData_[id]);
+    return d;
+  };
+  /*
+   * Each node is expanded at most once. A node evaluated outside the ball
+   * (e.g., during a greedy descent) is expanded when it's reached within
+   * rangeExpandHops_ hops from the ball.
+   */
+  auto expand = [&](MSWNodeId id, int hops) {
+    if (!buf.rangeExpanded.Visit(id)) return;
+    SEARCH_TRACE_SCOPE(query, kTraceQueue);
+    queue.emplace_back(id, hops);
+  };
+
+  for (int i = 0; i < initSearchAttempts_; i++) {
+    queue.clear();
+    // Only the first attempt starts from the hierarchy of entry points
+    MSWNodeId curr = i ? RandomInt() % frozenData_.size() : getEnterPoint(query);
+    dist_t    currDist = evaluate(curr);
+    if (currDist <= radius) expand(curr, 0);
+
+    // Greedy descent: move to the closest friend while it is closer than the current node
+    while (currDist > radius) {
+      MSWNodeId best = curr;
+      dist_t    bestDist = currDist;
+      const MSWNodeId* friends = frozenFriends_.data() + frozenOffsets_[curr];
+      const MSWNodeId* friendsEnd = frozenFriends_.data() + frozenOffsets_[curr + 1];
+      for (; friends < friendsEnd; ++friends) {
+        if (friends + 1 < friendsEnd) PrefetchObject(frozenData_[friends[1]], frozenPayload_[friends[1]]);
+        dist_t d = evaluate(*friends);
+        if (d <= radius) expand(*friends, 0);
+        if (d < bestDist) {
+          best = *friends;
+          bestDist = d;
+        }
+      }
+      if (best == curr) break;
+      curr = best;
+      currDist = bestDist;
+    }
+
+    /*
+     * If no nodes in the ball are left to expand, either the descent came to the part
+     * of the ball expanded before, or it stopped outside the ball: then, the closest
+     * node is one hop away from the ball.
+     */
+    if (queue.empty()) {
+      if (currDist <= radius || rangeExpandHops_ < 1) continue;
+      expand(curr, 1);
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+      const std::pair<MSWNodeId, int> currQ = queue[head];
+      const MSWNodeId* friends = frozenFriends_.data() + frozenOffsets_[currQ.first];
+      const MSWNodeId* friendsEnd = frozenFriends_.data() + frozenOffsets_[currQ.first + 1];
+      for (; friends < friendsEnd; ++friends) {
+        if (friends + 1 < friendsEnd) PrefetchObject(frozenData_[friends[1]], frozenPayload_[friends[1]]);
+        const MSWNodeId id = *friends;
+        const dist_t d = evaluate(id);
+        const int h = d <= radius ? 0 : currQ.second + 1;
+        if (SEARCH_TRACE_EXPR(query, kTracePruning, h > rangeExpandHops_)) continue;
+        expand(id, h);
+      }
+    }
+  }
 }
 
 template <typename dist_t>
@@ -196,93 +736,32 @@ void Metrized_small_world<dist_t>::Search(KNNQuery<dist_t>* query) {
 template <typename dist_t>
 template <typename QueryType>
 void Metrized_small_world<dist_t>::GenSearch(QueryType* query){
-/*
-	MSWNode *Node;
-	dist_t d1 =0 ,d2 = 100;
-	int i =0;
-
-	for (auto iter = ElList.begin(); iter != ElList.end(); iter++)
-	{
-		d1 = query->DistanceObjLeft((*iter)->getData());
+  if (frozenData_.empty()) return;
 
-		if (d1 < d2 && d1 > 0)
-		{
-			d2 = d1;
-			Node = *iter;
-		}
+  MSWSearchBuffers<dist_t>& buf = MSWSearchBuffers<dist_t>::ThreadLocal();
+  const size_t k = query->GetK();
+  const size_t ef = std::max(k, size_t(std::max(efSearch_, 0)));
+  vector<std::pair<dist_t, MSWNodeId>>& found = buf.idFound;
 
-	}
-*/
-
-//	query->CheckAndAddToResult(Node->getData());
-
-	int steps = 0;
-	int k = query->GetK();
-	set <EvaluatedMSWNode<dist_t>> globalViewedSet;
-
-	for (int i=0; i < initSearchAttempts_; i++){
-
-	/**
-	 * Search of most k-closest elements to the query.
-	 */
-	    MSWNode* provider = getRandomEnterPoint();
-
-			unordered_set<MSWNode*> visitedSet; //The set of elements which has used to extend our view represented by viewedSet
-			set<EvaluatedMSWNode<dist_t>> viewedSet; //The set of all elements which distance was calculated
-			map <MSWNode*, dist_t> viewedMap;
-			set<EvaluatedMSWNode<dist_t>> candidateSet; //the set of elements which we can use to evaluate
-			EvaluatedMSWNode<dist_t> evE1;
-
-			dist_t d = query->DistanceObjLeft(provider->getData());
-			EvaluatedMSWNode<dist_t> ev(d, provider);
-
-			candidateSet.insert(ev);
-			viewedSet.insert(ev);
-			viewedMap.insert(std::pair<MSWNode*, dist_t>(ev.getMSWNode(), ev.getDistance()));
-
-			while(!candidateSet.empty()){
-				auto iter = candidateSet.begin();
-				EvaluatedMSWNode<dist_t> currEv = *iter;
-				candidateSet.erase(iter);
-				dist_t lowerBound = getKDistance(viewedSet, k);
-				//Check condition for lower bound
-				if (currEv.getDistance() > lowerBound) {
-					break;
-				}
-
-				visitedSet.insert(currEv.getMSWNode());
-				const set<MSWNode*>& neighbor = (currEv.getMSWNode())->getAllFriends();
-
-				//synchronized
-				//calculate distance for each element from neighbor
-				for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter){
-					if (viewedMap.find(*iter) == viewedMap.end()){
-						d = query->DistanceObjLeft((*iter)->getData());
-						EvaluatedMSWNode<dist_t> evE1(d, *iter);
-						viewedMap.insert(std::pair<MSWNode*, dist_t>((*iter), evE1.getDistance()));
-						viewedSet.insert(evE1);
-						candidateSet.insert(evE1);
-					}
-				}
-
-			}
-
-			globalViewedSet.insert(viewedSet.begin(), viewedSet.end());
-			steps = steps + visitedSet.size();
-		}
-
-		auto iter = globalViewedSet.begin();
-		//MSWNode* v =  (*iter).getMSWNode();
-		//dist_t d = query->DistanceObjLeft(((*iter).getMSWNode())->getData());
-
-		while(k && iter != globalViewedSet.end()){
-			query->CheckAndAddToResult(iter->getDistance(), iter->getMSWNode()->getData());
-			iter++;
-			k--;
-		}
-	}
+  const MSWFrozenGraph graph(frozenOffsets_, frozenFriends_, frozenData_, frozenPayload_);
 
+  found.clear();
+  for (int i=0; i < initSearchAttempts_; i++){
+    // Only the first attempt starts from the hierarchy of entry points
+    MSWNodeId provider = i ? RandomInt() % frozenData_.size() : getEnterPoint(query);
+    searchOneAttemptFrozen(graph, query, provider, ef, buf);
+    found.insert(found.end(), buf.idResults.begin(), buf.idResults.end());
+  }
 
+  // The same node can be found by several attempts
+  std::sort(found.begin(), found.end());
+  size_t ResQty = 0;
+  for (size_t i = 0; i < found.size() && ResQty < k; ++i) {
+    if (i && found[i].second == found[i-1].second) continue;
+    query->CheckAndAddToResult(found[i].first, frozenData_[found[i].second]);
+    ++ResQty;
+  }
+}
 
 template class Metrized_small_world<float>;
 template class Metrized_small_world<double>;
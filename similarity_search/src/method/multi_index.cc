@@ -72,6 +72,13 @@ const std::string MultiIndex<dist_t>::ToString() const {
   return str.str();
 }
 
+template <typename dist_t>
+size_t MultiIndex<dist_t>::MemoryUsage() const {
+  size_t res = sizeof(*this) + VectorMemoryUsage(indices_);
+  for (const auto& index : indices_) res += index->MemoryUsage();
+  return res;
+}
+
 template <typename dist_t>
 void MultiIndex<dist_t>::Search(RangeQuery<dist_t>* query) {
   /* 
@@ -109,17 +116,16 @@ void MultiIndex<dist_t>::Search(KNNQuery<dist_t>* query) {
     KNNQuery<dist_t> TmpRes(space_, query->QueryObject(), query->GetK(), query->GetEPS());
 
     indices_[i]->Search(&TmpRes);
-    unique_ptr<KNNQueue<dist_t>> ResQ(TmpRes.Result()->Clone());
+    const KNNQueue<dist_t>* ResQ = TmpRes.Result();
 
     query->AddDistanceComputations(TmpRes.DistanceComputations());
-    while(!ResQ->Empty()) {
-      const Object* obj = reinterpret_cast<const Object*>(ResQ->TopObject());
+    for (auto it = ResQ->SortedBegin(); it != ResQ->SortedEnd(); ++it) {
+      const Object* obj = reinterpret_cast<const Object*>(it->second);
 
       if (!found.count(obj->id())) {
-        query->CheckAndAddToResult(ResQ->TopDistance(), obj);
+        query->CheckAndAddToResult(it->first, obj);
         found.insert(obj->id());
       }
-      ResQ->Pop();
     }
   }
 }
@@ -65,6 +65,11 @@ const std::string MultiVantagePointTree<dist_t>::ToString() const {
   return "multi vantage point tree";
 }
 
+template <typename dist_t>
+size_t MultiVantagePointTree<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + (root_ != NULL ? root_->MemoryUsage() : 0);
+}
+
 template <typename dist_t>
 typename MultiVantagePointTree<dist_t>::Node*
 MultiVantagePointTree<dist_t>::BuildTree(
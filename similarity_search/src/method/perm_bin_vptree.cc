@@ -35,21 +35,25 @@ template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*,
 PermBinVPTree<dist_t, RankCorrelDistFunc>::PermBinVPTree(
     const Space<dist_t>* space,
     const ObjectVector& data,
-    const AnyParams& AllParams) : 
+    const AnyParams& AllParams,
+    bool BuildIndex) : 
       space_(space), data_(data),   // reference
       VPTreeSpace_(new SpaceBitHamming())
 {
   AnyParamManager pmgr(AllParams);
 
   double        DbScanFrac   = 0.05;
-  size_t        NumPivot     = 16;
+  num_pivot_     = 16;
   bin_threshold_ = 8;
 
   pmgr.GetParamOptional("dbScanFrac", DbScanFrac);
-  pmgr.GetParamOptional("numPivot", NumPivot);
+  pmgr.GetParamOptional("numPivot", num_pivot_);
   pmgr.GetParamOptional("binThreshold", bin_threshold_);
+  // This parameter is also used by the VP-tree
+  size_t        IndexThreadQty = TaskPool::DefaultThreadQty();
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
 
-  bin_perm_word_qty_ = (NumPivot + 31)/32;
+  bin_perm_word_qty_ = (num_pivot_ + 31)/32;
 
   if (DbScanFrac < 0.0 || DbScanFrac > 1.0) {
     LOG(FATAL) << METH_PERM_BIN_VPTREE << " requires that dbScanFrac is in the range [0,1]";
@@ -57,7 +61,7 @@ PermBinVPTree<dist_t, RankCorrelDistFunc>::PermBinVPTree(
 
   AnyParams RemainParams;
 
-  LOG(INFO) << "# pivots                  = " << NumPivot;
+  LOG(INFO) << "# pivots                  = " << num_pivot_;
   LOG(INFO) << "# binarization threshold = "  << bin_threshold_;
   LOG(INFO) << "# binary entry size (words) = "  << bin_perm_word_qty_;
   LOG(INFO) << "db scan fraction = " << DbScanFrac;
@@ -77,20 +81,37 @@ PermBinVPTree<dist_t, RankCorrelDistFunc>::PermBinVPTree(
                         });
 
   // db_can_qty_ should always be > 0
-  db_scan_qty_ = max(size_t(1), static_cast<size_t>(DbScanFrac * data.size())),
-  GetPermutationPivot(data, space, NumPivot, &pivots_);
+  db_scan_qty_ = max(size_t(1), static_cast<size_t>(DbScanFrac * data.size()));
+
+  TriangIneqCreator<int> OracleCreator(AlphaLeft, AlphaRight);
+
+  if (!BuildIndex) {
+    // Pivots, binarized permutations, and the VP-tree are loaded by Load()
+    VPTreeIndex_ = new VPTree<int, TriangIneq<int>,
+                              TriangIneqCreator<int> >(
+                                            true,
+                                            OracleCreator,
+                                            VPTreeSpace_,
+                                            BinPermData_,
+                                            RemainParams,
+                                            true /* use random center */,
+                                            false
+                                      );
+    return;
+  }
+
+  GetPermutationPivot(data, space, num_pivot_, &pivots_);
   BinPermData_.resize(data.size());
 
-  for (size_t i = 0; i < data.size(); ++i) {
+  TaskPool pool(IndexThreadQty);
+  pool.ParallelFor(0, data.size(), 256, [&](size_t i) {
     Permutation TmpPerm;
     GetPermutation(pivots_, space_, data[i], &TmpPerm);
     vector<uint32_t>  binPivot;
     Binarize(TmpPerm, bin_threshold_, binPivot);
     CHECK(binPivot.size() == bin_perm_word_qty_);
     BinPermData_[i] = VPTreeSpace_->CreateObjFromVect(i, binPivot);
-  }
-
-  TriangIneqCreator<int> OracleCreator(AlphaLeft, AlphaRight);
+  });
 
   ReportIntrinsicDimensionality("Set of permutations" , *VPTreeSpace_, BinPermData_);
 
@@ -107,8 +128,8 @@ PermBinVPTree<dist_t, RankCorrelDistFunc>::PermBinVPTree(
 
 template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
 PermBinVPTree<dist_t, RankCorrelDistFunc>::~PermBinVPTree() {
-  for (size_t i = 0; i < data_.size(); ++i) {
-    delete BinPermData_[i];
+  for (const Object* obj : BinPermData_) {
+    delete obj;
   }
   delete VPTreeIndex_;
   delete VPTreeSpace_;
@@ -121,6 +142,57 @@ const std::string PermBinVPTree<dist_t, RankCorrelDistFunc>::ToString() const {
   return str.str();
 }
 
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+const string PermBinVPTree<dist_t, RankCorrelDistFunc>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_ << ",binThreshold=" << bin_threshold_ << "," << VPTreeIndex_->BuildParams();
+  return str.str();
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermBinVPTree<dist_t, RankCorrelDistFunc>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivots_);
+  writer.Write<uint64_t>(BinPermData_.size());
+  for (const Object* obj : BinPermData_) writer.WriteObjectCopy(obj);
+  writer.Close();
+
+  VPTreeIndex_->Save(location + ".vptree");
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermBinVPTree<dist_t, RankCorrelDistFunc>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivots_);
+  if (pivots_.size() != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivots_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+  uint64_t qty;
+  reader.Read(qty);
+  if (qty != data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+  for (const Object* obj : BinPermData_) delete obj;
+  BinPermData_.resize(qty);
+  for (const Object*& obj : BinPermData_) {
+    obj = reader.ReadObjectCopy();
+    if (obj->datalength() != bin_perm_word_qty_ * sizeof(uint32_t)) {
+      LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+    }
+  }
+  reader.Close();
+
+  VPTreeIndex_->Load(location + ".vptree");
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+size_t PermBinVPTree<dist_t, RankCorrelDistFunc>::MemoryUsage() const {
+  // Binarized permutations are indexed by the VP-tree as data objects
+  return sizeof(*this) + VectorMemoryUsage(pivots_) + ObjectsMemoryUsage(BinPermData_) +
+         VPTreeIndex_->MemoryUsage();
+}
+
 template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
 void PermBinVPTree<dist_t, RankCorrelDistFunc>::Search(RangeQuery<dist_t>* query) {
   Permutation perm_q;
@@ -136,12 +208,11 @@ void PermBinVPTree<dist_t, RankCorrelDistFunc>::Search(RangeQuery<dist_t>* query
 
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-  unique_ptr<KNNQueue<int>> ResQueue(VPTreeQuery->Result()->Clone());
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -160,12 +231,11 @@ void PermBinVPTree<dist_t, RankCorrelDistFunc>::Search(KNNQuery<dist_t>* query)
 
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-  unique_ptr<KNNQueue<int>> ResQueue(VPTreeQuery->Result()->Clone());
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -32,14 +32,23 @@ PermutationIndexIncrementalBin<dist_t, perm_func>::PermutationIndexIncrementalBi
     const ObjectVector& data,
     const size_t num_pivot,
     const size_t bin_threshold,
-    const double db_scan_fraction)
+    const double db_scan_fraction,
+    bool BuildIndex)
     : data_(data),   // reference
+      num_pivot_(num_pivot),
       bin_threshold_(bin_threshold),
       db_scan_(static_cast<size_t>(db_scan_fraction * data.size())),
       bin_perm_word_qty_((num_pivot + 31)/32) {
   CHECK(db_scan_fraction > 0.0);
   CHECK(db_scan_fraction <= 1.0);
 
+  LOG(INFO) << "# pivots                  = " << num_pivot;
+  LOG(INFO) << "# binarization threshold = "  << bin_threshold_;
+  LOG(INFO) << "# binary entry size (words) = "  << bin_perm_word_qty_;
+  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
+
+  if (!BuildIndex) return;
+
   GetPermutationPivot(data, space, num_pivot, &pivot_);
 
   permtable_.resize(data.size() * bin_perm_word_qty_);
@@ -54,13 +63,43 @@ PermutationIndexIncrementalBin<dist_t, perm_func>::PermutationIndexIncrementalBi
     memcpy(&permtable_[start], &binPivot[0], bin_perm_word_qty_ * sizeof(binPivot[0]));
   }
 
-  LOG(INFO) << "# pivots                  = " << num_pivot;
-  LOG(INFO) << "# binarization threshold = "  << bin_threshold_;
-  LOG(INFO) << "# binary entry size (words) = "  << bin_perm_word_qty_;
-  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
   //SavePermTable(permtable_, "permtab");
 }
 
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+const string PermutationIndexIncrementalBin<dist_t, perm_func>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_ << ",binThreshold=" << bin_threshold_;
+  return str.str();
+}
+
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationIndexIncrementalBin<dist_t, perm_func>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.Write<uint64_t>(bin_threshold_);
+  writer.WriteObjectVector(pivot_);
+  writer.WriteVector(permtable_);
+  writer.Close();
+}
+
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationIndexIncrementalBin<dist_t, perm_func>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  uint64_t bin_threshold;
+  reader.Read(bin_threshold);
+  reader.ReadObjectVector(pivot_);
+  if (pivot_.size() != num_pivot_ || bin_threshold != bin_threshold_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivot_.size()
+               << " pivots and the binarization threshold " << bin_threshold
+               << ", but the current values are " << num_pivot_ << " and " << bin_threshold_;
+  }
+  reader.ReadVector(permtable_);
+  if (permtable_.size() != data_.size() * bin_perm_word_qty_) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+  reader.Close();
+}
+
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
 PermutationIndexIncrementalBin<dist_t, perm_func>::~PermutationIndexIncrementalBin() {
 }
@@ -72,6 +111,11 @@ const std::string PermutationIndexIncrementalBin<dist_t, perm_func>::ToString()
   return str.str();
 }
 
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+size_t PermutationIndexIncrementalBin<dist_t, perm_func>::MemoryUsage() const {
+  return sizeof(*this) + VectorMemoryUsage(pivot_) + VectorMemoryUsage(permtable_);
+}
+
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)> 
 template <typename QueryType>
 void PermutationIndexIncrementalBin<dist_t, perm_func>::GenSearch(QueryType* query) {
@@ -88,11 +132,15 @@ void PermutationIndexIncrementalBin<dist_t, perm_func>::GenSearch(QueryType* que
   }
 
   IncrementalQuickSelect<IntInt> quick_select(perm_dists);
+  // Candidates are checked in batches (let's not allocate memory for each query)
+  static thread_local ObjectVector candidates;
+  candidates.clear();
   for (size_t i = 0; i < db_scan_; ++i) {
     const size_t idx = quick_select.GetNext().second;
     quick_select.Next();
-    query->CheckAndAddToResult(data_[idx]);
+    candidates.push_back(data_[idx]);
   }
+  query->CheckAndAddToResult(candidates);
 }
 
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
@@ -31,20 +31,63 @@ PermutationIndex<dist_t>::PermutationIndex(
     const ObjectVector& data,
     const size_t num_pivot,
     const double db_scan_fraction,
-    const IntDistFuncPtr permfunc)
+    const IntDistFuncPtr permfunc,
+    bool BuildIndex)
     : data_(data),   // reference
       db_scan_(static_cast<size_t>(db_scan_fraction * data.size())),
-      permfunc_(permfunc) {
+      permfunc_(permfunc),
+      num_pivot_(num_pivot) {
   CHECK(db_scan_fraction > 0.0);
   CHECK(db_scan_fraction <= 1.0);
   CHECK(permfunc != NULL);
+  LOG(INFO) << "# pivots         = " << num_pivot;
+  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
+
+  if (!BuildIndex) return;
+
   GetPermutationPivot(data, space, num_pivot, &pivot_);
   permtable_.resize(data.size());
   for (size_t i = 0; i < data.size(); ++i) {
     GetPermutation(pivot_, space, data[i], &permtable_[i]);
   }
-  LOG(INFO) << "# pivots         = " << num_pivot;
-  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
+}
+
+template <typename dist_t>
+const string PermutationIndex<dist_t>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_;
+  return str.str();
+}
+
+template <typename dist_t>
+void PermutationIndex<dist_t>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivot_);
+  writer.Write<uint64_t>(permtable_.size());
+  for (const auto& perm : permtable_) {
+    writer.WriteVector(perm);
+  }
+  writer.Close();
+}
+
+template <typename dist_t>
+void PermutationIndex<dist_t>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivot_);
+  if (pivot_.size() != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivot_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+  uint64_t qty;
+  reader.Read(qty);
+  if (qty != data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+  permtable_.resize(qty);
+  for (auto& perm : permtable_) {
+    reader.ReadVector(perm);
+  }
+  reader.Close();
 }
 
 template <typename dist_t>
@@ -58,6 +101,11 @@ const std::string PermutationIndex<dist_t>::ToString() const {
   return str.str();
 }
 
+template <typename dist_t>
+size_t PermutationIndex<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + VectorMemoryUsage(pivot_) + VectorMemoryUsage(permtable_);
+}
+
 template <typename dist_t> 
 template <typename QueryType>
 void PermutationIndex<dist_t>::GenSearch(QueryType* query) {
@@ -68,10 +116,14 @@ void PermutationIndex<dist_t>::GenSearch(QueryType* query) {
       perm_dists.push_back(std::make_pair((*permfunc_)(&permtable_[i][0], &perm_q[0], perm_q.size()), i)); 
     }
     std::sort(perm_dists.begin(), perm_dists.end());
+    // Candidates are checked in batches (let's not allocate memory for each query)
+    static thread_local ObjectVector candidates;
+    candidates.clear();
     for (size_t i = 0; i < db_scan_; ++i) {
       const size_t idx = perm_dists[i].second;
-      query->CheckAndAddToResult(data_[idx]);
+      candidates.push_back(data_[idx]);
     }
+    query->CheckAndAddToResult(candidates);
 }
 
 template <typename dist_t>
@@ -31,11 +31,18 @@ PermutationIndexIncremental<dist_t, perm_func>::PermutationIndexIncremental(
     const Space<dist_t>* space,
     const ObjectVector& data,
     const size_t num_pivot,
-    const double db_scan_fraction)
+    const double db_scan_fraction,
+    bool BuildIndex)
     : data_(data),   // reference
-      db_scan_(static_cast<size_t>(db_scan_fraction * data.size())) {
+      db_scan_(static_cast<size_t>(db_scan_fraction * data.size())),
+      num_pivot_(num_pivot) {
   CHECK(db_scan_fraction > 0.0);
   CHECK(db_scan_fraction <= 1.0);
+  LOG(INFO) << "# pivots         = " << num_pivot;
+  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
+
+  if (!BuildIndex) return;
+
   GetPermutationPivot(data, space, num_pivot, &pivot_);
 #ifdef CONTIGUOUS_STORAGE
   permtable_.resize(data.size() * num_pivot);
@@ -52,11 +59,58 @@ PermutationIndexIncremental<dist_t, perm_func>::PermutationIndexIncremental(
     GetPermutation(pivot_, space, data[i], &permtable_[i]);
   }
 #endif
-  LOG(INFO) << "# pivots         = " << num_pivot;
-  LOG(INFO) << "db scan fraction = " << db_scan_fraction;
   //SavePermTable(permtable_, "permtab");
 }
 
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+const string PermutationIndexIncremental<dist_t, perm_func>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_;
+  return str.str();
+}
+
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationIndexIncremental<dist_t, perm_func>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivot_);
+#ifdef CONTIGUOUS_STORAGE
+  writer.WriteVector(permtable_);
+#else
+  writer.Write<uint64_t>(permtable_.size());
+  for (const auto& perm : permtable_) {
+    writer.WriteVector(perm);
+  }
+#endif
+  writer.Close();
+}
+
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationIndexIncremental<dist_t, perm_func>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivot_);
+  if (pivot_.size() != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivot_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+#ifdef CONTIGUOUS_STORAGE
+  reader.ReadVector(permtable_);
+  if (permtable_.size() != data_.size() * num_pivot_) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+#else
+  uint64_t qty;
+  reader.Read(qty);
+  if (qty != data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+  permtable_.resize(qty);
+  for (auto& perm : permtable_) {
+    reader.ReadVector(perm);
+  }
+#endif
+  reader.Close();
+}
+
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
 PermutationIndexIncremental<dist_t, perm_func>::~PermutationIndexIncremental() {
 }
@@ -68,6 +122,11 @@ const std::string PermutationIndexIncremental<dist_t, perm_func>::ToString() con
   return str.str();
 }
 
+template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
+size_t PermutationIndexIncremental<dist_t, perm_func>::MemoryUsage() const {
+  return sizeof(*this) + VectorMemoryUsage(pivot_) + VectorMemoryUsage(permtable_);
+}
+
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)> 
 template <typename QueryType>
 void PermutationIndexIncremental<dist_t, perm_func>::GenSearch(QueryType* query) {
@@ -88,11 +147,15 @@ void PermutationIndexIncremental<dist_t, perm_func>::GenSearch(QueryType* query)
   }
 #endif
   IncrementalQuickSelect<IntInt> quick_select(perm_dists);
+  // Candidates are checked in batches (let's not allocate memory for each query)
+  static thread_local ObjectVector candidates;
+  candidates.clear();
   for (size_t i = 0; i < db_scan_; ++i) {
     const size_t idx = quick_select.GetNext().second;
     quick_select.Next();
-    query->CheckAndAddToResult(data_[idx]);
+    candidates.push_back(data_[idx]);
   }
+  query->CheckAndAddToResult(candidates);
 }
 
 template <typename dist_t, PivotIdType (*perm_func)(const PivotIdType*, const PivotIdType*, size_t)>
@@ -37,9 +37,11 @@ PermutationInvertedIndex<dist_t>::PermutationInvertedIndex(
     const size_t num_pivot_index,
     const size_t num_pivot_search,
     const size_t max_pos_diff,
-    const double db_scan_fraction)
+    const double db_scan_fraction,
+    bool BuildIndex)
     : data_(data),   // reference
       db_scan_(static_cast<size_t>(db_scan_fraction * data.size())),
+      num_pivot_(num_pivot),
       num_pivot_index_(min(num_pivot_index, num_pivot_search + max_pos_diff)),
       num_pivot_search_(num_pivot_search),
       max_pos_diff_(max_pos_diff) {
@@ -52,6 +54,8 @@ PermutationInvertedIndex<dist_t>::PermutationInvertedIndex(
   LOG(INFO) << "# pivots search (ks) = " << num_pivot_search_;
   LOG(INFO) << "# max position difference = " << max_pos_diff_;
 
+  if (!BuildIndex) return;
+
   GetPermutationPivot(data, space, num_pivot, &pivot_);
 
   posting_lists_.resize(num_pivot);
@@ -75,6 +79,64 @@ template <typename dist_t>
 PermutationInvertedIndex<dist_t>::~PermutationInvertedIndex() {
 }
 
+/*
+ * Only the effective number of indexed pivots (ki) affects posting lists,
+ * ks and the maximum position difference are used only during search.
+ */
+template <typename dist_t>
+const string PermutationInvertedIndex<dist_t>::BuildParams() const {
+  stringstream str;
+  str << "numPivot=" << num_pivot_ << ",numPivotIndex=" << num_pivot_index_;
+  return str.str();
+}
+
+template <typename dist_t>
+void PermutationInvertedIndex<dist_t>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivot_);
+  writer.Write<uint64_t>(posting_lists_.size());
+  for (const PostingList& PostList : posting_lists_) {
+    writer.Write<uint64_t>(PostList.size());
+    for (const ObjectInvEntry& e : PostList) {
+      writer.Write(e.id_);
+      writer.Write(e.pos_);
+    }
+  }
+  writer.Close();
+}
+
+template <typename dist_t>
+void PermutationInvertedIndex<dist_t>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivot_);
+  uint64_t qty;
+  reader.Read(qty);
+  if (pivot_.size() != num_pivot_ || qty != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivot_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+  posting_lists_.clear();
+  posting_lists_.resize(qty);
+  for (PostingList& PostList : posting_lists_) {
+    reader.Read(qty);
+    if (qty > data_.size()) {
+      LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+    }
+    PostList.reserve(qty);
+    for (size_t i = 0; i < qty; ++i) {
+      IdType  id;
+      int     pos;
+      reader.Read(id);
+      reader.Read(pos);
+      if (id >= data_.size()) {
+        LOG(FATAL) << "The index file is corrupt: '" << location << "' (invalid object position: " << id << ")";
+      }
+      PostList.push_back(ObjectInvEntry(id, pos));
+    }
+  }
+  reader.Close();
+}
+
 template <typename dist_t>
 const string PermutationInvertedIndex<dist_t>::ToString() const {
   stringstream str;
@@ -82,6 +144,11 @@ const string PermutationInvertedIndex<dist_t>::ToString() const {
   return str.str();
 }
 
+template <typename dist_t>
+size_t PermutationInvertedIndex<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + VectorMemoryUsage(pivot_) + VectorMemoryUsage(posting_lists_);
+}
+
 template <typename dist_t>
 template <typename QueryType>
 void PermutationInvertedIndex<dist_t>::GenSearch(QueryType* query) {
@@ -115,11 +182,15 @@ void PermutationInvertedIndex<dist_t>::GenSearch(QueryType* query) {
 
   size_t scan_qty = min(db_scan_, perm_dists.size());
 
+  // Candidates are checked in batches (let's not allocate memory for each query)
+  static thread_local ObjectVector candidates;
+  candidates.clear();
   for (size_t i = 0; i < scan_qty; ++i) {
     const size_t idx = quick_select.GetNext().second;
     quick_select.Next();
-    query->CheckAndAddToResult(data_[idx]);
+    candidates.push_back(data_[idx]);
   }
+  query->CheckAndAddToResult(candidates);
 #else
   vector<vector<ObjectInvEntry>::iterator>  iterBegs;
   vector<vector<ObjectInvEntry>::iterator>  iterEnds;
@@ -214,11 +285,15 @@ void PermutationInvertedIndex<dist_t>::GenSearch(QueryType* query) {
   size_t scan_qty = min(db_scan_, perm_dists.size());
 
   IncrementalQuickSelect<IntInt> quick_select(perm_dists);
+  // Candidates are checked in batches (let's not allocate memory for each query)
+  static thread_local ObjectVector candidates;
+  candidates.clear();
   for (size_t i = 0; i < scan_qty; ++i) {
     const size_t idx = quick_select.GetNext().second;
     quick_select.Next();
-    query->CheckAndAddToResult(data_[idx]);
+    candidates.push_back(data_[idx]);
   }
+  query->CheckAndAddToResult(candidates);
 #endif
 }
 
@@ -45,6 +45,11 @@ class PrefixNode {
                                        const size_t sub_length,
                                        const size_t cur_depth) const = 0;
   virtual void ChunkBuckets() = 0;
+  virtual size_t MemoryUsage() const = 0;
+  // Writes the flag IsLeaf() followed by the node contents
+  virtual void Save(IndexFileWriter& writer) const = 0;
+  // Loads a (sub)tree saved by Save()
+  static PrefixNode* Load(IndexFileReader& reader, size_t& num_objects);
 };
 
 class PrefixNodeLeaf : public PrefixNode {
@@ -62,6 +67,17 @@ class PrefixNodeLeaf : public PrefixNode {
 
   bool IsLeaf() const { return true; }
 
+  size_t MemoryUsage() const {
+    return sizeof(*this) + BucketMemoryUsage(CacheOptimizedBucket_, bucket_);
+  }
+
+  void Save(IndexFileWriter& writer) const {
+    writer.Write<uint8_t>(1);
+    writer.WriteObjectVector(*bucket_);
+  }
+
+  void Load(IndexFileReader& reader) { reader.ReadObjectVector(*bucket_); }
+
   void Insert(const Permutation& perm,
               const Object* object,
               const size_t length,
@@ -104,10 +120,37 @@ class PrefixNodeInternal : public PrefixNode {
 
   bool IsLeaf() const { return false; }
 
+  size_t MemoryUsage() const {
+    size_t res = sizeof(*this) + HashMemoryUsage(children_);
+    for (const auto& it : children_) res += it.second->MemoryUsage();
+    return res;
+  }
+
   virtual void ChunkBuckets() {
     for (auto& it: children_) it.second->ChunkBuckets();
   }
 
+  void Save(IndexFileWriter& writer) const {
+    writer.Write<uint8_t>(0);
+    writer.Write<uint64_t>(children_.size());
+    for (const auto& it : children_) {
+      writer.Write<uint64_t>(it.first);
+      it.second->Save(writer);
+    }
+  }
+
+  void Load(IndexFileReader& reader) {
+    uint64_t qty;
+    reader.Read(qty);
+    for (size_t i = 0; i < qty; ++i) {
+      uint64_t key;
+      reader.Read(key);
+      size_t num_objects = 0;
+      children_[key] = PrefixNode::Load(reader, num_objects);
+      num_objects_ += num_objects;
+    }
+  }
+
   void Insert(const Permutation& perm,
               const Object* object,
               const size_t length,
@@ -162,13 +205,38 @@ class PrefixNodeInternal : public PrefixNode {
   size_t num_objects_;
 };
 
+PrefixNode* PrefixNode::Load(IndexFileReader& reader, size_t& num_objects) {
+  uint8_t IsLeaf;
+  reader.Read(IsLeaf);
+  if (IsLeaf) {
+    PrefixNodeLeaf* node = new PrefixNodeLeaf;
+    node->Load(reader);
+    num_objects = node->GetNumberObjects();
+    return node;
+  }
+  PrefixNodeInternal* node = new PrefixNodeInternal;
+  node->Load(reader);
+  num_objects = node->GetNumberObjects();
+  return node;
+}
+
 class PrefixTree {
  public:
   PrefixTree() : root_(new PrefixNodeInternal) {}
+  explicit PrefixTree(IndexFileReader& reader) : root_(new PrefixNodeInternal) {
+    uint8_t IsLeaf;
+    reader.Read(IsLeaf);
+    CHECK(!IsLeaf);
+    root_->Load(reader);
+  }
   void ChunkBuckets() { root_->ChunkBuckets(); }
 
   ~PrefixTree() { delete root_; }
 
+  size_t MemoryUsage() const { return sizeof(*this) + root_->MemoryUsage(); }
+
+  void Save(IndexFileWriter& writer) const { root_->Save(writer); }
+
   void Insert(const Permutation& perm,
               const Object* object,
               const size_t length) {
@@ -193,7 +261,7 @@ class PrefixTree {
   }
 
  private:
-  PrefixNode* root_;
+  PrefixNodeInternal* root_;
 };
 
 template <typename dist_t>
@@ -203,8 +271,13 @@ PermutationPrefixIndex<dist_t>::PermutationPrefixIndex(
     const size_t num_pivot,
     const size_t prefix_length,
     const size_t min_candidate,
-    bool chunk_bucket)
-  : prefix_length_(prefix_length), min_candidate_(min_candidate) {
+    bool chunk_bucket,
+    bool BuildIndex)
+  : data_(data),   // reference
+    num_pivot_(num_pivot),
+    chunk_bucket_(chunk_bucket),
+    prefix_length_(prefix_length), min_candidate_(min_candidate),
+    prefixtree_(NULL) {
   CHECK(prefix_length_ <= num_pivot);
   CHECK(prefix_length_ > 0);
 
@@ -212,6 +285,8 @@ PermutationPrefixIndex<dist_t>::PermutationPrefixIndex(
   LOG(INFO) << "prefix length    = " << prefix_length_;
   LOG(INFO) << "min candidate    = " << min_candidate_;
 
+  if (!BuildIndex) return;
+
   GetPermutationPivot(data, space, num_pivot, &pivot_);
   prefixtree_ = new PrefixTree;
   Permutation permutation;
@@ -229,11 +304,46 @@ PermutationPrefixIndex<dist_t>::~PermutationPrefixIndex() {
   delete prefixtree_;
 }
 
+template <typename dist_t>
+const string PermutationPrefixIndex<dist_t>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_ << ",prefixLength=" << prefix_length_;
+  return str.str();
+}
+
+template <typename dist_t>
+void PermutationPrefixIndex<dist_t>::Save(const string& location) const {
+  CHECK(prefixtree_ != NULL);
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivot_);
+  prefixtree_->Save(writer);
+  writer.Close();
+}
+
+template <typename dist_t>
+void PermutationPrefixIndex<dist_t>::Load(const string& location) {
+  delete prefixtree_;
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivot_);
+  if (pivot_.size() != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivot_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+  prefixtree_ = new PrefixTree(reader);
+  reader.Close();
+  if (chunk_bucket_) prefixtree_->ChunkBuckets();
+}
+
 template <typename dist_t>
 const std::string PermutationPrefixIndex<dist_t>::ToString() const {
   return "permutation (pref. index)";
 }
 
+template <typename dist_t>
+size_t PermutationPrefixIndex<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + VectorMemoryUsage(pivot_) + (prefixtree_ != NULL ? prefixtree_->MemoryUsage() : 0);
+}
+
 template <typename dist_t>
 template <typename QueryType>
 void PermutationPrefixIndex<dist_t>::GenSearch(QueryType* query) {
@@ -245,9 +355,7 @@ void PermutationPrefixIndex<dist_t>::GenSearch(QueryType* query) {
   prefixtree_->FindCandidates(perm_q, prefix_length_,
                               min_candidate_, &candidates);
 
-  for (const auto& it : candidates) {
-    query->CheckAndAddToResult(it);
-  }
+  query->CheckAndAddToResult(candidates);
 }
 
 template <typename dist_t>
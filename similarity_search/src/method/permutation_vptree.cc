@@ -35,7 +35,8 @@ template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*,
 PermutationVPTree<dist_t, RankCorrelDistFunc>::PermutationVPTree(
     const Space<dist_t>* space,
     const ObjectVector& data,
-    const AnyParams& AllParams) : 
+    const AnyParams& AllParams,
+    bool BuildIndex) : 
       space_(space), data_(data),   // reference
 #ifdef USE_VPTREE_SAMPLE
       VPTreeSpace_(new RankCorrelVectorSpace<RankCorrelDistFunc>())
@@ -46,10 +47,13 @@ PermutationVPTree<dist_t, RankCorrelDistFunc>::PermutationVPTree(
   AnyParamManager pmgr(AllParams);
 
   double    DbScanFrac = 0.05;
-  size_t    NumPivot   = 16;
+  num_pivot_           = 16;
 
   pmgr.GetParamOptional("dbScanFrac", DbScanFrac);
-  pmgr.GetParamOptional("numPivot", NumPivot);
+  pmgr.GetParamOptional("numPivot", num_pivot_);
+  // This parameter is also used by the VP-tree
+  size_t    IndexThreadQty = TaskPool::DefaultThreadQty();
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
 
   if (DbScanFrac < 0.0 || DbScanFrac > 1.0) {
     LOG(FATAL) << METH_PERMUTATION_VPTREE << " requires that dbScanFrac is in the range [0,1]";
@@ -99,18 +103,9 @@ PermutationVPTree<dist_t, RankCorrelDistFunc>::PermutationVPTree(
 #endif
 
   // db_can_qty_ should always be > 0
-  db_scan_qty_ = max(size_t(1), static_cast<size_t>(DbScanFrac * data.size())),
-  GetPermutationPivot(data, space, NumPivot, &pivots_);
-  PermData_.resize(data.size());
-#ifdef USE_VPTREE_SAMPLE
-  for (size_t i = 0; i < data.size(); ++i) {
-    Permutation OnePerm;
-    GetPermutation(pivots_, space_, data[i], &OnePerm);
-    PermData_[i] = VPTreeSpace_->CreateObjFromVect(i, OnePerm);
-  }
+  db_scan_qty_ = max(size_t(1), static_cast<size_t>(DbScanFrac * data.size()));
 
-  ReportIntrinsicDimensionality("Set of permutations" , *VPTreeSpace_, PermData_);
-  
+#ifdef USE_VPTREE_SAMPLE
   SamplingOracleCreator<PivotIdType> OracleCreator(VPTreeSpace_,
                                                   PermData_,
                                                   DoRandSample,
@@ -119,45 +114,53 @@ PermutationVPTree<dist_t, RankCorrelDistFunc>::PermutationVPTree(
                                                   QuantileStepPseudoQuery,
                                                   NumOfPseudoQueriesInQuantile,
                                                   DistLearnThreshold);
-
-  VPTreeIndex_ = new VPTree<PivotIdType, SamplingOracle<PivotIdType>,
-                            SamplingOracleCreator<PivotIdType> >(
-                                          true,
-                                          OracleCreator,
-                                          VPTreeSpace_,
-                                          PermData_,
-                                          RemainParams
-                                    );
 #else
-  for (size_t i = 0; i < data.size(); ++i) {
-    Permutation OnePerm;
-    GetPermutation(pivots_, space_, data[i], &OnePerm);
-    vector<float> OnePermFloat(OnePerm.size());
-    for (size_t j = 0;j < OnePerm.size(); ++j) {
-      OnePermFloat[j] = OnePerm[j];
-    }
-    PermData_[i] = VPTreeSpace_->CreateObjFromVect(i, OnePermFloat);
-  }
   TriangIneqCreator<float> OracleCreator(AlphaLeft, AlphaRight);
+#endif
 
-  ReportIntrinsicDimensionality("Set of permutations" , *VPTreeSpace_, PermData_);
+  // Otherwise, pivots, permutations, and the VP-tree are loaded by Load()
+  if (BuildIndex) {
+    GetPermutationPivot(data, space, num_pivot_, &pivots_);
+    PermData_.resize(data.size());
+    TaskPool pool(IndexThreadQty);
+    pool.ParallelFor(0, data.size(), 256, [&](size_t i) {
+      Permutation OnePerm;
+      GetPermutation(pivots_, space_, data[i], &OnePerm);
+#ifdef USE_VPTREE_SAMPLE
+      PermData_[i] = VPTreeSpace_->CreateObjFromVect(i, OnePerm);
+#else
+      vector<float> OnePermFloat(OnePerm.size());
+      for (size_t j = 0;j < OnePerm.size(); ++j) {
+        OnePermFloat[j] = OnePerm[j];
+      }
+      PermData_[i] = VPTreeSpace_->CreateObjFromVect(i, OnePermFloat);
+#endif
+    });
 
+    ReportIntrinsicDimensionality("Set of permutations" , *VPTreeSpace_, PermData_);
+  }
 
+#ifdef USE_VPTREE_SAMPLE
+  VPTreeIndex_ = new VPTree<PivotIdType, SamplingOracle<PivotIdType>,
+                            SamplingOracleCreator<PivotIdType> >(
+#else
   VPTreeIndex_ = new VPTree<float, TriangIneq<float>,
                             TriangIneqCreator<float> >(
+#endif
                                           true,
                                           OracleCreator,
                                           VPTreeSpace_,
                                           PermData_,
-                                          RemainParams
+                                          RemainParams,
+                                          true /* use random center */,
+                                          BuildIndex
                                     );
-#endif
 }
 
 template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
 PermutationVPTree<dist_t, RankCorrelDistFunc>::~PermutationVPTree() {
-  for (size_t i = 0; i < data_.size(); ++i) {
-    delete PermData_[i];
+  for (const Object* obj : PermData_) {
+    delete obj;
   }
   delete VPTreeIndex_;
   delete VPTreeSpace_;
@@ -170,6 +173,52 @@ const std::string PermutationVPTree<dist_t, RankCorrelDistFunc>::ToString() cons
   return str.str();
 }
 
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+const string PermutationVPTree<dist_t, RankCorrelDistFunc>::BuildParams() const {
+  std::stringstream str;
+  str << "numPivot=" << num_pivot_ << "," << VPTreeIndex_->BuildParams();
+  return str.str();
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationVPTree<dist_t, RankCorrelDistFunc>::Save(const string& location) const {
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.WriteObjectVector(pivots_);
+  writer.Write<uint64_t>(PermData_.size());
+  for (const Object* obj : PermData_) writer.WriteObjectCopy(obj);
+  writer.Close();
+
+  VPTreeIndex_->Save(location + ".vptree");
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+void PermutationVPTree<dist_t, RankCorrelDistFunc>::Load(const string& location) {
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  reader.ReadObjectVector(pivots_);
+  if (pivots_.size() != num_pivot_) {
+    LOG(FATAL) << "The index file '" << location << "' was created using " << pivots_.size()
+               << " pivots, but the current # of pivots is " << num_pivot_;
+  }
+  uint64_t qty;
+  reader.Read(qty);
+  if (qty != data_.size()) {
+    LOG(FATAL) << "The index file is corrupt: '" << location << "'";
+  }
+  for (const Object* obj : PermData_) delete obj;
+  PermData_.resize(qty);
+  for (const Object*& obj : PermData_) obj = reader.ReadObjectCopy();
+  reader.Close();
+
+  VPTreeIndex_->Load(location + ".vptree");
+}
+
+template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
+size_t PermutationVPTree<dist_t, RankCorrelDistFunc>::MemoryUsage() const {
+  // Permutations are indexed by the VP-tree as data objects
+  return sizeof(*this) + VectorMemoryUsage(pivots_) + ObjectsMemoryUsage(PermData_) +
+         VPTreeIndex_->MemoryUsage();
+}
+
 template <typename dist_t, PivotIdType (*RankCorrelDistFunc)(const PivotIdType*, const PivotIdType*, size_t)>
 void PermutationVPTree<dist_t, RankCorrelDistFunc>::Search(RangeQuery<dist_t>* query) {
   Permutation perm_q;
@@ -190,16 +239,11 @@ void PermutationVPTree<dist_t, RankCorrelDistFunc>::Search(RangeQuery<dist_t>* q
 #endif
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-#ifdef USE_VPTREE_SAMPLE
-  unique_ptr<KNNQueue<PivotIdType>> ResQueue(VPTreeQuery->Result()->Clone());
-#else
-  unique_ptr<KNNQueue<float>> ResQueue(VPTreeQuery->Result()->Clone());
-#endif
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -223,16 +267,11 @@ void PermutationVPTree<dist_t, RankCorrelDistFunc>::Search(KNNQuery<dist_t>* que
 #endif
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-#ifdef USE_VPTREE_SAMPLE
-  unique_ptr<KNNQueue<PivotIdType>> ResQueue(VPTreeQuery->Result()->Clone());
-#else
-  unique_ptr<KNNQueue<float>> ResQueue(VPTreeQuery->Result()->Clone());
-#endif
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -68,6 +68,9 @@ ProjectionVPTree<dist_t>::ProjectionVPTree(
 
   pmgr.GetParamOptional("projPivotQty", ProjPivotQty);
   pmgr.GetParamOptional("projMaxElem", ProjMaxElem);
+  // This parameter is also used by the VP-tree
+  size_t        IndexThreadQty = TaskPool::DefaultThreadQty();
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
 
   space_->GenRandProjPivots(randProjPivots_, ProjPivotQty, ProjMaxElem);
 
@@ -92,9 +95,10 @@ ProjectionVPTree<dist_t>::ProjectionVPTree(
   db_scan_qty_ = max(size_t(1), static_cast<size_t>(DbScanFrac * data.size())),
   projData_.resize(data.size());
 
-  for (size_t id = 0; id < data.size(); ++id) {
+  TaskPool pool(IndexThreadQty);
+  pool.ParallelFor(0, data.size(), 256, [&](size_t id) {
     projData_[id] = ProjectOneVect(id, data[id]);
-  }
+  });
 
   ReportIntrinsicDimensionality("Set of projections" , *VPTreeSpace_, projData_);
 
@@ -129,6 +133,13 @@ const std::string ProjectionVPTree<dist_t>::ToString() const {
   return str.str();
 }
 
+template <typename dist_t>
+size_t ProjectionVPTree<dist_t>::MemoryUsage() const {
+  // Projections are indexed by the VP-tree as data objects
+  return sizeof(*this) + ObjectsMemoryUsage(randProjPivots_) + ObjectsMemoryUsage(projData_) +
+         VPTreeIndex_->MemoryUsage();
+}
+
 template <typename dist_t>
 void ProjectionVPTree<dist_t>::Search(RangeQuery<dist_t>* query) {
   unique_ptr<Object>            QueryObject(ProjectOneVect(0, query->QueryObject()));
@@ -136,12 +147,11 @@ void ProjectionVPTree<dist_t>::Search(RangeQuery<dist_t>* query) {
 
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-  unique_ptr<KNNQueue<float>> ResQueue(VPTreeQuery->Result()->Clone());
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -152,12 +162,11 @@ void ProjectionVPTree<dist_t>::Search(KNNQuery<dist_t>* query) {
 
   VPTreeIndex_->Search(VPTreeQuery.get());
 
-  unique_ptr<KNNQueue<float>> ResQueue(VPTreeQuery->Result()->Clone());
+  const auto* ResQueue = VPTreeQuery->Result();
 
-  while (!ResQueue->Empty()) {
-      size_t id = reinterpret_cast<const Object*>(ResQueue->TopObject())->id();
+  for (auto it = ResQueue->SortedBegin(); it != ResQueue->SortedEnd(); ++it) {
+      size_t id = reinterpret_cast<const Object*>(it->second)->id();
       query->CheckAndAddToResult(data_[id]);
-      ResQueue->Pop();
   }
 }
 
@@ -23,16 +23,12 @@ namespace similarity {
 
 template <typename dist_t>
 void SeqSearch<dist_t>::Search(RangeQuery<dist_t>* query) {
-  for (size_t i = 0; i < data_.size(); ++i) {
-    query->CheckAndAddToResult(data_[i]);
-  }
+  query->CheckAndAddToResult(data_);
 }
 
 template <typename dist_t>
 void SeqSearch<dist_t>::Search(KNNQuery<dist_t>* query) {
-  for (size_t i = 0; i < data_.size(); ++i) {
-    query->CheckAndAddToResult(data_[i]);
-  }
+  query->CheckAndAddToResult(data_);
 }
 
 template class SeqSearch<float>;
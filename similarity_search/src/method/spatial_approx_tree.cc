@@ -56,6 +56,14 @@ class SpatialApproxTree<dist_t>::SATNode {
               dist_t dist_qp,
               dist_t mind);
 
+  size_t MemoryUsage() const {
+    size_t res = sizeof(*this) + VectorMemoryUsage(neighbors_);
+    for (const auto& n : neighbors_) {
+      if (n.second != nullptr) res += n.second->MemoryUsage();
+    }
+    return res;
+  }
+
  private:
   const Object*                           pivot_;
   dist_t                                  covering_radius_;
@@ -180,6 +188,11 @@ SpatialApproxTree<dist_t>::~SpatialApproxTree() {
   delete root_;
 }
 
+template <typename dist_t>
+size_t SpatialApproxTree<dist_t>::MemoryUsage() const {
+  return sizeof(*this) + (root_ != NULL ? root_->MemoryUsage() : 0);
+}
+
 template <typename dist_t>
 const string SpatialApproxTree<dist_t>::ToString() const {
   return "satree";
@@ -19,6 +19,9 @@
 #include <sstream>
 #include <string>
 #include <cmath>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
 
 #include "space.h"
 #include "rangequery.h"
@@ -26,6 +29,7 @@
 #include "vptree.h"
 #include "searchoracle.h"
 #include "vptree_utils.h"
+#include "search_trace.h"
 #include "methodfactory.h"
 
 namespace similarity {
@@ -42,29 +46,67 @@ VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPTree(
                        const Space<dist_t>* space,
                        const ObjectVector& data,
                        const AnyParams& MethParams,
-                       bool use_random_center) : 
+                       bool use_random_center,
+                       bool BuildIndex) : 
+                              space_(space),
+                              data_(data),
+                              OracleCreator_(OracleCreator),
+                              root_(NULL),
                               BucketSize_(50),
                               MaxLeavesToVisit_(FAKE_MAX_LEAVES_TO_VISIT),
                               ChunkBucket_(true),
-                              SaveHistFileName_("")
+                              TransposeBucket_(false),
+                              SaveHistFileName_(""),
+                              FlatLayout_("none"),
+                              BestFirst_(false),
+                              MaxPathLen_(0),
+                              Arity_(2)
                        {
   AnyParamManager pmgr(MethParams);
 
+  size_t   IndexThreadQty = TaskPool::DefaultThreadQty();
+  unsigned Seed = RandomInt();
+
   pmgr.GetParamOptional("bucketSize", BucketSize_);
   pmgr.GetParamOptional("chunkBucket", ChunkBucket_);
+  pmgr.GetParamOptional("transposeBucket", TransposeBucket_);
   pmgr.GetParamOptional("maxLeavesToVisit", MaxLeavesToVisit_);
   pmgr.GetParamOptional("saveHistFileName", SaveHistFileName_);
+  pmgr.GetParamOptional("indexThreadQty", IndexThreadQty);
+  pmgr.GetParamOptional("seed", Seed);
+  pmgr.GetParamOptional("flatLayout", FlatLayout_);
+  pmgr.GetParamOptional("bestFirst", BestFirst_);
+  pmgr.GetParamOptional("maxPathLen", MaxPathLen_);
+  pmgr.GetParamOptional("arity", Arity_);
+
+  if (FlatLayout_ != "none" && FlatLayout_ != "dfs" && FlatLayout_ != "veb") {
+    LOG(FATAL) << "Invalid flatLayout: '" << FlatLayout_ << "', expected none, dfs, or veb";
+  }
+  if (Arity_ < 2) {
+    LOG(FATAL) << "Invalid arity: " << Arity_ << ", expected at least 2";
+  }
+
+  if (!BuildIndex) return;
+
+  // The same seed produces the same tree regardless of the number of threads
+  LOG(INFO) << "Building the VP-tree using " << IndexThreadQty << " threads, seed: " << Seed;
 
-  size_t IndexedQty = 0;
+  std::atomic<size_t> IndexedQty(0);
+  TaskPool            pool(IndexThreadQty);
   
   root_ = new VPNode(
                      PrintProgress, 0,
                      data.size(), IndexedQty,
+                     pool, Seed,
                      OracleCreator, space,
                      const_cast<ObjectVector&>(data),
-                     BucketSize_, ChunkBucket_,
+                     Arity_,
+                     MaxPathLen_, vector<dist_t>(),
+                     BucketSize_, ChunkBucket_, TransposeBucket_,
                      SaveHistFileName_,
                      use_random_center, true);
+
+  Flatten();
 }
 
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
@@ -79,29 +121,242 @@ const std::string VPTree<dist_t, SearchOracle, SearchOracleCreator>::ToString()
 
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
 void VPTree<dist_t, SearchOracle, SearchOracleCreator>::Search(RangeQuery<dist_t>* query) {
-  int mx = MaxLeavesToVisit_;
-  root_->GenericSearch(query, mx);
+  int            mx = MaxLeavesToVisit_;
+  vector<dist_t> QueryPath;
+  if (!flatNodes_.empty()) {
+    FlatSearch(query, 0, mx, QueryPath);
+  } else {
+    root_->GenericSearch(query, mx, QueryPath);
+  }
 }
 
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
 void VPTree<dist_t, SearchOracle, SearchOracleCreator>::Search(KNNQuery<dist_t>* query) {
-  int mx = MaxLeavesToVisit_;
-  root_->GenericSearch(query, mx);
+  if (BestFirst_) {
+    if (!flatNodes_.empty()) {
+      BestFirstSearch(FlatTreeView(*this), query);
+    } else {
+      BestFirstSearch(PointerTreeView(root_), query);
+    }
+    return;
+  }
+  int            mx = MaxLeavesToVisit_;
+  vector<dist_t> QueryPath;
+  if (!flatNodes_.empty()) {
+    FlatSearch(query, 0, mx, QueryPath);
+  } else {
+    root_->GenericSearch(query, mx, QueryPath);
+  }
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+const string VPTree<dist_t, SearchOracle, SearchOracleCreator>::BuildParams() const {
+  std::stringstream str;
+  str << "bucketSize=" << BucketSize_ << ",arity=" << Arity_ << ",maxPathLen=" << MaxPathLen_;
+  return str.str();
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::Save(const string& location) const {
+  CHECK(root_ != NULL || !flatNodes_.empty());
+  IndexFileWriter writer(location, ToString(), BuildParams(), data_);
+  writer.Write<uint64_t>(MaxPathLen_);
+  if (!flatNodes_.empty()) {
+    SaveFlat(writer, 0, 0);
+  } else {
+    root_->Save(writer);
+  }
+  writer.Close();
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::Load(const string& location) {
+  delete root_;
+  IndexFileReader reader(location, ToString(), BuildParams(), data_);
+  uint64_t MaxPathLen;
+  reader.Read(MaxPathLen);
+  // Distances to pivots were computed when the index was built
+  if (MaxPathLen != MaxPathLen_) {
+    LOG(FATAL) << "The index file '" << location << "' was created with maxPathLen=" << MaxPathLen
+               << ", but the current maxPathLen=" << MaxPathLen_;
+  }
+  root_ = new VPNode(reader, OracleCreator_, space_, ChunkBucket_, TransposeBucket_, 0, MaxPathLen_);
+  reader.Close();
+
+  Flatten();
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+size_t VPTree<dist_t, SearchOracle, SearchOracleCreator>::MemoryUsage() const {
+  size_t res = sizeof(*this) + (root_ != NULL ? root_->MemoryUsage() : 0);
+  res += VectorMemoryUsage(flatNodes_) + VectorMemoryUsage(flatShells_) + VectorMemoryUsage(flatObjects_) +
+         VectorMemoryUsage(flatOracles_) + VectorMemoryUsage(flatPivotDists_) + VectorMemoryUsage(flatTransposed_);
+  for (const auto& transposed : flatTransposed_) {
+    if (transposed) res += transposed->MemoryUsage();
+  }
+  for (const SearchOracle& oracle : flatOracles_) res += oracle.MemoryUsage() - sizeof(oracle);
+  if (flatArena_) res += flatArena_->MemoryAllocated();
+  return res;
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+size_t VPTree<dist_t, SearchOracle, SearchOracleCreator>::Height(const VPNode* node) {
+  if (node == NULL) return 0;
+  size_t res = 0;
+  for (const auto& shell : node->shells_) res = std::max(res, Height(shell.child_));
+  return 1 + res;
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::LayoutDFS(VPNode* node, vector<VPNode*>& order) {
+  if (node == NULL) return;
+  order.push_back(node);
+  for (const auto& shell : node->shells_) LayoutDFS(shell.child_, order);
+}
+
+/*
+ * The van Emde Boas layout of a tree of the height h: the top tree of the height h/2
+ * is laid out recursively, followed by subtrees rooted in its children
+ * (each of them is also laid out recursively). Subtrees of the VP-tree may be
+ * shorter than h, but this doesn't matter.
+ */
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::LayoutVEB(VPNode* node, size_t height,
+                                                                  vector<VPNode*>& order, vector<VPNode*>& below) {
+  if (node == NULL) return;
+  if (height == 1) {
+    order.push_back(node);
+    for (const auto& shell : node->shells_) {
+      if (shell.child_ != NULL) below.push_back(shell.child_);
+    }
+    return;
+  }
+  const size_t    TopHeight = height / 2;
+  vector<VPNode*> middle;
+  LayoutVEB(node, TopHeight, order, middle);
+  for (VPNode* child : middle) LayoutVEB(child, height - TopHeight, order, below);
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::Flatten() {
+  if (FlatLayout_ == "none" || root_ == NULL) return;
+
+  vector<VPNode*> order;
+  if (FlatLayout_ == "dfs") {
+    LayoutDFS(root_, order);
+  } else {
+    vector<VPNode*> below;
+    LayoutVEB(root_, Height(root_), order, below);
+    CHECK(below.empty());
+  }
+
+  std::unordered_map<const VPNode*, uint32_t> pos;
+  size_t                                      OracleQty = 0, ShellQty = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    pos[order[i]] = i;
+    if (order[i]->bucket_ == NULL && order[i]->oracle_ != NULL) ++OracleQty;
+    if (order[i]->bucket_ == NULL) ShellQty += order[i]->shells_.size();
+  }
+
+  if (ChunkBucket_) flatArena_.reset(new ObjectArena());
+  auto copy = [this](const Object* obj) {
+    return ChunkBucket_ ? flatArena_->CloneObject(obj) : obj;
+  };
+
+  flatNodes_.reserve(order.size());
+  flatTransposed_.reserve(order.size());
+  flatOracles_.reserve(OracleQty);
+  flatShells_.reserve(ShellQty);
+  for (VPNode* node : order) {
+    FlatNode flat;
+
+    flat.pivot_       = NULL;
+    flat.oracle_      = kFlatNull;
+    flat.ShellStart_  = flatShells_.size();
+    flat.ShellQty_    = 0;
+    flat.BucketStart_ = flatObjects_.size();
+    // A node that has a bucket is searched as a bucket (even if it has a pivot)
+    if (node->bucket_ != NULL) {
+      const size_t qty = node->bucket_->size();
+      const size_t PathQty = qty ? node->PivotDists_.size() / qty : 0;
+      // Paths of shallow buckets are padded to MaxPathLen_
+      flatPivotDists_.resize((flatObjects_.size() + qty) * MaxPathLen_);
+      for (size_t i = 0; i < qty; ++i) {
+        std::copy(node->PivotDists_.begin() + i * PathQty, node->PivotDists_.begin() + (i + 1) * PathQty,
+                  flatPivotDists_.begin() + (flatObjects_.size() + i) * MaxPathLen_);
+      }
+      for (const Object* obj : *node->bucket_) flatObjects_.push_back(copy(obj));
+    } else {
+      flat.pivot_ = copy(node->pivot_);
+      if (node->oracle_ != NULL) {
+        flat.oracle_ = flatOracles_.size();
+        flatOracles_.push_back(*node->oracle_);
+      }
+      flat.ShellQty_ = node->shells_.size();
+      for (const auto& shell : node->shells_) {
+        flatShells_.push_back(FlatShell{shell.child_ != NULL ? pos[shell.child_] : kFlatNull, shell.bound_});
+      }
+    }
+    flat.BucketEnd_ = flatObjects_.size();
+    flatNodes_.push_back(flat);
+    // The transposed bucket doesn't refer to objects, so it is taken from the node
+    flatTransposed_.emplace_back(node->transposed_);
+    node->transposed_ = NULL;
+  }
+
+  delete root_;
+  root_ = NULL;
 }
 
+// Uses the same format as VPNode::Save()
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
-void VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::CreateBucket(bool ChunkBucket, 
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::SaveFlat(IndexFileWriter& writer, uint32_t node,
+                                                                 unsigned level) const {
+  const FlatNode& flat = flatNodes_[node];
+
+  writer.Write<uint8_t>(flat.pivot_ == NULL);
+  if (flat.pivot_ == NULL) {
+    writer.Write<uint64_t>(flat.BucketEnd_ - flat.BucketStart_);
+    for (uint32_t i = flat.BucketStart_; i < flat.BucketEnd_; ++i) writer.WriteObject(flatObjects_[i]);
+
+    const size_t    PathQty = PathLen(level, MaxPathLen_);
+    vector<dist_t>  PivotDists;
+    for (uint32_t i = flat.BucketStart_; i < flat.BucketEnd_; ++i) {
+      PivotDists.insert(PivotDists.end(), flatPivotDists_.begin() + i * MaxPathLen_,
+                        flatPivotDists_.begin() + i * MaxPathLen_ + PathQty);
+    }
+    writer.WriteVector(PivotDists);
+    return;
+  }
+  writer.WriteObject(flat.pivot_);
+  writer.Write<uint8_t>(flat.oracle_ != kFlatNull);
+  if (flat.oracle_ != kFlatNull) flatOracles_[flat.oracle_].Save(writer);
+  writer.Write<uint64_t>(flat.ShellQty_);
+  for (uint32_t i = flat.ShellStart_; i < flat.ShellStart_ + flat.ShellQty_; ++i) {
+    const FlatShell& shell = flatShells_[i];
+    writer.Write(shell.bound_);
+    writer.Write<uint8_t>(shell.child_ != kFlatNull);
+    if (shell.child_ != kFlatNull) SaveFlat(writer, shell.child_, level + 1);
+  }
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::CreateBucket(const Space<dist_t>* space,
+                                                                             bool ChunkBucket, bool TransposeBucket,
                                                                              const ObjectVector& data, 
+                                                                             const vector<dist_t>& paths,
                                                                              bool PrintProgress,
-                                                                             size_t&  IndexedQty,
+                                                                             std::atomic<size_t>&  IndexedQty,
                                                                              size_t   TotalQty) {
     if (ChunkBucket) {
       CreateCacheOptimizedBucket(data, CacheOptimizedBucket_, bucket_);
     } else {
       bucket_ = new ObjectVector(data);
     }
-    IndexedQty += data.size();
-    if (PrintProgress) std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\bBuilding an index: " << std::round(1000.0 * IndexedQty / TotalQty)/10.0 << "% done     \r"; // Note the trailing spaces - they are to compensate differences in output length.
+    if (TransposeBucket) transposed_ = TransposedBucket<dist_t>::Create(space, *bucket_);
+    PivotDists_ = paths;
+    const size_t qty = IndexedQty += data.size();
+    if (PrintProgress) std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\bBuilding an index: " << std::round(1000.0 * qty / TotalQty)/10.0 << "% done     \r"; // Note the trailing spaces - they are to compensate differences in output length.
 }
 
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
@@ -109,45 +364,89 @@ VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::VPNode(
                                bool     PrintProgress,
                                unsigned level,
                                size_t   TotalQty,
-                               size_t&  IndexedQty,
+                               std::atomic<size_t>&  IndexedQty,
+                               TaskPool& pool,
+                               unsigned seed,
                                const SearchOracleCreator& OracleCreator,
                                const Space<dist_t>* space, const ObjectVector& data,
-                               size_t BucketSize, bool ChunkBucket,
+                               size_t arity,
+                               size_t MaxPathLen, const vector<dist_t>& paths,
+                               size_t BucketSize, bool ChunkBucket, bool TransposeBucket,
                                const string& SaveHistFileName,
                                bool use_random_center, bool is_root)
-    : pivot_(NULL), mediandist_(0),
-      left_child_(NULL), right_child_(NULL), oracle_(NULL),
-      bucket_(NULL), CacheOptimizedBucket_(NULL) 
+    : pivot_(NULL), oracle_(NULL),
+      bucket_(NULL), CacheOptimizedBucket_(NULL), transposed_(NULL)
 {
   CHECK(!data.empty());
 
   if (!data.empty() && data.size() <= BucketSize) {
-    CreateBucket(ChunkBucket, data, PrintProgress, IndexedQty, TotalQty);
+    CreateBucket(space, ChunkBucket, TransposeBucket, data, paths, PrintProgress, IndexedQty, TotalQty);
     return;
   }
 
-  const size_t index = SelectVantagePoint(data, use_random_center);
+  mt19937 gen(seed);
+
+  const size_t index = SelectVantagePoint(data, use_random_center, gen);
   pivot_ = data[index];
 
   if (data.size() >= 2) {
-    DistObjectPairVector<dist_t> dp;
-    for (size_t i = 0; i < data.size(); ++i) {
+    DistObjectPairVector<dist_t> dp(data.size() - 1);
+    pool.ParallelFor(0, data.size(), ParallelDistChunkQty, [&](size_t i) {
       if (i == index) {
-        continue;
+        return;
       }
       // Distance can be asymmetric, the pivot is always on the left side!
-      dp.push_back(std::make_pair(space->IndexTimeDistance(pivot_, data[i]), data[i]));
-    }
+      dp[i < index ? i : i - 1] = std::make_pair(space->IndexTimeDistance(pivot_, data[i]), data[i]);
+    });
 
     std::sort(dp.begin(), dp.end(), DistObjectPairAscComparator<dist_t>());
-    DistObjectPair<dist_t>  medianDistObj = GetMedian(dp);
-    mediandist_ = medianDistObj.first; 
 
-    oracle_ = OracleCreator.Create(level, pivot_, dp);
+    oracle_ = OracleCreator.Create(level, pivot_, dp, gen);
+
+    /*
+     * The shell of each element of dp and bounds between shells.
+     * Shells are found by positions in dp rather than by comparing
+     * distances with bounds, because bounds are stored as floats.
+     */
+    vector<size_t> ShellIds(dp.size());
+    vector<float>  bounds;
+
+    if (arity == 2) {
+      DistObjectPair<dist_t>  medianDistObj = GetMedian(dp);
+      bounds.push_back(medianDistObj.first);
+
+      for (size_t i = 0; i < dp.size(); ++i) {
+        /* 
+         * Note that here we compare a pair (distance, pointer)
+         * If distances are equal, pointers are compared.
+         * Thus, we would get a balanced split, even if the median
+         * occurs many times in the array dp[].
+         */
+        ShellIds[i] = dp[i] < medianDistObj ? 0 : 1;
+      }
+    } else {
+      vector<float> quant;
+      for (size_t i = 1; i < arity; ++i) quant.push_back(float(i) / arity);
+
+      /*
+       * Each index is the last element of a shell: the next element
+       * has a strictly larger distance, which becomes the bound.
+       */
+      size_t start = 0;
+      for (size_t indx : EstimateQuantileIndices(dp, quant)) {
+        if (indx + 1 >= dp.size()) break;
+        std::fill(ShellIds.begin() + start, ShellIds.begin() + indx + 1, bounds.size());
+        bounds.push_back(dp[indx + 1].first);
+        start = indx + 1;
+      }
+      std::fill(ShellIds.begin() + start, ShellIds.end(), bounds.size());
+    }
 
     if (0 == level && !SaveHistFileName.empty()) {
       stringstream str;
-      str <<  oracle_->Dump() <<  mediandist_ << endl ;
+      str <<  oracle_->Dump();
+      for (size_t i = 0; i < bounds.size(); ++i) str << (i ? "," : "") << bounds[i];
+      str << endl;
 
       std::ofstream  of(SaveHistFileName.c_str(), std::ios::trunc | std::ios::out); 
 
@@ -157,116 +456,458 @@ VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::VPNode(
       of << str.str();
     }
 
-    ObjectVector left;
-    ObjectVector right;
+    vector<ObjectVector> parts(bounds.size() + 1);
+    for (size_t i = 0; i < dp.size(); ++i) parts[ShellIds[i]].push_back(dp[i].second);
 
-#if 1
-    for (auto it = dp.begin(); it != dp.end(); ++it) {
-      const Object* v = it->second;
+    /*
+     * Sometimes, e.g.., for integer-valued distances,
+     * the median will be non-discriminative. In this case
+     * it is more efficient to put everything into a single bucket.
+     * The same is true if many distances are equal and quantiles
+     * put almost everything into one shell: otherwise, with any arity,
+     * the tree can degenerate into a long chain. Thus, all shells except
+     * the largest one should have at least LeastSize elements in total
+     * (for two shells, each shell should have LeastSize elements).
+     */
+    size_t LeastSize = dp.size() / BalanceConst;
+    size_t MaxPartSize = 0;
+    for (const ObjectVector& part : parts) MaxPartSize = std::max(MaxPartSize, part.size());
+    bool   balanced = MaxPartSize < dp.size() && dp.size() - MaxPartSize >= LeastSize;
 
-      /* 
-       * Note that here we compare a pair (distance, pointer)
-       * If distances are equal, pointers are compared.
-       * Thus, we would get a balanced split, even if the median
-       * occurs many times in the array dp[].
-       */
-      if (*it < medianDistObj) {
-        left.push_back(v);
-      } else {
-        right.push_back(v);
-      }
+    if (!balanced) {
+        CreateBucket(space, ChunkBucket, TransposeBucket, data, paths, PrintProgress, IndexedQty, TotalQty);
+        return;
     }
-#else
+
     /*
-     * TODO: This code creates overlapping partitions.
-     *       If we ever uncomment it, you will have to take care of duplicates.
-     *       You will also need to modify the code that reports progress in index creation.
-     *       See std::cout << ... in VPNode
+     * Paths of children: the distance to the pivot is appended
+     * and the distance to the farthest ancestor is removed (if needed).
      */
-    size_t LeftQty = dp.size() / 2;
-    size_t RightQty = dp.size() / 2;
-    if (level < 8) {
-        RightQty = (size_t)round(0.4 * dp.size());
-        LeftQty = (size_t)round(0.6 * dp.size());
+    vector<vector<dist_t>> PartPaths(parts.size());
+    if (MaxPathLen) {
+      const size_t  PathQty = PathLen(level, MaxPathLen);
+      const size_t  SkipQty = PathQty + 1 - PathLen(level + 1, MaxPathLen);
+      std::unordered_map<const Object*, size_t> pos;
+      for (size_t i = 0; i < data.size(); ++i) pos[data[i]] = i;
+
+      for (size_t i = 0; i < parts.size(); ++i) {
+        PartPaths[i].reserve(parts[i].size() * PathLen(level + 1, MaxPathLen));
+      }
+      for (size_t i = 0; i < dp.size(); ++i) {
+        vector<dist_t>& ChildPaths = PartPaths[ShellIds[i]];
+        auto            start = paths.begin() + pos[dp[i].second] * PathQty;
+        ChildPaths.insert(ChildPaths.end(), start + SkipQty, start + PathQty);
+        ChildPaths.push_back(dp[i].first);
+      }
     }
 
-    for (size_t i = 0; i < dp.size(); ++i) {
-      const Object* v = dp[i].second;
+    vector<unsigned> ChildSeeds(parts.size());
+    for (unsigned& ChildSeed : ChildSeeds) ChildSeed = gen();
 
-      if (i <= LeftQty) {
-        left.push_back(v);
-      }
-      if (i >= RightQty)  {
-        right.push_back(v);
+    shells_.resize(parts.size(), Shell{NULL, 0});
+    for (size_t i = 0; i < bounds.size(); ++i) shells_[i].bound_ = bounds[i];
+
+    TaskGroup children;
+
+    for (size_t i = 0; i < parts.size(); ++i) {
+      if (parts[i].empty()) continue;
+      auto BuildChild = [&, i]() {
+        shells_[i].child_ = new VPNode(PrintProgress, level + 1, TotalQty, IndexedQty, pool, ChildSeeds[i], OracleCreator, space, parts[i], arity, MaxPathLen, PartPaths[i], BucketSize, ChunkBucket, TransposeBucket, "", use_random_center, false);
+      };
+      // The last child is built by this thread
+      if (i + 1 < parts.size() && parts[i].size() >= ParallelSubtreeMinQty) {
+        pool.Spawn(children, BuildChild);
+      } else {
+        BuildChild();
       }
     }
-#endif
-    /*
-     * Sometimes, e.g.., for integer-valued distances,
-     * mediandist_ will be non-discriminative. In this case
-     * it is more efficient to put everything into a single bucket.
-     */
-    size_t LeastSize = dp.size() / BalanceConst;
 
-    if (left.size() < LeastSize || right.size() < LeastSize) {
-        CreateBucket(ChunkBucket, data, PrintProgress, IndexedQty, TotalQty);
-        return;
-    }
+    pool.Wait(children);
+  }
+}
 
-    if (!left.empty()) {
-      left_child_ = new VPNode(PrintProgress, level + 1, TotalQty, IndexedQty, OracleCreator, space, left, BucketSize, ChunkBucket, "", use_random_center, false);
-    }
+/*
+ * A node is saved as follows:
+ * 1) a bucket flag; a bucket node is followed by the vector of bucket objects
+ *    and distances from them to ancestor pivots;
+ * 2) otherwise, the pivot, the oracle flag, the oracle, the number of shells,
+ *    and shells: the bound and the child (each child is preceded by a flag).
+ */
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::Save(IndexFileWriter& writer) const {
+  writer.Write<uint8_t>(bucket_ != NULL);
+  if (bucket_ != NULL) {
+    writer.WriteObjectVector(*bucket_);
+    writer.WriteVector(PivotDists_);
+    return;
+  }
+  writer.WriteObject(pivot_);
+  writer.Write<uint8_t>(oracle_ != NULL);
+  if (oracle_ != NULL) oracle_->Save(writer);
+  writer.Write<uint64_t>(shells_.size());
+  for (const Shell& shell : shells_) {
+    writer.Write(shell.bound_);
+    writer.Write<uint8_t>(shell.child_ != NULL);
+    if (shell.child_ != NULL) shell.child_->Save(writer);
+  }
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+size_t VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::MemoryUsage() const {
+  size_t res = sizeof(*this) + BucketMemoryUsage(CacheOptimizedBucket_, bucket_) +
+               VectorMemoryUsage(PivotDists_) + VectorMemoryUsage(shells_);
+  if (transposed_ != NULL)  res += transposed_->MemoryUsage();
+  if (oracle_ != NULL)      res += oracle_->MemoryUsage();
+  for (const Shell& shell : shells_) {
+    if (shell.child_ != NULL) res += shell.child_->MemoryUsage();
+  }
+  return res;
+}
 
-    if (!right.empty()) {
-      right_child_ = new VPNode(PrintProgress, level + 1, TotalQty, IndexedQty, OracleCreator, space, right, BucketSize, ChunkBucket, "", use_random_center, false);
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::VPNode(
+                               IndexFileReader& reader,
+                               const SearchOracleCreator& OracleCreator,
+                               const Space<dist_t>* space,
+                               bool ChunkBucket, bool TransposeBucket,
+                               unsigned level, size_t MaxPathLen)
+    : pivot_(NULL), oracle_(NULL),
+      bucket_(NULL), CacheOptimizedBucket_(NULL), transposed_(NULL)
+{
+  uint8_t flag;
+
+  reader.Read(flag);
+  if (flag) {
+    ObjectVector data;
+    reader.ReadObjectVector(data);
+    if (ChunkBucket) {
+      CreateCacheOptimizedBucket(data, CacheOptimizedBucket_, bucket_);
+    } else {
+      bucket_ = new ObjectVector(data);
     }
+    if (TransposeBucket) transposed_ = TransposedBucket<dist_t>::Create(space, *bucket_);
+    reader.ReadVector(PivotDists_);
+    if (PivotDists_.size() != data.size() * PathLen(level, MaxPathLen)) {
+      LOG(FATAL) << "The index file is corrupt (invalid number of distances to pivots)";
+    }
+    return;
+  }
+  pivot_ = reader.ReadObject();
+  reader.Read(flag);
+  if (flag) oracle_ = OracleCreator.Load(reader);
+  uint64_t ShellQty;
+  reader.Read(ShellQty);
+  shells_.resize(ShellQty, Shell{NULL, 0});
+  for (Shell& shell : shells_) {
+    reader.Read(shell.bound_);
+    reader.Read(flag);
+    if (flag) shell.child_ = new VPNode(reader, OracleCreator, space, ChunkBucket, TransposeBucket, level + 1, MaxPathLen);
   }
 }
 
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
 VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::~VPNode() {
-  delete left_child_;
-  delete right_child_;
+  for (const Shell& shell : shells_) delete shell.child_;
   delete oracle_;
+  delete transposed_;
   ClearBucket(CacheOptimizedBucket_, bucket_);
 }
 
+/*
+ * Checks if the triangle inequality for one of the pivots on the path
+ * guarantees that the object is farther from the query than the radius.
+ */
+template <typename dist_t>
+inline bool IsFarByPivots(const dist_t* QueryDists, const dist_t* ObjDists, size_t PathQty, dist_t radius) {
+  for (size_t k = 0; k < PathQty; ++k) {
+    if ((QueryDists[k] > ObjDists[k] ? QueryDists[k] - ObjDists[k] : ObjDists[k] - QueryDists[k]) > radius) return true;
+  }
+  return false;
+}
+
+/*
+ * Searches bucket objects. The distances from the i-th object to PathQty ancestor pivots
+ * are PivotDists[i * stride], ..., PivotDists[i * stride + PathQty - 1]. If, for some pivot,
+ * the triangle inequality guarantees that the object is outside the query ball,
+ * the distance to the object isn't computed. Without such filtering, distances
+ * are computed in batches (using the transposed copy of objects, if it isn't NULL).
+ * With filtering, they are computed one by one, because the radius of a KNN query
+ * shrinks after each distance computation.
+ */
+template <typename dist_t, typename QueryType>
+inline void SearchBucket(QueryType* query, const Object* const* objects, size_t qty,
+                         const TransposedBucket<dist_t>* transposed,
+                         const dist_t* PivotDists, size_t stride,
+                         const dist_t* QueryDists, size_t PathQty) {
+  if (!PathQty) {
+    if (transposed != NULL) {
+      query->CheckAndAddToResult(objects, *transposed);
+    } else {
+      query->CheckAndAddToResult(objects, qty);
+    }
+    return;
+  }
+  for (size_t i = 0; i < qty; ++i) {
+    if (SEARCH_TRACE_EXPR(query, kTracePruning,
+                          IsFarByPivots(QueryDists, PivotDists + i * stride, PathQty, query->Radius()))) continue;
+
+    const Object* Obj = objects[i];
+    dist_t distQC = query->DistanceObjLeft(Obj);
+    query->CheckAndAddToResult(distQC, Obj);
+  }
+}
+
+/*
+ * Checks if the oracle allows visiting the i-th shell: the query ball
+ * should not be entirely inside the lower bound or outside the upper bound.
+ * For the binary tree, this is the same as checking the decision for the median.
+ */
+template <typename dist_t, typename SearchOracle, typename ShellType>
+inline bool VisitShell(SearchOracle& oracle, dist_t distQC, dist_t radius,
+                       const ShellType* shells, size_t qty, size_t i) {
+  return (i == 0       || oracle.Classify(distQC, radius, shells[i - 1].bound_) != kVisitLeft) &&
+         (i + 1 == qty || oracle.Classify(distQC, radius, shells[i].bound_) != kVisitRight);
+}
+
+/*
+ * A lower bound on the distance from the query to objects of the i-th shell
+ * (it's exact only in metric spaces).
+ */
+template <typename dist_t, typename ShellType>
+inline dist_t ShellLowerBound(dist_t distQC, const ShellType* shells, size_t qty, size_t i) {
+  dist_t res = 0;
+  if (i + 1 < qty) res = std::max<dist_t>(res, distQC - dist_t(shells[i].bound_));
+  if (i > 0)       res = std::max<dist_t>(res, dist_t(shells[i - 1].bound_) - distQC);
+  return res;
+}
+
+/*
+ * Calls visit(i) for all shells: the shell containing the query comes first,
+ * then we move outwards, each time choosing the closest of the two next shells.
+ * For the binary tree, this means that the query side is visited first.
+ */
+template <typename dist_t, typename ShellType, typename VisitFunc>
+inline void ForEachShell(dist_t distQC, const ShellType* shells, size_t qty, VisitFunc visit) {
+  if (qty == 0) return;
+  size_t lo = 0;
+  while (lo + 1 < qty && !(distQC < shells[lo].bound_)) ++lo;
+  size_t hi = lo + 1;
+  visit(lo);
+  while (lo > 0 || hi < qty) {
+    if (hi == qty || (lo > 0 && distQC - shells[lo - 1].bound_ <= shells[hi - 1].bound_ - distQC)) {
+      visit(--lo);
+    } else {
+      visit(hi++);
+    }
+  }
+}
+
 template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
 template <typename QueryType>
 void VPTree<dist_t, SearchOracle, SearchOracleCreator>::VPNode::GenericSearch(QueryType* query,
-                                                                          int& MaxLeavesToVisit) {
+                                                                          int& MaxLeavesToVisit,
+                                                                          vector<dist_t>& QueryPath) {
   if (MaxLeavesToVisit <= 0) return; // early termination
   if (bucket_) {
     --MaxLeavesToVisit;
 
-    for (unsigned i = 0; i < bucket_->size(); ++i) {
-      const Object* Obj = (*bucket_)[i];
-      dist_t distQC = query->DistanceObjLeft(Obj);
-      query->CheckAndAddToResult(distQC, Obj);
-    }
+    const size_t PathQty = bucket_->empty() ? 0 : PivotDists_.size() / bucket_->size();
+    SearchBucket(query, bucket_->data(), bucket_->size(), transposed_, PivotDists_.data(), PathQty,
+                 QueryPath.data() + QueryPath.size() - PathQty, PathQty);
     return;
   }
 
   // Distance can be asymmetric, the pivot is always on the left side (see the function that create the node)!
   dist_t distQC = query->DistanceObjLeft(pivot_);
   query->CheckAndAddToResult(distQC, pivot_);
+  QueryPath.push_back(distQC);
+
+  const Shell* shells = shells_.data();
+  const size_t qty = shells_.size();
+  ForEachShell(distQC, shells, qty, [&](size_t i) {
+    if (shells[i].child_ != NULL && SEARCH_TRACE_EXPR(query, kTracePruning, VisitShell(*oracle_, distQC, query->Radius(), shells, qty, i)))
+      shells[i].child_->GenericSearch(query, MaxLeavesToVisit, QueryPath);
+  });
+  QueryPath.pop_back();
+}
+
+// The same as VPNode::GenericSearch()
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+template <typename QueryType>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::FlatSearch(QueryType* query, uint32_t node,
+                                                                   int& MaxLeavesToVisit,
+                                                                   vector<dist_t>& QueryPath) {
+  if (MaxLeavesToVisit <= 0) return; // early termination
+  const FlatNode& flat = flatNodes_[node];
+  if (flat.pivot_ == NULL) {
+    --MaxLeavesToVisit;
 
-  if (distQC < mediandist_) {      // the query is inside
-    // then first check inside
-    if (left_child_ != NULL && oracle_->Classify(distQC, query->Radius(), mediandist_) != kVisitRight)
-       left_child_->GenericSearch(query, MaxLeavesToVisit);
-
-    // after that outside
-    if (right_child_ != NULL && oracle_->Classify(distQC, query->Radius(), mediandist_) != kVisitLeft)
-       right_child_->GenericSearch(query, MaxLeavesToVisit);
-  } else {                         // the query is outside
-    // then first check outside
-    if (right_child_ != NULL && oracle_->Classify(distQC, query->Radius(), mediandist_) != kVisitLeft)
-       right_child_->GenericSearch(query, MaxLeavesToVisit);
-
-    // after that inside
-    if (left_child_ != NULL && oracle_->Classify(distQC, query->Radius(), mediandist_) != kVisitRight)
-      left_child_->GenericSearch(query, MaxLeavesToVisit);
+    const size_t PathQty = std::min(QueryPath.size(), MaxPathLen_);
+    SearchBucket(query, flatObjects_.data() + flat.BucketStart_, flat.BucketEnd_ - flat.BucketStart_,
+                 flatTransposed_[node].get(),
+                 flatPivotDists_.data() + flat.BucketStart_ * MaxPathLen_, MaxPathLen_,
+                 QueryPath.data() + QueryPath.size() - PathQty, PathQty);
+    return;
+  }
+
+  dist_t distQC = query->DistanceObjLeft(flat.pivot_);
+  query->CheckAndAddToResult(distQC, flat.pivot_);
+  QueryPath.push_back(distQC);
+
+  const FlatShell*  shells = flatShells_.data() + flat.ShellStart_;
+  const size_t      qty = flat.ShellQty_;
+  // A pivot without other objects (e.g., if bucketSize is zero) has neither shells nor an oracle
+  if (qty) {
+    DCHECK(flat.oracle_ != kFlatNull);
+    SearchOracle&   oracle = flatOracles_[flat.oracle_];
+    ForEachShell(distQC, shells, qty, [&](size_t i) {
+      if (shells[i].child_ != kFlatNull && SEARCH_TRACE_EXPR(query, kTracePruning, VisitShell(oracle, distQC, query->Radius(), shells, qty, i)))
+        FlatSearch(query, shells[i].child_, MaxLeavesToVisit, QueryPath);
+    });
+  }
+  QueryPath.pop_back();
+}
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+class VPTree<dist_t, SearchOracle, SearchOracleCreator>::PointerTreeView {
+ public:
+  typedef VPNode* Node;
+  explicit PointerTreeView(VPNode* root) : root_(root) {}
+
+  Node          Root() const { return root_; }
+  bool          IsNull(Node node) const { return node == NULL; }
+  bool          IsBucket(Node node) const { return node->bucket_ != NULL; }
+  const Object* Pivot(Node node) const { return node->pivot_; }
+  SearchOracle& Oracle(Node node) const { return *node->oracle_; }
+  // Shells have fields child_ and bound_
+  const typename VPNode::Shell* Shells(Node node) const { return node->shells_.data(); }
+  size_t        ShellQty(Node node) const { return node->shells_.size(); }
+
+  template <typename QueryType>
+  void SearchBucket(Node node, QueryType* query, const dist_t* QueryDists, size_t PathQty) const {
+    similarity::SearchBucket(query, node->bucket_->data(), node->bucket_->size(), node->transposed_,
+                             node->PivotDists_.data(), PathQty, QueryDists, PathQty);
+  }
+ private:
+  VPNode* root_;
+};
+
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+class VPTree<dist_t, SearchOracle, SearchOracleCreator>::FlatTreeView {
+ public:
+  typedef uint32_t Node;
+  explicit FlatTreeView(VPTree& tree) : tree_(tree) {}
+
+  Node          Root() const { return 0; }
+  bool          IsNull(Node node) const { return node == kFlatNull; }
+  bool          IsBucket(Node node) const { return tree_.flatNodes_[node].pivot_ == NULL; }
+  const Object* Pivot(Node node) const { return tree_.flatNodes_[node].pivot_; }
+  SearchOracle& Oracle(Node node) const {
+    DCHECK(tree_.flatNodes_[node].oracle_ != kFlatNull);
+    return tree_.flatOracles_[tree_.flatNodes_[node].oracle_];
+  }
+  const FlatShell* Shells(Node node) const { return tree_.flatShells_.data() + tree_.flatNodes_[node].ShellStart_; }
+  size_t        ShellQty(Node node) const { return tree_.flatNodes_[node].ShellQty_; }
+
+  template <typename QueryType>
+  void SearchBucket(Node node, QueryType* query, const dist_t* QueryDists, size_t PathQty) const {
+    const FlatNode& flat = tree_.flatNodes_[node];
+    similarity::SearchBucket(query, tree_.flatObjects_.data() + flat.BucketStart_, flat.BucketEnd_ - flat.BucketStart_,
+                             tree_.flatTransposed_[node].get(),
+                             tree_.flatPivotDists_.data() + flat.BucketStart_ * tree_.MaxPathLen_, tree_.MaxPathLen_,
+                             QueryDists, PathQty);
+  }
+ private:
+  VPTree& tree_;
+};
+
+/*
+ * Unexplored subtrees are kept in a priority queue. The key of a subtree is a lower bound
+ * on the distance from the query to its objects: the distance from d(pivot, q) to the
+ * closest bound of the shell (and zero for the shell containing the query), or
+ * the key of the parent, if it is larger. A subtree is expanded only if the oracle of
+ * its parent still allows visiting it: the query radius shrinks during the search.
+ * Because the closest subtrees are explored first, the radius shrinks faster and
+ * maxLeavesToVisit buckets are the most promising ones. If the oracle prunes all
+ * the subtrees whose lower bound exceeds the radius, the search stops as soon as
+ * the closest unexplored subtree is farther than the radius.
+ *
+ * Distances from the query to pivots are kept in a tree of paths: each subtree
+ * refers to the distance to the pivot of its parent, which refers to the previous one.
+ */
+template <typename dist_t, typename SearchOracle, typename SearchOracleCreator>
+template <typename TreeView>
+void VPTree<dist_t, SearchOracle, SearchOracleCreator>::BestFirstSearch(const TreeView& view,
+                                                                        KNNQuery<dist_t>* query) {
+  typedef typename TreeView::Node Node;
+  struct Subtree {
+    dist_t  bound_;
+    Node    node_;
+    Node    parent_;
+    dist_t  distQC_;  // The distance from the query to the pivot of the parent
+    int     path_;    // The position of distQC_ in paths (-1 for the root)
+    size_t  shell_;   // The shell of the parent
+    bool operator>(const Subtree& o) const { return bound_ > o.bound_; }
+  };
+  // Let's not allocate memory for each query
+  static thread_local vector<Subtree>                   queue;
+  // A distance to a pivot and the position of the previous distance on the path
+  static thread_local vector<std::pair<dist_t, int>>    paths;
+  static thread_local vector<dist_t>                    QueryDists;
+  const std::greater<Subtree>                           minHeapCmp;
+
+  // Checks if the oracle of the parent allows visiting the subtree
+  auto Visit = [&](Node parent, dist_t distQC, size_t shell) {
+    return SEARCH_TRACE_EXPR(query, kTracePruning, VisitShell(view.Oracle(parent), distQC, query->Radius(),
+                                                              view.Shells(parent), view.ShellQty(parent), shell));
+  };
+
+  int MaxLeavesToVisit = MaxLeavesToVisit_;
+  const bool StopBeyondRadius = OracleCreator_.PrunesBeyondRadius();
+
+  queue.clear();
+  paths.clear();
+  if (!view.IsNull(view.Root())) queue.push_back(Subtree{0, view.Root(), view.Root(), 0, -1, 0});
+
+  while (!queue.empty() && MaxLeavesToVisit > 0) {
+    const Subtree curr = queue.front();
+    {
+      SEARCH_TRACE_SCOPE(query, kTraceQueue);
+      std::pop_heap(queue.begin(), queue.end(), minHeapCmp);
+      queue.pop_back();
+    }
+    // Keys of the remaining subtrees are not smaller, and the radius doesn't grow
+    if (StopBeyondRadius && curr.bound_ > query->Radius()) break;
+
+    if (curr.node_ != view.Root() && !Visit(curr.parent_, curr.distQC_, curr.shell_)) continue;
+
+    if (view.IsBucket(curr.node_)) {
+      --MaxLeavesToVisit;
+      QueryDists.clear();
+      for (int i = curr.path_; i >= 0 && QueryDists.size() < MaxPathLen_; i = paths[i].second) {
+        QueryDists.push_back(paths[i].first);
+      }
+      std::reverse(QueryDists.begin(), QueryDists.end());
+      view.SearchBucket(curr.node_, query, QueryDists.data(), QueryDists.size());
+      continue;
+    }
+
+    // Distance can be asymmetric, the pivot is always on the left side!
+    const Object* pivot = view.Pivot(curr.node_);
+    const dist_t  distQC = query->DistanceObjLeft(pivot);
+    query->CheckAndAddToResult(distQC, pivot);
+    const int     path = paths.size();
+    paths.emplace_back(distQC, curr.path_);
+
+    const auto*   shells = view.Shells(curr.node_);
+    const size_t  qty = view.ShellQty(curr.node_);
+    for (size_t i = 0; i < qty; ++i) {
+      if (view.IsNull(shells[i].child_) || !Visit(curr.node_, distQC, i)) continue;
+      const dist_t bound = std::max<dist_t>(curr.bound_, ShellLowerBound(distQC, shells, qty, i));
+      SEARCH_TRACE_SCOPE(query, kTraceQueue);
+      queue.push_back(Subtree{bound, shells[i].child_, curr.node_, distQC, path, i});
+      std::push_heap(queue.begin(), queue.end(), minHeapCmp);
+    }
   }
 }
 
@@ -46,6 +46,7 @@ void ParseCommandLine(int argc, char*argv[],
                       shared_ptr<AnyParams>&  SpaceParams,
                       unsigned&               dimension,
                       unsigned&               ThreadTestQty,
+                      bool&                   PerfCounters,
                       bool&                   AppendToResFile,
                       string&                 ResFilePrefix,
                       unsigned&               TestSetQty,
@@ -56,6 +57,12 @@ void ParseCommandLine(int argc, char*argv[],
                       vector<unsigned>&       knn,
                       float&                  eps,
                       string&                 RangeArg,
+                      string&                 SaveIndexPrefix,
+                      string&                 LoadIndexPrefix,
+                      string&                 CachePrefixGS,
+                      unsigned&               MaxCacheGSRelativeQty,
+                      bool&                   KeepAllDistsGS,
+                      unsigned&               ThreadGSQty,
                       multimap<string, shared_ptr<AnyParams>>& pars) {
   knn.clear();
   RangeArg.clear();
@@ -98,10 +105,32 @@ void ParseCommandLine(int argc, char*argv[],
                         "<method name>:<param1>,<param2>,...,<paramK>")
     ("threadTestQty",   po::value<unsigned>(&ThreadTestQty)->default_value(1),
                         "# of threads")
+    ("perfCounters",    po::value<bool>(&PerfCounters)->default_value(false),
+                        "collect hardware performance counters (cycles, instructions, LLC and branch misses)"
+                        " during efficiency testing (Linux only)")
     ("outFilePrefix,o", po::value<string>(&ResFilePrefix)->default_value(""),
                         "output file prefix")
     ("appendToResFile", po::value<bool>(&AppendToResFile)->default_value(false),
                         "do not override information in results files, append new data")
+    ("saveIndex",       po::value<string>(&SaveIndexPrefix)->default_value(""),
+                        "index file prefix: if specified, each index is saved to <prefix>.<method name>.<index parameters>,"
+                        " e.g., <prefix>.vptree.bucketSize=50,arity=2,maxPathLen=0")
+    ("loadIndex",       po::value<string>(&LoadIndexPrefix)->default_value(""),
+                        "index file prefix: if specified, each index is loaded from <prefix>.<method name>.<index parameters>"
+                        " instead of being built (the data set should be the same)")
+    ("cachePrefixGS",   po::value<string>(&CachePrefixGS)->default_value(""),
+                        "gold standard cache file prefix: if specified, the gold standard for the i-th test set"
+                        " is loaded from (or saved to) <prefix>_tset=i")
+    ("maxCacheGSRelativeQty", po::value<unsigned>(&MaxCacheGSRelativeQty)->default_value(10),
+                        "the gold standard keeps only maxCacheGSRelativeQty * (the largest K) closest points"
+                        " per query (plus all the points within the largest radius); zero means keeping all the points")
+    ("keepAllDistsGS",  po::value<bool>(&KeepAllDistsGS)->default_value(true),
+                        "the gold standard keeps sorted distances to all the data points, so that RelPosError"
+                        " and NumCloser are exact (this takes #queries * #data points distance values of memory);"
+                        " if zero (and maxCacheGSRelativeQty isn't), RelPosError and NumCloser of found points"
+                        " beyond the kept ones are underestimated, which is noted in the reports")
+    ("threadGSQty",     po::value<unsigned>(&ThreadGSQty)->default_value(0),
+                        "# of threads computing the gold standard (0 means the number of hardware threads)")
 
     ;
 
@@ -0,0 +1,131 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#ifdef __linux
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <atomic>
+
+#include "perf_counters.h"
+#include "logging.h"
+
+namespace similarity {
+
+const char* PerfCounterName(unsigned counter) {
+  static const char* names[kPerfCounterQty] = {"Cycles", "Instructions", "LLCMisses", "BranchMisses"};
+  return counter < kPerfCounterQty ? names[counter] : "Unknown";
+}
+
+#ifdef __linux
+
+static int OpenCounter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+
+  attr.size           = sizeof(attr);
+  attr.type           = type;
+  attr.config         = config;
+  attr.disabled       = 1;
+  attr.inherit        = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &attr, 0 /* this process */, -1 /* any CPU */, -1 /* no group */, 0);
+}
+
+PerfCounters::PerfCounters() {
+  static const uint32_t type[kPerfCounterQty] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+  };
+  static const uint64_t config[kPerfCounterQty] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+  // Let's not flood the log: the reason is the same for all the experiments
+  static std::atomic<bool> reported(false);
+
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+    fd_[i] = OpenCounter(type[i], config[i]);
+    if (fd_[i] < 0 && !reported.exchange(true)) {
+      LOG(INFO) << "Hardware counter " << PerfCounterName(i) << " is unavailable: " << strerror(errno)
+                << " (check /proc/sys/kernel/perf_event_paranoid)";
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+    if (fd_[i] >= 0) close(fd_[i]);
+  }
+}
+
+void PerfCounters::Start() {
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+    if (fd_[i] >= 0) {
+      ioctl(fd_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void PerfCounters::Stop() {
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+    if (fd_[i] >= 0) ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+  }
+}
+
+uint64_t PerfCounters::Get(unsigned counter) const {
+  if (fd_[counter] < 0) return 0;
+
+  // value, time enabled, time running
+  uint64_t data[3];
+  if (read(fd_[counter], data, sizeof(data)) != sizeof(data) || !data[2]) return 0;
+  // Extrapolate if the counter was multiplexed
+  if (data[2] < data[1]) {
+    return static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+  }
+  return data[0];
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) fd_[i] = -1;
+  LOG(INFO) << "Hardware counters are supported only on Linux";
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::Start() {}
+void PerfCounters::Stop() {}
+uint64_t PerfCounters::Get(unsigned counter) const { return 0; }
+
+#endif
+
+bool PerfCounters::IsAnyAvailable() const {
+  for (unsigned i = 0; i < kPerfCounterQty; ++i) {
+    if (IsAvailable(i)) return true;
+  }
+  return false;
+}
+
+}   // namespace similarity
@@ -21,9 +21,13 @@
 #include "object.h"
 #include "utils.h"
 #include "query.h"
+#include "transposed_bucket.h"
 
 namespace similarity {
 
+template <typename dist_t>
+const size_t Query<dist_t>::kDistanceBatchQty;
+
 template <typename dist_t>
 Query<dist_t>::Query(const Space<dist_t>* space, const Object* query_object)
     : space_(space),
@@ -54,10 +58,26 @@ template <typename dist_t>
 dist_t Query<dist_t>::Distance(
     const Object* object1,
     const Object* object2) {
+  SEARCH_TRACE_SCOPE(this, kTraceDistance);
   ++distance_computations_;
   return space_->HiddenDistance(object1, object2);
 }
 
+template <typename dist_t>
+void Query<dist_t>::DistanceBatch(const Object* const* objs, size_t qty, dist_t* out) {
+  SEARCH_TRACE_SCOPE(this, kTraceDistance);
+  distance_computations_ += qty;
+  space_->BatchDistance(query_object_, objs, qty, out);
+}
+
+template <typename dist_t>
+void Query<dist_t>::DistanceTransposed(const TransposedBucket<dist_t>& bucket, size_t start, size_t qty, dist_t* out) {
+  SEARCH_TRACE_SCOPE(this, kTraceDistance);
+  CHECK(start + qty <= bucket.size());
+  distance_computations_ += qty;
+  space_->TransposedDistance(query_object_, bucket.data(), bucket.dim(), bucket.stride(), start, qty, out);
+}
+
 template <typename dist_t>
 dist_t Query<dist_t>::DistanceObjLeft(const Object* object) {
   return Distance(object, query_object_);
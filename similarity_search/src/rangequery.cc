@@ -22,6 +22,7 @@
 #include "object.h"
 #include "utils.h"
 #include "rangequery.h"
+#include "transposed_bucket.h"
 
 namespace similarity {
 
@@ -66,6 +67,7 @@ void RangeQuery<dist_t>::Reset() {
 template <typename dist_t>
 bool RangeQuery<dist_t>::CheckAndAddToResult(const dist_t distance,
                                              const Object* object) {
+  SEARCH_TRACE_SCOPE(this, kTraceQueue);
   if (distance <= radius_) {
     result_.push_back(object);
     resultDists_.push_back(distance);
@@ -82,10 +84,37 @@ bool RangeQuery<dist_t>::CheckAndAddToResult(const Object* object) {
 
 template <typename dist_t>
 size_t RangeQuery<dist_t>::CheckAndAddToResult(const ObjectVector& bucket) {
+  return CheckAndAddToResult(bucket.data(), bucket.size());
+}
+
+template <typename dist_t>
+size_t RangeQuery<dist_t>::CheckAndAddToResult(const Object* const* objs, size_t qty) {
+  size_t res = 0;
+  dist_t dists[Query<dist_t>::kDistanceBatchQty];
+  for (size_t start = 0; start < qty; start += Query<dist_t>::kDistanceBatchQty) {
+    const size_t BatchQty = std::min(Query<dist_t>::kDistanceBatchQty, qty - start);
+    this->DistanceBatch(objs + start, BatchQty, dists);
+    for (size_t i = 0; i < BatchQty; ++i) {
+      if (CheckAndAddToResult(dists[i], objs[start + i])) {
+        ++res;
+      }
+    }
+  }
+  return res;
+}
+
+template <typename dist_t>
+size_t RangeQuery<dist_t>::CheckAndAddToResult(const Object* const* objs, const TransposedBucket<dist_t>& bucket) {
+  const size_t qty = bucket.size();
   size_t res = 0;
-  for (size_t i = 0; i < bucket.size(); ++i) {
-    if (CheckAndAddToResult(bucket[i])) {
-      ++res;
+  dist_t dists[Query<dist_t>::kDistanceBatchQty];
+  for (size_t start = 0; start < qty; start += Query<dist_t>::kDistanceBatchQty) {
+    const size_t BatchQty = std::min(Query<dist_t>::kDistanceBatchQty, qty - start);
+    this->DistanceTransposed(bucket, start, BatchQty, dists);
+    for (size_t i = 0; i < BatchQty; ++i) {
+      if (CheckAndAddToResult(dists[i], objs[start + i])) {
+        ++res;
+      }
     }
   }
   return res;
@@ -0,0 +1,43 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include "search_trace.h"
+#include "ztimer.h"
+
+namespace similarity {
+
+static double EstimateTicksPerNanosec() {
+#if defined(__x86_64__) || defined(__i386__)
+  // Counts TSC ticks during (at least) 20 ms of wall-clock time
+  WallClockTimer  timer;
+  uint64_t        start = SearchTraceTicks();
+  uint64_t        nsec;
+
+  while ((nsec = timer.splitnsec()) < 20000000ULL);
+
+  return static_cast<double>(SearchTraceTicks() - start) / nsec;
+#else
+  return 1.0;
+#endif
+}
+
+double SearchTraceTicksPerNanosec() {
+  // The initialization of a local static variable is thread-safe in C++11
+  static const double res = EstimateTicksPerNanosec();
+  return res;
+}
+
+}   // namespace similarity
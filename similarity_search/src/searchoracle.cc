@@ -63,7 +63,8 @@ SamplingOracle<dist_t>::SamplingOracle(
                    float  QuantileStepPivot,
                    float  QuantileStepPseudoQuery,
                    size_t NumOfPseudoQueriesInQuantile,
-                   float  DistLearnThreshold
+                   float  DistLearnThreshold,
+                   mt19937& gen
                    ) : NotEnoughData_(false)
 {
   CHECK(QuantileStepPivot > 0 && QuantileStepPivot < 1);
@@ -100,7 +101,7 @@ SamplingOracle<dist_t>::SamplingOracle(
   if (dists.size() < MinReqSize) {
     // Let's ignore a few unlikely duplicates
     for (unsigned i = 0; i < MinReqSize - dists.size(); ++i) {
-      size_t RandId = RandomInt() % AllVectors.size();
+      size_t RandId = gen() % AllVectors.size();
 
       // Distance can be asymmetric, pivot should be on the left
       dists.push_back(std::make_pair(space->IndexTimeDistance(pivot, AllVectors[RandId]), AllVectors[RandId]));
@@ -133,7 +134,7 @@ SamplingOracle<dist_t>::SamplingOracle(
         size_t d = qind[quant + 1] - qind[quant];
         CHECK(d > 0);
 
-        size_t Id = qind[quant] + static_cast<size_t>(RandomInt() % d);
+        size_t Id = qind[quant] + static_cast<size_t>(gen() % d);
 
         CHECK(qind[quant] <= Id && Id < qind[quant + 1]);
 
@@ -205,7 +206,7 @@ SamplingOracle<dist_t>::SamplingOracle(
           }
         } else {
           for (size_t k = 0; k < MaxK; ++k) {
-            size_t Id = static_cast<size_t>(RandomInt() % dists.size());
+            size_t Id = static_cast<size_t>(gen() % dists.size());
             const Object* ThatObj = dists[Id].second;
 
             // distance can be asymmetric, but the pivot is on the left
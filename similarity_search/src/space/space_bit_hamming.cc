@@ -19,12 +19,16 @@
 #include <string>
 #include <sstream>
 #include <bitset>
+#include <stdexcept>
 
 #include "space_bit_hamming.h"
 #include "permutation_utils.h"
 #include "logging.h"
 #include "distcomp.h"
 #include "experimentconf.h"
+#include "object_arena.h"
+#include "binary_dataset.h"
+#include "text_reader.h"
 
 namespace similarity {
 
@@ -38,29 +42,21 @@ int SpaceBitHamming::HiddenDistance(const Object* obj1, const Object* obj2) cons
   return BitHamming(x, y, length);
 }
 
-void SpaceBitHamming::ReadVec(std::string line, std::vector<uint32_t>& binVect) const
+void SpaceBitHamming::ReadVec(const char* line, size_t len, std::vector<PivotIdType>& v, std::vector<uint32_t>& binVect) const
 {
   binVect.clear();
-  std::stringstream str(line);
+  v.clear();
 
-  str.exceptions(std::ios::badbit);
+  const char* p = line;
+  const char* end = line + len;
+  uint32_t    val;
 
-  unsigned val;
-
-  ReplaceSomePunct(line); 
-
-  vector<PivotIdType> v;
-
-  try {
-    while (str >> val) {
-      if (val != 0 && val != 1) {
-        LOG(FATAL) << "Only zeros and ones are allowed, line: '" << line << "'";
-      }
-      v.push_back(val);
+  while (ReadNextNum(p, end, val)) {
+    if (val != 0 && val != 1) {
+      // This function runs in reading threads: the error is reported by ReadDataset
+      throw std::runtime_error("Only zeros and ones are allowed, line: '" + string(line, len) + "'");
     }
-  } catch (const std::exception &e) {
-    LOG(ERROR) << "Exception: " << e.what() << std::endl;
-    LOG(FATAL) << "Failed to parse the line: '" << line << "'" << std::endl;
+    v.push_back(val);
   }
   Binarize(v, 1, binVect);
 /*
@@ -70,6 +66,27 @@ void SpaceBitHamming::ReadVec(std::string line, std::vector<uint32_t>& binVect)
 */
 }
 
+/*
+ * Parses a line and creates an object (in the arena of the thread, if it isn't NULL).
+ * Each reading thread has its own copy.
+ * The result is the object plus the # of words in the binarized vector.
+ */
+class SpaceBitHamming::LineParser {
+ public:
+  typedef std::pair<Object*, int> ResultType;
+
+  LineParser(const SpaceBitHamming* space) : space_(space) {}
+
+  ResultType operator()(size_t id, const char* line, size_t len, ObjectArena* arena) {
+    space_->ReadVec(line, len, temp_, binTemp_);
+    return std::make_pair(space_->CreateObjFromVect(id, binTemp_, arena), static_cast<int>(binTemp_.size()));
+  }
+
+ private:
+  const SpaceBitHamming*    space_;
+  std::vector<PivotIdType>  temp_;
+  std::vector<uint32_t>     binTemp_;
+};
 
 void SpaceBitHamming::ReadDataset(
     ObjectVector& dataset,
@@ -80,23 +97,27 @@ void SpaceBitHamming::ReadDataset(
   dataset.clear();
   dataset.reserve(MaxNumObjects);
 
-  std::vector<uint32_t>    temp;
+  ObjectArena* arena = config ? config->GetArena() : NULL;
 
-  std::ifstream InFile(FileName);
-  InFile.exceptions(std::ios::badbit);
+  if (IsBinaryDataset(FileName)) {
+    ReadBinaryDataset(dataset, arena, ToString(), DistTypeName<int>(), FileName,
+                      0 /* dimension is ignored */, MaxNumObjects);
+    return;
+  }
 
   try {
+    std::vector<LineParser::ResultType> parsed;
 
-    std::string StrLine;
+    ParallelParseTextFile(FileName, MaxNumObjects, false /* don't skip empty lines */,
+                          LineParser(this), parsed,
+                          0 /* use all the cores */, arena);
 
-    int linenum = 0;
-    int id = linenum;
+    dataset.reserve(parsed.size());
 
     int wordQty = 0;
 
-    while (getline(InFile, StrLine) && (!MaxNumObjects || linenum < MaxNumObjects)) {
-      ReadVec(StrLine, temp);
-      int currWordQty = static_cast<int>(temp.size());
+    for (size_t linenum = 0; linenum < parsed.size(); ++linenum) {
+      int currWordQty = parsed[linenum].second;
       if (!wordQty) wordQty = currWordQty;
       else {
         if (wordQty != currWordQty) {
@@ -105,10 +126,7 @@ void SpaceBitHamming::ReadDataset(
                       "Found mismatch in line: " << (linenum + 1) << " file: " << FileName;
         }
       }
-
-      id = linenum;
-      ++linenum;
-      dataset.push_back(CreateObjFromVect(id, temp));
+      dataset.push_back(parsed[linenum].first);
     }
     LOG(INFO) << "Number of words per vector : " << wordQty;
   } catch (const std::exception &e) {
@@ -117,8 +135,8 @@ void SpaceBitHamming::ReadDataset(
   }
 }
 
-Object* SpaceBitHamming::CreateObjFromVect(size_t id, const std::vector<uint32_t>& InpVect) const {
-  return new Object(id, InpVect.size() * sizeof(uint32_t), &InpVect[0]);
+Object* SpaceBitHamming::CreateObjFromVect(size_t id, const std::vector<uint32_t>& InpVect, ObjectArena* arena) const {
+  return NewObject(arena, id, InpVect.size() * sizeof(uint32_t), &InpVect[0]);
 };
 
 }  // namespace similarity
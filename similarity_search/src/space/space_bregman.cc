@@ -28,24 +28,45 @@ namespace similarity {
 
 template <typename dist_t>
 Object* BregmanDiv<dist_t>::Mean(const ObjectVector& data) const {
+  TaskPool pool(1);
+  return Mean(data, pool);
+}
+
+template <typename dist_t>
+Object* BregmanDiv<dist_t>::Mean(const ObjectVector& data, TaskPool& pool) const {
   CHECK(!data.empty());
 
+  const size_t ChunkQty = 1024;
+
   // the caller is responsible for releasing the pointer
   Object* mean = Object::CreateNewEmptyObject(data[0]->datalength());
 
   const size_t length = GetElemQty(data[0]);
   dist_t* x = reinterpret_cast<dist_t*>(mean->data());
 
+  // sum chunks
+  vector<vector<dist_t>> sums((data.size() + ChunkQty - 1) / ChunkQty, vector<dist_t>(length));
+
+  pool.ParallelFor(0, sums.size(), 1, [&](size_t chunk) {
+    vector<dist_t>& sum = sums[chunk];
+    const size_t end = std::min(data.size(), (chunk + 1) * ChunkQty);
+    for (size_t i = chunk * ChunkQty; i < end; ++i) {
+      const dist_t* y = reinterpret_cast<const dist_t*>(data[i]->data());
+      for (size_t d = 0; d < length; ++d) {
+        sum[d] += y[d];
+      }
+    }
+  });
+
   // init
   for (size_t d = 0; d < length; ++d) {
     x[d] = 0.0;
   }
 
   // sum
-  for (auto it = data.begin(); it != data.end(); ++it) {
-    const dist_t* y = reinterpret_cast<const dist_t*>((*it)->data());
+  for (const auto& sum : sums) {
     for (size_t d = 0; d < length; ++d) {
-      x[d] += y[d];
+      x[d] += sum[d];
     }
   }
 
@@ -54,6 +75,8 @@ Object* BregmanDiv<dist_t>::Mean(const ObjectVector& data) const {
     x[d] /= static_cast<double>(data.size());
   }
 
+  FinalizeMean(mean);
+
   return mean;
 }
 
@@ -105,18 +128,10 @@ Object* KLDivAbstract<dist_t>::InverseGradientFunction(const Object* object) con
 //=============================================================
 
 template <typename dist_t>
-Object* KLDivGenFast<dist_t>::Mean(const ObjectVector& data) const {
-  CHECK(!data.empty());
-
-  // the caller is responsible for releasing the pointer
-  Object* mean = BregmanDiv<dist_t>::Mean(data);
-
-  const size_t length = GetElemQty(data[0]);
+void KLDivGenFast<dist_t>::FinalizeMean(Object* mean) const {
   dist_t* x = reinterpret_cast<dist_t*>(mean->data());
 
-  PrecompLogarithms(x, length);
-
-  return mean;
+  PrecompLogarithms(x, GetElemQty(mean));
 }
 
 template <typename dist_t>
@@ -143,32 +158,31 @@ dist_t KLDivGenFast<dist_t>::HiddenDistance(const Object* obj1, const Object* ob
 }
 
 template <typename dist_t>
-Object* KLDivGenFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+void KLDivGenFast<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return KLGeneralPrecompSIMD(x, y, length); });
+}
+
+template <typename dist_t>
+Object* KLDivGenFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   std::vector<dist_t>   temp(InpVect);
 
   // Reserve space to store logarithms
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 
 //=============================================================
 
 template <typename dist_t>
-Object* ItakuraSaitoFast<dist_t>::Mean(const ObjectVector& data) const {
-  CHECK(!data.empty());
-
-  // the caller is responsible for releasing the pointer
-  Object* mean = BregmanDiv<dist_t>::Mean(data);
-
-  const size_t length = GetElemQty(data[0]);
+void ItakuraSaitoFast<dist_t>::FinalizeMean(Object* mean) const {
   dist_t* x = reinterpret_cast<dist_t*>(mean->data());
 
-  PrecompLogarithms(x, length);
-
-  return mean;
+  PrecompLogarithms(x, GetElemQty(mean));
 }
 
 template <typename dist_t>
@@ -227,14 +241,21 @@ dist_t ItakuraSaitoFast<dist_t>::HiddenDistance(const Object* obj1, const Object
 }
 
 template <typename dist_t>
-Object* ItakuraSaitoFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+void ItakuraSaitoFast<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return ItakuraSaitoPrecompSIMD(x, y, length); });
+}
+
+template <typename dist_t>
+Object* ItakuraSaitoFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   std::vector<dist_t>   temp(InpVect);
 
   // Reserve space to store logarithms
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 //=============================================================
@@ -252,8 +273,15 @@ dist_t KLDivGenSlow<dist_t>::HiddenDistance(const Object* obj1, const Object* ob
 }
 
 template <typename dist_t>
-Object* KLDivGenSlow<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
-  return new Object(id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
+void KLDivGenSlow<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return KLGeneralStandard(x, y, length); });
+}
+
+template <typename dist_t>
+Object* KLDivGenSlow<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
+  return NewObject(arena, id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
 }
 
 template <typename dist_t>
@@ -269,14 +297,21 @@ dist_t KLDivGenFastRightQuery<dist_t>::HiddenDistance(const Object* obj1, const
 }
 
 template <typename dist_t>
-Object* KLDivGenFastRightQuery<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+void KLDivGenFastRightQuery<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return KLGeneralPrecompSIMD(y, x, length); });
+}
+
+template <typename dist_t>
+Object* KLDivGenFastRightQuery<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   std::vector<dist_t>   temp(InpVect);
 
   // Reserve space to store logarithms
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 //=============================================================
@@ -294,14 +329,21 @@ dist_t KLDivFast<dist_t>::HiddenDistance(const Object* obj1, const Object* obj2)
 }
 
 template <typename dist_t>
-Object* KLDivFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+void KLDivFast<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return KLPrecompSIMD(x, y, length); });
+}
+
+template <typename dist_t>
+Object* KLDivFast<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   std::vector<dist_t>   temp(InpVect);
 
   // Reserve space to store logarithms
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 //=============================================================
@@ -319,14 +361,21 @@ dist_t KLDivFastRightQuery<dist_t>::HiddenDistance(const Object* obj1, const Obj
 }
 
 template <typename dist_t>
-Object* KLDivFastRightQuery<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+void KLDivFastRightQuery<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, GetElemQty(query),
+                            [](const dist_t* x, const dist_t* y, size_t length) { return KLPrecompSIMD(y, x, length); });
+}
+
+template <typename dist_t>
+Object* KLDivFastRightQuery<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   std::vector<dist_t>   temp(InpVect);
 
   // Reserve space to store logarithms
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 template class BregmanDiv<float>;
@@ -46,6 +46,10 @@ void SpaceDummy<dist_t>::ReadDataset(
     const char* FileName,
     const int MaxNumObjects) const {
   LOG(INFO) << "Reading at most " << MaxNumObjects << " from the file: " << FileName;
+  /*
+   * If config isn't NULL, objects should be created in the arena, e.g.:
+   * dataset.push_back(NewObject(config->GetArena(), id, datalength, data));
+   */
 }
 
 template class SpaceDummy<int>;
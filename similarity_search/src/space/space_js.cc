@@ -27,9 +27,9 @@
 namespace similarity {
 
 template <typename dist_t>
-Object* SpaceJSBase<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
+Object* SpaceJSBase<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
   if (type_ == kJSSlow) {
-    return new Object(id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
+    return NewObject(arena, id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
   }
   std::vector<dist_t>   temp(InpVect);
 
@@ -37,7 +37,7 @@ Object* SpaceJSBase<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist
   temp.resize(2 * InpVect.size());
   // Compute logarithms
   PrecompLogarithms(&temp[0], InpVect.size());
-  return new Object(id, temp.size() * sizeof(dist_t), &temp[0]);
+  return NewObject(arena, id, temp.size() * sizeof(dist_t), &temp[0]);
 }
 
 
@@ -64,6 +64,36 @@ dist_t SpaceJSBase<dist_t>::JensenShannonFunc(const Object* obj1, const Object*
   return val;
 }
 
+// The function is chosen once for all the objects
+template <typename dist_t>
+void SpaceJSBase<dist_t>::JensenShannonBatch(const Object* query, const Object* const* objs, size_t qty,
+                                             dist_t* out, bool TakeSqrt) const {
+  CHECK(query->datalength() > 0);
+  size_t length = query->datalength() / sizeof(dist_t);
+
+  if (type_ != kJSSlow) length /= 2;
+
+  switch (type_) {
+    case kJSSlow:
+      this->BatchVectorDistance(query, objs, qty, out, length,
+                                [](const dist_t* x, const dist_t* y, size_t n) { return JSStandard(x, y, n); });
+      break;
+    case kJSFastPrecomp:
+      this->BatchVectorDistance(query, objs, qty, out, length,
+                                [](const dist_t* x, const dist_t* y, size_t n) { return JSPrecomp(x, y, n); });
+      break;
+    case kJSFastPrecompApprox:
+      this->BatchVectorDistance(query, objs, qty, out, length,
+                                [](const dist_t* x, const dist_t* y, size_t n) { return JSPrecompSIMDApproxLog(x, y, n); });
+      break;
+    default: LOG(FATAL) << "Unknown JS function type code: " << type_ << endl;
+  }
+
+  if (TakeSqrt) {
+    for (size_t i = 0; i < qty; ++i) out[i] = sqrt(out[i]);
+  }
+}
+
 template class SpaceJSBase<float>;
 template class SpaceJSBase<double>;
 
@@ -36,6 +36,49 @@ dist_t SpaceLp<dist_t>::HiddenDistance(const Object* obj1, const Object* obj2) c
   return distObj_(x, y, length);
 }
 
+// The implementation is chosen once for all the objects
+template <typename dist_t>
+void SpaceLp<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty, dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  const size_t length = query->datalength() / sizeof(dist_t);
+  const dist_t p = distObj_.getP();
+
+  if (distObj_.getCustom() && p == -1) {
+    this->BatchVectorDistance(query, objs, qty, out, length,
+                              [](const dist_t* x, const dist_t* y, size_t n) { return LInfNormSIMD(x, y, n); });
+  } else if (distObj_.getCustom() && p == 1) {
+    this->BatchVectorDistance(query, objs, qty, out, length,
+                              [](const dist_t* x, const dist_t* y, size_t n) { return L1NormSIMD(x, y, n); });
+  } else if (distObj_.getCustom() && p == 2) {
+    this->BatchVectorDistance(query, objs, qty, out, length,
+                              [](const dist_t* x, const dist_t* y, size_t n) { return L2NormSIMD(x, y, n); });
+  } else {
+    this->BatchVectorDistance(query, objs, qty, out, length, distObj_);
+  }
+}
+
+template <typename dist_t>
+size_t SpaceLp<dist_t>::TransposedDim(const Object* obj) const {
+  return distObj_.getCustom() ? obj->datalength() / sizeof(dist_t) : 0;
+}
+
+template <typename dist_t>
+void SpaceLp<dist_t>::TransposedDistance(const Object* query, const dist_t* block, size_t dim, size_t stride,
+                                         size_t start, size_t qty, dist_t* out) const {
+  CHECK(distObj_.getCustom());
+  CHECK(query->datalength() == dim * sizeof(dist_t));
+  const dist_t* y = reinterpret_cast<const dist_t*>(query->data());
+  const dist_t  p = distObj_.getP();
+
+  if (p == -1) {
+    LInfNormTransposed(y, block, dim, stride, start, qty, out);
+  } else if (p == 1) {
+    L1NormTransposed(y, block, dim, stride, start, qty, out);
+  } else {
+    L2NormTransposed(y, block, dim, stride, start, qty, out);
+  }
+}
+
 template <typename dist_t>
 std::string SpaceLp<dist_t>::ToString() const {
   std::stringstream stream;
@@ -39,6 +39,18 @@ dist_t SpaceCosineSimilarity<dist_t>::HiddenDistance(const Object* obj1, const O
   return val;
 }
 
+template <typename dist_t>
+void SpaceCosineSimilarity<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty,
+                                                  dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, query->datalength() / sizeof(dist_t),
+                            [](const dist_t* x, const dist_t* y, size_t length) {
+    dist_t val = CosineSimilarity(x, y, length);
+    if (std::isnan(val)) LOG(FATAL) << "Bug: NAN dist!!!!";
+    return val;
+  });
+}
+
 template class SpaceCosineSimilarity<float>;
 template class SpaceCosineSimilarity<double>;
 
@@ -56,6 +68,18 @@ dist_t SpaceAngularDistance<dist_t>::HiddenDistance(const Object* obj1, const Ob
   return val;
 }
 
+template <typename dist_t>
+void SpaceAngularDistance<dist_t>::BatchDistance(const Object* query, const Object* const* objs, size_t qty,
+                                                 dist_t* out) const {
+  CHECK(query->datalength() > 0);
+  this->BatchVectorDistance(query, objs, qty, out, query->datalength() / sizeof(dist_t),
+                            [](const dist_t* x, const dist_t* y, size_t length) {
+    dist_t val = AngularDistance(x, y, length);
+    if (std::isnan(val)) LOG(FATAL) << "Bug: NAN dist!!!!";
+    return val;
+  });
+}
+
 template class SpaceAngularDistance<float>;
 template class SpaceAngularDistance<double>;
 
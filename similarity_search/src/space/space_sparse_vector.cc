@@ -24,80 +24,95 @@
 #include "logging.h"
 #include "distcomp.h"
 #include "experimentconf.h"
+#include "object_arena.h"
+#include "binary_dataset.h"
+#include "text_reader.h"
 
 namespace similarity {
 
 template <typename dist_t>
-void SpaceSparseVector<dist_t>::ReadSparseVec(std::string line, std::vector<ElemType>& v) const
+void SpaceSparseVector<dist_t>::ReadSparseVec(const char* line, size_t len, std::vector<ElemType>& v) const
 {
   v.clear();
-  std::stringstream str(line);
 
-  str.exceptions(std::ios::badbit);
+  const char* p = line;
+  const char* end = line + len;
+  uint32_t    id;
+  dist_t      val;
 
-  uint32_t id;
-  dist_t   val;
+  // This function runs in reading threads: errors are reported by ReadDataset
+  while (ReadNextNum(p, end, id) && ReadNextNum(p, end, val)) {
+    v.push_back(ElemType(id, val));
+  }
+  sort(v.begin(), v.end());
 
-  ReplaceSomePunct(line); 
+  for (unsigned i = 1; i < v.size(); ++i) {
+    uint32_t  prevId = v[i-1].first;
+    uint32_t  id = v[i].first;
 
-  try {
-    while (str >> id && str >> val) {
-      v.push_back(ElemType(id, val));
+    if (id == prevId) {
+      stringstream err;
+      err << "Repeating ID: prevId = " << prevId << " current id: " << id
+          << " in the line: '" << string(line, len) << "'";
+      throw std::runtime_error(err.str());
     }
-    sort(v.begin(), v.end());
-
-    for (unsigned i = 1; i < v.size(); ++i) {
-      uint32_t  prevId = v[i-1].first;
-      uint32_t  id = v[i].first;
-
-      if (id == prevId) {
-        stringstream err;
-        err << "Repeating ID: prevId = " << prevId << " current id: " << id;
-        throw std::runtime_error(err.str());
-      }
-
-      if (id < prevId) {
-        stringstream err;
-        err << "But: Ids are not sorted, prevId = " << prevId << " current id: " << id;
-        throw std::runtime_error(err.str());
-      }
+
+    if (id < prevId) {
+      stringstream err;
+      err << "But: Ids are not sorted, prevId = " << prevId << " current id: " << id
+          << " in the line: '" << string(line, len) << "'";
+      throw std::runtime_error(err.str());
     }
-  } catch (const std::exception &e) {
-    LOG(ERROR) << "Exception: " << e.what() << std::endl;
-    LOG(FATAL) << "Failed to parse the line: '" << line << "'" << std::endl;
   }
 }
 
+/*
+ * Parses a line and creates an object (in the arena of the thread, if it isn't NULL).
+ * Each reading thread has its own copy.
+ */
+template <typename dist_t>
+class SpaceSparseVector<dist_t>::LineParser {
+ public:
+  typedef Object* ResultType;
+
+  LineParser(const SpaceSparseVector<dist_t>* space) : space_(space) {}
+
+  ResultType operator()(size_t id, const char* line, size_t len, ObjectArena* arena) {
+    space_->ReadSparseVec(line, len, temp_);
+    return space_->CreateObjFromVect(id, temp_, arena);
+  }
+
+ private:
+  const SpaceSparseVector<dist_t>*  space_;
+  std::vector<ElemType>             temp_;
+};
 
 template <typename dist_t>
 void SpaceSparseVector<dist_t>::ReadDataset(
     ObjectVector& dataset,
-    const ExperimentConfig<dist_t>* /* ignoring it here */,
+    const ExperimentConfig<dist_t>* config,
     const char* FileName,
     const int MaxNumObjects) const {
 
   dataset.clear();
   dataset.reserve(MaxNumObjects);
 
-  std::vector<ElemType>    temp;
+  ObjectArena* arena = config ? config->GetArena() : NULL;
 
-  std::ifstream InFile(FileName);
-  InFile.exceptions(std::ios::badbit);
+  if (IsBinaryDataset(FileName)) {
+    ReadBinaryDataset(dataset, arena, this->ToString(), DistTypeName<dist_t>(), FileName,
+                      0 /* dimension is ignored */, MaxNumObjects);
+    return;
+  }
 
   try {
+    std::vector<Object*> parsed;
 
-    std::string StrLine;
-
-    int linenum = 0;
-    int id = linenum;
+    ParallelParseTextFile(FileName, MaxNumObjects, true /* skip empty lines */,
+                          LineParser(this), parsed,
+                          0 /* use all the cores */, arena);
 
-    while (getline(InFile, StrLine) && (!MaxNumObjects || linenum < MaxNumObjects)) {
-      if (StrLine.empty()) continue;
-      ReadSparseVec(StrLine, temp);
-      id = linenum;
-      ++linenum;
-      dataset.push_back(CreateObjFromVect(id, temp));
-    }
+    dataset.assign(parsed.begin(), parsed.end());
   } catch (const std::exception &e) {
     LOG(ERROR) << "Exception: " << e.what() << std::endl;
     LOG(FATAL) << "Failed to read/parse the file: '" << FileName << "'" << std::endl;
@@ -105,8 +120,8 @@ void SpaceSparseVector<dist_t>::ReadDataset(
 }
 
 template <typename dist_t>
-Object* SpaceSparseVector<dist_t>::CreateObjFromVect(size_t id, const std::vector<ElemType>& InpVect) const {
-  return new Object(id, InpVect.size() * sizeof(ElemType), &InpVect[0]);
+Object* SpaceSparseVector<dist_t>::CreateObjFromVect(size_t id, const std::vector<ElemType>& InpVect, ObjectArena* arena) const {
+  return NewObject(arena, id, InpVect.size() * sizeof(ElemType), &InpVect[0]);
 };
 
 template <typename dist_t>
@@ -23,31 +23,62 @@
 #include "logging.h"
 #include "distcomp.h"
 #include "experimentconf.h"
+#include "object_arena.h"
+#include "binary_dataset.h"
+#include "text_reader.h"
 
 namespace similarity {
 
 template <typename dist_t>
-void VectorSpace<dist_t>::ReadVec(std::string line, std::vector<dist_t>& v) const
+void VectorSpace<dist_t>::ReadVec(const char* line, size_t len, std::vector<dist_t>& v) const
 {
   v.clear();
-  std::stringstream str(line);
 
-  str.exceptions(std::ios::badbit);
+  const char* end = line + len;
+  dist_t      val;
 
-  dist_t val;
-
-  ReplaceSomePunct(line); 
+  while (ReadNextNum(line, end, val)) {
+    v.push_back(val);
+  }
+}
 
-  try {
-    while (str >> val) {
-      v.push_back(val);
+/*
+ * Parses a line and creates an object (in the arena of the thread, if it isn't NULL).
+ * Each reading thread has its own copy.
+ * The result is the object plus the original (not truncated) # of elements.
+ */
+template <typename dist_t>
+class VectorSpace<dist_t>::LineParser {
+ public:
+  typedef std::pair<Object*, int> ResultType;
+
+  LineParser(const VectorSpace<dist_t>* space, int RequestedDim, const char* FileName)
+    : space_(space), RequestedDim_(RequestedDim), FileName_(FileName) {}
+
+  ResultType operator()(size_t id, const char* line, size_t len, ObjectArena* arena) {
+    space_->ReadVec(line, len, temp_);
+    int currDim = static_cast<int>(temp_.size());
+
+    if (RequestedDim_) {
+      if (RequestedDim_ > currDim) {
+        // This function runs in a reading thread, the error is reported by ReadDataset
+        std::stringstream err;
+        err << "The # of vector elements (" << currDim << ")" <<
+               " is smaller than the requested # of dimensions. " <<
+               "Found mismatch in line: " << (id + 1) << " file: " << FileName_;
+        throw std::runtime_error(err.str());
+      }
+      temp_.resize(RequestedDim_);
     }
-  } catch (const std::exception &e) {
-    LOG(ERROR) << "Exception: " << e.what() << std::endl;
-    LOG(FATAL) << "Failed to parse the line: '" << line << "'" << std::endl;
+    return std::make_pair(space_->CreateObjFromVect(id, temp_, arena), currDim);
   }
-}
 
+ private:
+  const VectorSpace<dist_t>*  space_;
+  int                         RequestedDim_;
+  const char*                 FileName_;
+  std::vector<dist_t>         temp_;
+};
 
 template <typename dist_t>
 void VectorSpace<dist_t>::ReadDataset(
@@ -59,24 +90,30 @@ void VectorSpace<dist_t>::ReadDataset(
   dataset.clear();
   dataset.reserve(MaxNumObjects);
 
-  std::vector<dist_t>    temp;
+  ObjectArena* arena = config ? config->GetArena() : NULL;
 
-  std::ifstream InFile(FileName);
-  InFile.exceptions(std::ios::badbit);
+  if (IsBinaryDataset(FileName)) {
+    ReadBinaryDataset(dataset, arena, this->ToString(), DistTypeName<dist_t>(), FileName,
+                      config ? config->GetDimension() : 0, MaxNumObjects);
+    return;
+  }
+
+  const int RequestedDim = config ? config->GetDimension() : 0;
 
   try {
+    std::vector<typename LineParser::ResultType> parsed;
 
-    std::string StrLine;
+    ParallelParseTextFile(FileName, MaxNumObjects, false /* don't skip empty lines */,
+                          LineParser(this, RequestedDim, FileName), parsed,
+                          0 /* use all the cores */, arena);
 
-    int linenum = 0;
-    int id = linenum;
+    dataset.reserve(parsed.size());
 
     int dim = 0;
     int actualDim = 0;
 
-    while (getline(InFile, StrLine) && (!MaxNumObjects || linenum < MaxNumObjects)) {
-      ReadVec(StrLine, temp);
-      int currDim = static_cast<int>(temp.size());
+    for (size_t linenum = 0; linenum < parsed.size(); ++linenum) {
+      int currDim = parsed[linenum].second;
       if (!dim) dim = currDim;
       else {
         if (dim != currDim) {
@@ -85,22 +122,8 @@ void VectorSpace<dist_t>::ReadDataset(
                       "Found mismatch in line: " << (linenum + 1) << " file: " << FileName;
         }
       }
-
-      actualDim = dim;
-
-      if (config && config->GetDimension()) {
-        if (config->GetDimension() > currDim) {
-          LOG(FATAL) << "The # of vector elements (" << currDim << ")" <<
-                      " is smaller than the requested # of dimensions. " <<
-                      "Found mismatch in line: " << (linenum + 1) << " file: " << FileName;
-        } else {
-          actualDim = config->GetDimension();
-        }
-      }
-      temp.resize(actualDim);
-      id = linenum;
-      ++linenum;
-      dataset.push_back(CreateObjFromVect(id, temp));
+      actualDim = RequestedDim ? RequestedDim : dim;
+      dataset.push_back(parsed[linenum].first);
     }
     LOG(INFO) << "Actual dimensionality: " << actualDim;
   } catch (const std::exception &e) {
@@ -110,8 +133,20 @@ void VectorSpace<dist_t>::ReadDataset(
 }
 
 template <typename dist_t>
-Object* VectorSpace<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect) const {
-  return new Object(id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
+int VectorSpace<dist_t>::ReadDimensionality(const char* FileName) const {
+  std::ifstream InFile(FileName);
+  if (!InFile) {
+    LOG(FATAL) << "Cannot open file: '" << FileName << "'";
+  }
+  std::string         line;
+  std::vector<dist_t> v;
+  if (std::getline(InFile, line)) ReadVec(line.c_str(), line.size(), v);
+  return static_cast<int>(v.size());
+}
+
+template <typename dist_t>
+Object* VectorSpace<dist_t>::CreateObjFromVect(size_t id, const std::vector<dist_t>& InpVect, ObjectArena* arena) const {
+  return NewObject(arena, id, InpVect.size() * sizeof(dist_t), &InpVect[0]);
 };
 
 /* 
@@ -0,0 +1,102 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include "task_pool.h"
+
+namespace similarity {
+
+TaskPool::TaskPool(size_t ThreadQty) : stop_(false) {
+  for (size_t i = 1; i < ThreadQty; ++i) {
+    workers_.push_back(std::thread(&TaskPool::Worker, this));
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto& w : workers_) w.join();
+}
+
+void TaskPool::Spawn(TaskGroup& group, std::function<void()> task) {
+  if (workers_.empty()) {
+    task();
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++group.pending_;
+    queue_.push_back(Task{&group, std::move(task)});
+  }
+  cond_.notify_one();
+}
+
+void TaskPool::Wait(TaskGroup& group) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (group.pending_) {
+    if (!queue_.empty()) {
+      Task task = std::move(queue_.back());
+      queue_.pop_back();
+      lock.unlock();
+      Execute(task);
+      lock.lock();
+    } else {
+      cond_.wait(lock);
+    }
+  }
+  if (group.error_) {
+    std::exception_ptr error = group.error_;
+    group.error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskPool::Worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (!queue_.empty()) {
+      Task task = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      Execute(task);
+      lock.lock();
+    } else if (stop_) {
+      return;
+    } else {
+      cond_.wait(lock);
+    }
+  }
+}
+
+void TaskPool::Execute(Task& task) {
+  std::exception_ptr error;
+  try {
+    task.func_();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error && !task.group_->error_) task.group_->error_ = error;
+    --task.group_->pending_;
+  }
+  // Waiting threads need to check their groups
+  cond_.notify_all();
+}
+
+}   // namespace similarity
@@ -33,6 +33,7 @@
 #include "memory.h"
 #include "ztimer.h"
 #include "experiments.h"
+#include "gold_standard.h"
 #include "experimentconf.h"
 #include "space.h"
 #include "index.h"
@@ -61,6 +62,10 @@ template <typename dist_t>
 void GetOptimalAlphas(ExperimentConfig<dist_t>& config, 
                       const string& SpaceType,
                       AnyParams AllParams, 
+                      unsigned ThreadQty,
+                      unsigned MaxCacheGSRelativeQty,
+                      bool KeepAllDistsGS,
+                      unsigned ThreadGSQty,
                       float& recall, float& time_best, float& alpha_left_best, float& alpha_right_best) {
   time_best = std::numeric_limits<float>::max();
   alpha_left_best = 0;
@@ -83,6 +88,14 @@ void GetOptimalAlphas(ExperimentConfig<dist_t>& config,
 
   AnyParams  MethPars = pmgr.ExtractParametersExcept({"desiredRecall"});
 
+  // The gold standard is computed only once for each test set
+  vector<std::unique_ptr<GoldStandardManager<dist_t>>> managerGS(config.GetTestSetQty());
+  for (int TestSetId = 0; TestSetId < config.GetTestSetQty(); ++TestSetId) {
+    config.SelectTestSet(TestSetId);
+    managerGS[TestSetId].reset(new GoldStandardManager<dist_t>(config, MaxCacheGSRelativeQty, KeepAllDistsGS));
+    managerGS[TestSetId]->Compute(ThreadGSQty);
+  }
+
   for (unsigned iter = 0; iter < MaxIter; ++iter) {
     LOG(INFO) << "Iteration: " << iter << " StepFactor: " << StepFactor;
     double MinRecall = 1.0;
@@ -123,9 +136,10 @@ void GetOptimalAlphas(ExperimentConfig<dist_t>& config,
           IndexPtrs.push_back(MethodPtr.get());
 
           Experiments<dist_t>::RunAll(false /* don't print info */, 1 /* thread */,
+                                      false /* no hardware counters */,
                                       TestSetId,
                                       ExpResRange, ExpResKNN,
-                                      config, IndexPtrs);
+                                      config, *managerGS[TestSetId], IndexPtrs);
 
         }
         Stat.ComputeAll();
@@ -198,7 +212,11 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
              unsigned                       MaxNumQuery,
              vector<unsigned>               knnAll,
              float                          eps,
-             const string&                  RangeArg
+             const string&                  RangeArg,
+             unsigned                       ThreadTestQty,
+             unsigned                       MaxCacheGSRelativeQty,
+             bool                           KeepAllDistsGS,
+             unsigned                       ThreadGSQty
 )
 {
   vector<dist_t> rangeAll;
@@ -234,7 +252,8 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
       config.ReadDataset();
 
       float recall, time_best, alpha_left, alpha_right;
-      GetOptimalAlphas(config, SpaceType, MethPars, recall, time_best, alpha_left, alpha_right);
+      GetOptimalAlphas(config, SpaceType, MethPars, ThreadTestQty, MaxCacheGSRelativeQty, KeepAllDistsGS, ThreadGSQty,
+                       recall, time_best, alpha_left, alpha_right);
 
       LOG(INFO) << "Optimization results";
       LOG(INFO) << "Range: "  << rangeAll[i];
@@ -261,7 +280,8 @@ void RunExper(const multimap<string, shared_ptr<AnyParams>>& Methods,
       config.ReadDataset();
 
       float recall, time_best, alpha_left, alpha_right;
-      GetOptimalAlphas(config, SpaceType, MethPars, recall, time_best, alpha_left, alpha_right);
+      GetOptimalAlphas(config, SpaceType, MethPars, ThreadTestQty, MaxCacheGSRelativeQty, KeepAllDistsGS, ThreadGSQty,
+                       recall, time_best, alpha_left, alpha_right);
 
       LOG(INFO) << "Optimization results";
       LOG(INFO) << "K: "  << knnAll[i];
@@ -296,7 +316,14 @@ int main(int ac, char* av[]) {
   string                  RangeArg;
   unsigned                dimension;
   unsigned                ThreadTestQty;
+  bool                    PerfCounters;
   float                   eps;
+  string                  SaveIndexPrefix;
+  string                  LoadIndexPrefix;
+  string                  CachePrefixGS;
+  unsigned                MaxCacheGSRelativeQty;
+  bool                    KeepAllDistsGS;
+  unsigned                ThreadGSQty;
   multimap<string, shared_ptr<AnyParams>> Methods;
 
 
@@ -307,6 +334,7 @@ int main(int ac, char* av[]) {
                        SpaceParams,
                        dimension,
                        ThreadTestQty,
+                       PerfCounters,
                        DoAppend, 
                        ResFilePrefix,
                        TestSetQty,
@@ -317,8 +345,24 @@ int main(int ac, char* av[]) {
                        knn,
                        eps,
                        RangeArg,
+                       SaveIndexPrefix,
+                       LoadIndexPrefix,
+                       CachePrefixGS,
+                       MaxCacheGSRelativeQty,
+                       KeepAllDistsGS,
+                       ThreadGSQty,
                        Methods);
 
+  if (!SaveIndexPrefix.empty() || !LoadIndexPrefix.empty()) {
+    LOG(FATAL) << "Saving/loading of indices is not supported by this utility";
+  }
+  if (!CachePrefixGS.empty()) {
+    LOG(FATAL) << "Caching of the gold standard is not supported by this utility";
+  }
+  if (PerfCounters) {
+    LOG(FATAL) << "Hardware counters are not supported by this utility";
+  }
+
   ToLower(DistType);
 
   if ("int" == DistType) {
@@ -333,7 +377,11 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  ThreadTestQty,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else if ("float" == DistType) {
     RunExper<float>(Methods,
@@ -347,7 +395,11 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  ThreadTestQty,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else if ("double" == DistType) {
     RunExper<double>(Methods,
@@ -361,7 +413,11 @@ int main(int ac, char* av[]) {
                   MaxNumQuery,
                   knn,
                   eps,
-                  RangeArg
+                  RangeArg,
+                  ThreadTestQty,
+                  MaxCacheGSRelativeQty,
+                  KeepAllDistsGS,
+                  ThreadGSQty
                  );
   } else {
     LOG(FATAL) << "Unknown distance value type: " << DistType;
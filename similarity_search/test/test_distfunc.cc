@@ -222,6 +222,48 @@ bool TestL2Agree(size_t N, size_t dim, size_t Rep) {
     return true;
 }
 
+template <class T>
+bool TestTransposedAgree(size_t N, size_t dim, size_t Rep) {
+    /*
+     * The transposed versions perform the same operations as the SIMD versions,
+     * but the compiler may reorder operations in the SIMD versions (e.g., with -Ofast).
+     */
+    const size_t stride = max(N, kTransposedLaneQty);
+    vector<T> query(dim), block(dim * stride), vect(dim), out(N);
+
+    bool bug = false;
+
+    for (size_t i = 0; i < Rep && !bug; ++i) {
+        GenRandVect(&query[0], dim, -T(RANGE), T(RANGE));
+        GenRandVect(&block[0], dim * stride, -T(RANGE), T(RANGE));
+
+        size_t start = RandomInt() % N;
+        size_t qty = 1 + RandomInt() % (N - start);
+
+        for (int norm = 0; norm < 3 && !bug; ++norm) {
+            if (norm == 0) LInfNormTransposed(&query[0], &block[0], dim, stride, start, qty, &out[0]);
+            if (norm == 1) L1NormTransposed(&query[0], &block[0], dim, stride, start, qty, &out[0]);
+            if (norm == 2) L2NormTransposed(&query[0], &block[0], dim, stride, start, qty, &out[0]);
+
+            for (size_t k = 0; k < qty; ++k) {
+                for (size_t j = 0; j < dim; ++j) vect[j] = block[j * stride + start + k];
+
+                T val = norm == 0 ? LInfNormSIMD(&query[0], &vect[0], dim) :
+                        norm == 1 ? L1NormSIMD(&query[0], &vect[0], dim) :
+                                    L2NormSIMD(&query[0], &vect[0], dim);
+                if (fabs(val - out[k])/max(max(val, out[k]),T(1e-18)) > 1e-6) {
+                    cerr << "Bug transposed norm " << norm << " !!! Dim = " << dim << " N = " << N
+                         << " val = " << val << " transposed val = " << out[k] << endl;
+                    bug = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return !bug;
+}
+
 template <class T>
 bool TestItakuraSaitoAgree(size_t N, size_t dim, size_t Rep) {
     T* pVect1 = new T[dim];
@@ -696,6 +738,13 @@ TEST(TestAgree) {
         nTest++;
         nFail += !TestL2Agree<double>(1024, dim, 10);
 
+        for (size_t N = 1; N <= 40; ++N) {
+          nTest++;
+          nFail += !TestTransposedAgree<float>(N, dim, 10);
+          nTest++;
+          nFail += !TestTransposedAgree<double>(N, dim, 10);
+        }
+
         nTest++;
         nFail += !TestKLAgree<float>(1024, dim, 10);
         nTest++;
@@ -0,0 +1,74 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "histogram.h"
+#include "bunit.h"
+
+namespace similarity {
+
+// Log-normally distributed values (a typical shape of query times)
+static double RandomValue() {
+  double sum = 0;
+  for (int i = 0; i < 12; ++i) sum += static_cast<double>(rand()) / RAND_MAX;
+  return exp(2 * (sum - 6));
+}
+
+TEST(LogHistogramQuantiles) {
+  srand(0);
+  std::vector<double>  vals;
+  LogHistogram         hist1(1e-3, 1e7), hist2(1e-3, 1e7);
+
+  for (int i = 0; i < 20000; ++i) {
+    double v = RandomValue();
+    vals.push_back(v);
+    // Merged histograms should be as good as a single one
+    if (i % 3) hist1.Add(v); else hist2.Add(v);
+  }
+  hist1.Merge(hist2);
+  std::sort(vals.begin(), vals.end());
+
+  EXPECT_EQ(static_cast<uint64_t>(vals.size()), hist1.Count());
+  EXPECT_EQ(vals.front(), hist1.Min());
+  EXPECT_EQ(vals.back(), hist1.Max());
+
+  const double qs[] = {0.01, 0.5, 0.9, 0.95, 0.99, 0.999, 1};
+  for (double q: qs) {
+    double exact = vals[static_cast<size_t>(std::ceil(q * vals.size())) - 1];
+    // The maximum relative error is 2^(1/16) - 1 < 0.045
+    EXPECT_TRUE(std::fabs(hist1.Quantile(q) - exact) <= 0.045 * exact);
+  }
+}
+
+TEST(LogHistogramOutOfRange) {
+  LogHistogram hist(1, 1000);
+
+  hist.Add(0);
+  hist.Add(1e6);
+
+  // Values are counted in the first and the last buckets
+  EXPECT_TRUE(hist.Quantile(0.5) <= 1);
+  EXPECT_EQ(1e6, hist.Quantile(1));
+  EXPECT_EQ(static_cast<uint64_t>(1), hist.BucketCount(0));
+  EXPECT_EQ(static_cast<uint64_t>(1), hist.BucketCount(hist.BucketQty() - 1));
+}
+
+}  // namespace similarity
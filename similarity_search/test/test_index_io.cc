@@ -0,0 +1,585 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "space_lp.h"
+#include "knnqueue.h"
+#include "knnquery.h"
+#include "rangequery.h"
+#include "params.h"
+#include "distcomp.h"
+#include "searchoracle.h"
+#include "seqsearch.h"
+#include "vptree.h"
+#include "ghtree.h"
+#include "list_clusters.h"
+#include "metrized_small_world.h"
+#include "permutation_index.h"
+#include "permutation_index_incremental.h"
+#include "perm_index_incr_bin.h"
+#include "permutation_inverted_index.h"
+#include "permutation_prefix_index.h"
+#include "permutation_vptree.h"
+#include "perm_bin_vptree.h"
+#include "utils.h"
+#include "bunit.h"
+
+namespace similarity {
+
+typedef std::function<Index<float>*(bool BuildIndex)>  IndexCreator;
+typedef std::vector<std::pair<float, IdType>>          ResultType;
+
+static const size_t kDim        = 8;
+static const size_t kDataQty    = 2000;
+static const size_t kQueryQty   = 50;
+static const char*  kIndexFile  = "test_index_io.tmp";
+
+/*
+ * Random vectors in the unit cube (the same vectors in each run).
+ * If GridQty isn't zero, coordinates are integers from 0 to GridQty - 1:
+ * there are many duplicate vectors and equal distances.
+ */
+class RandomVectors {
+ public:
+  RandomVectors(const SpaceLp<float>& space, size_t qty, unsigned seed, unsigned GridQty = 0) {
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> distr(0, 1);
+    std::uniform_int_distribution<int>    GridDistr(0, GridQty ? GridQty - 1 : 0);
+    std::vector<float>                    vect(kDim);
+
+    for (size_t i = 0; i < qty; ++i) {
+      for (float& e: vect) e = GridQty ? GridDistr(gen) : distr(gen);
+      objects_.push_back(space.CreateObjFromVect(i, vect));
+    }
+  }
+  ~RandomVectors() {
+    for (const Object* obj: objects_) delete obj;
+  }
+  const ObjectVector& Get() const { return objects_; }
+ private:
+  ObjectVector objects_;
+};
+
+static ResultType GetResult(const KNNQuery<float>& query) {
+  ResultType res;
+  for (auto it = query.Result()->SortedBegin(); it != query.Result()->SortedEnd(); ++it) {
+    res.push_back(std::make_pair(it->first, reinterpret_cast<const Object*>(it->second)->id()));
+  }
+  return res;
+}
+
+static ResultType GetResult(const RangeQuery<float>& query) {
+  ResultType res;
+  for (size_t i = 0; i < query.Result()->size(); ++i) {
+    res.push_back(std::make_pair((*query.ResultDists())[i], (*query.Result())[i]->id()));
+  }
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+/*
+ * Builds an index for a small data set and saves it, then loads it into an index
+ * created without building. Both indices should return the same results.
+ * Searching can be randomized, so the random generator is re-seeded
+ * in the same way before each search.
+ */
+class SaveLoadTest {
+ public:
+  SaveLoadTest() : space_(2), data_(space_, kDataQty, 0), queries_(space_, kQueryQty, 1) {}
+
+  const SpaceLp<float>* space() const { return &space_; }
+  const ObjectVector&   data() const { return data_.Get(); }
+  const ObjectVector&   queries() const { return queries_.Get(); }
+
+  void Check(const IndexCreator& CreateIndex) {
+    std::unique_ptr<Index<float>> built(CreateIndex(true));
+    built->Save(kIndexFile);
+
+    std::unique_ptr<Index<float>> loaded(CreateIndex(false));
+    loaded->Load(kIndexFile);
+
+    remove(kIndexFile);
+    // Permutation VP-trees save the VP-tree separately
+    remove((std::string(kIndexFile) + ".vptree").c_str());
+
+    // Range searches shouldn't return empty results only
+    size_t RangeResultQty = 0;
+
+    for (size_t q = 0; q < kQueryQty; ++q) {
+      const Object*     query = queries_.Get()[q];
+      KNNQuery<float>   knn1(&space_, query, 10, 0), knn2(&space_, query, 10, 0);
+      RangeQuery<float> range1(&space_, query, 0.5), range2(&space_, query, 0.5);
+
+      RandomGen().seed(q);
+      built->Search(&knn1);
+      RandomGen().seed(q);
+      loaded->Search(&knn2);
+      EXPECT_EQ(knn1.ResultSize(), knn2.ResultSize());
+      EXPECT_TRUE(GetResult(knn1) == GetResult(knn2));
+
+      RandomGen().seed(q);
+      built->Search(&range1);
+      RandomGen().seed(q);
+      loaded->Search(&range2);
+      EXPECT_EQ(range1.ResultSize(), range2.ResultSize());
+      EXPECT_TRUE(GetResult(range1) == GetResult(range2));
+      RangeResultQty += range1.ResultSize();
+    }
+    EXPECT_TRUE(RangeResultQty > 0);
+  }
+ private:
+  SpaceLp<float>  space_;
+  RandomVectors   data_;
+  RandomVectors   queries_;
+};
+
+static std::vector<float> GetDists(const ResultType& res) {
+  std::vector<float> dists;
+  for (const auto& e : res) dists.push_back(e.first);
+  return dists;
+}
+
+/*
+ * An exact search should return the same results as the sequential search.
+ * Nearest neighbors are compared by distances only: neighbors with equal
+ * distances can be returned in a different order or replaced with each other.
+ */
+static void CheckExactSearch(const SpaceLp<float>* space, const ObjectVector& data,
+                             const ObjectVector& queries, Index<float>* index) {
+  SeqSearch<float> seq(data);
+  size_t           RangeResultQty = 0;
+
+  for (const Object* query : queries) {
+    KNNQuery<float>   knn1(space, query, 10, 0), knn2(space, query, 10, 0);
+    RangeQuery<float> range1(space, query, 0.5), range2(space, query, 0.5);
+
+    seq.Search(&knn1);
+    index->Search(&knn2);
+    EXPECT_EQ(knn1.ResultSize(), knn2.ResultSize());
+    EXPECT_TRUE(GetDists(GetResult(knn1)) == GetDists(GetResult(knn2)));
+
+    seq.Search(&range1);
+    index->Search(&range2);
+    EXPECT_EQ(range1.ResultSize(), range2.ResultSize());
+    EXPECT_TRUE(GetResult(range1) == GetResult(range2));
+    RangeResultQty += range1.ResultSize();
+  }
+  EXPECT_TRUE(RangeResultQty > 0);
+}
+
+/*
+ * Fatal errors terminate the program, so the function is called in a child process.
+ * Returns true if the child exits with an error.
+ */
+static bool ExitsWithError(const std::function<void()>& f) {
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid == 0) {
+    f();
+    _exit(0);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid) return false;
+  return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+/*
+ * An index can't be loaded for a data set that differs from the original one
+ * only in the contents of objects, i.e., objects have the same ids and sizes.
+ */
+TEST(LoadDifferentDataSet) {
+  SaveLoadTest    t;
+  RandomVectors   other(*t.space(), kDataQty, 2);
+
+  EXPECT_NE(DataSetHash(t.data()), DataSetHash(other.Get()));
+
+  std::unique_ptr<Index<float>> built(new GHTree<float>(t.space(), t.data(), AnyParams({"bucketSize=20"}), true));
+  built->Save(kIndexFile);
+
+  EXPECT_FALSE(ExitsWithError([&]() {
+    std::unique_ptr<Index<float>> loaded(new GHTree<float>(t.space(), t.data(), AnyParams({"bucketSize=20"}), true, false));
+    loaded->Load(kIndexFile);
+  }));
+  EXPECT_TRUE(ExitsWithError([&]() {
+    std::unique_ptr<Index<float>> loaded(new GHTree<float>(t.space(), other.Get(), AnyParams({"bucketSize=20"}), true, false));
+    loaded->Load(kIndexFile);
+  }));
+
+  remove(kIndexFile);
+}
+
+/*
+ * A corrupt vector size is reported before the vector is allocated.
+ */
+TEST(ReadVectorCorruptSize) {
+  SaveLoadTest t;
+  {
+    IndexFileWriter out(kIndexFile, "test", "", t.data());
+    out.WriteVector(vector<float>(10));
+    out.Write<uint64_t>(1ULL << 60);
+    out.Close();
+  }
+
+  EXPECT_FALSE(ExitsWithError([&]() {
+    IndexFileReader in(kIndexFile, "test", "", t.data());
+    vector<float> v;
+    in.ReadVector(v);
+  }));
+  EXPECT_TRUE(ExitsWithError([&]() {
+    IndexFileReader in(kIndexFile, "test", "", t.data());
+    vector<float> v;
+    in.ReadVector(v);
+    in.ReadVector(v);
+  }));
+
+  remove(kIndexFile);
+}
+
+TEST(SaveLoadVPTree) {
+  SaveLoadTest t;
+  TriangIneqCreator<float> OracleCreator(1, 1);
+  t.Check([&](bool BuildIndex) {
+    return new VPTree<float, TriangIneq<float>, TriangIneqCreator<float>>(
+                  false, OracleCreator, t.space(), t.data(),
+                  AnyParams({"bucketSize=20", "maxPathLen=2"}), true, BuildIndex);
+  });
+}
+
+/*
+ * If bucketSize is zero, a VP-tree built for a single object has only a pivot,
+ * which has neither shells nor an oracle.
+ */
+TEST(VPTreeSingleObject) {
+  SaveLoadTest              t;
+  const ObjectVector        data(1, t.data()[0]);
+  TriangIneqCreator<float>  OracleCreator(1, 1);
+
+  for (const char* layout : {"flatLayout=none", "flatLayout=dfs"}) {
+    for (const char* bestFirst : {"bestFirst=0", "bestFirst=1"}) {
+      VPTree<float, TriangIneq<float>, TriangIneqCreator<float>> index(
+                  false, OracleCreator, t.space(), data, AnyParams({"bucketSize=0", layout, bestFirst}), true);
+      KNNQuery<float> knn(t.space(), t.data()[1], 10, 0);
+      index.Search(&knn);
+      EXPECT_EQ(1U, knn.ResultSize());
+    }
+  }
+}
+
+/*
+ * With alphaLeft = alphaRight = 1, the VP-tree is exact for a metric space
+ * regardless of the layout of nodes and the order of visiting them.
+ */
+TEST(VPTreeExactSearch) {
+  SaveLoadTest              t;
+  TriangIneqCreator<float>  OracleCreator(1, 1);
+
+  for (const char* layout : {"flatLayout=none", "flatLayout=dfs", "flatLayout=veb"}) {
+    for (const char* bestFirst : {"bestFirst=0", "bestFirst=1"}) {
+      VPTree<float, TriangIneq<float>, TriangIneqCreator<float>> index(
+                  false, OracleCreator, t.space(), t.data(), AnyParams({"bucketSize=20", layout, bestFirst}), true);
+      CheckExactSearch(t.space(), t.data(), t.queries(), &index);
+    }
+  }
+}
+
+/*
+ * Distances to ancestor pivots filter out bucket objects
+ * only if they are guaranteed to be outside the query ball.
+ */
+TEST(VPTreeExactSearchPivotPaths) {
+  SaveLoadTest              t;
+  TriangIneqCreator<float>  OracleCreator(1, 1);
+
+  for (const char* layout : {"flatLayout=none", "flatLayout=dfs"}) {
+    VPTree<float, TriangIneq<float>, TriangIneqCreator<float>> index(
+                false, OracleCreator, t.space(), t.data(), AnyParams({"bucketSize=20", "maxPathLen=2", layout}), true);
+    CheckExactSearch(t.space(), t.data(), t.queries(), &index);
+  }
+}
+
+/*
+ * Shells of a VP-tree with a larger arity are found by quantiles. For vectors on a grid,
+ * quantiles of distances often coincide and a node becomes a bucket: small buckets
+ * force such nodes to appear deep in the tree.
+ */
+TEST(VPTreeExactSearchArity) {
+  SaveLoadTest              t;
+  RandomVectors             grid(*t.space(), kDataQty, 2, 2);
+  const ObjectVector        GridQueries(grid.Get().begin(), grid.Get().begin() + kQueryQty);
+  TriangIneqCreator<float>  OracleCreator(1, 1);
+
+  for (const char* arity : {"arity=3", "arity=4"}) {
+    for (const char* layout : {"flatLayout=none", "flatLayout=dfs"}) {
+      VPTree<float, TriangIneq<float>, TriangIneqCreator<float>> index(
+                  false, OracleCreator, t.space(), t.data(), AnyParams({"bucketSize=20", arity, layout}), true);
+      CheckExactSearch(t.space(), t.data(), t.queries(), &index);
+
+      VPTree<float, TriangIneq<float>, TriangIneqCreator<float>> GridIndex(
+                  false, OracleCreator, t.space(), grid.Get(), AnyParams({"bucketSize=1", arity, layout}), true);
+      CheckExactSearch(t.space(), grid.Get(), GridQueries, &GridIndex);
+    }
+  }
+}
+
+TEST(SaveLoadGHTree) {
+  SaveLoadTest t;
+  t.Check([&](bool BuildIndex) {
+    return new GHTree<float>(t.space(), t.data(), AnyParams({"bucketSize=20"}), true, BuildIndex);
+  });
+}
+
+TEST(SaveLoadListClusters) {
+  SaveLoadTest t;
+  t.Check([&](bool BuildIndex) {
+    return new ListClusters<float>(t.space(), t.data(), AnyParams({"bucketSize=50"}), BuildIndex);
+  });
+}
+
+TEST(SaveLoadSmallWorld) {
+  SaveLoadTest t;
+  t.Check([&](bool BuildIndex) {
+    return new Metrized_small_world<float>(t.space(), t.data(),
+                                           AnyParams({"NN=5", "initSearchAttempts=2", "indexThreadQty=1"}),
+                                           BuildIndex);
+  });
+  // Friend lists of the bottom and upper layers are pruned
+  t.Check([&](bool BuildIndex) {
+    return new Metrized_small_world<float>(t.space(), t.data(),
+                                           AnyParams({"NN=5", "maxDegree=6", "useHierarchy=1", "indexThreadQty=1"}),
+                                           BuildIndex);
+  });
+}
+
+/*
+ * Zero index threads means building in the calling thread. Building
+ * in the calling thread shouldn't change the state of its random generator:
+ * it should be the same as if the index were only created (and then loaded).
+ */
+TEST(SmallWorldSerialBuild) {
+  SaveLoadTest t;
+  const AnyParams params({"NN=5", "indexThreadQty=0", "seed=0"});
+
+  RandomGen().seed(0);
+  delete new Metrized_small_world<float>(t.space(), t.data(), params, false);
+  const mt19937 gen = RandomGen();
+
+  RandomGen().seed(0);
+  std::unique_ptr<Index<float>> index(new Metrized_small_world<float>(t.space(), t.data(), params, true));
+  EXPECT_TRUE(gen == RandomGen());
+
+  KNNQuery<float> knn(t.space(), t.data()[0], 10, 0);
+  index->Search(&knn);
+  EXPECT_EQ(10U, knn.ResultSize());
+}
+
+/*
+ * By default, the graph is built in one thread: the same seed produces the same graph.
+ * A specified seed doesn't consume numbers of the global random generator.
+ */
+TEST(SmallWorldSeed) {
+  SaveLoadTest    t;
+  const AnyParams params({"NN=5", "seed=1"});
+
+  RandomGen().seed(0);
+  const mt19937 gen = RandomGen();
+  std::unique_ptr<Index<float>> index1(new Metrized_small_world<float>(t.space(), t.data(), params, true));
+  EXPECT_TRUE(gen == RandomGen());
+  std::unique_ptr<Index<float>> index2(new Metrized_small_world<float>(t.space(), t.data(), params, true));
+
+  for (size_t q = 0; q < 10; ++q) {
+    KNNQuery<float> knn1(t.space(), t.data()[q], 10, 0), knn2(t.space(), t.data()[q], 10, 0);
+    RandomGen().seed(q);
+    index1->Search(&knn1);
+    RandomGen().seed(q);
+    index2->Search(&knn2);
+    EXPECT_TRUE(GetResult(knn1) == GetResult(knn2));
+  }
+}
+
+/*
+ * A range search in the graph is approximate: it can miss objects, but shouldn't
+ * return objects outside the query ball. Most objects should be found though.
+ */
+TEST(SmallWorldRangeSearch) {
+  SaveLoadTest      t;
+  SeqSearch<float>  seq(t.data());
+  std::unique_ptr<Index<float>> index(new Metrized_small_world<float>(t.space(), t.data(),
+                                                                      AnyParams({"NN=10", "seed=0"}), true));
+  size_t TrueQty = 0, FoundQty = 0;
+
+  for (const Object* query : t.queries()) {
+    RangeQuery<float> range1(t.space(), query, 0.5), range2(t.space(), query, 0.5);
+    seq.Search(&range1);
+    index->Search(&range2);
+
+    const ResultType res1 = GetResult(range1), res2 = GetResult(range2);
+    EXPECT_TRUE(std::includes(res1.begin(), res1.end(), res2.begin(), res2.end()));
+    TrueQty += res1.size();
+    FoundQty += res2.size();
+  }
+  EXPECT_TRUE(TrueQty > 0);
+  EXPECT_TRUE(FoundQty >= 0.9 * TrueQty);
+}
+
+/*
+ * Returns the fraction of the true nearest neighbors found by the index.
+ * The random generator is re-seeded before each search.
+ */
+static double KNNRecall(const SaveLoadTest& t, Index<float>* index) {
+  SeqSearch<float> seq(t.data());
+  size_t           FoundQty = 0, TrueQty = 0;
+
+  for (size_t q = 0; q < kQueryQty; ++q) {
+    const Object*   query = t.queries()[q];
+    KNNQuery<float> knn1(t.space(), query, 10, 0), knn2(t.space(), query, 10, 0);
+    seq.Search(&knn1);
+    RandomGen().seed(q);
+    index->Search(&knn2);
+
+    ResultType res1 = GetResult(knn1), res2 = GetResult(knn2);
+    std::sort(res1.begin(), res1.end());
+    std::sort(res2.begin(), res2.end());
+    ResultType common;
+    std::set_intersection(res1.begin(), res1.end(), res2.begin(), res2.end(), std::back_inserter(common));
+    FoundQty += common.size();
+    TrueQty += res1.size();
+  }
+  return TrueQty ? double(FoundQty) / TrueQty : 1;
+}
+
+/*
+ * With the same parameters (including the number of search attempts), searches
+ * starting from entry points found via the hierarchy should be at least as accurate
+ * as searches starting from random nodes. For a single graph, this isn't always true,
+ * so the recall is averaged over graphs built with different seeds. The descent
+ * starts from the first node of the top layer and ends in a node of the lowest upper layer.
+ */
+TEST(SmallWorldHierarchy) {
+  SaveLoadTest t;
+  double       FlatRecall = 0, HierRecall = 0;
+
+  for (const char* seed : {"seed=0", "seed=1", "seed=2", "seed=3", "seed=4", "seed=5", "seed=6", "seed=7"}) {
+    Metrized_small_world<float> flat(t.space(), t.data(),
+                                     AnyParams({"NN=10", "initSearchAttempts=1", "useHierarchy=0", seed}), true);
+    Metrized_small_world<float> hier(t.space(), t.data(),
+                                     AnyParams({"NN=10", "initSearchAttempts=1", "useHierarchy=1", seed}), true);
+    EXPECT_EQ(size_t(0), flat.getUpperLayerQty());
+    EXPECT_TRUE(hier.getUpperLayerQty() > 0);
+    FlatRecall += KNNRecall(t, &flat);
+    HierRecall += KNNRecall(t, &hier);
+
+    const size_t             TopLayer = hier.getUpperLayerQty();
+    const vector<MSWNodeId>& LowestIds = hier.getUpperLayerIds(1);
+    const Object*            TopObj = t.data()[hier.getUpperLayerIds(TopLayer)[0]];
+
+    for (const Object* query : t.queries()) {
+      KNNQuery<float> knn(t.space(), query, 10, 0);
+      RandomGen().seed(0);
+      const mt19937   gen = RandomGen();
+      const MSWNodeId id = hier.getEnterPoint(&knn);
+      // Entry points aren't random
+      EXPECT_TRUE(gen == RandomGen());
+      EXPECT_TRUE(std::binary_search(LowestIds.begin(), LowestIds.end(), id));
+      EXPECT_TRUE(knn.DistanceObjLeft(t.data()[id]) <= knn.DistanceObjLeft(TopObj));
+    }
+  }
+  EXPECT_TRUE(HierRecall >= FlatRecall);
+}
+
+/*
+ * Friend lists are pruned to maxDegree entries while the graph is built,
+ * so neither the frozen graph nor the upper layers have longer lists,
+ * which is also true for the loaded graph.
+ */
+TEST(SmallWorldMaxDegree) {
+  SaveLoadTest    t;
+  const size_t    MaxDegree = 6;
+  const AnyParams params({"NN=5", "maxDegree=6", "useHierarchy=1", "seed=0"});
+
+  // The graph isn't frozen until all the nodes are added
+  Metrized_small_world<float> unfrozen(t.space(), t.data(), params, false);
+  vector<MSWNode*>            nodes;
+  for (size_t i = 0; i < t.data().size(); ++i) {
+    nodes.push_back(new MSWNode(t.data()[i], i));
+    unfrozen.add(t.space(), nodes.back());
+  }
+  for (MSWNode* node : nodes) EXPECT_TRUE(node->getAllFriends().size() <= MaxDegree);
+
+  Metrized_small_world<float> built(t.space(), t.data(), params, true);
+  built.Save(kIndexFile);
+  Metrized_small_world<float> loaded(t.space(), t.data(), params, false);
+  loaded.Load(kIndexFile);
+  remove(kIndexFile);
+
+  EXPECT_TRUE(built.getUpperLayerQty() > 0);
+  EXPECT_EQ(built.getUpperLayerQty(), loaded.getUpperLayerQty());
+  for (size_t l = 0; l <= built.getUpperLayerQty(); ++l) {
+    EXPECT_TRUE(built.getMaxDegree(l) <= MaxDegree);
+    EXPECT_EQ(built.getMaxDegree(l), loaded.getMaxDegree(l));
+  }
+}
+
+TEST(SaveLoadPermutationIndices) {
+  SaveLoadTest t;
+  t.Check([&](bool BuildIndex) {
+    return new PermutationIndex<float>(t.space(), t.data(), 16, 0.1, SpearmanRhoSIMD, BuildIndex);
+  });
+  t.Check([&](bool BuildIndex) {
+    return new PermutationIndexIncremental<float, SpearmanRhoSIMD>(t.space(), t.data(), 16, 0.1, BuildIndex);
+  });
+  t.Check([&](bool BuildIndex) {
+    return new PermutationIndexIncrementalBin<float, SpearmanRhoSIMD>(t.space(), t.data(), 16, 8, 0.1, BuildIndex);
+  });
+  t.Check([&](bool BuildIndex) {
+    return new PermutationInvertedIndex<float>(t.space(), t.data(), 16, 8, 4, 16, 0.1, BuildIndex);
+  });
+  t.Check([&](bool BuildIndex) {
+    return new PermutationPrefixIndex<float>(t.space(), t.data(), 16, 4, 100, true, BuildIndex);
+  });
+}
+
+/*
+ * Distances between permutations (especially Hamming distances between binarized ones)
+ * have many ties. Ties are broken by comparing object pointers, which differ
+ * in the loaded index. Thus, candidates are the same only if all data objects are candidates.
+ */
+TEST(SaveLoadPermutationVPTrees) {
+  SaveLoadTest t;
+  t.Check([&](bool BuildIndex) {
+    return new PermutationVPTree<float, SpearmanRhoSIMD>(t.space(), t.data(),
+                                                         AnyParams({"numPivot=16", "bucketSize=20", "dbScanFrac=1"}),
+                                                         BuildIndex);
+  });
+  t.Check([&](bool BuildIndex) {
+    return new PermBinVPTree<float, SpearmanRhoSIMD>(t.space(), t.data(),
+                                                     AnyParams({"numPivot=32", "bucketSize=20", "dbScanFrac=1"}),
+                                                     BuildIndex);
+  });
+}
+
+}  // namespace similarity
@@ -0,0 +1,94 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "knnqueue.h"
+#include "bunit.h"
+
+namespace similarity {
+
+typedef std::pair<float, const void*> Elem;
+
+/*
+ * Compares the queue with the std::priority_queue-based implementation:
+ * the contents (in the sorted order) and the top distance should be the same
+ * after each insertion. The queue is reset and reused a few times.
+ */
+static bool CheckQueue(unsigned K, size_t InsertQty) {
+  KNNQueue<float> queue(K);
+
+  for (int iter = 0; iter < 3; ++iter) {
+    std::priority_queue<Elem> ref;
+    queue.Reset();
+
+    for (size_t i = 0; i < InsertQty; ++i) {
+      // Few distinct values to produce ties
+      float dist = static_cast<float>(rand() % 50);
+      const void* obj = reinterpret_cast<const void*>(i + 1);
+
+      queue.Push(dist, obj);
+      if (ref.size() < K) {
+        ref.push(Elem(dist, obj));
+      } else if (ref.top().first > dist) {
+        ref.pop();
+        ref.push(Elem(dist, obj));
+      }
+
+      if (queue.Size() != ref.size()) return false;
+      if (queue.TopDistance() != ref.top().first) return false;
+
+      if (i % 7 == 0) {
+        std::vector<Elem> expected;
+        std::priority_queue<Elem> tmp = ref;
+        while (!tmp.empty()) {
+          expected.insert(expected.begin(), tmp.top());
+          tmp.pop();
+        }
+        std::vector<Elem> actual(queue.SortedBegin(), queue.SortedEnd());
+        if (actual != expected) return false;
+      }
+    }
+    // Popping should return elements in the order of decreasing distances
+    while (!ref.empty()) {
+      if (queue.Empty() || queue.TopDistance() != ref.top().first) return false;
+      if (queue.Pop() != ref.top().second) return false;
+      ref.pop();
+    }
+    if (!queue.Empty()) return false;
+  }
+  return true;
+}
+
+TEST(KNNQueueSmallK) {
+  srand(0);
+  for (unsigned K = 1; K <= KNNQueue<float>::kSmallK; K += 3) {
+    EXPECT_TRUE(CheckQueue(K, 1000));
+  }
+}
+
+TEST(KNNQueueLargeK) {
+  srand(0);
+  EXPECT_TRUE(CheckQueue(KNNQueue<float>::kSmallK + 1, 1000));
+  EXPECT_TRUE(CheckQueue(100, 1000));
+  EXPECT_TRUE(CheckQueue(500, 300));
+}
+
+}  // namespace similarity
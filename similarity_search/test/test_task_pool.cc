@@ -0,0 +1,85 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+#include "task_pool.h"
+#include "bunit.h"
+
+namespace similarity {
+
+// Recursively splits the range in halves, the same way index construction does
+static void SumRange(TaskPool& pool, const std::vector<size_t>& vals,
+                     size_t start, size_t end, std::atomic<size_t>& sum) {
+  if (end - start <= 16) {
+    for (size_t i = start; i < end; ++i) sum += vals[i];
+    return;
+  }
+  size_t    mid = (start + end) / 2;
+  TaskGroup children;
+  pool.Spawn(children, [&]() { SumRange(pool, vals, start, mid, sum); });
+  SumRange(pool, vals, mid, end, sum);
+  pool.Wait(children);
+}
+
+TEST(TaskPoolNestedTasks) {
+  std::vector<size_t> vals(10000);
+  size_t              expected = 0;
+  for (size_t i = 0; i < vals.size(); ++i) {
+    vals[i] = i * i % 977;
+    expected += vals[i];
+  }
+  for (size_t ThreadQty = 1; ThreadQty <= 4; ++ThreadQty) {
+    TaskPool            pool(ThreadQty);
+    std::atomic<size_t> sum(0);
+
+    EXPECT_EQ(ThreadQty, pool.GetThreadQty());
+    SumRange(pool, vals, 0, vals.size(), sum);
+    EXPECT_EQ(expected, sum.load());
+  }
+}
+
+TEST(TaskPoolParallelFor) {
+  for (size_t ThreadQty = 1; ThreadQty <= 4; ++ThreadQty) {
+    TaskPool          pool(ThreadQty);
+    std::vector<int>  visited(1001);
+
+    pool.ParallelFor(0, visited.size(), 10, [&](size_t i) { visited[i]++; });
+    for (size_t i = 0; i < visited.size(); ++i) {
+      EXPECT_EQ(1, visited[i]);
+    }
+  }
+}
+
+TEST(TaskPoolException) {
+  TaskPool  pool(3);
+  TaskGroup group;
+  bool      caught = false;
+
+  for (int i = 0; i < 10; ++i) {
+    pool.Spawn(group, [i]() { if (i == 5) throw std::runtime_error("task failed"); });
+  }
+  try {
+    pool.Wait(group);
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  EXPECT_TRUE(caught);
+}
+
+}  // namespace similarity
@@ -0,0 +1,195 @@
+/**
+ * Non-metric Space Library
+ *
+ * Authors: Bilegsaikhan Naidan (https://github.com/bileg), Leonid Boytsov (http://boytsov.info).
+ * With contributions from Lawrence Cayton (http://lcayton.com/).
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/searchivarius/NonMetricSpaceLib
+ *
+ * Copyright (c) 2014
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include <stdio.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "text_reader.h"
+#include "bunit.h"
+
+namespace similarity {
+
+// Line i (empty lines are not counted) contains "i:2*i"
+class IdValueParser {
+ public:
+  typedef std::pair<size_t, int> ResultType;
+
+  ResultType operator()(size_t id, const char* line, size_t len, ObjectArena*) {
+    int key = -1, val = -1;
+    ReadNextNum(line, line + len, key);
+    ReadNextNum(line, line + len, val);
+    return key == static_cast<int>(id) && val == 2 * key ?
+            std::make_pair(id, val) : std::make_pair(id, -1);
+  }
+};
+
+// Lines aren't zero-terminated: numbers end at the end of the line
+TEST(ReadNextNumInLine) {
+  const char  text[] = "1.5,-2:3e1 x\n4";
+  const char* p = text;
+  const char* end = text + 12;
+  float       val = 0;
+
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(1.5f, val);
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(-2.0f, val);
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(30.0f, val);
+  // Not a number
+  EXPECT_FALSE(ReadNextNum(p, end, val));
+
+  const char  digits[] = "12 345";
+  uint32_t    num = 0;
+  p = digits;
+  end = digits + 5;
+  EXPECT_TRUE(ReadNextNum(p, end, num));
+  EXPECT_EQ(12U, num);
+  EXPECT_TRUE(ReadNextNum(p, end, num));
+  EXPECT_EQ(34U, num);
+  EXPECT_FALSE(ReadNextNum(p, end, num));
+}
+
+// As with stream >> val, only decimal floating-point numbers are accepted
+TEST(ReadNextNumDecimal) {
+  const char* tokens[] = {"nan", "-inf", "infinity", "0x1p3", "-0X10", "e5", "."};
+  for (const char* token : tokens) {
+    const char* p = token;
+    double      val = 0;
+    EXPECT_FALSE(ReadNextNum(p, token + strlen(token), val));
+  }
+
+  const char  text[] = "-.5 +0.25 0 1e-2";
+  const char* p = text;
+  const char* end = text + strlen(text);
+  double      val = 0;
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(-0.5, val);
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(0.25, val);
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(0.0, val);
+  EXPECT_TRUE(ReadNextNum(p, end, val));
+  EXPECT_EQ(1e-2, val);
+  EXPECT_FALSE(ReadNextNum(p, end, val));
+}
+
+// The file is large enough to be split into several chunks
+static const int kLineQty = 300000;
+
+static std::string CreateTextFile() {
+  std::string FileName = "test_text_reader.tmp";
+  std::ofstream out(FileName.c_str());
+  for (int i = 0; i < kLineQty; ++i) {
+    out << i << ":" << 2 * i << "\n";
+    if (i % 1000 == 0) out << "\n";
+  }
+  return FileName;
+}
+
+static bool CheckResult(const std::vector<IdValueParser::ResultType>& res, size_t qty) {
+  if (res.size() != qty) return false;
+  for (size_t i = 0; i < res.size(); ++i) {
+    if (res[i].first != i || res[i].second != static_cast<int>(2 * i)) return false;
+  }
+  return true;
+}
+
+TEST(ParallelParseTextFile) {
+  std::string FileName = CreateTextFile();
+  std::vector<IdValueParser::ResultType> res;
+
+  for (unsigned ThreadQty = 1; ThreadQty <= 4; ++ThreadQty) {
+    ParallelParseTextFile(FileName.c_str(), 0, true, IdValueParser(), res, ThreadQty);
+    EXPECT_TRUE(CheckResult(res, kLineQty));
+
+    ParallelParseTextFile(FileName.c_str(), kLineQty / 2 + 1, true, IdValueParser(), res, ThreadQty);
+    EXPECT_TRUE(CheckResult(res, kLineQty / 2 + 1));
+  }
+
+  remove(FileName.c_str());
+}
+
+// Creates objects whose data is the value of the line
+class ObjectParser {
+ public:
+  typedef Object* ResultType;
+
+  ResultType operator()(size_t id, const char* line, size_t len, ObjectArena* arena) {
+    int key = -1, val = -1;
+    ReadNextNum(line, line + len, key);
+    ReadNextNum(line, line + len, val);
+    return NewObject(arena, id, sizeof(val), &val);
+  }
+};
+
+TEST(ParallelParseTextFileToArena) {
+  std::string FileName = CreateTextFile();
+  std::vector<Object*> res;
+
+  for (unsigned ThreadQty = 1; ThreadQty <= 4; ++ThreadQty) {
+    ObjectArena arena;
+    ParallelParseTextFile(FileName.c_str(), 0, true, ObjectParser(), res, ThreadQty, &arena);
+    EXPECT_EQ(static_cast<size_t>(kLineQty), res.size());
+    EXPECT_EQ(res.size(), arena.ObjectQty());
+    bool ok = true;
+    for (size_t i = 0; i < res.size(); ++i) {
+      ok = ok && arena.Owns(res[i]) && res[i]->id() == static_cast<IdType>(i) &&
+           *reinterpret_cast<const int*>(res[i]->data()) == static_cast<int>(2 * i);
+    }
+    EXPECT_TRUE(ok);
+  }
+
+  remove(FileName.c_str());
+}
+
+// Fails to parse the middle and the last lines
+class FailingParser {
+ public:
+  typedef size_t ResultType;
+
+  ResultType operator()(size_t id, const char*, size_t, ObjectArena*) {
+    if (id == kLineQty / 2 || id + 1 == kLineQty) {
+      throw std::runtime_error(std::to_string(id));
+    }
+    return id;
+  }
+};
+
+TEST(ParallelParseTextFileError) {
+  std::string FileName = CreateTextFile();
+  std::vector<size_t> res;
+
+  for (unsigned ThreadQty = 1; ThreadQty <= 4; ++ThreadQty) {
+    std::string error;
+    try {
+      ParallelParseTextFile(FileName.c_str(), 0, true, FailingParser(), res, ThreadQty);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    // The error in the earliest line is reported
+    EXPECT_TRUE(std::to_string(kLineQty / 2) == error);
+  }
+
+  remove(FileName.c_str());
+}
+
+}  // namespace similarity